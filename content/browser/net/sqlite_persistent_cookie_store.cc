@@ -67,7 +67,9 @@ namespace content {
 // Subsequent to loading, mutations may be queued by any thread using
 // AddCookie, UpdateCookieAccessTime, and DeleteCookie. These are flushed to
 // disk on the BG runner every 30 seconds, 512 operations, or call to Flush(),
-// whichever occurs first.
+// whichever occurs first. Operations on a cookie that is still pending are
+// coalesced: an addition followed by a deletion cancels out, and repeated
+// access time updates collapse into the latest one.
 class SQLitePersistentCookieStore::Backend
     : public base::RefCountedThreadSafe<SQLitePersistentCookieStore::Backend> {
  public:
@@ -141,7 +143,9 @@ class SQLitePersistentCookieStore::Backend
         : op_(op), cc_(cc) { }
 
     OperationType op() const { return op_; }
+    void set_op(OperationType op) { op_ = op; }
     const net::CanonicalCookie& cc() const { return cc_; }
+    void set_cc(const net::CanonicalCookie& cc) { cc_ = cc; }
 
    private:
     OperationType op_;
@@ -196,6 +200,11 @@ class SQLitePersistentCookieStore::Backend
   // Batch a cookie operation (add or delete)
   void BatchOperation(PendingOperation::OperationType op,
                       const net::CanonicalCookie& cc);
+  // Folds |op| into the operation still pending for the same cookie, if any.
+  // Returns false if |op| must be queued on its own. Must be called with
+  // |lock_| held.
+  bool CoalesceOperation(PendingOperation::OperationType op,
+                         const net::CanonicalCookie& cc);
   // Commit our pending operations to the database.
   void Commit();
   // Close() executed on the background runner.
@@ -219,10 +228,16 @@ class SQLitePersistentCookieStore::Backend
 
   typedef std::list<PendingOperation*> PendingOperationsList;
   PendingOperationsList pending_;
+  // Number of operations batched since the last commit, including those
+  // coalesced away.
   PendingOperationsList::size_type num_pending_;
+  // Last operation in |pending_| for each cookie, keyed by creation date.
+  typedef std::map<int64, PendingOperationsList::iterator> PendingOperationsMap;
+  PendingOperationsMap pending_by_creation_date_;
   // True if the persistent store should skip delete on exit rules.
   bool force_keep_session_state_;
-  // Guard |cookies_|, |pending_|, |num_pending_|, |force_keep_session_state_|
+  // Guard |cookies_|, |pending_|, |num_pending_|, |pending_by_creation_date_|,
+  // |force_keep_session_state_|
   base::Lock lock_;
 
   // Temporary buffer for cookies loaded from DB. Accumulates cookies to reduce
@@ -929,13 +944,17 @@ void SQLitePersistentCookieStore::Backend::BatchOperation(
   static const size_t kCommitAfterBatchSize = 512;
   DCHECK(!background_task_runner_->RunsTasksOnCurrentThread());
 
-  // We do a full copy of the cookie here, and hopefully just here.
-  scoped_ptr<PendingOperation> po(new PendingOperation(op, cc));
-
   PendingOperationsList::size_type num_pending;
   {
     base::AutoLock locked(lock_);
-    pending_.push_back(po.release());
+    if (!CoalesceOperation(op, cc)) {
+      // We do a full copy of the cookie here, and hopefully just here.
+      pending_.push_back(new PendingOperation(op, cc));
+      pending_by_creation_date_[cc.CreationDate().ToInternalValue()] =
+          --pending_.end();
+    }
+    // Coalesced operations still count towards the batch size, so that a
+    // stream of updates to the same cookies is not held back indefinitely.
     num_pending = ++num_pending_;
   }
 
@@ -952,6 +971,51 @@ void SQLitePersistentCookieStore::Backend::BatchOperation(
   }
 }
 
+bool SQLitePersistentCookieStore::Backend::CoalesceOperation(
+    PendingOperation::OperationType op,
+    const net::CanonicalCookie& cc) {
+  lock_.AssertAcquired();
+  PendingOperationsMap::iterator map_it =
+      pending_by_creation_date_.find(cc.CreationDate().ToInternalValue());
+  if (map_it == pending_by_creation_date_.end())
+    return false;
+  PendingOperationsList::iterator list_it = map_it->second;
+  PendingOperation* pending = *list_it;
+
+  switch (op) {
+    case PendingOperation::COOKIE_ADD:
+      // The pending operation must be a deletion of a cookie with the same
+      // creation date; both have to reach the database, in order.
+      return false;
+
+    case PendingOperation::COOKIE_UPDATEACCESS:
+      if (pending->op() == PendingOperation::COOKIE_DELETE)
+        return false;
+      // A pending addition writes the new access time along with the cookie,
+      // and a pending update is superseded.
+      pending->set_cc(cc);
+      return true;
+
+    case PendingOperation::COOKIE_DELETE:
+      if (pending->op() == PendingOperation::COOKIE_ADD) {
+        // The cookie never made it to the database.
+        delete pending;
+        pending_.erase(list_it);
+        pending_by_creation_date_.erase(map_it);
+        return true;
+      }
+      if (pending->op() == PendingOperation::COOKIE_UPDATEACCESS) {
+        pending->set_op(PendingOperation::COOKIE_DELETE);
+        pending->set_cc(cc);
+        return true;
+      }
+      return false;
+  }
+
+  NOTREACHED();
+  return false;
+}
+
 void SQLitePersistentCookieStore::Backend::Commit() {
   DCHECK(background_task_runner_->RunsTasksOnCurrentThread());
 
@@ -959,6 +1023,7 @@ void SQLitePersistentCookieStore::Backend::Commit() {
   {
     base::AutoLock locked(lock_);
     pending_.swap(ops);
+    pending_by_creation_date_.clear();
     num_pending_ = 0;
   }
 
@@ -8,6 +8,7 @@
 #include "base/compiler_specific.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/sequenced_task_runner.h"
+#include "base/stl_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/test/perf_time_logger.h"
@@ -140,4 +141,30 @@ TEST_F(SQLitePersistentCookieStorePerfTest, TestLoadPerformance) {
   ASSERT_EQ(15000U, cookies_.size());
 }
 
+// Test the performance of committing repeated access time updates followed by
+// the deletion of every cookie.
+TEST_F(SQLitePersistentCookieStorePerfTest, TestUpdateAndDeletePerformance) {
+  Load();
+  ASSERT_EQ(15000U, cookies_.size());
+
+  base::PerfTimeLogger timer("Update and delete all cookies");
+  base::Time t = base::Time::Now();
+  for (int update = 0; update < 10; ++update) {
+    t += base::TimeDelta::FromSeconds(1);
+    for (size_t i = 0; i < cookies_.size(); ++i) {
+      cookies_[i]->SetLastAccessDate(t);
+      store_->UpdateCookieAccessTime(*cookies_[i]);
+    }
+  }
+  for (size_t i = 0; i < cookies_.size(); ++i)
+    store_->DeleteCookie(*cookies_[i]);
+  base::WaitableEvent flushed(false, false);
+  store_->Flush(base::Bind(&base::WaitableEvent::Signal,
+                           base::Unretained(&flushed)));
+  flushed.Wait();
+  timer.Done();
+
+  STLDeleteElements(&cookies_);
+}
+
 }  // namespace content
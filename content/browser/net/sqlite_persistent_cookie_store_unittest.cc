@@ -358,6 +358,46 @@ TEST_F(SQLitePersistentCookieStoreTest, TestFlush) {
   ASSERT_GT(info.size, base_size);
 }
 
+// Test that operations on a cookie which is still pending are coalesced.
+TEST_F(SQLitePersistentCookieStoreTest, TestCoalescePendingOperations) {
+  InitializeStore(false, false);
+  base::Time t = base::Time::Now();
+  base::Time accessed = t + base::TimeDelta::FromMinutes(2);
+
+  // An addition followed by a deletion never reaches the database.
+  net::CanonicalCookie removed(GURL(), "A", "B", "foo.bar", "/", t, t, t,
+                               false, false, net::COOKIE_PRIORITY_DEFAULT);
+  store_->AddCookie(removed);
+  store_->DeleteCookie(removed);
+
+  // Access time updates of a pending addition are folded into it.
+  base::Time kept_creation = t + base::TimeDelta::FromMicroseconds(1);
+  net::CanonicalCookie kept(GURL(), "C", "D", "foo.bar", "/", kept_creation,
+                            kept_creation, kept_creation, false, false,
+                            net::COOKIE_PRIORITY_DEFAULT);
+  store_->AddCookie(kept);
+  kept.SetLastAccessDate(t + base::TimeDelta::FromMinutes(1));
+  store_->UpdateCookieAccessTime(kept);
+  kept.SetLastAccessDate(accessed);
+  store_->UpdateCookieAccessTime(kept);
+  DestroyStore();
+
+  CanonicalCookieVector cookies;
+  CreateAndLoad(false, false, &cookies);
+  ASSERT_EQ(1U, cookies.size());
+  EXPECT_EQ("C", cookies[0]->Name());
+  EXPECT_EQ(accessed, cookies[0]->LastAccessDate());
+
+  // An update followed by a deletion deletes the cookie.
+  store_->UpdateCookieAccessTime(*cookies[0]);
+  store_->DeleteCookie(*cookies[0]);
+  DestroyStore();
+  STLDeleteElements(&cookies);
+
+  CreateAndLoad(false, false, &cookies);
+  EXPECT_EQ(0U, cookies.size());
+}
+
 // Test loading old session cookies from the disk.
 TEST_F(SQLitePersistentCookieStoreTest, TestLoadOldSessionCookies) {
   InitializeStore(false, true);
@@ -136,6 +136,20 @@ class ExpiringCache {
     return &it->second.first;
   }
 
+  // Returns the value matching |key| whether or not it has expired, and sets
+  // |*expiration| to its expiration. Returns NULL if the item is not found.
+  // Unlike Get(), expired items are left in the cache.
+  // Note: The returned pointer remains owned by the ExpiringCache and is
+  // invalidated by a call to a non-const method.
+  const ValueType* Peek(const KeyType& key, ExpirationType* expiration) const {
+    typename EntryMap::const_iterator it = entries_.find(key);
+    if (it == entries_.end())
+      return NULL;
+
+    *expiration = it->second.second;
+    return &it->second.first;
+  }
+
   // Updates or replaces the value associated with |key|.
   void Put(const KeyType& key,
            const ValueType& value,
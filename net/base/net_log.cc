@@ -4,6 +4,8 @@
 
 #include "net/base/net_log.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/logging.h"
 #include "base/strings/string_number_conversions.h"
@@ -198,13 +200,24 @@ void NetLog::ThreadSafeObserver::OnAddEntryData(const EntryData& entry_data) {
   OnAddEntry(Entry(&entry_data, log_level()));
 }
 
+NetLog::ObserverList::ObserverList() : dispatch_count(0) {
+}
+
+NetLog::ObserverList::~ObserverList() {
+  DCHECK_EQ(0, dispatch_count);
+}
+
 NetLog::NetLog()
-    : last_id_(0),
+    : dispatch_done_(&lock_),
+      last_id_(0),
       base_log_level_(LOG_NONE),
-      effective_log_level_(LOG_NONE) {
+      effective_log_level_(LOG_NONE),
+      num_observers_(0),
+      observer_list_(new ObserverList()) {
 }
 
 NetLog::~NetLog() {
+  DCHECK(observer_list_->observers.empty());
 }
 
 void NetLog::AddGlobalEntry(EventType type) {
@@ -248,7 +261,9 @@ void NetLog::AddThreadSafeObserver(
 
   DCHECK(!observer->net_log_);
   DCHECK_EQ(LOG_NONE, observer->log_level_);
-  observers_.AddObserver(observer);
+  scoped_ptr<ObserverList> observer_list = CopyObserverList();
+  observer_list->observers.push_back(observer);
+  ReplaceObserverList(observer_list.Pass());
   observer->net_log_ = this;
   observer->log_level_ = log_level;
   UpdateLogLevel();
@@ -260,7 +275,9 @@ void NetLog::SetObserverLogLevel(
   DCHECK_NE(LOG_NONE, log_level);
   base::AutoLock lock(lock_);
 
-  DCHECK(observers_.HasObserver(observer));
+  DCHECK(std::find(observer_list_->observers.begin(),
+                   observer_list_->observers.end(),
+                   observer) != observer_list_->observers.end());
   DCHECK_EQ(this, observer->net_log_);
   DCHECK_NE(LOG_NONE, observer->log_level_);
   observer->log_level_ = log_level;
@@ -271,10 +288,16 @@ void NetLog::RemoveThreadSafeObserver(
     net::NetLog::ThreadSafeObserver* observer) {
   base::AutoLock lock(lock_);
 
-  DCHECK(observers_.HasObserver(observer));
+  scoped_ptr<ObserverList> observer_list = CopyObserverList();
+  ObserverVector::iterator it =
+      std::find(observer_list->observers.begin(),
+                observer_list->observers.end(),
+                observer);
+  DCHECK(it != observer_list->observers.end());
   DCHECK_EQ(this, observer->net_log_);
   DCHECK_NE(LOG_NONE, observer->log_level_);
-  observers_.RemoveObserver(observer);
+  observer_list->observers.erase(it);
+  ReplaceObserverList(observer_list.Pass());
   observer->net_log_ = NULL;
   observer->log_level_ = LOG_NONE;
   UpdateLogLevel();
@@ -286,16 +309,37 @@ void NetLog::UpdateLogLevel() {
   // Look through all the observers and find the finest granularity
   // log level (higher values of the enum imply *lower* log levels).
   LogLevel new_effective_log_level = base_log_level_;
-  ObserverListBase<ThreadSafeObserver>::Iterator it(observers_);
-  ThreadSafeObserver* observer;
-  while ((observer = it.GetNext()) != NULL) {
+  for (ObserverVector::const_iterator it =
+           observer_list_->observers.begin();
+       it != observer_list_->observers.end(); ++it) {
     new_effective_log_level =
-        std::min(new_effective_log_level, observer->log_level());
+        std::min(new_effective_log_level, (*it)->log_level());
   }
   base::subtle::NoBarrier_Store(&effective_log_level_,
                                 new_effective_log_level);
 }
 
+scoped_ptr<NetLog::ObserverList> NetLog::CopyObserverList() const {
+  lock_.AssertAcquired();
+  scoped_ptr<ObserverList> observer_list(new ObserverList());
+  observer_list->observers = observer_list_->observers;
+  return observer_list.Pass();
+}
+
+void NetLog::ReplaceObserverList(scoped_ptr<ObserverList> observer_list) {
+  lock_.AssertAcquired();
+  scoped_ptr<ObserverList> old_observer_list(observer_list_.release());
+  observer_list_ = observer_list.Pass();
+  base::subtle::NoBarrier_Store(
+      &num_observers_,
+      static_cast<base::subtle::Atomic32>(observer_list_->observers.size()));
+
+  // New entries go to the new list, so this only waits for the entries
+  // already being passed to the observers of the old one.
+  while (old_observer_list->dispatch_count > 0)
+    dispatch_done_.Wait();
+}
+
 // static
 std::string NetLog::TickCountToString(const base::TimeTicks& time) {
   int64 delta_time = (time - base::TimeTicks()).InMilliseconds();
@@ -400,12 +444,32 @@ void NetLog::AddEntry(EventType type,
                       const NetLog::ParametersCallback* parameters_callback) {
   if (GetLogLevel() == LOG_NONE)
     return;
+  // A base log level may be set without anyone watching.
+  if (base::subtle::NoBarrier_Load(&num_observers_) == 0)
+    return;
   EntryData entry_data(type, source, phase, base::TimeTicks::Now(),
                        parameters_callback);
 
-  // Notify all of the log observers.
+  // Notify all of the log observers, without holding |lock_| so that entries
+  // added on other threads are not blocked meanwhile.
+  ObserverList* observer_list;
+  {
+    base::AutoLock lock(lock_);
+    observer_list = observer_list_.get();
+    ++observer_list->dispatch_count;
+  }
+  for (ObserverVector::const_iterator it =
+           observer_list->observers.begin();
+       it != observer_list->observers.end(); ++it) {
+    (*it)->OnAddEntryData(entry_data);
+  }
+
   base::AutoLock lock(lock_);
-  FOR_EACH_OBSERVER(ThreadSafeObserver, observers_, OnAddEntryData(entry_data));
+  --observer_list->dispatch_count;
+  if (observer_list->dispatch_count == 0 &&
+      observer_list != observer_list_.get()) {
+    dispatch_done_.Broadcast();
+  }
 }
 
 void BoundNetLog::AddEntry(NetLog::EventType type,
@@ -6,13 +6,16 @@
 #define NET_BASE_NET_LOG_H_
 
 #include <string>
+#include <vector>
 
 #include "base/atomicops.h"
 #include "base/basictypes.h"
 #include "base/callback_forward.h"
 #include "base/compiler_specific.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/observer_list.h"
 #include "base/strings/string16.h"
+#include "base/synchronization/condition_variable.h"
 #include "base/synchronization/lock.h"
 #include "base/time/time.h"
 #include "net/base/net_export.h"
@@ -177,7 +180,9 @@ class NET_EXPORT NetLog {
     // observe a single NetLog at a time.
     //
     // Observers will be called on the same thread an entry is added on,
-    // and are responsible for ensuring their own thread safety.
+    // and are responsible for ensuring their own thread safety.  Entries
+    // added on different threads may be passed to an observer at the same
+    // time.
     //
     // Observers must stop watching a NetLog before either the Observer or the
     // NetLog is destroyed.
@@ -312,13 +317,41 @@ class NET_EXPORT NetLog {
                 EventPhase phase,
                 const NetLog::ParametersCallback* parameters_callback);
 
+  typedef std::vector<ThreadSafeObserver*> ObserverVector;
+
+  // The observers entries are passed to, with the number of AddEntry() calls
+  // passing them an entry.  Both are only accessed with |lock_| held.
+  struct ObserverList {
+    ObserverList();
+    ~ObserverList();
+
+    ObserverVector observers;
+    int dispatch_count;
+  };
+
   // Called whenever an observer is added or removed, or has its log level
   // changed.  Must have acquired |lock_| prior to calling.
   void UpdateLogLevel();
 
-  // |lock_| protects access to |observers_|.
+  // Makes a copy of the current observers, to be changed and passed to
+  // ReplaceObserverList().  Must have acquired |lock_| prior to calling.
+  scoped_ptr<ObserverList> CopyObserverList() const;
+
+  // Makes |observer_list| the current list of observers, then waits for the
+  // AddEntry() calls still passing entries to the observers of the previous
+  // list, so that an observer is never notified after
+  // RemoveThreadSafeObserver() returns.  Must have acquired |lock_| prior to
+  // calling.
+  void ReplaceObserverList(scoped_ptr<ObserverList> observer_list);
+
+  // |lock_| protects access to |observer_list_|.  It is not held while
+  // observers are notified.
   base::Lock lock_;
 
+  // Signaled when the last AddEntry() call notifying the observers of a
+  // replaced ObserverList is done.
+  base::ConditionVariable dispatch_done_;
+
   // Last assigned source ID.  Incremented to get the next one.
   base::subtle::Atomic32 last_id_;
 
@@ -329,8 +362,15 @@ class NET_EXPORT NetLog {
   // The current log level.
   base::subtle::Atomic32 effective_log_level_;
 
-  // |lock_| must be acquired whenever reading or writing to this.
-  ObserverList<ThreadSafeObserver, true> observers_;
+  // Number of observers, readable without acquiring |lock_|.  AddEntry()
+  // uses it to skip locking when nobody is watching.
+  base::subtle::Atomic32 num_observers_;
+
+  // |lock_| must be acquired whenever reading or writing to this.  The list
+  // is replaced rather than modified when observers are added or removed, so
+  // that AddEntry() can notify the observers of the list it started with
+  // without holding |lock_|.
+  scoped_ptr<ObserverList> observer_list_;
 
   DISALLOW_COPY_AND_ASSIGN(NetLog);
 };
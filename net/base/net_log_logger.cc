@@ -94,6 +94,7 @@ void NetLogLogger::OnAddEntry(const net::NetLog::Entry& entry) {
   scoped_ptr<base::Value> value(entry.ToValue());
   std::string json;
   base::JSONWriter::Write(value.get(), &json);
+  base::AutoLock lock(lock_);
   fprintf(file_.get(), "%s%s",
           (added_events_ ? ",\n" : ""),
           json.c_str());
@@ -9,6 +9,7 @@
 
 #include "base/files/scoped_file.h"
 #include "base/macros.h"
+#include "base/synchronization/lock.h"
 #include "net/base/net_log.h"
 
 namespace base {
@@ -53,6 +54,10 @@ class NET_EXPORT NetLogLogger : public NetLog::ThreadSafeObserver {
   // The LogLevel to log at.
   NetLog::LogLevel log_level_;
 
+  // Guards |file_| and |added_events_| in OnAddEntry(), which may be called
+  // on several threads at once.
+  base::Lock lock_;
+
   // True if OnAddEntry() has been called at least once.
   bool added_events_;
 
@@ -0,0 +1,82 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/net_log.h"
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumEvents = 1000000;
+
+// Counts events without looking at their parameters, so that only the cost
+// of dispatching is measured.
+class CountingObserver : public NetLog::ThreadSafeObserver {
+ public:
+  CountingObserver() : count_(0) {}
+
+  virtual ~CountingObserver() {
+    if (net_log())
+      net_log()->RemoveThreadSafeObserver(this);
+  }
+
+  virtual void OnAddEntry(const NetLog::Entry& entry) OVERRIDE {
+    ++count_;
+  }
+
+  int count() const { return count_; }
+
+ private:
+  int count_;
+};
+
+void AddEventsWithObservers(size_t num_observers) {
+  NetLog net_log;
+  ScopedVector<CountingObserver> observers;
+  for (size_t i = 0; i < num_observers; ++i) {
+    observers.push_back(new CountingObserver());
+    net_log.AddThreadSafeObserver(observers.back(), NetLog::LOG_ALL_BUT_BYTES);
+  }
+  BoundNetLog bound_net_log =
+      BoundNetLog::Make(&net_log, NetLog::SOURCE_URL_REQUEST);
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumEvents; ++i) {
+    bound_net_log.AddEvent(NetLog::TYPE_CANCELLED,
+                           NetLog::IntegerCallback("index", i));
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  for (size_t i = 0; i < num_observers; ++i)
+    EXPECT_EQ(kNumEvents, observers[i]->count());
+  base::LogPerfResult(
+      base::StringPrintf("NetLog_add_event_%d_observers",
+                         static_cast<int>(num_observers)).c_str(),
+      kNumEvents / elapsed.InSecondsF(),
+      "events/s");
+}
+
+TEST(NetLogPerfTest, AddEventNoObservers) {
+  AddEventsWithObservers(0);
+}
+
+TEST(NetLogPerfTest, AddEventOneObserver) {
+  AddEventsWithObservers(1);
+}
+
+TEST(NetLogPerfTest, AddEventThreeObservers) {
+  AddEventsWithObservers(3);
+}
+
+}  // namespace
+
+}  // namespace net
@@ -6,6 +6,7 @@
 
 #include "base/bind.h"
 #include "base/memory/scoped_vector.h"
+#include "base/synchronization/lock.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/threading/simple_thread.h"
 #include "base/values.h"
@@ -71,6 +72,8 @@ TEST(NetLogTest, LogLevels) {
   }
 }
 
+// Entries added on several threads may be passed to the observer at once, so
+// it counts them under a lock.
 class CountingObserver : public NetLog::ThreadSafeObserver {
  public:
   CountingObserver() : count_(0) {}
@@ -81,12 +84,17 @@ class CountingObserver : public NetLog::ThreadSafeObserver {
   }
 
   virtual void OnAddEntry(const NetLog::Entry& entry) OVERRIDE {
+    base::AutoLock lock(lock_);
     ++count_;
   }
 
-  int count() const { return count_; }
+  int count() const {
+    base::AutoLock lock(lock_);
+    return count_;
+  }
 
  private:
+  mutable base::Lock lock_;
   int count_;
 };
 
@@ -11,7 +11,9 @@
 #include "base/compiler_specific.h"
 #include "base/message_loop/message_loop.h"
 #include "base/metrics/histogram.h"
+#include "base/pickle.h"
 #include "base/stl_util.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/synchronization/lock.h"
 #include "base/threading/worker_pool.h"
 #include "base/time/time.h"
@@ -71,6 +73,10 @@ namespace net {
 //
 // On a cache hit, MultiThreadedCertVerifier::Verify() returns synchronously
 // without posting a task to a worker thread.
+//
+// With a persistent cache, Verify() looks the result up in it instead of
+// starting the worker, and OnPersistentCacheLoad() either completes the job
+// with the stored result or starts the worker then.
 
 namespace {
 
@@ -80,6 +86,15 @@ const unsigned kMaxCacheEntries = 256;
 // The number of seconds for which we'll cache a cache entry.
 const unsigned kTTLSecs = 1800;  // 30 minutes.
 
+// The number of seconds for which we'll keep a result in the persistent cache.
+// Trust store changes made while the process is not running are only picked up
+// once the results expire.
+const unsigned kPersistentTTLSecs = 24 * 60 * 60;  // 1 day.
+
+// Version of the format of the results in the persistent cache, bumped
+// whenever it changes so that results in an older format are ignored.
+const int kPersistentCacheVersion = 1;
+
 base::Value* CertVerifyResultCallback(const CertVerifyResult& verify_result,
                                       NetLog::LogLevel log_level) {
   base::DictionaryValue* results = new base::DictionaryValue();
@@ -109,6 +124,104 @@ base::Value* CertVerifyResultCallback(const CertVerifyResult& verify_result,
   return results;
 }
 
+// Serializes a successful |verify_result| and its validity period for the
+// persistent cache.
+std::string SerializeResult(const CertVerifyResult& verify_result,
+                            base::Time verification_time,
+                            base::Time expiration_time) {
+  Pickle pickle;
+  pickle.WriteInt(kPersistentCacheVersion);
+  pickle.WriteInt64(verification_time.ToInternalValue());
+  pickle.WriteInt64(expiration_time.ToInternalValue());
+  pickle.WriteUInt32(verify_result.cert_status);
+  pickle.WriteBool(verify_result.has_md2);
+  pickle.WriteBool(verify_result.has_md4);
+  pickle.WriteBool(verify_result.has_md5);
+  pickle.WriteBool(verify_result.has_sha1);
+  pickle.WriteBool(verify_result.is_issued_by_known_root);
+  pickle.WriteBool(verify_result.is_issued_by_additional_trust_anchor);
+  pickle.WriteBool(verify_result.common_name_fallback_used);
+  pickle.WriteInt(static_cast<int>(verify_result.public_key_hashes.size()));
+  for (size_t i = 0; i < verify_result.public_key_hashes.size(); ++i)
+    pickle.WriteString(verify_result.public_key_hashes[i].ToString());
+  pickle.WriteBool(verify_result.verified_cert.get() != NULL);
+  if (verify_result.verified_cert.get())
+    verify_result.verified_cert->Persist(&pickle);
+  return std::string(static_cast<const char*>(pickle.data()), pickle.size());
+}
+
+// Returns the earliest expiry of |cert| and of its intermediates, or a null
+// time if none of them has one.
+base::Time GetChainExpiry(const X509Certificate* cert) {
+  base::Time expiry = cert->valid_expiry();
+  const X509Certificate::OSCertHandles& intermediates =
+      cert->GetIntermediateCertificates();
+  for (size_t i = 0; i < intermediates.size(); ++i) {
+    scoped_refptr<X509Certificate> intermediate =
+        X509Certificate::CreateFromHandle(intermediates[i],
+                                          X509Certificate::OSCertHandles());
+    const base::Time& intermediate_expiry = intermediate->valid_expiry();
+    if (!intermediate_expiry.is_null() &&
+        (expiry.is_null() || intermediate_expiry < expiry)) {
+      expiry = intermediate_expiry;
+    }
+  }
+  return expiry;
+}
+
+// Parses a result serialized by SerializeResult(). Returns false if |data|
+// does not hold one.
+bool DeserializeResult(const std::string& data,
+                       CertVerifyResult* verify_result,
+                       base::Time* verification_time,
+                       base::Time* expiration_time) {
+  Pickle pickle(data.data(), static_cast<int>(data.size()));
+  PickleIterator iter(pickle);
+  int version;
+  int64 verification_time_value;
+  int64 expiration_time_value;
+  uint32 cert_status;
+  int hash_count;
+  if (!iter.ReadInt(&version) || version != kPersistentCacheVersion ||
+      !iter.ReadInt64(&verification_time_value) ||
+      !iter.ReadInt64(&expiration_time_value) ||
+      !iter.ReadUInt32(&cert_status) ||
+      !iter.ReadBool(&verify_result->has_md2) ||
+      !iter.ReadBool(&verify_result->has_md4) ||
+      !iter.ReadBool(&verify_result->has_md5) ||
+      !iter.ReadBool(&verify_result->has_sha1) ||
+      !iter.ReadBool(&verify_result->is_issued_by_known_root) ||
+      !iter.ReadBool(&verify_result->is_issued_by_additional_trust_anchor) ||
+      !iter.ReadBool(&verify_result->common_name_fallback_used) ||
+      !iter.ReadInt(&hash_count) || hash_count < 0) {
+    return false;
+  }
+  verify_result->cert_status = cert_status;
+  *verification_time = base::Time::FromInternalValue(verification_time_value);
+  *expiration_time = base::Time::FromInternalValue(expiration_time_value);
+
+  verify_result->public_key_hashes.clear();
+  for (int i = 0; i < hash_count; ++i) {
+    std::string hash_string;
+    HashValue hash;
+    if (!iter.ReadString(&hash_string) || !hash.FromString(hash_string))
+      return false;
+    verify_result->public_key_hashes.push_back(hash);
+  }
+
+  bool has_verified_cert;
+  if (!iter.ReadBool(&has_verified_cert))
+    return false;
+  verify_result->verified_cert = NULL;
+  if (has_verified_cert) {
+    verify_result->verified_cert = X509Certificate::CreateFromPickle(
+        pickle, &iter, X509Certificate::PICKLETYPE_CERTIFICATE_CHAIN_V3);
+    if (!verify_result->verified_cert.get())
+      return false;
+  }
+  return true;
+}
+
 }  // namespace
 
 MultiThreadedCertVerifier::CachedResult::CachedResult() : error(ERR_FAILED) {}
@@ -288,6 +401,7 @@ class CertVerifierWorker {
         cert_verifier_->HandleResult(cert_.get(),
                                      hostname_,
                                      flags_,
+                                     crl_set_.get(),
                                      additional_trust_anchors_,
                                      error_,
                                      verify_result_);
@@ -347,13 +461,16 @@ class CertVerifierWorker {
 };
 
 // A CertVerifierJob is a one-to-one counterpart of a CertVerifierWorker. It
-// lives only on the CertVerifier's origin message loop.
+// lives only on the CertVerifier's origin message loop. It owns its worker
+// until the worker is started, which does not happen if the job completes with
+// a result from the persistent cache.
 class CertVerifierJob {
  public:
   CertVerifierJob(CertVerifierWorker* worker,
                   const BoundNetLog& net_log)
       : start_time_(base::TimeTicks::Now()),
         worker_(worker),
+        worker_started_(false),
         net_log_(net_log) {
     net_log_.BeginEvent(
         NetLog::TYPE_CERT_VERIFIER_JOB,
@@ -365,11 +482,21 @@ class CertVerifierJob {
     if (worker_) {
       net_log_.AddEvent(NetLog::TYPE_CANCELLED);
       net_log_.EndEvent(NetLog::TYPE_CERT_VERIFIER_JOB);
-      worker_->Cancel();
+      if (worker_started_)
+        worker_->Cancel();
+      else
+        delete worker_;
       DeleteAllCanceled();
     }
   }
 
+  // Starts the worker. Returns false if it could not be started.
+  bool StartWorker() {
+    DCHECK(!worker_started_);
+    worker_started_ = worker_->Start();
+    return worker_started_;
+  }
+
   void AddRequest(CertVerifierRequest* request) {
     request->net_log().AddEvent(
         NetLog::TYPE_CERT_VERIFIER_REQUEST_BOUND_TO_JOB,
@@ -381,6 +508,8 @@ class CertVerifierJob {
   void HandleResult(
       const MultiThreadedCertVerifier::CachedResult& verify_result,
       bool is_first_job) {
+    if (!worker_started_)
+      delete worker_;
     worker_ = NULL;
     net_log_.EndEvent(
         NetLog::TYPE_CERT_VERIFIER_JOB,
@@ -427,6 +556,7 @@ class CertVerifierJob {
   const base::TimeTicks start_time_;
   std::vector<CertVerifierRequest*> requests_;
   CertVerifierWorker* worker_;
+  bool worker_started_;
   const BoundNetLog net_log_;
 };
 
@@ -437,8 +567,12 @@ MultiThreadedCertVerifier::MultiThreadedCertVerifier(
       requests_(0),
       cache_hits_(0),
       inflight_joins_(0),
+      persistent_cache_hits_(0),
+      ca_change_count_(0),
       verify_proc_(verify_proc),
-      trust_anchor_provider_(NULL) {
+      trust_anchor_provider_(NULL),
+      persistent_cache_(NULL),
+      weak_ptr_factory_(this) {
   CertDatabase::GetInstance()->AddObserver(this);
 }
 
@@ -453,6 +587,12 @@ void MultiThreadedCertVerifier::SetCertTrustAnchorProvider(
   trust_anchor_provider_ = trust_anchor_provider;
 }
 
+void MultiThreadedCertVerifier::SetPersistentCache(
+    PersistentCache* persistent_cache) {
+  DCHECK(CalledOnValidThread());
+  persistent_cache_ = persistent_cache;
+}
+
 int MultiThreadedCertVerifier::Verify(X509Certificate* cert,
                                       const std::string& hostname,
                                       int flags,
@@ -508,9 +648,14 @@ int MultiThreadedCertVerifier::Verify(X509Certificate* cert,
     job = new CertVerifierJob(
         worker,
         BoundNetLog::Make(net_log.net_log(), NetLog::SOURCE_CERT_VERIFIER_JOB));
-    if (!worker->Start()) {
+    if (persistent_cache_) {
+      // The worker is only started if the persistent cache has no result.
+      persistent_cache_->Load(
+          GetPersistentCacheKey(key, crl_set),
+          base::Bind(&MultiThreadedCertVerifier::OnPersistentCacheLoad,
+                     weak_ptr_factory_.GetWeakPtr(), key, ca_change_count_));
+    } else if (!job->StartWorker()) {
       delete job;
-      delete worker;
       *out_req = NULL;
       // TODO(wtc): log to the NetLog.
       LOG(ERROR) << "CertVerifierWorker couldn't be started.";
@@ -568,12 +713,30 @@ bool MultiThreadedCertVerifier::RequestParams::operator<(
       net::SHA1HashValueLessThan());
 }
 
+// static
+std::string MultiThreadedCertVerifier::GetPersistentCacheKey(
+    const RequestParams& params,
+    const CRLSet* crl_set) {
+  std::string key = params.hostname;
+  key += "/" + base::IntToString(params.flags) + "/";
+  for (size_t i = 0; i < params.hash_values.size(); ++i) {
+    key += base::HexEncode(params.hash_values[i].data,
+                           sizeof(params.hash_values[i].data));
+  }
+  // Results are verified again whenever a new CRLSet is used.
+  key += "/";
+  if (crl_set)
+    key += base::UintToString(crl_set->sequence());
+  return key;
+}
+
 // HandleResult is called by CertVerifierWorker on the origin message loop.
 // It deletes CertVerifierJob.
 void MultiThreadedCertVerifier::HandleResult(
     X509Certificate* cert,
     const std::string& hostname,
     int flags,
+    CRLSet* crl_set,
     const CertificateList& additional_trust_anchors,
     int error,
     const CertVerifyResult& verify_result) {
@@ -590,6 +753,77 @@ void MultiThreadedCertVerifier::HandleResult(
       key, cached_result, CacheValidityPeriod(now),
       CacheValidityPeriod(now, now + base::TimeDelta::FromSeconds(kTTLSecs)));
 
+  // Only successful results are persisted, as errors are more likely to be
+  // transient (e.g. a wrong clock). They are not kept past the expiry of any
+  // certificate of the chain.
+  if (persistent_cache_ && error == OK) {
+    base::Time expiration =
+        now + base::TimeDelta::FromSeconds(kPersistentTTLSecs);
+    base::Time chain_expiry = GetChainExpiry(cert);
+    if (verify_result.verified_cert.get()) {
+      base::Time verified_chain_expiry =
+          GetChainExpiry(verify_result.verified_cert.get());
+      if (!verified_chain_expiry.is_null() &&
+          (chain_expiry.is_null() || verified_chain_expiry < chain_expiry)) {
+        chain_expiry = verified_chain_expiry;
+      }
+    }
+    if (!chain_expiry.is_null())
+      expiration = std::min(expiration, chain_expiry);
+    persistent_cache_->Store(GetPersistentCacheKey(key, crl_set),
+                             SerializeResult(verify_result, now, expiration));
+  }
+
+  CompleteJob(key, cached_result);
+}
+
+void MultiThreadedCertVerifier::OnPersistentCacheLoad(
+    const RequestParams& key,
+    int ca_change_count,
+    const std::string& data) {
+  DCHECK(CalledOnValidThread());
+
+  CachedResult cached_result;
+  base::Time verification_time;
+  base::Time expiration_time;
+  const CacheValidityPeriod now(base::Time::Now());
+  // A result loaded while the trust store changed may have been stored
+  // before the change.
+  if (ca_change_count == ca_change_count_ && !data.empty() &&
+      DeserializeResult(data, &cached_result.result, &verification_time,
+                        &expiration_time) &&
+      CacheExpirationFunctor()(
+          now, CacheValidityPeriod(verification_time, expiration_time))) {
+    ++persistent_cache_hits_;
+    cached_result.error = OK;
+    // Loaded results are kept in memory no longer than verified ones.
+    base::Time memory_expiration_time = std::min(
+        expiration_time,
+        now.verification_time + base::TimeDelta::FromSeconds(kTTLSecs));
+    cache_.Put(key, cached_result, now,
+               CacheValidityPeriod(verification_time,
+                                   memory_expiration_time));
+    CompleteJob(key, cached_result);
+    return;
+  }
+
+  std::map<RequestParams, CertVerifierJob*>::iterator j = inflight_.find(key);
+  if (j == inflight_.end()) {
+    NOTREACHED();
+    return;
+  }
+  if (!j->second->StartWorker()) {
+    // TODO(wtc): log to the NetLog.
+    LOG(ERROR) << "CertVerifierWorker couldn't be started.";
+    cached_result.error = ERR_INSUFFICIENT_RESOURCES;
+    cached_result.result = CertVerifyResult();
+    CompleteJob(key, cached_result);
+  }
+}
+
+void MultiThreadedCertVerifier::CompleteJob(
+    const RequestParams& key,
+    const CachedResult& cached_result) {
   std::map<RequestParams, CertVerifierJob*>::iterator j;
   j = inflight_.find(key);
   if (j == inflight_.end()) {
@@ -612,7 +846,10 @@ void MultiThreadedCertVerifier::OnCACertChanged(
     const X509Certificate* cert) {
   DCHECK(CalledOnValidThread());
 
+  ++ca_change_count_;
   ClearCache();
+  if (persistent_cache_)
+    persistent_cache_->Clear();
 }
 
 }  // namespace net
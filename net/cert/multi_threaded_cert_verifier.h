@@ -11,7 +11,9 @@
 
 #include "base/basictypes.h"
 #include "base/gtest_prod_util.h"
+#include "base/callback_forward.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
 #include "base/threading/non_thread_safe.h"
 #include "net/base/completion_callback.h"
 #include "net/base/expiring_cache.h"
@@ -29,6 +31,7 @@ class CertVerifierJob;
 class CertVerifierRequest;
 class CertVerifierWorker;
 class CertVerifyProc;
+class CRLSet;
 
 // MultiThreadedCertVerifier is a CertVerifier implementation that runs
 // synchronous CertVerifier implementations on worker threads.
@@ -37,6 +40,31 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
       NON_EXPORTED_BASE(public base::NonThreadSafe),
       public CertDatabase::Observer {
  public:
+  // A cache that keeps verification results across restarts. Requests that
+  // miss the in-memory cache look their result up in it before verifying the
+  // certificate, and successful verifications are stored in it. Keys cover
+  // the chain, hostname, flags and CRLSet of a request, and the data holds
+  // the result along with how long it stays valid.
+  class NET_EXPORT_PRIVATE PersistentCache {
+   public:
+    // Runs with the data stored for a key, or an empty string if there is
+    // none.
+    typedef base::Callback<void(const std::string& data)> LoadCallback;
+
+    virtual ~PersistentCache() {}
+
+    // Looks up the data stored for |key|. |callback| must be run
+    // asynchronously.
+    virtual void Load(const std::string& key,
+                      const LoadCallback& callback) = 0;
+
+    // Stores |data| for |key|, replacing anything stored for it.
+    virtual void Store(const std::string& key, const std::string& data) = 0;
+
+    // Drops everything stored so far. Called when the trust store changes.
+    virtual void Clear() = 0;
+  };
+
   explicit MultiThreadedCertVerifier(CertVerifyProc* verify_proc);
 
   // When the verifier is destroyed, all certificate verifications requests are
@@ -53,6 +81,10 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
   void SetCertTrustAnchorProvider(
       CertTrustAnchorProvider* trust_anchor_provider);
 
+  // Sets the persistent cache of verification results, which must outlive
+  // the MultiThreadedCertVerifier. Passing NULL unsets it.
+  void SetPersistentCache(PersistentCache* persistent_cache);
+
   // CertVerifier implementation
   virtual int Verify(X509Certificate* cert,
                      const std::string& hostname,
@@ -78,6 +110,16 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
                            RequestParamsComparators);
   FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest,
                            CertTrustAnchorProvider);
+  FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest,
+                           PersistentCacheHit);
+  FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest,
+                           PersistentCacheKeys);
+  FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest,
+                           PersistentCacheInvalidation);
+  FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest,
+                           PersistentCacheLoadBeforeCACertChanged);
+  FRIEND_TEST_ALL_PREFIXES(MultiThreadedCertVerifierTest,
+                           PersistentCacheHitKeptInMemoryForTTL);
 
   // Input parameters of a certificate verification request.
   struct NET_EXPORT_PRIVATE RequestParams {
@@ -129,13 +171,30 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
   typedef ExpiringCache<RequestParams, CachedResult, CacheValidityPeriod,
                         CacheExpirationFunctor> CertVerifierCache;
 
+  // Returns the key of the result of |params| in the persistent cache.
+  static std::string GetPersistentCacheKey(const RequestParams& params,
+                                           const CRLSet* crl_set);
+
   void HandleResult(X509Certificate* cert,
                     const std::string& hostname,
                     int flags,
+                    CRLSet* crl_set,
                     const CertificateList& additional_trust_anchors,
                     int error,
                     const CertVerifyResult& verify_result);
 
+  // Completes the job of |key| with the result stored in the persistent
+  // cache, or starts verifying if |data| holds no valid result.
+  // |ca_change_count| is the value of |ca_change_count_| when the load was
+  // issued; results loaded across a trust store change are not used.
+  void OnPersistentCacheLoad(const RequestParams& key,
+                             int ca_change_count,
+                             const std::string& data);
+
+  // Removes the job of |key| from |inflight_|, and posts |cached_result| to
+  // its requests.
+  void CompleteJob(const RequestParams& key, const CachedResult& cached_result);
+
   // CertDatabase::Observer methods:
   virtual void OnCACertChanged(const X509Certificate* cert) OVERRIDE;
 
@@ -145,6 +204,7 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
   uint64 cache_hits() const { return cache_hits_; }
   uint64 requests() const { return requests_; }
   uint64 inflight_joins() const { return inflight_joins_; }
+  uint64 persistent_cache_hits() const { return persistent_cache_hits_; }
 
   // cache_ maps from a request to a cached result.
   CertVerifierCache cache_;
@@ -159,11 +219,19 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
   uint64 requests_;
   uint64 cache_hits_;
   uint64 inflight_joins_;
+  uint64 persistent_cache_hits_;
+
+  // The number of times the trust store changed.
+  int ca_change_count_;
 
   scoped_refptr<CertVerifyProc> verify_proc_;
 
   CertTrustAnchorProvider* trust_anchor_provider_;
 
+  PersistentCache* persistent_cache_;
+
+  base::WeakPtrFactory<MultiThreadedCertVerifier> weak_ptr_factory_;
+
   DISALLOW_COPY_AND_ASSIGN(MultiThreadedCertVerifier);
 };
 
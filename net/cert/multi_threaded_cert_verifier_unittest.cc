@@ -4,9 +4,12 @@
 
 #include "net/cert/multi_threaded_cert_verifier.h"
 
+#include <map>
+
 #include "base/bind.h"
 #include "base/files/file_path.h"
 #include "base/format_macros.h"
+#include "base/message_loop/message_loop.h"
 #include "base/strings/stringprintf.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_log.h"
@@ -15,6 +18,7 @@
 #include "net/cert/cert_trust_anchor_provider.h"
 #include "net/cert/cert_verify_proc.h"
 #include "net/cert/cert_verify_result.h"
+#include "net/cert/crl_set.h"
 #include "net/cert/x509_certificate.h"
 #include "net/test/cert_test_util.h"
 #include "testing/gmock/include/gmock/gmock.h"
@@ -56,6 +60,71 @@ class MockCertVerifyProc : public CertVerifyProc {
   }
 };
 
+// A CertVerifyProc that accepts every certificate, and counts how many it
+// verified.
+class SuccessfulCertVerifyProc : public CertVerifyProc {
+ public:
+  SuccessfulCertVerifyProc() : verify_count_(0) {}
+
+  int verify_count() const { return verify_count_; }
+
+ private:
+  virtual ~SuccessfulCertVerifyProc() {}
+
+  // CertVerifyProc implementation
+  virtual bool SupportsAdditionalTrustAnchors() const OVERRIDE {
+    return false;
+  }
+
+  virtual int VerifyInternal(X509Certificate* cert,
+                             const std::string& hostname,
+                             int flags,
+                             CRLSet* crl_set,
+                             const CertificateList& additional_trust_anchors,
+                             CertVerifyResult* verify_result) OVERRIDE {
+    ++verify_count_;
+    verify_result->Reset();
+    verify_result->verified_cert = cert;
+    verify_result->is_issued_by_known_root = true;
+    return OK;
+  }
+
+  // Verifications run on worker threads, but the tests only read the count
+  // once they are done.
+  int verify_count_;
+};
+
+// A PersistentCache that keeps its data in memory.
+class FakePersistentCache : public MultiThreadedCertVerifier::PersistentCache {
+ public:
+  typedef std::map<std::string, std::string> DataMap;
+
+  FakePersistentCache() {}
+  virtual ~FakePersistentCache() {}
+
+  DataMap& data() { return data_; }
+
+  // MultiThreadedCertVerifier::PersistentCache implementation:
+  virtual void Load(const std::string& key,
+                    const LoadCallback& callback) OVERRIDE {
+    DataMap::const_iterator it = data_.find(key);
+    base::MessageLoop::current()->PostTask(
+        FROM_HERE,
+        base::Bind(callback,
+                   it == data_.end() ? std::string() : it->second));
+  }
+
+  virtual void Store(const std::string& key,
+                     const std::string& data) OVERRIDE {
+    data_[key] = data;
+  }
+
+  virtual void Clear() OVERRIDE { data_.clear(); }
+
+ private:
+  DataMap data_;
+};
+
 class MockCertTrustAnchorProvider : public CertTrustAnchorProvider {
  public:
   MockCertTrustAnchorProvider() {}
@@ -482,4 +551,310 @@ TEST_F(MultiThreadedCertVerifierTest, CertTrustAnchorProvider) {
   ASSERT_EQ(1u, verifier_.cache_hits());
 }
 
+// Tests that successful results are verified only once across restarts. The
+// persistent cache tests use a certificate that has not expired, as results are
+// not kept past the expiry of the certificate.
+TEST_F(MultiThreadedCertVerifierTest, PersistentCacheHit) {
+  scoped_refptr<X509Certificate> test_cert(
+      ImportCertFromFile(GetTestCertsDirectory(), "ocsp-test-root.pem"));
+  ASSERT_TRUE(test_cert.get());
+
+  FakePersistentCache persistent_cache;
+  scoped_refptr<SuccessfulCertVerifyProc> verify_proc(
+      new SuccessfulCertVerifyProc());
+
+  int error;
+  CertVerifyResult verify_result;
+  TestCompletionCallback callback;
+  CertVerifier::RequestHandle request_handle;
+  {
+    MultiThreadedCertVerifier verifier(verify_proc.get());
+    verifier.SetPersistentCache(&persistent_cache);
+    error = verifier.Verify(test_cert.get(),
+                            "www.example.com",
+                            0,
+                            NULL,
+                            &verify_result,
+                            callback.callback(),
+                            &request_handle,
+                            BoundNetLog());
+    ASSERT_EQ(ERR_IO_PENDING, error);
+    EXPECT_EQ(OK, callback.WaitForResult());
+    EXPECT_EQ(1, verify_proc->verify_count());
+    EXPECT_EQ(0u, verifier.persistent_cache_hits());
+    EXPECT_EQ(1u, persistent_cache.data().size());
+  }
+
+  // After a restart, the result is loaded instead of verified again.
+  MultiThreadedCertVerifier verifier(verify_proc.get());
+  verifier.SetPersistentCache(&persistent_cache);
+  verify_result.Reset();
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.com",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ(1, verify_proc->verify_count());
+  EXPECT_EQ(1u, verifier.persistent_cache_hits());
+  EXPECT_TRUE(verify_result.is_issued_by_known_root);
+  ASSERT_TRUE(verify_result.verified_cert.get());
+  EXPECT_TRUE(verify_result.verified_cert->Equals(test_cert.get()));
+
+  // Loaded results are kept in memory as well.
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.com",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  EXPECT_EQ(OK, error);
+  EXPECT_EQ(1u, verifier.cache_hits());
+
+  // A request that differs from it is verified.
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.org",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ(2, verify_proc->verify_count());
+  EXPECT_EQ(1u, verifier.persistent_cache_hits());
+}
+
+TEST_F(MultiThreadedCertVerifierTest, PersistentCacheKeys) {
+  scoped_refptr<X509Certificate> test_cert(
+      ImportCertFromFile(GetTestCertsDirectory(), "ocsp-test-root.pem"));
+  ASSERT_TRUE(test_cert.get());
+  const CertificateList empty_cert_list;
+  scoped_refptr<CRLSet> crl_set(CRLSet::EmptyCRLSetForTesting());
+
+  const MultiThreadedCertVerifier::RequestParams params(
+      test_cert->fingerprint(), test_cert->ca_fingerprint(),
+      "www.example.com", 0, empty_cert_list);
+  const std::string key =
+      MultiThreadedCertVerifier::GetPersistentCacheKey(params, NULL);
+  EXPECT_EQ(key,
+            MultiThreadedCertVerifier::GetPersistentCacheKey(params, NULL));
+
+  // Results verified with a CRLSet are not used without it, nor with another
+  // version of it.
+  const std::string crl_set_key =
+      MultiThreadedCertVerifier::GetPersistentCacheKey(params, crl_set.get());
+  EXPECT_NE(key, crl_set_key);
+  EXPECT_NE(std::string::npos,
+            crl_set_key.find(base::StringPrintf("/%u", crl_set->sequence())));
+
+  const MultiThreadedCertVerifier::RequestParams other_hostname(
+      test_cert->fingerprint(), test_cert->ca_fingerprint(),
+      "www.example.org", 0, empty_cert_list);
+  EXPECT_NE(key, MultiThreadedCertVerifier::GetPersistentCacheKey(
+                     other_hostname, NULL));
+
+  const MultiThreadedCertVerifier::RequestParams other_flags(
+      test_cert->fingerprint(), test_cert->ca_fingerprint(),
+      "www.example.com", CertVerifier::VERIFY_REV_CHECKING_ENABLED,
+      empty_cert_list);
+  EXPECT_NE(key, MultiThreadedCertVerifier::GetPersistentCacheKey(
+                     other_flags, NULL));
+
+  CertificateList cert_list;
+  cert_list.push_back(test_cert);
+  const MultiThreadedCertVerifier::RequestParams other_anchors(
+      test_cert->fingerprint(), test_cert->ca_fingerprint(),
+      "www.example.com", 0, cert_list);
+  EXPECT_NE(key, MultiThreadedCertVerifier::GetPersistentCacheKey(
+                     other_anchors, NULL));
+}
+
+// Tests that errors, unreadable results and results stored before a trust
+// store change are not used.
+TEST_F(MultiThreadedCertVerifierTest, PersistentCacheInvalidation) {
+  scoped_refptr<X509Certificate> test_cert(
+      ImportCertFromFile(GetTestCertsDirectory(), "ocsp-test-root.pem"));
+  ASSERT_TRUE(test_cert.get());
+
+  int error;
+  CertVerifyResult verify_result;
+  TestCompletionCallback callback;
+  CertVerifier::RequestHandle request_handle;
+
+  // |verifier_| fails to verify every certificate.
+  FakePersistentCache persistent_cache;
+  verifier_.SetPersistentCache(&persistent_cache);
+  error = verifier_.Verify(test_cert.get(),
+                           "www.example.com",
+                           0,
+                           NULL,
+                           &verify_result,
+                           callback.callback(),
+                           &request_handle,
+                           BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  EXPECT_EQ(ERR_CERT_COMMON_NAME_INVALID, callback.WaitForResult());
+  EXPECT_TRUE(persistent_cache.data().empty());
+
+  scoped_refptr<SuccessfulCertVerifyProc> verify_proc(
+      new SuccessfulCertVerifyProc());
+  MultiThreadedCertVerifier verifier(verify_proc.get());
+  verifier.SetPersistentCache(&persistent_cache);
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.com",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  ASSERT_EQ(1u, persistent_cache.data().size());
+
+  // A result that cannot be parsed is verified again.
+  persistent_cache.data().begin()->second = "garbage";
+  verifier.ClearCache();
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.com",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ(2, verify_proc->verify_count());
+  EXPECT_EQ(0u, verifier.persistent_cache_hits());
+
+  // Trust store changes drop the stored results.
+  verifier.OnCACertChanged(NULL);
+  EXPECT_EQ(0u, verifier.GetCacheSize());
+  EXPECT_TRUE(persistent_cache.data().empty());
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.com",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ(3, verify_proc->verify_count());
+  EXPECT_EQ(0u, verifier.persistent_cache_hits());
+
+  verifier_.SetPersistentCache(NULL);
+}
+
+// Tests that a result loaded from the persistent cache is not used if the trust
+// store changed while it was loaded.
+TEST_F(MultiThreadedCertVerifierTest, PersistentCacheLoadBeforeCACertChanged) {
+  scoped_refptr<X509Certificate> test_cert(
+      ImportCertFromFile(GetTestCertsDirectory(), "ocsp-test-root.pem"));
+  ASSERT_TRUE(test_cert.get());
+
+  FakePersistentCache persistent_cache;
+  scoped_refptr<SuccessfulCertVerifyProc> verify_proc(
+      new SuccessfulCertVerifyProc());
+  MultiThreadedCertVerifier verifier(verify_proc.get());
+  verifier.SetPersistentCache(&persistent_cache);
+
+  int error;
+  CertVerifyResult verify_result;
+  TestCompletionCallback callback;
+  CertVerifier::RequestHandle request_handle;
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.com",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  ASSERT_EQ(1u, persistent_cache.data().size());
+
+  // The fake cache reads the stored result when the load is issued, and
+  // returns it after the trust store changed.
+  verifier.ClearCache();
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.com",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  verifier.OnCACertChanged(NULL);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ(2, verify_proc->verify_count());
+  EXPECT_EQ(0u, verifier.persistent_cache_hits());
+}
+
+// Tests that a result loaded from the persistent cache is kept in memory no
+// longer than a verified one.
+TEST_F(MultiThreadedCertVerifierTest, PersistentCacheHitKeptInMemoryForTTL) {
+  scoped_refptr<X509Certificate> test_cert(
+      ImportCertFromFile(GetTestCertsDirectory(), "ocsp-test-root.pem"));
+  ASSERT_TRUE(test_cert.get());
+
+  FakePersistentCache persistent_cache;
+  scoped_refptr<SuccessfulCertVerifyProc> verify_proc(
+      new SuccessfulCertVerifyProc());
+  MultiThreadedCertVerifier verifier(verify_proc.get());
+  verifier.SetPersistentCache(&persistent_cache);
+
+  int error;
+  CertVerifyResult verify_result;
+  TestCompletionCallback callback;
+  CertVerifier::RequestHandle request_handle;
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.com",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  EXPECT_EQ(OK, callback.WaitForResult());
+
+  verifier.ClearCache();
+  error = verifier.Verify(test_cert.get(),
+                          "www.example.com",
+                          0,
+                          NULL,
+                          &verify_result,
+                          callback.callback(),
+                          &request_handle,
+                          BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ(1u, verifier.persistent_cache_hits());
+
+  // The persistent cache keeps the result for a day, but memory only for the
+  // 30 minutes of a verified result.
+  const MultiThreadedCertVerifier::RequestParams params(
+      test_cert->fingerprint(), test_cert->ca_fingerprint(),
+      "www.example.com", 0, CertificateList());
+  const base::Time now = base::Time::Now();
+  EXPECT_TRUE(verifier.cache_.Get(
+      params, MultiThreadedCertVerifier::CacheValidityPeriod(now)));
+  EXPECT_FALSE(verifier.cache_.Get(
+      params, MultiThreadedCertVerifier::CacheValidityPeriod(
+                  now + base::TimeDelta::FromMinutes(31))));
+}
+
 }  // namespace net
@@ -127,6 +127,10 @@ typedef std::vector<CanonicalCookie*> CanonicalCookieVector;
 // will update it again.
 const int kDefaultAccessUpdateThresholdSeconds = 60;
 
+// Maximum number of cookie lines cached for a single CookieMap key. Requests
+// to many different paths of one domain just start over with an empty cache.
+const size_t kMaxCachedCookieLinesPerKey = 16;
+
 // Comparator to sort cookies from highest creation date to lowest
 // creation date.
 struct OrderByCreationTimeDesc {
@@ -291,6 +295,21 @@ ChangeCausePair ChangeCauseMapping[] = {
   { CookieMonsterDelegate::CHANGE_COOKIE_EXPLICIT, false }
 };
 
+// Returns the parts of a request that, besides the cookies under the key of
+// its host, determine its cookie line. See
+// CanonicalCookie::IncludeForRequestURL().
+std::string GetCookieLineCacheKey(const GURL& url,
+                                  const CookieOptions& options) {
+  std::string cache_key;
+  cache_key.reserve(2 + url.host().size() + url.path().size() + 1);
+  cache_key += url.SchemeIsSecure() ? 's' : 'i';
+  cache_key += options.exclude_httponly() ? 'e' : 'h';
+  cache_key += url.host();
+  cache_key += '/';
+  cache_key += url.path();
+  return cache_key;
+}
+
 std::string BuildCookieLine(const CanonicalCookieVector& cookies) {
   std::string cookie_line;
   for (CanonicalCookieVector::const_iterator it = cookies.begin();
@@ -1316,11 +1335,19 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
 
   TimeTicks start_time(TimeTicks::Now());
 
-  std::vector<CanonicalCookie*> cookies;
-  FindCookiesForHostAndDomain(url, options, true, &cookies);
-  std::sort(cookies.begin(), cookies.end(), CookieSorter);
+  const Time current_time(CurrentTime());
+  RecordPeriodicStats(current_time);
 
-  std::string cookie_line = BuildCookieLine(cookies);
+  const std::string key(GetKey(url.host()));
+  std::string cookie_line;
+  if (!GetCachedCookieLine(key, url, options, current_time, &cookie_line)) {
+    std::vector<CanonicalCookie*> cookies;
+    FindCookiesForKey(key, url, options, current_time, true, &cookies);
+    std::sort(cookies.begin(), cookies.end(), CookieSorter);
+
+    cookie_line = BuildCookieLine(cookies);
+    CacheCookieLine(key, url, options, cookies, cookie_line);
+  }
 
   histogram_time_get_->AddTime(TimeTicks::Now() - start_time);
 
@@ -1410,6 +1437,10 @@ CookieMonster::~CookieMonster() {
   DeleteAll(false);
 }
 
+CookieMonster::CachedCookieLine::CachedCookieLine() {}
+
+CookieMonster::CachedCookieLine::~CachedCookieLine() {}
+
 bool CookieMonster::SetCookieWithCreationTime(const GURL& url,
                                               const std::string& cookie_line,
                                               const base::Time& creation_time) {
@@ -1733,6 +1764,73 @@ void CookieMonster::FindCookiesForKey(const std::string& key,
   }
 }
 
+bool CookieMonster::GetCachedCookieLine(const std::string& key,
+                                        const GURL& url,
+                                        const CookieOptions& options,
+                                        const Time& current,
+                                        std::string* cookie_line) {
+  lock_.AssertAcquired();
+
+  CookieLineCache::iterator key_it = cookie_line_cache_.find(key);
+  if (key_it == cookie_line_cache_.end())
+    return false;
+  CookieLineMap::iterator it =
+      key_it->second.find(GetCookieLineCacheKey(url, options));
+  if (it == key_it->second.end())
+    return false;
+
+  const CachedCookieLine& cached_line = it->second;
+  if (!keep_expired_cookies_ && !cached_line.earliest_expiry.is_null() &&
+      cached_line.earliest_expiry <= current) {
+    // FindCookiesForKey() deletes the expired cookies of the key, which drops
+    // the line.
+    return false;
+  }
+
+  for (std::vector<CanonicalCookie*>::const_iterator cookie_it =
+           cached_line.cookies.begin();
+       cookie_it != cached_line.cookies.end(); ++cookie_it) {
+    InternalUpdateCookieAccessTime(*cookie_it, current);
+  }
+  *cookie_line = cached_line.cookie_line;
+  return true;
+}
+
+void CookieMonster::CacheCookieLine(
+    const std::string& key,
+    const GURL& url,
+    const CookieOptions& options,
+    const std::vector<CanonicalCookie*>& cookies,
+    const std::string& cookie_line) {
+  lock_.AssertAcquired();
+
+  // Only keys with cookies are cached, so that the cache stays bounded by the
+  // cookies themselves: deleting the last cookie of a key drops its lines.
+  if (cookies_.find(key) == cookies_.end())
+    return;
+
+  CookieLineMap& key_lines = cookie_line_cache_[key];
+  if (key_lines.size() >= kMaxCachedCookieLinesPerKey)
+    key_lines.clear();
+
+  CachedCookieLine& cached_line =
+      key_lines[GetCookieLineCacheKey(url, options)];
+  cached_line.cookie_line = cookie_line;
+  cached_line.cookies = cookies;
+  // All the cookies of the key count, not only those in the line, so that
+  // reads still purge the expired ones as FindCookiesForKey() does.
+  cached_line.earliest_expiry = Time();
+  for (CookieMapItPair its = cookies_.equal_range(key);
+       its.first != its.second; ++its.first) {
+    const CanonicalCookie* cc = its.first->second;
+    if (cc->IsPersistent() &&
+        (cached_line.earliest_expiry.is_null() ||
+         cc->ExpiryDate() < cached_line.earliest_expiry)) {
+      cached_line.earliest_expiry = cc->ExpiryDate();
+    }
+  }
+}
+
 bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
                                               const CanonicalCookie& ecc,
                                               bool skip_httponly,
@@ -1773,6 +1871,7 @@ CookieMonster::CookieMap::iterator CookieMonster::InternalInsertCookie(
   if ((cc->IsPersistent() || persist_session_cookies_) && store_.get() &&
       sync_to_store)
     store_->AddCookie(*cc);
+  cookie_line_cache_.erase(key);
   CookieMap::iterator inserted =
       cookies_.insert(CookieMap::value_type(key, cc));
   if (delegate_.get()) {
@@ -1895,6 +1994,7 @@ void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
     if (mapping.notify)
       delegate_->OnCookieChanged(*cc, true, mapping.cause);
   }
+  cookie_line_cache_.erase(it->first);
   cookies_.erase(it);
   delete cc;
 }
@@ -362,6 +362,9 @@ class NET_EXPORT CookieMonster : public CookieStore {
   // For FindCookiesForKey.
   FRIEND_TEST_ALL_PREFIXES(CookieMonsterTest, ShortLivedSessionCookies);
 
+  // For |cookie_line_cache_|.
+  FRIEND_TEST_ALL_PREFIXES(CookieMonsterTest, CachedCookieLineInvalidation);
+
   // Internal reasons for deletion, used to populate informative histograms
   // and to provide a public cause for onCookieChange notifications.
   //
@@ -529,6 +532,24 @@ class NET_EXPORT CookieMonster : public CookieStore {
                          bool update_access_time,
                          std::vector<CanonicalCookie*>* cookies);
 
+  // Sets |cookie_line| to the line cached for a request to |url| with
+  // |options|, whose cookies are under |key|, and updates the access time of
+  // its cookies like FindCookiesForKey() does. Returns false if no line is
+  // cached, or if a cookie under |key| has expired since.
+  bool GetCachedCookieLine(const std::string& key,
+                           const GURL& url,
+                           const CookieOptions& options,
+                           const base::Time& current,
+                           std::string* cookie_line);
+
+  // Caches the |cookie_line| built from |cookies| for a request to |url| with
+  // |options|, until a cookie under |key| is inserted or deleted.
+  void CacheCookieLine(const std::string& key,
+                       const GURL& url,
+                       const CookieOptions& options,
+                       const std::vector<CanonicalCookie*>& cookies,
+                       const std::string& cookie_line);
+
   // Delete any cookies that are equivalent to |ecc| (same path, domain, etc).
   // If |skip_httponly| is true, httponly cookies will not be deleted.  The
   // return value with be true if |skip_httponly| skipped an httponly cookie.
@@ -636,6 +657,28 @@ class NET_EXPORT CookieMonster : public CookieStore {
 
   CookieMap cookies_;
 
+  // A cookie line built by GetCookiesWithOptions(), with the cookies it is
+  // made of, so they can be marked as accessed each time it is reused.
+  struct CachedCookieLine {
+    CachedCookieLine();
+    ~CachedCookieLine();
+
+    std::string cookie_line;
+    std::vector<CanonicalCookie*> cookies;
+    // The earliest expiry of the cookies under the key of the line. The line
+    // must be rebuilt once this time is reached, since expired cookies are
+    // left out of it and deleted when it is built.
+    base::Time earliest_expiry;
+  };
+
+  // The cookie lines last built for each CookieMap key, themselves keyed by
+  // the parts of the request they depend on. All the lines of a key are
+  // dropped whenever one of its cookies is inserted or deleted, so that
+  // |CachedCookieLine::cookies| never dangle.
+  typedef std::map<std::string, CachedCookieLine> CookieLineMap;
+  typedef std::map<std::string, CookieLineMap> CookieLineCache;
+  CookieLineCache cookie_line_cache_;
+
   // Indicates whether the cookie store has been initialized. This happens
   // lazily in InitStoreIfNecessary().
   bool initialized_;
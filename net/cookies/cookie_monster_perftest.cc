@@ -276,6 +276,32 @@ TEST_F(CookieMonsterTest, TestDomainLine) {
   timer2.Done();
 }
 
+TEST_F(CookieMonsterTest, TestGetCookiesManyDomains) {
+  scoped_refptr<CookieMonster> cm(new CookieMonster(NULL, NULL));
+  SetCookieCallback setCookieCallback;
+  GetCookiesCallback getCookiesCallback;
+
+  // 3000 cookies over 100 domains, as in a well used profile.
+  const int kNumDomains = 100;
+  const int kCookiesPerDomain = 30;
+  std::vector<GURL> gurls;
+  for (int i = 0; i < kNumDomains; i++) {
+    gurls.push_back(GURL(base::StringPrintf("http://site%03d.izzle/", i)));
+    for (int j = 0; j < kCookiesPerDomain; j++) {
+      setCookieCallback.SetCookie(cm.get(), gurls.back(),
+                                  base::StringPrintf("a%02d=b", j));
+    }
+  }
+
+  base::PerfTimeLogger timer("Cookie_monster_get_cookies_many_domains");
+  for (int i = 0; i < kNumCookies; i++) {
+    const std::string& cookie_line =
+        getCookiesCallback.GetCookies(cm.get(), gurls[i % kNumDomains]);
+    EXPECT_EQ(kCookiesPerDomain, CountInString(cookie_line, '='));
+  }
+  timer.Done();
+}
+
 TEST_F(CookieMonsterTest, TestImport) {
   scoped_refptr<MockPersistentCookieStore> store(new MockPersistentCookieStore);
   std::vector<CanonicalCookie*> initial_cookies;
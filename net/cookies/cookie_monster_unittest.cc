@@ -1231,6 +1231,47 @@ TEST_F(CookieMonsterTest, TestPriorityAwareGarbageCollection) {
   TestPriorityAwareGarbageCollectHelper();
 }
 
+TEST_F(CookieMonsterTest, CachedCookieLineInvalidation) {
+  scoped_refptr<CookieMonster> cm(new CookieMonster(NULL, NULL));
+  CookieOptions options;
+  options.set_include_httponly();
+
+  EXPECT_TRUE(SetCookie(cm.get(), url_google_, "A=B"));
+  EXPECT_TRUE(SetCookie(cm.get(), url_google_foo_, "C=D; path=/foo"));
+  EXPECT_TRUE(
+      SetCookieWithOptions(cm.get(), url_google_, "E=F; httponly", options));
+  EXPECT_EQ("A=B", GetCookies(cm.get(), url_google_));
+  EXPECT_EQ("C=D; A=B", GetCookies(cm.get(), url_google_foo_));
+  EXPECT_EQ("A=B; E=F", GetCookiesWithOptions(cm.get(), url_google_, options));
+  EXPECT_EQ(1U, cm->cookie_line_cache_.size());
+
+  // The cached lines are reused as long as the cookies do not change.
+  EXPECT_EQ("A=B", GetCookies(cm.get(), url_google_));
+  EXPECT_EQ("C=D; A=B", GetCookies(cm.get(), url_google_foo_));
+
+  // Setting or deleting a cookie drops the lines of its domain.
+  EXPECT_TRUE(SetCookie(cm.get(), url_google_, "G=H"));
+  EXPECT_TRUE(cm->cookie_line_cache_.empty());
+  EXPECT_EQ("C=D; A=B; G=H", GetCookies(cm.get(), url_google_foo_));
+  EXPECT_TRUE(FindAndDeleteCookie(cm.get(), url_google_.host(), "A"));
+  EXPECT_EQ("C=D; G=H", GetCookies(cm.get(), url_google_foo_));
+
+  // An expired cookie is not served from the cache.
+  EXPECT_TRUE(SetCookie(cm.get(), url_google_, "I=J; max-age=1"));
+  EXPECT_EQ("G=H; I=J", GetCookies(cm.get(), url_google_));
+  base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1100));
+  EXPECT_EQ("G=H", GetCookies(cm.get(), url_google_));
+
+  // Nor is a line when another cookie of its domain has expired, so that the
+  // read deletes it.
+  EXPECT_TRUE(SetCookie(cm.get(), url_google_foo_, "K=L; path=/foo; max-age=1"));
+  EXPECT_EQ("G=H", GetCookies(cm.get(), url_google_));
+  EXPECT_EQ(3U, cm->cookies_.size());
+  base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1100));
+  EXPECT_EQ("G=H", GetCookies(cm.get(), url_google_));
+  EXPECT_EQ(2U, cm->cookies_.size());
+}
+
 TEST_F(CookieMonsterTest, TestDeleteSingleCookie) {
   scoped_refptr<CookieMonster> cm(new CookieMonster(NULL, NULL));
 
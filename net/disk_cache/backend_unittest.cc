@@ -3251,8 +3251,9 @@ TEST_F(DiskCacheBackendTest, SimpleCacheOpenMissingFile) {
   entry = NULL;
 
   // Delete one of the files in the entry.
-  base::FilePath to_delete_file = cache_path_.AppendASCII(
-      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0));
+  base::FilePath to_delete_file =
+      disk_cache::simple_util::GetFilePathFromKeyAndFileIndex(
+          cache_path_, key, 0);
   EXPECT_TRUE(base::PathExists(to_delete_file));
   EXPECT_TRUE(disk_cache::DeleteCacheFile(to_delete_file));
 
@@ -3261,8 +3262,9 @@ TEST_F(DiskCacheBackendTest, SimpleCacheOpenMissingFile) {
 
   // Confirm the rest of the files are gone.
   for (int i = 1; i < disk_cache::kSimpleEntryFileCount; ++i) {
-    base::FilePath should_be_gone_file(cache_path_.AppendASCII(
-        disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, i)));
+    base::FilePath should_be_gone_file(
+        disk_cache::simple_util::GetFilePathFromKeyAndFileIndex(
+            cache_path_, key, i));
     EXPECT_FALSE(base::PathExists(should_be_gone_file));
   }
 }
@@ -3288,8 +3290,9 @@ TEST_F(DiskCacheBackendTest, SimpleCacheOpenBadFile) {
   entry = NULL;
 
   // Write an invalid header for stream 0 and stream 1.
-  base::FilePath entry_file1_path = cache_path_.AppendASCII(
-      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0));
+  base::FilePath entry_file1_path =
+      disk_cache::simple_util::GetFilePathFromKeyAndFileIndex(
+          cache_path_, key, 0);
 
   disk_cache::SimpleFileHeader header;
   header.initial_magic_number = GG_UINT64_C(0xbadf00d);
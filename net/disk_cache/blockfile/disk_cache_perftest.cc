@@ -2,13 +2,19 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/files/file_enumerator.h"
 #include "base/hash.h"
+#include "base/metrics/field_trial.h"
 #include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
 #include "base/test/perf_time_logger.h"
 #include "base/test/test_file_util.h"
 #include "base/threading/thread.h"
@@ -22,6 +28,7 @@
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -144,6 +151,218 @@ int BlockSize() {
   return (rand() & 0x3) + 1;
 }
 
+// Logs the median and 99th percentile of |latencies| as |name|.
+void LogPercentiles(const std::string& name,
+                    std::vector<base::TimeDelta>* latencies) {
+  if (latencies->empty())
+    return;
+  std::sort(latencies->begin(), latencies->end());
+  base::LogPerfResult(
+      (name + "_p50").c_str(),
+      (*latencies)[latencies->size() / 2].InMillisecondsF(), "ms");
+  base::LogPerfResult(
+      (name + "_p99").c_str(),
+      (*latencies)[latencies->size() * 99 / 100].InMillisecondsF(), "ms");
+}
+
+// The number of entries a large simple cache is filled with, and the number of
+// entries opened and created in it once filled.
+const int kLargeCacheEntries = 100000;
+const int kLargeCacheOperations = 1000;
+
+// Fills a simple cache at |path| with kLargeCacheEntries entries, then logs the
+// latencies of opening kLargeCacheOperations of them at random and of creating
+// as many new ones.
+void MeasureOpenCreateLatencyInLargeCache(const base::FilePath& path) {
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+
+  net::TestCompletionCallback cb;
+  scoped_ptr<disk_cache::Backend> cache;
+  int rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
+                                          net::CACHE_BACKEND_SIMPLE,
+                                          path,
+                                          0,
+                                          false,
+                                          cache_thread.task_runner(),
+                                          NULL,
+                                          &cache,
+                                          cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  std::vector<std::string> keys;
+  keys.reserve(kLargeCacheEntries);
+  for (int i = 0; i < kLargeCacheEntries; ++i) {
+    keys.push_back(GenerateKey(true));
+    disk_cache::Entry* entry;
+    rv = cache->CreateEntry(keys.back(), &entry, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    entry->Close();
+  }
+  base::MessageLoop::current()->RunUntilIdle();
+
+  std::vector<base::TimeDelta> open_latencies;
+  std::vector<base::TimeDelta> create_latencies;
+  for (int i = 0; i < kLargeCacheOperations; ++i) {
+    disk_cache::Entry* entry;
+    base::TimeTicks start = base::TimeTicks::Now();
+    rv = cache->OpenEntry(keys[rand() % keys.size()], &entry, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    open_latencies.push_back(base::TimeTicks::Now() - start);
+    entry->Close();
+
+    start = base::TimeTicks::Now();
+    rv = cache->CreateEntry(GenerateKey(true), &entry, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    create_latencies.push_back(base::TimeTicks::Now() - start);
+    entry->Close();
+  }
+  LogPercentiles(base::StringPrintf("SimpleCacheOpen_%d", kLargeCacheEntries),
+                 &open_latencies);
+  LogPercentiles(
+      base::StringPrintf("SimpleCacheCreate_%d", kLargeCacheEntries),
+      &create_latencies);
+
+  cache.reset();
+  base::MessageLoop::current()->RunUntilIdle();
+}
+
+// The number of entries written and read back with and without small entry
+// packing, the seed their sizes are drawn from, and the block size their disk
+// usage is counted in.
+const int kPackingEntries = 5000;
+const unsigned int kPackingSeed = 42;
+const int64 kDiskBlockSize = 4096;
+
+// Returns the body size of a response, drawn so that most are small, as for
+// favicons, empty responses and small JSON, and a tenth are too large to be
+// packed.
+int GetRealisticBodySize() {
+  const int bucket = rand() % 10;
+  if (bucket < 4)
+    return rand() % 1024;
+  if (bucket < 7)
+    return 1024 + rand() % (3 * 1024);
+  if (bucket < 9)
+    return 4 * 1024 + rand() % (11 * 1024);
+  return 16 * 1024 + rand() % (48 * 1024);
+}
+
+// Returns the number of files under |path|, and their size rounded up to
+// whole blocks in |out_disk_usage|.
+int GetDiskUsage(const base::FilePath& path, int64* out_disk_usage) {
+  int file_count = 0;
+  *out_disk_usage = 0;
+  base::FileEnumerator enumerator(path, /* recursive = */ true,
+                                  base::FileEnumerator::FILES);
+  for (base::FilePath file = enumerator.Next(); !file.empty();
+       file = enumerator.Next()) {
+    ++file_count;
+    const int64 size = enumerator.GetInfo().GetSize();
+    *out_disk_usage += (size + kDiskBlockSize - 1) / kDiskBlockSize *
+                       kDiskBlockSize;
+  }
+  return file_count;
+}
+
+scoped_ptr<disk_cache::Backend> CreateSimpleBackend(
+    const base::FilePath& path,
+    base::Thread* cache_thread) {
+  net::TestCompletionCallback cb;
+  scoped_ptr<disk_cache::Backend> cache;
+  int rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
+                                          net::CACHE_BACKEND_SIMPLE,
+                                          path,
+                                          0,
+                                          false,
+                                          cache_thread->task_runner(),
+                                          NULL,
+                                          &cache,
+                                          cb.callback());
+  if (cb.GetResult(rv) != net::OK)
+    return scoped_ptr<disk_cache::Backend>();
+  return cache.Pass();
+}
+
+// Writes kPackingEntries entries of realistic sizes to a simple cache at
+// |path|, then reads them back after a restart, and logs the operations per
+// second and the disk usage as |name|.
+void MeasureSmallEntryPacking(const base::FilePath& path,
+                              bool packing,
+                              const std::string& name) {
+  base::FieldTrialList field_trial_list(NULL);
+  if (packing) {
+    base::FieldTrialList::CreateFieldTrial("SimpleCacheSmallEntryPacking",
+                                           "Enabled");
+  }
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+  scoped_ptr<disk_cache::Backend> cache =
+      CreateSimpleBackend(path, &cache_thread);
+  ASSERT_TRUE(cache.get());
+
+  const int kHeadersSize = 200;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(64 * 1024));
+  CacheTestFillBuffer(buffer->data(), 64 * 1024, false);
+  srand(kPackingSeed);
+  std::vector<std::string> keys;
+  std::vector<int> body_sizes;
+  net::TestCompletionCallback cb;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kPackingEntries; ++i) {
+    keys.push_back(GenerateKey(true));
+    body_sizes.push_back(GetRealisticBodySize());
+    disk_cache::Entry* entry;
+    int rv = cache->CreateEntry(keys.back(), &entry, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    rv = entry->WriteData(0, 0, buffer.get(), kHeadersSize, cb.callback(),
+                          false);
+    EXPECT_EQ(kHeadersSize, cb.GetResult(rv));
+    rv = entry->WriteData(1, 0, buffer.get(), body_sizes.back(),
+                          cb.callback(), false);
+    EXPECT_EQ(body_sizes.back(), cb.GetResult(rv));
+    entry->Close();
+  }
+  base::LogPerfResult(
+      (name + "_writes").c_str(),
+      kPackingEntries / (base::TimeTicks::Now() - start).InSecondsF(),
+      "ops/s");
+
+  // Entries are packed as they are closed, on the worker pool.
+  cache.reset();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::MessageLoop::current()->RunUntilIdle();
+  int64 disk_usage = 0;
+  const int file_count = GetDiskUsage(path, &disk_usage);
+  base::LogPerfResult((name + "_files").c_str(), file_count, "files");
+  base::LogPerfResult((name + "_disk_usage").c_str(),
+                      static_cast<double>(disk_usage), "bytes");
+
+  cache = CreateSimpleBackend(path, &cache_thread);
+  ASSERT_TRUE(cache.get());
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kPackingEntries; ++i) {
+    disk_cache::Entry* entry;
+    int rv = cache->OpenEntry(keys[i], &entry, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    rv = entry->ReadData(0, 0, buffer.get(), kHeadersSize, cb.callback());
+    EXPECT_EQ(kHeadersSize, cb.GetResult(rv));
+    rv = entry->ReadData(1, 0, buffer.get(), body_sizes[i], cb.callback());
+    EXPECT_EQ(body_sizes[i], cb.GetResult(rv));
+    entry->Close();
+  }
+  base::LogPerfResult(
+      (name + "_reads").c_str(),
+      kPackingEntries / (base::TimeTicks::Now() - start).InSecondsF(),
+      "ops/s");
+
+  cache.reset();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::MessageLoop::current()->RunUntilIdle();
+}
+
 }  // namespace
 
 TEST_F(DiskCacheTest, Hash) {
@@ -218,6 +437,26 @@ TEST_F(DiskCacheTest, CacheBackendPerformance) {
   base::MessageLoop::current()->RunUntilIdle();
 }
 
+// Measures opening and creating entries in a simple cache holding enough
+// entries for the layout of its directory to matter.
+TEST_F(DiskCacheTest, SimpleCacheOpenCreateLatencyInLargeCache) {
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  ASSERT_TRUE(CleanupCacheDir());
+  MeasureOpenCreateLatencyInLargeCache(cache_path_);
+}
+
+// Compares the simple cache with and without small entry packing, over
+// entries whose sizes are typical of the responses of web pages.
+TEST_F(DiskCacheTest, SimpleCacheSmallEntryPacking) {
+  ASSERT_TRUE(CleanupCacheDir());
+  MeasureSmallEntryPacking(cache_path_, false, "SimpleCacheUnpacked");
+
+  ASSERT_TRUE(CleanupCacheDir());
+  MeasureSmallEntryPacking(cache_path_, true, "SimpleCachePacked");
+}
+
 // Creating and deleting "entries" on a block-file is something quite frequent
 // (after all, almost everything is stored on block files). The operation is
 // almost free when the file is empty, but can be expensive if the file gets
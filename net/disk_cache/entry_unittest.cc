@@ -7,6 +7,7 @@
 #include "base/bind_helpers.h"
 #include "base/files/file.h"
 #include "base/files/file_util.h"
+#include "base/memory/discardable_memory.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/threading/platform_thread.h"
@@ -19,6 +20,7 @@
 #include "net/disk_cache/blockfile/entry_impl.h"
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/memory/mem_entry_impl.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_entry_impl.h"
@@ -2052,6 +2054,32 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyDoomSparseEntry) {
   DoomSparseEntry();
 }
 
+// Tests that a memory-only entry whose data was discarded by the system is
+// doomed once it is read.
+TEST_F(DiskCacheEntryTest, MemoryOnlyDiscardedData) {
+  SetMemoryOnlyMode();
+  InitCache();
+  mem_cache_->SetUseDiscardableMemory(true);
+
+  std::string key("the first key");
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+
+  const int kSize = 20000;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+  EXPECT_EQ(kSize, ReadData(entry, 1, 0, buffer.get(), kSize));
+  entry->Close();
+
+  base::DiscardableMemory::PurgeForTesting();
+  ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+  EXPECT_EQ(net::ERR_CACHE_READ_FAILURE,
+            ReadData(entry, 1, 0, buffer.get(), kSize));
+  entry->Close();
+  EXPECT_NE(net::OK, OpenEntry(key, &entry));
+}
+
 // A CompletionCallback wrapper that deletes the cache from within the callback.
 // The way a CompletionCallback works means that all tasks (even new ones)
 // are executed by the message loop before returning to the caller so the only
@@ -2507,8 +2535,9 @@ bool DiskCacheEntryTest::SimpleCacheMakeBadChecksumEntry(const std::string& key,
   entry = NULL;
 
   // Corrupt the last byte of the data.
-  base::FilePath entry_file0_path = cache_path_.AppendASCII(
-      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0));
+  base::FilePath entry_file0_path =
+      disk_cache::simple_util::GetFilePathFromKeyAndFileIndex(
+          cache_path_, key, 0);
   base::File entry_file0(entry_file0_path,
                          base::File::FLAG_WRITE | base::File::FLAG_OPEN);
   if (!entry_file0.IsValid())
@@ -2596,8 +2625,9 @@ TEST_F(DiskCacheEntryTest, SimpleCacheNoEOF) {
   // Truncate the file such that the length isn't sufficient to have an EOF
   // record.
   int kTruncationBytes = -implicit_cast<int>(sizeof(disk_cache::SimpleFileEOF));
-  const base::FilePath entry_path = cache_path_.AppendASCII(
-      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0));
+  const base::FilePath entry_path =
+      disk_cache::simple_util::GetFilePathFromKeyAndFileIndex(
+          cache_path_, key, 0);
   const int64 invalid_size =
       disk_cache::simple_util::GetFileSizeFromKeyAndDataSize(key,
                                                              kTruncationBytes);
@@ -3080,8 +3110,9 @@ TEST_F(DiskCacheEntryTest, SimpleCacheCreateDoomRace) {
   base::MessageLoop::current()->RunUntilIdle();
 
   for (int i = 0; i < disk_cache::kSimpleEntryFileCount; ++i) {
-    base::FilePath entry_file_path = cache_path_.AppendASCII(
-        disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, i));
+    base::FilePath entry_file_path =
+        disk_cache::simple_util::GetFilePathFromKeyAndFileIndex(
+            cache_path_, key, i);
     base::File::Info info;
     EXPECT_FALSE(base::GetFileInfo(entry_file_path, &info));
   }
@@ -3619,8 +3650,9 @@ TEST_F(DiskCacheEntryTest, SimpleCacheStream1SizeChanges) {
   // the synchronization with the previous Close. This ensures the EOF records
   // have been written to disk before we attempt to read them independently.
   ASSERT_EQ(net::OK, OpenEntry(key, &entry));
-  base::FilePath entry_file0_path = cache_path_.AppendASCII(
-      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0));
+  base::FilePath entry_file0_path =
+      disk_cache::simple_util::GetFilePathFromKeyAndFileIndex(
+          cache_path_, key, 0);
   base::File entry_file0(entry_file0_path,
                          base::File::FLAG_READ | base::File::FLAG_OPEN);
   ASSERT_TRUE(entry_file0.IsValid());
@@ -3709,9 +3741,9 @@ TEST_F(DiskCacheEntryTest, SimpleCacheCRCRewrite) {
 bool DiskCacheEntryTest::SimpleCacheThirdStreamFileExists(const char* key) {
   int third_stream_file_index =
       disk_cache::simple_util::GetFileIndexFromStreamIndex(2);
-  base::FilePath third_stream_file_path = cache_path_.AppendASCII(
-      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(
-          key, third_stream_file_index));
+  base::FilePath third_stream_file_path =
+      disk_cache::simple_util::GetFilePathFromKeyAndFileIndex(
+          cache_path_, key, third_stream_file_index);
   return PathExists(third_stream_file_path);
 }
 
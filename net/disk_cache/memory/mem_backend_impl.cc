@@ -5,6 +5,7 @@
 #include "net/disk_cache/memory/mem_backend_impl.h"
 
 #include "base/logging.h"
+#include "base/metrics/field_trial.h"
 #include "base/sys_info.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/cache_util.h"
@@ -46,6 +47,10 @@ scoped_ptr<Backend> MemBackendImpl::CreateBackend(int max_bytes,
                                                   net::NetLog* net_log) {
   scoped_ptr<MemBackendImpl> cache(new MemBackendImpl(net_log));
   cache->SetMaxSize(max_bytes);
+  if (base::FieldTrialList::FindFullName("MemoryCacheDiscardableMemory") ==
+      "Enabled") {
+    cache->SetUseDiscardableMemory(true);
+  }
   if (cache->Init())
     return cache.PassAs<Backend>();
 
@@ -88,6 +93,11 @@ bool MemBackendImpl::SetMaxSize(int max_bytes) {
   return true;
 }
 
+void MemBackendImpl::SetUseDiscardableMemory(bool use_discardable_memory) {
+  DCHECK(entries_.empty());
+  allocator_.SetUseDiscardableMemory(use_discardable_memory);
+}
+
 void MemBackendImpl::InternalDoomEntry(MemEntryImpl* entry) {
   // Only parent entries can be passed into this method.
   DCHECK(entry->type() == MemEntryImpl::kParentEntry);
@@ -12,6 +12,7 @@
 #include "base/memory/weak_ptr.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/memory/mem_rankings.h"
+#include "net/disk_cache/memory/mem_slab_allocator.h"
 
 namespace net {
 class NetLog;
@@ -41,6 +42,15 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
   // Sets the maximum size for the total amount of data stored by this instance.
   bool SetMaxSize(int max_bytes);
 
+  // Keeps the data of entries in discardable memory, which the system may
+  // reclaim while the entries are not being read or written. Entries whose
+  // data was reclaimed are doomed the next time they are accessed. Must be
+  // called before any entry is created.
+  void SetUseDiscardableMemory(bool use_discardable_memory);
+
+  // Returns the allocator that entries keep their data in.
+  MemSlabAllocator* allocator() { return &allocator_; }
+
   // Permanently deletes an entry.
   void InternalDoomEntry(MemEntryImpl* entry);
 
@@ -106,6 +116,9 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
   void AddStorageSize(int32 bytes);
   void SubstractStorageSize(int32 bytes);
 
+  // Declared before |entries_| so that it outlives every entry.
+  MemSlabAllocator allocator_;
+
   EntryMap entries_;
   MemRankings rankings_;  // Rankings to be able to trim the cache.
   int32 max_size_;        // Maximum data size for this instance.
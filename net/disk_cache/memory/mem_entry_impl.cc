@@ -68,8 +68,10 @@ MemEntryImpl::MemEntryImpl(MemBackendImpl* backend) {
   child_first_pos_ = 0;
   next_ = NULL;
   prev_ = NULL;
-  for (int i = 0; i < NUM_STREAMS; i++)
+  for (int i = 0; i < NUM_STREAMS; i++) {
+    data_[i].Init(backend_->allocator());
     data_size_[i] = 0;
+  }
 }
 
 // ------------------------------------------------------------------------
@@ -274,7 +276,7 @@ int MemEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
 
 MemEntryImpl::~MemEntryImpl() {
   for (int i = 0; i < NUM_STREAMS; i++)
-    backend_->ModifyStorageSize(data_size_[i], 0);
+    backend_->ModifyStorageSize(data_[i].capacity(), 0);
   backend_->ModifyStorageSize(static_cast<int32>(key_.size()), 0);
   net_log_.EndEvent(net::NetLog::TYPE_DISK_CACHE_MEM_ENTRY_IMPL);
 }
@@ -298,7 +300,10 @@ int MemEntryImpl::InternalReadData(int index, int offset, IOBuffer* buf,
 
   UpdateRank(false);
 
-  memcpy(buf->data(), &(data_[index])[offset], buf_len);
+  if (!data_[index].Read(offset, buf->data(), buf_len)) {
+    DoomAfterDataLoss();
+    return net::ERR_CACHE_READ_FAILURE;
+  }
   return buf_len;
 }
 
@@ -320,27 +325,34 @@ int MemEntryImpl::InternalWriteData(int index, int offset, IOBuffer* buf,
     return net::ERR_FAILED;
   }
 
-  // Read the size at this point.
+  // Read the sizes at this point.
   int entry_size = GetDataSize(index);
+  int capacity = data_[index].capacity();
 
-  PrepareTarget(index, offset, buf_len);
+  bool data_kept = PrepareTarget(index, offset, buf_len);
 
   if (entry_size < offset + buf_len) {
-    backend_->ModifyStorageSize(entry_size, offset + buf_len);
     data_size_[index] = offset + buf_len;
   } else if (truncate) {
     if (entry_size > offset + buf_len) {
-      backend_->ModifyStorageSize(entry_size, offset + buf_len);
+      if (!data_[index].Shrink(offset + buf_len))
+        data_kept = false;
       data_size_[index] = offset + buf_len;
     }
   }
 
-  UpdateRank(true);
+  // The cache is charged for the slab memory the stream holds rather than for
+  // its size, so that eviction accounts for unused room in chunks.
+  backend_->ModifyStorageSize(capacity, data_[index].capacity());
 
-  if (!buf_len)
-    return 0;
+  UpdateRank(true);
 
-  memcpy(&(data_[index])[offset], buf->data(), buf_len);
+  if (buf_len && !data_[index].Write(offset, buf->data(), buf_len))
+    data_kept = false;
+  if (!data_kept) {
+    DoomAfterDataLoss();
+    return net::ERR_CACHE_WRITE_FAILURE;
+  }
   return buf_len;
 }
 
@@ -511,21 +523,28 @@ int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start) {
   return 0;
 }
 
-void MemEntryImpl::PrepareTarget(int index, int offset, int buf_len) {
+bool MemEntryImpl::PrepareTarget(int index, int offset, int buf_len) {
   int entry_size = GetDataSize(index);
 
   if (entry_size >= offset + buf_len)
-    return;  // Not growing the stored data.
+    return true;  // Not growing the stored data.
 
-  if (static_cast<int>(data_[index].size()) < offset + buf_len)
-    data_[index].resize(offset + buf_len);
+  if (!data_[index].Reserve(offset + buf_len))
+    return false;
 
   if (offset <= entry_size)
-    return;  // There is no "hole" on the stored data.
+    return true;  // There is no "hole" on the stored data.
 
   // Cleanup the hole not written by the user. The point is to avoid returning
   // random stuff later on.
-  memset(&(data_[index])[entry_size], 0, offset - entry_size);
+  return data_[index].Clear(entry_size, offset - entry_size);
+}
+
+void MemEntryImpl::DoomAfterDataLoss() {
+  if (parent_)
+    parent_->Doom();
+  else
+    Doom();
 }
 
 void MemEntryImpl::UpdateRank(bool modified) {
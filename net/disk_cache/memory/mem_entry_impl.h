@@ -10,6 +10,7 @@
 #include "base/memory/scoped_ptr.h"
 #include "net/base/net_log.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/memory/mem_slab_allocator.h"
 
 namespace disk_cache {
 
@@ -128,8 +129,13 @@ class MemEntryImpl : public Entry {
   // Old Entry interface.
   int GetAvailableRange(int64 offset, int len, int64* start);
 
-  // Grows and cleans up the data buffer.
-  void PrepareTarget(int index, int offset, int buf_len);
+  // Grows and cleans up the data buffer. Returns false if the data stored so
+  // far was discarded.
+  bool PrepareTarget(int index, int offset, int buf_len);
+
+  // Dooms the entry that the user opened after its data was discarded. Child
+  // entries leave that to their parent, which is the one kept open.
+  void DoomAfterDataLoss();
 
   // Updates ranking information.
   void UpdateRank(bool modified);
@@ -158,7 +164,7 @@ class MemEntryImpl : public Entry {
   void DetachChild(int child_id);
 
   std::string key_;
-  std::vector<char> data_[NUM_STREAMS];  // User data.
+  MemSlabBuffer data_[NUM_STREAMS];  // User data, one buffer per stream.
   int32 data_size_[NUM_STREAMS];
   int ref_count_;
 
@@ -0,0 +1,336 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/mem_slab_allocator.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/memory/discardable_memory.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/stl_util.h"
+
+namespace {
+
+// Chunk sizes go up in powers of two with a class halfway between each, so
+// that at most a third of a chunk is left unused.
+const int kChunkSizes[] = {
+  64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144,
+  8192, 12288, 16384
+};
+
+}  // namespace
+
+namespace disk_cache {
+
+class MemSlabAllocator::Slab {
+ public:
+  Slab(int size_class, bool use_discardable_memory)
+      : size_class_(size_class),
+        next_offset_(0),
+        used_chunks_(0),
+        lock_count_(0),
+        generation_(0) {
+    if (use_discardable_memory) {
+      discardable_memory_ =
+          base::DiscardableMemory::CreateLockedMemory(kSlabSize);
+      if (discardable_memory_)
+        discardable_memory_->Unlock();
+    }
+    if (!discardable_memory_)
+      heap_memory_.reset(new char[kSlabSize]);
+  }
+
+  int size_class() const { return size_class_; }
+  int chunk_size() const { return kChunkSizes[size_class_]; }
+  int generation() const { return generation_; }
+
+  bool HasFreeChunk() const {
+    return !free_offsets_.empty() || next_offset_ + chunk_size() <= kSlabSize;
+  }
+
+  bool IsEmpty() const { return !used_chunks_; }
+
+  int AllocateChunk() {
+    DCHECK(HasFreeChunk());
+    used_chunks_++;
+    if (free_offsets_.empty()) {
+      int offset = next_offset_;
+      next_offset_ += chunk_size();
+      return offset;
+    }
+    int offset = free_offsets_.back();
+    free_offsets_.pop_back();
+    return offset;
+  }
+
+  void FreeChunk(int offset) {
+    DCHECK_GT(used_chunks_, 0);
+    used_chunks_--;
+    free_offsets_.push_back(offset);
+  }
+
+  void Lock() {
+    if (lock_count_++ || !discardable_memory_)
+      return;
+
+    switch (discardable_memory_->Lock()) {
+      case base::DISCARDABLE_MEMORY_LOCK_STATUS_SUCCESS:
+        return;
+      case base::DISCARDABLE_MEMORY_LOCK_STATUS_PURGED:
+        generation_++;
+        return;
+      case base::DISCARDABLE_MEMORY_LOCK_STATUS_FAILED:
+        // The memory is gone for good, so replace it.
+        generation_++;
+        discardable_memory_ =
+            base::DiscardableMemory::CreateLockedMemory(kSlabSize);
+        if (!discardable_memory_)
+          heap_memory_.reset(new char[kSlabSize]);
+        return;
+    }
+    NOTREACHED();
+  }
+
+  void Unlock() {
+    DCHECK_GT(lock_count_, 0);
+    if (--lock_count_ || !discardable_memory_)
+      return;
+    discardable_memory_->Unlock();
+  }
+
+  char* memory() const {
+    if (!discardable_memory_)
+      return heap_memory_.get();
+    DCHECK(lock_count_);
+    return static_cast<char*>(discardable_memory_->Memory());
+  }
+
+ private:
+  const int size_class_;
+  scoped_ptr<base::DiscardableMemory> discardable_memory_;
+  scoped_ptr<char[]> heap_memory_;
+
+  // Offsets of the chunks freed so far, reused before any chunk past
+  // |next_offset_|.
+  std::vector<int> free_offsets_;
+  int next_offset_;
+  int used_chunks_;
+
+  int lock_count_;
+  int generation_;
+
+  DISALLOW_COPY_AND_ASSIGN(Slab);
+};
+
+MemSlabAllocator::MemSlabAllocator()
+    : use_discardable_memory_(false),
+      slabs_with_free_chunks_(arraysize(kChunkSizes)) {
+}
+
+MemSlabAllocator::~MemSlabAllocator() {
+  STLDeleteElements(&slabs_);
+}
+
+void MemSlabAllocator::SetUseDiscardableMemory(bool use_discardable_memory) {
+  DCHECK(slabs_.empty());
+  use_discardable_memory_ = use_discardable_memory;
+}
+
+// static
+int MemSlabAllocator::GetChunkSize(int size) {
+  return kChunkSizes[GetSizeClass(size)];
+}
+
+MemSlabAllocator::Chunk MemSlabAllocator::Allocate(int size) {
+  int size_class = GetSizeClass(size);
+  SlabSet& slabs = slabs_with_free_chunks_[size_class];
+  Slab* slab;
+  if (slabs.empty()) {
+    slab = new Slab(size_class, use_discardable_memory_);
+    slabs_.insert(slab);
+    slabs.insert(slab);
+  } else {
+    slab = *slabs.begin();
+  }
+
+  Chunk chunk;
+  chunk.slab = slab;
+  chunk.offset = slab->AllocateChunk();
+  if (!slab->HasFreeChunk())
+    slabs.erase(slab);
+
+  // Lock before reading the generation, so that discarding what the slab held
+  // before does not count against the new chunk.
+  slab->Lock();
+  chunk.generation = slab->generation();
+  return chunk;
+}
+
+void MemSlabAllocator::Free(const Chunk& chunk) {
+  Slab* slab = chunk.slab;
+  slab->FreeChunk(chunk.offset);
+  SlabSet& slabs = slabs_with_free_chunks_[slab->size_class()];
+  slabs.insert(slab);
+
+  // An empty slab is kept while it is the only one of its class with room, so
+  // that an entry being created and doomed over and over does not allocate a
+  // slab each time.
+  if (slab->IsEmpty() && slabs.size() > 1) {
+    slabs.erase(slab);
+    slabs_.erase(slab);
+    delete slab;
+  }
+}
+
+bool MemSlabAllocator::Lock(const Chunk& chunk) {
+  chunk.slab->Lock();
+  return chunk.slab->generation() == chunk.generation;
+}
+
+void MemSlabAllocator::Unlock(const Chunk& chunk) {
+  chunk.slab->Unlock();
+}
+
+char* MemSlabAllocator::GetMemory(const Chunk& chunk) const {
+  return chunk.slab->memory() + chunk.offset;
+}
+
+int MemSlabAllocator::GetChunkSize(const Chunk& chunk) const {
+  return chunk.slab->chunk_size();
+}
+
+int MemSlabAllocator::GetSlabCount() const {
+  return static_cast<int>(slabs_.size());
+}
+
+// static
+int MemSlabAllocator::GetSizeClass(int size) {
+  DCHECK_GT(size, 0);
+  DCHECK_LE(size, kMaxChunkSize);
+  return std::lower_bound(kChunkSizes, kChunkSizes + arraysize(kChunkSizes),
+                          size) - kChunkSizes;
+}
+
+// ------------------------------------------------------------------------
+
+MemSlabBuffer::MemSlabBuffer() : allocator_(NULL), capacity_(0) {
+}
+
+MemSlabBuffer::MemSlabBuffer(MemSlabAllocator* allocator)
+    : allocator_(allocator), capacity_(0) {
+}
+
+MemSlabBuffer::~MemSlabBuffer() {
+  Shrink(0);
+}
+
+void MemSlabBuffer::Init(MemSlabAllocator* allocator) {
+  DCHECK(!allocator_);
+  allocator_ = allocator;
+}
+
+bool MemSlabBuffer::Reserve(int size) {
+  const int kMaxChunkSize = MemSlabAllocator::kMaxChunkSize;
+  if (size <= capacity_)
+    return true;
+
+  bool contents_kept = true;
+  if (chunks_.empty()) {
+    MemSlabAllocator::Chunk chunk =
+        allocator_->Allocate(std::min(size, kMaxChunkSize));
+    allocator_->Unlock(chunk);
+    chunks_.push_back(chunk);
+    capacity_ = allocator_->GetChunkSize(chunk);
+  } else if (capacity_ < kMaxChunkSize) {
+    // Move the contents to a chunk that fits |size| bytes, or that starts a
+    // chain.
+    contents_kept = MoveToNewChunk(std::min(size, kMaxChunkSize), capacity_);
+  }
+
+  while (capacity_ < size) {
+    MemSlabAllocator::Chunk chunk = allocator_->Allocate(kMaxChunkSize);
+    allocator_->Unlock(chunk);
+    chunks_.push_back(chunk);
+    capacity_ += kMaxChunkSize;
+  }
+  return contents_kept;
+}
+
+bool MemSlabBuffer::Shrink(int size) {
+  while (!chunks_.empty() &&
+         static_cast<int>(chunks_.size() - 1) * MemSlabAllocator::kMaxChunkSize
+             >= size) {
+    capacity_ -= allocator_->GetChunkSize(chunks_.back());
+    allocator_->Free(chunks_.back());
+    chunks_.pop_back();
+  }
+  DCHECK_GE(capacity_, 0);
+
+  if (chunks_.size() != 1 || size >= capacity_ ||
+      MemSlabAllocator::GetChunkSize(size) >= capacity_) {
+    return true;
+  }
+  return MoveToNewChunk(size, size);
+}
+
+bool MemSlabBuffer::MoveToNewChunk(int size, int len) {
+  DCHECK_EQ(1u, chunks_.size());
+  MemSlabAllocator::Chunk chunk = allocator_->Allocate(size);
+  bool contents_kept = allocator_->Lock(chunks_[0]);
+  memcpy(allocator_->GetMemory(chunk), allocator_->GetMemory(chunks_[0]), len);
+  allocator_->Unlock(chunks_[0]);
+  allocator_->Unlock(chunk);
+  allocator_->Free(chunks_[0]);
+  chunks_[0] = chunk;
+  capacity_ = allocator_->GetChunkSize(chunk);
+  return contents_kept;
+}
+
+bool MemSlabBuffer::Read(int offset, char* data, int len) {
+  return Access(offset, data, NULL, len);
+}
+
+bool MemSlabBuffer::Write(int offset, const char* data, int len) {
+  return Access(offset, NULL, data, len);
+}
+
+bool MemSlabBuffer::Clear(int offset, int len) {
+  return Access(offset, NULL, NULL, len);
+}
+
+bool MemSlabBuffer::Access(int offset,
+                           char* read_data,
+                           const char* write_data,
+                           int len) {
+  DCHECK_GE(offset, 0);
+  DCHECK_LE(offset + len, capacity_);
+  bool contents_kept = true;
+  while (len > 0) {
+    const MemSlabAllocator::Chunk& chunk =
+        chunks_[offset / MemSlabAllocator::kMaxChunkSize];
+    int chunk_offset = offset % MemSlabAllocator::kMaxChunkSize;
+    int bytes = std::min(len, allocator_->GetChunkSize(chunk) - chunk_offset);
+
+    if (!allocator_->Lock(chunk))
+      contents_kept = false;
+    char* memory = allocator_->GetMemory(chunk) + chunk_offset;
+    if (read_data) {
+      memcpy(read_data, memory, bytes);
+      read_data += bytes;
+    } else if (write_data) {
+      memcpy(memory, write_data, bytes);
+      write_data += bytes;
+    } else {
+      memset(memory, 0, bytes);
+    }
+    allocator_->Unlock(chunk);
+
+    offset += bytes;
+    len -= bytes;
+  }
+  return contents_kept;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,142 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_MEMORY_MEM_SLAB_ALLOCATOR_H_
+#define NET_DISK_CACHE_MEMORY_MEM_SLAB_ALLOCATOR_H_
+
+#include <set>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+// This class hands out the memory that the memory-only cache keeps entry data
+// in. Memory is allocated in slabs of kSlabSize bytes, each one carved into
+// chunks of a single size class, so that entries of similar sizes share slabs
+// instead of each stream being a separate heap allocation.
+//
+// Slabs can optionally be backed by base::DiscardableMemory, in which case the
+// system may discard the contents of a slab while none of its chunks is
+// locked. A chunk must be locked while its memory is accessed, and Lock()
+// reports whether its contents survived since it was allocated.
+class NET_EXPORT_PRIVATE MemSlabAllocator {
+ public:
+  static const int kMinChunkSize = 64;
+  static const int kMaxChunkSize = 16 * 1024;
+  static const int kSlabSize = 128 * 1024;
+
+  class Slab;
+
+  // A chunk of slab memory.
+  struct Chunk {
+    Chunk() : slab(NULL), offset(0), generation(0) {}
+
+    Slab* slab;
+    int offset;
+    // The generation of |slab| when the chunk was allocated. Slabs move to a
+    // new generation whenever their contents are discarded.
+    int generation;
+  };
+
+  MemSlabAllocator();
+  ~MemSlabAllocator();
+
+  // Backs new slabs with discardable memory. Must be called before any chunk
+  // is allocated.
+  void SetUseDiscardableMemory(bool use_discardable_memory);
+
+  // Returns the size of the chunk that Allocate() returns for |size| bytes,
+  // which must be at most kMaxChunkSize.
+  static int GetChunkSize(int size);
+
+  // Returns a new chunk of at least |size| bytes. The chunk is returned locked
+  // and must be unlocked once the caller is done writing to it.
+  Chunk Allocate(int size);
+
+  // Releases |chunk|, which must not be locked.
+  void Free(const Chunk& chunk);
+
+  // Locks the memory of |chunk| so that it can be accessed. Returns false if
+  // its contents were discarded since it was allocated. The chunk must be
+  // unlocked afterwards either way.
+  bool Lock(const Chunk& chunk);
+  void Unlock(const Chunk& chunk);
+
+  // Returns the memory of a locked |chunk|.
+  char* GetMemory(const Chunk& chunk) const;
+
+  int GetChunkSize(const Chunk& chunk) const;
+
+  // Returns the number of slabs currently allocated.
+  int GetSlabCount() const;
+
+ private:
+  typedef std::set<Slab*> SlabSet;
+
+  static int GetSizeClass(int size);
+
+  bool use_discardable_memory_;
+  SlabSet slabs_;
+
+  // Slabs with free chunks, one set for each size class.
+  std::vector<SlabSet> slabs_with_free_chunks_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemSlabAllocator);
+};
+
+// A growable buffer that keeps its contents in chunks of a MemSlabAllocator.
+// Buffers of up to kMaxChunkSize bytes take a single chunk of the smallest
+// size class that fits, and larger buffers a chain of kMaxChunkSize chunks, so
+// that growing a large buffer never copies it.
+//
+// The methods that access the contents return false if some of them were
+// discarded.
+class NET_EXPORT_PRIVATE MemSlabBuffer {
+ public:
+  // A buffer built with the default constructor must be given its allocator
+  // with Init() before it is used.
+  MemSlabBuffer();
+  explicit MemSlabBuffer(MemSlabAllocator* allocator);
+  ~MemSlabBuffer();
+
+  void Init(MemSlabAllocator* allocator);
+
+  // Returns the number of bytes of slab memory held by this buffer.
+  int capacity() const { return capacity_; }
+
+  // Grows the buffer to hold at least |size| bytes, keeping its contents.
+  bool Reserve(int size);
+
+  // Releases the chunks that are not needed to hold |size| bytes, and moves
+  // what is left of a single chunk buffer to the smallest size class that
+  // fits.
+  bool Shrink(int size);
+
+  bool Read(int offset, char* data, int len);
+  bool Write(int offset, const char* data, int len);
+
+  // Fills |len| bytes at |offset| with zeros.
+  bool Clear(int offset, int len);
+
+ private:
+  // Moves the first |len| bytes of a single chunk buffer to a new chunk of
+  // at least |size| bytes.
+  bool MoveToNewChunk(int size, int len);
+
+  // Copies |len| bytes at |offset| to |read_data|, or from |write_data|, or
+  // zeros them if both are NULL.
+  bool Access(int offset, char* read_data, const char* write_data, int len);
+
+  MemSlabAllocator* allocator_;
+  std::vector<MemSlabAllocator::Chunk> chunks_;
+  int capacity_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemSlabBuffer);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEMORY_MEM_SLAB_ALLOCATOR_H_
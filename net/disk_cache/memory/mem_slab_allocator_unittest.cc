@@ -0,0 +1,169 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/mem_slab_allocator.h"
+
+#include <string>
+
+#include "base/memory/discardable_memory.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+std::string MakeData(int size) {
+  std::string data(size, '\0');
+  for (int i = 0; i < size; ++i)
+    data[i] = static_cast<char>(i * 7);
+  return data;
+}
+
+}  // namespace
+
+TEST(MemSlabAllocatorTest, ChunkSizes) {
+  EXPECT_EQ(64, MemSlabAllocator::GetChunkSize(1));
+  EXPECT_EQ(64, MemSlabAllocator::GetChunkSize(64));
+  EXPECT_EQ(96, MemSlabAllocator::GetChunkSize(65));
+  EXPECT_EQ(1536, MemSlabAllocator::GetChunkSize(1100));
+  EXPECT_EQ(MemSlabAllocator::kMaxChunkSize,
+            MemSlabAllocator::GetChunkSize(MemSlabAllocator::kMaxChunkSize));
+}
+
+TEST(MemSlabAllocatorTest, SharesSlabs) {
+  MemSlabAllocator allocator;
+  MemSlabAllocator::Chunk first = allocator.Allocate(100);
+  MemSlabAllocator::Chunk second = allocator.Allocate(120);
+  MemSlabAllocator::Chunk other_class = allocator.Allocate(1000);
+  EXPECT_EQ(first.slab, second.slab);
+  EXPECT_NE(first.slab, other_class.slab);
+  EXPECT_NE(first.offset, second.offset);
+  EXPECT_EQ(2, allocator.GetSlabCount());
+
+  allocator.Unlock(first);
+  allocator.Unlock(second);
+  allocator.Unlock(other_class);
+  allocator.Free(first);
+  allocator.Free(second);
+  allocator.Free(other_class);
+}
+
+TEST(MemSlabAllocatorTest, ReleasesEmptySlabs) {
+  MemSlabAllocator allocator;
+  const int kChunksPerSlab =
+      MemSlabAllocator::kSlabSize / MemSlabAllocator::kMaxChunkSize;
+  std::vector<MemSlabAllocator::Chunk> chunks;
+  for (int i = 0; i < 2 * kChunksPerSlab; ++i) {
+    chunks.push_back(allocator.Allocate(MemSlabAllocator::kMaxChunkSize));
+    allocator.Unlock(chunks.back());
+  }
+  EXPECT_EQ(2, allocator.GetSlabCount());
+
+  // Emptying the first slab releases it, as the second one has room.
+  allocator.Free(chunks.back());
+  for (int i = 0; i < kChunksPerSlab; ++i)
+    allocator.Free(chunks[i]);
+  EXPECT_EQ(1, allocator.GetSlabCount());
+
+  // The last slab of a class is kept even once empty.
+  for (int i = kChunksPerSlab; i < 2 * kChunksPerSlab - 1; ++i)
+    allocator.Free(chunks[i]);
+  EXPECT_EQ(1, allocator.GetSlabCount());
+}
+
+TEST(MemSlabAllocatorTest, DetectsDiscardedChunks) {
+  MemSlabAllocator allocator;
+  allocator.SetUseDiscardableMemory(true);
+  MemSlabAllocator::Chunk chunk = allocator.Allocate(100);
+  allocator.Unlock(chunk);
+
+  EXPECT_TRUE(allocator.Lock(chunk));
+  allocator.Unlock(chunk);
+
+  base::DiscardableMemory::PurgeForTesting();
+  EXPECT_FALSE(allocator.Lock(chunk));
+  allocator.Unlock(chunk);
+
+  // Chunks allocated after the purge are not affected by it.
+  MemSlabAllocator::Chunk new_chunk = allocator.Allocate(100);
+  allocator.Unlock(new_chunk);
+  EXPECT_TRUE(allocator.Lock(new_chunk));
+  allocator.Unlock(new_chunk);
+
+  allocator.Free(chunk);
+  allocator.Free(new_chunk);
+}
+
+TEST(MemSlabBufferTest, GrowAndShrink) {
+  MemSlabAllocator allocator;
+  MemSlabBuffer buffer(&allocator);
+  EXPECT_EQ(0, buffer.capacity());
+
+  const std::string data = MakeData(100 * 1024);
+  ASSERT_TRUE(buffer.Reserve(100));
+  EXPECT_EQ(128, buffer.capacity());
+  ASSERT_TRUE(buffer.Write(0, data.data(), 100));
+
+  // Growing within kMaxChunkSize moves the contents to a larger chunk.
+  ASSERT_TRUE(buffer.Reserve(5000));
+  EXPECT_EQ(6144, buffer.capacity());
+  ASSERT_TRUE(buffer.Write(100, data.data() + 100, 4900));
+
+  // Larger buffers are chains of kMaxChunkSize chunks.
+  ASSERT_TRUE(buffer.Reserve(static_cast<int>(data.size())));
+  EXPECT_EQ(7 * MemSlabAllocator::kMaxChunkSize, buffer.capacity());
+  ASSERT_TRUE(buffer.Write(5000, data.data() + 5000,
+                           static_cast<int>(data.size()) - 5000));
+
+  std::string read(data.size(), '\0');
+  ASSERT_TRUE(buffer.Read(0, &read[0], static_cast<int>(read.size())));
+  EXPECT_EQ(data, read);
+
+  EXPECT_TRUE(buffer.Shrink(20000));
+  EXPECT_EQ(2 * MemSlabAllocator::kMaxChunkSize, buffer.capacity());
+  ASSERT_TRUE(buffer.Read(0, &read[0], 20000));
+  EXPECT_EQ(0, data.compare(0, 20000, read, 0, 20000));
+
+  // Once a single chunk is left, it moves to the smallest class that fits.
+  EXPECT_TRUE(buffer.Shrink(1000));
+  EXPECT_EQ(1024, buffer.capacity());
+  ASSERT_TRUE(buffer.Read(0, &read[0], 1000));
+  EXPECT_EQ(0, data.compare(0, 1000, read, 0, 1000));
+
+  EXPECT_TRUE(buffer.Shrink(0));
+  EXPECT_EQ(0, buffer.capacity());
+}
+
+TEST(MemSlabBufferTest, Clear) {
+  MemSlabAllocator allocator;
+  MemSlabBuffer buffer(&allocator);
+  const std::string data = MakeData(40000);
+  ASSERT_TRUE(buffer.Reserve(static_cast<int>(data.size())));
+  ASSERT_TRUE(buffer.Write(0, data.data(), static_cast<int>(data.size())));
+  ASSERT_TRUE(buffer.Clear(10000, 20000));
+
+  std::string read(data.size(), '\0');
+  ASSERT_TRUE(buffer.Read(0, &read[0], static_cast<int>(read.size())));
+  EXPECT_EQ(0, data.compare(0, 10000, read, 0, 10000));
+  EXPECT_EQ(std::string(20000, '\0'), read.substr(10000, 20000));
+  EXPECT_EQ(0, data.compare(30000, 10000, read, 30000, 10000));
+}
+
+TEST(MemSlabBufferTest, DiscardedContents) {
+  MemSlabAllocator allocator;
+  allocator.SetUseDiscardableMemory(true);
+  MemSlabBuffer buffer(&allocator);
+  const std::string data = MakeData(1000);
+  ASSERT_TRUE(buffer.Reserve(static_cast<int>(data.size())));
+  ASSERT_TRUE(buffer.Write(0, data.data(), static_cast<int>(data.size())));
+
+  base::DiscardableMemory::PurgeForTesting();
+  std::string read(data.size(), '\0');
+  EXPECT_FALSE(buffer.Read(0, &read[0], static_cast<int>(read.size())));
+
+  // Growing the buffer copies what is left, and reports the loss as well.
+  EXPECT_FALSE(buffer.Reserve(2000));
+}
+
+}  // namespace disk_cache
@@ -29,9 +29,11 @@
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_entry_impl.h"
+#include "net/disk_cache/simple/simple_eviction_policy.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index.h"
 #include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_pack_store.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "net/disk_cache/simple/simple_version_upgrade.h"
@@ -250,20 +252,31 @@ int SimpleBackendImpl::Init(const CompletionCallback& completion_callback) {
   worker_pool_ = g_sequenced_worker_pool->GetTaskRunnerWithShutdownBehavior(
       SequencedWorkerPool::CONTINUE_ON_SHUTDOWN);
 
+  if (base::FieldTrialList::FindFullName("SimpleCacheSmallEntryPacking") ==
+      "Enabled") {
+    pack_store_ = new SimplePackStore(path_, worker_pool_);
+  }
+
   index_.reset(new SimpleIndex(
       base::ThreadTaskRunnerHandle::Get(),
       this,
       cache_type_,
       make_scoped_ptr(new SimpleIndexFile(
-          cache_thread_, worker_pool_.get(), cache_type_, path_))));
+          cache_thread_, worker_pool_.get(), pack_store_, cache_type_,
+          path_))));
+  index_->SetEvictionPolicy(SimpleEvictionPolicy::Create(
+      SimpleEvictionPolicy::GetTypeFromName(
+          base::FieldTrialList::FindFullName("SimpleCacheEvictionPolicy"))));
   index_->ExecuteWhenReady(
       base::Bind(&RecordIndexLoad, cache_type_, base::TimeTicks::Now()));
 
   PostTaskAndReplyWithResult(
       cache_thread_.get(),
       FROM_HERE,
-      base::Bind(
-          &SimpleBackendImpl::InitCacheStructureOnDisk, path_, orig_max_size_),
+      base::Bind(&SimpleBackendImpl::InitCacheStructureOnDisk,
+                 path_,
+                 orig_max_size_,
+                 pack_store_),
       base::Bind(&SimpleBackendImpl::InitializeIndex,
                  AsWeakPtr(),
                  completion_callback));
@@ -351,7 +364,8 @@ void SimpleBackendImpl::DoomEntries(std::vector<uint64>* entry_hashes,
                              FROM_HERE,
                              base::Bind(&SimpleSynchronousEntry::DoomEntrySet,
                                         mass_doom_entry_hashes_ptr,
-                                        path_),
+                                        path_,
+                                        pack_store_),
                              base::Bind(&SimpleBackendImpl::DoomEntriesComplete,
                                         AsWeakPtr(),
                                         base::Passed(&mass_doom_entry_hashes),
@@ -550,7 +564,7 @@ void SimpleBackendImpl::GetStats(
 }
 
 void SimpleBackendImpl::OnExternalCacheHit(const std::string& key) {
-  index_->UseIfExists(simple_util::GetEntryHashKey(key));
+  index_->HitIfExists(simple_util::GetEntryHashKey(key));
 }
 
 void SimpleBackendImpl::InitializeIndex(const CompletionCallback& callback,
@@ -564,7 +578,8 @@ void SimpleBackendImpl::InitializeIndex(const CompletionCallback& callback,
 
 SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
     const base::FilePath& path,
-    uint64 suggested_max_size) {
+    uint64 suggested_max_size,
+    const scoped_refptr<SimplePackStore>& pack_store) {
   DiskStatResult result;
   result.max_size = suggested_max_size;
   result.net_error = net::OK;
@@ -572,9 +587,13 @@ SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
     LOG(ERROR) << "Simple Cache Backend: wrong file structure on disk: "
                << path.LossyDisplayName();
     result.net_error = net::ERR_FAILED;
+  } else if (pack_store.get() && !pack_store->Load()) {
+    LOG(ERROR) << "Simple Cache Backend: could not load the pack files in: "
+               << path.LossyDisplayName();
+    result.net_error = net::ERR_FAILED;
   } else {
     bool mtime_result =
-        disk_cache::simple_util::GetMTime(path, &result.cache_dir_mtime);
+        disk_cache::simple_util::GetCacheMTime(path, &result.cache_dir_mtime);
     DCHECK(mtime_result);
     if (!result.max_size) {
       int64 available = base::SysInfo::AmountOfFreeDiskSpace(path);
@@ -44,6 +44,7 @@ namespace disk_cache {
 
 class SimpleEntryImpl;
 class SimpleIndex;
+class SimplePackStore;
 
 class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
     public SimpleIndexDelegate,
@@ -63,6 +64,11 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
 
   base::TaskRunner* worker_pool() { return worker_pool_.get(); }
 
+  // Returns NULL unless small entries are packed, see simple_pack_store.h.
+  const scoped_refptr<SimplePackStore>& pack_store() const {
+    return pack_store_;
+  }
+
   int Init(const CompletionCallback& completion_callback);
 
   // Sets the maximum size for the total amount of data stored by this instance.
@@ -137,10 +143,12 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
                          const CompletionCallback& callback,
                          int result);
 
-  // Try to create the directory if it doesn't exist. This must run on the IO
-  // thread.
-  static DiskStatResult InitCacheStructureOnDisk(const base::FilePath& path,
-                                                 uint64 suggested_max_size);
+  // Try to create the directory if it doesn't exist, and load |pack_store|
+  // if not NULL. This must run on the IO thread.
+  static DiskStatResult InitCacheStructureOnDisk(
+      const base::FilePath& path,
+      uint64 suggested_max_size,
+      const scoped_refptr<SimplePackStore>& pack_store);
 
   // Searches |active_entries_| for the entry corresponding to |key|. If found,
   // returns the found entry. Otherwise, creates a new entry and returns that.
@@ -190,6 +198,7 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   scoped_ptr<SimpleIndex> index_;
   const scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
   scoped_refptr<base::TaskRunner> worker_pool_;
+  scoped_refptr<SimplePackStore> pack_store_;
 
   int orig_max_size_;
   const SimpleEntryImpl::OperationsMode entry_operations_mode_;
@@ -23,4 +23,9 @@ SimpleFileSparseRangeHeader::SimpleFileSparseRangeHeader() {
   std::memset(this, 0, sizeof(*this));
 }
 
+SimplePackRecordHeader::SimplePackRecordHeader() {
+  // Make hashing repeatable: leave no padding bytes untouched.
+  std::memset(this, 0, sizeof(*this));
+}
+
 }  // namespace disk_cache
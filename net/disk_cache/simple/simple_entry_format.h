@@ -19,6 +19,7 @@ namespace disk_cache {
 const uint64 kSimpleInitialMagicNumber = GG_UINT64_C(0xfcfb6d1ba7725c30);
 const uint64 kSimpleFinalMagicNumber = GG_UINT64_C(0xf4fa6f45970d41d8);
 const uint64 kSimpleSparseRangeMagicNumber = GG_UINT64_C(0xeb97bf016553676b);
+const uint64 kSimplePackRecordMagicNumber = GG_UINT64_C(0x8d2c5e17b3a6f049);
 
 // A file containing stream 0 and stream 1 in the Simple cache consists of:
 //   - a SimpleFileHeader.
@@ -68,6 +69,24 @@ struct SimpleFileSparseRangeHeader {
   uint32 data_crc32;
 };
 
+// A pack file in the Simple cache consists of records, each of which is:
+//   - a SimplePackRecordHeader.
+//   - the contents of the file containing stream 0 and stream 1 of an entry,
+//     |data_size| bytes long.
+struct NET_EXPORT_PRIVATE SimplePackRecordHeader {
+  enum Flags {
+    FLAG_REMOVED = (1U << 0),
+  };
+
+  SimplePackRecordHeader();
+
+  uint64 pack_record_magic_number;
+  uint64 entry_hash;
+  int64 last_modified;
+  uint32 data_size;
+  uint32 flags;
+};
+
 }  // namespace disk_cache
 
 #endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_FORMAT_H_
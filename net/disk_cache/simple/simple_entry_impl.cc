@@ -25,6 +25,7 @@
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index.h"
 #include "net/disk_cache/simple/simple_net_log_parameters.h"
+#include "net/disk_cache/simple/simple_pack_store.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
@@ -172,6 +173,7 @@ SimpleEntryImpl::SimpleEntryImpl(net::CacheType cache_type,
     : backend_(backend->AsWeakPtr()),
       cache_type_(cache_type),
       worker_pool_(backend->worker_pool()),
+      pack_store_(backend->pack_store()),
       path_(path),
       entry_hash_(entry_hash),
       use_optimistic_operations_(operations_mode == OPTIMISTIC_OPERATIONS),
@@ -663,6 +665,8 @@ void SimpleEntryImpl::OpenEntryInternal(bool have_index,
   net_log_.AddEvent(net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_OPEN_BEGIN);
 
   if (state_ == STATE_READY) {
+    if (!doomed_ && backend_.get())
+      backend_->index()->HitIfExists(entry_hash_);
     ReturnEntryToCaller(out_entry);
     PostClientCallback(callback, net::OK);
     net_log_.AddEvent(
@@ -689,6 +693,7 @@ void SimpleEntryImpl::OpenEntryInternal(bool have_index,
   Closure task = base::Bind(&SimpleSynchronousEntry::OpenEntry,
                             cache_type_,
                             path_,
+                            pack_store_,
                             entry_hash_,
                             have_index,
                             results.get());
@@ -738,6 +743,7 @@ void SimpleEntryImpl::CreateEntryInternal(bool have_index,
   Closure task = base::Bind(&SimpleSynchronousEntry::CreateEntry,
                             cache_type_,
                             path_,
+                            pack_store_,
                             key_,
                             entry_hash_,
                             have_index,
@@ -784,7 +790,8 @@ void SimpleEntryImpl::CloseInternal() {
                    SimpleEntryStat(last_used_, last_modified_, data_size_,
                                    sparse_data_size_),
                    base::Passed(&crc32s_to_write),
-                   stream_0_data_);
+                   stream_0_data_,
+                   doomed_);
     Closure reply = base::Bind(&SimpleEntryImpl::CloseOperationComplete, this);
     synchronous_entry_ = NULL;
     worker_pool_->PostTaskAndReply(FROM_HERE, task, reply);
@@ -1081,7 +1088,10 @@ void SimpleEntryImpl::DoomEntryInternal(const CompletionCallback& callback) {
   PostTaskAndReplyWithResult(
       worker_pool_.get(),
       FROM_HERE,
-      base::Bind(&SimpleSynchronousEntry::DoomEntry, path_, entry_hash_),
+      base::Bind(&SimpleSynchronousEntry::DoomEntry,
+                 path_,
+                 pack_store_,
+                 entry_hash_),
       base::Bind(
           &SimpleEntryImpl::DoomOperationComplete, this, callback, state_));
   state_ = STATE_IO_PENDING;
@@ -1135,6 +1145,10 @@ void SimpleEntryImpl::CreationOperationComplete(
                    "EntryCreationTime", cache_type_,
                    (base::TimeTicks::Now() - start_time));
   AdjustOpenEntryCountBy(cache_type_, 1);
+  if (end_event_type == net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_OPEN_END &&
+      !doomed_ && backend_.get()) {
+    backend_->index()->HitIfExists(entry_hash_);
+  }
 
   net_log_.AddEvent(end_event_type);
   PostClientCallback(completion_callback, net::OK);
@@ -31,6 +31,7 @@ class IOBuffer;
 namespace disk_cache {
 
 class SimpleBackendImpl;
+class SimplePackStore;
 class SimpleSynchronousEntry;
 class SimpleEntryStat;
 struct SimpleEntryCreationResults;
@@ -311,6 +312,7 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   const base::WeakPtr<SimpleBackendImpl> backend_;
   const net::CacheType cache_type_;
   const scoped_refptr<base::TaskRunner> worker_pool_;
+  const scoped_refptr<SimplePackStore> pack_store_;
   const base::FilePath path_;
   const uint64 entry_hash_;
   const bool use_optimistic_operations_;
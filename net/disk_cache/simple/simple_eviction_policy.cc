@@ -0,0 +1,287 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_eviction_policy.h"
+
+#include <algorithm>
+
+#include "base/containers/hash_tables.h"
+#include "base/logging.h"
+#include "base/time/time.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Share of the cache, in bytes, that protected entries may take up in a
+// segmented LRU before the least recently used of them are demoted.
+const uint64 kProtectedSegmentPercent = 80;
+
+// Number of counters in each row of the TinyLFU frequency sketch.
+const size_t kFrequencySketchWidth = 32 * 1024;
+
+// An eviction candidate, copied out of the index so that sorting them does not
+// need any hash table lookups.
+struct EvictionCandidate {
+  EvictionCandidate(base::Time last_used_time, uint64 entry_hash,
+                    int entry_size)
+      : last_used_time(last_used_time),
+        entry_hash(entry_hash),
+        entry_size(entry_size),
+        frequency(0) {}
+
+  bool operator<(const EvictionCandidate& other) const {
+    return last_used_time < other.last_used_time;
+  }
+
+  base::Time last_used_time;
+  uint64 entry_hash;
+  int entry_size;
+  int frequency;
+};
+
+typedef std::vector<EvictionCandidate> CandidateList;
+
+// Orders less frequently used candidates first, and the least recently used
+// of equally frequent ones.
+bool IsLessFrequentlyUsed(const EvictionCandidate& a,
+                          const EvictionCandidate& b) {
+  if (a.frequency != b.frequency)
+    return a.frequency < b.frequency;
+  return a.last_used_time < b.last_used_time;
+}
+
+// Appends the hashes of |candidates|, in order, to |entry_hashes| until
+// |*evicted_size| reaches |bytes_to_evict|.
+void AppendEntriesToEvict(const CandidateList& candidates,
+                          uint64 bytes_to_evict,
+                          uint64* evicted_size,
+                          std::vector<uint64>* entry_hashes) {
+  for (CandidateList::const_iterator it = candidates.begin();
+       it != candidates.end() && *evicted_size < bytes_to_evict; ++it) {
+    *evicted_size += it->entry_size;
+    entry_hashes->push_back(it->entry_hash);
+  }
+}
+
+class LruEvictionPolicy : public SimpleEvictionPolicy {
+ public:
+  LruEvictionPolicy() {}
+  virtual ~LruEvictionPolicy() {}
+
+  // SimpleEvictionPolicy implementation.
+  virtual void OnInsert(uint64 entry_hash) OVERRIDE {}
+  virtual void OnUse(uint64 entry_hash) OVERRIDE {}
+  virtual void OnRemove(uint64 entry_hash) OVERRIDE {}
+
+  virtual uint64 SelectEntriesToEvict(
+      const SimpleIndex::EntrySet& entries,
+      uint64 bytes_to_evict,
+      std::vector<uint64>* entry_hashes) OVERRIDE {
+    CandidateList candidates;
+    candidates.reserve(entries.size());
+    for (SimpleIndex::EntrySet::const_iterator it = entries.begin(),
+         end = entries.end(); it != end; ++it) {
+      candidates.push_back(EvictionCandidate(it->second.GetLastUsedTime(),
+                                             it->first,
+                                             it->second.GetEntrySize()));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    uint64 evicted_size = 0;
+    AppendEntriesToEvict(candidates, bytes_to_evict, &evicted_size,
+                         entry_hashes);
+    return evicted_size;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LruEvictionPolicy);
+};
+
+class SegmentedLruEvictionPolicy : public SimpleEvictionPolicy {
+ public:
+  SegmentedLruEvictionPolicy() {}
+  virtual ~SegmentedLruEvictionPolicy() {}
+
+  // SimpleEvictionPolicy implementation.
+  virtual void OnInsert(uint64 entry_hash) OVERRIDE {
+    // A recreated entry starts over on probation.
+    protected_entries_.erase(entry_hash);
+  }
+
+  virtual void OnUse(uint64 entry_hash) OVERRIDE {
+    protected_entries_.insert(entry_hash);
+  }
+
+  virtual void OnRemove(uint64 entry_hash) OVERRIDE {
+    protected_entries_.erase(entry_hash);
+  }
+
+  virtual uint64 SelectEntriesToEvict(
+      const SimpleIndex::EntrySet& entries,
+      uint64 bytes_to_evict,
+      std::vector<uint64>* entry_hashes) OVERRIDE {
+    CandidateList probationary;
+    CandidateList protected_candidates;
+    uint64 total_size = 0;
+    uint64 protected_size = 0;
+    for (SimpleIndex::EntrySet::const_iterator it = entries.begin(),
+         end = entries.end(); it != end; ++it) {
+      EvictionCandidate candidate(it->second.GetLastUsedTime(), it->first,
+                                  it->second.GetEntrySize());
+      total_size += candidate.entry_size;
+      if (protected_entries_.count(it->first)) {
+        protected_size += candidate.entry_size;
+        protected_candidates.push_back(candidate);
+      } else {
+        probationary.push_back(candidate);
+      }
+    }
+    SortProbationaryEntries(&probationary);
+    std::sort(protected_candidates.begin(), protected_candidates.end());
+
+    // Once the protected segment outgrows its share of the cache, its least
+    // recently used entries go back on probation, behind the entries already
+    // there.
+    CandidateList::iterator protected_begin = protected_candidates.begin();
+    while (protected_begin != protected_candidates.end() &&
+           protected_size * 100 > total_size * kProtectedSegmentPercent) {
+      protected_size -= protected_begin->entry_size;
+      protected_entries_.erase(protected_begin->entry_hash);
+      probationary.push_back(*protected_begin);
+      ++protected_begin;
+    }
+    protected_candidates.erase(protected_candidates.begin(), protected_begin);
+
+    uint64 evicted_size = 0;
+    AppendEntriesToEvict(probationary, bytes_to_evict, &evicted_size,
+                         entry_hashes);
+    AppendEntriesToEvict(protected_candidates, bytes_to_evict, &evicted_size,
+                         entry_hashes);
+    return evicted_size;
+  }
+
+ protected:
+  // Orders |probationary| entries in the order they should be evicted.
+  virtual void SortProbationaryEntries(CandidateList* probationary) {
+    std::sort(probationary->begin(), probationary->end());
+  }
+
+ private:
+  base::hash_set<uint64> protected_entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentedLruEvictionPolicy);
+};
+
+class TinyLfuEvictionPolicy : public SegmentedLruEvictionPolicy {
+ public:
+  TinyLfuEvictionPolicy() : sketch_(kFrequencySketchWidth) {}
+  virtual ~TinyLfuEvictionPolicy() {}
+
+  // SimpleEvictionPolicy implementation.
+  virtual void OnInsert(uint64 entry_hash) OVERRIDE {
+    sketch_.Increment(entry_hash);
+    SegmentedLruEvictionPolicy::OnInsert(entry_hash);
+  }
+
+  virtual void OnUse(uint64 entry_hash) OVERRIDE {
+    sketch_.Increment(entry_hash);
+    SegmentedLruEvictionPolicy::OnUse(entry_hash);
+  }
+
+ protected:
+  // SegmentedLruEvictionPolicy implementation.
+  virtual void SortProbationaryEntries(CandidateList* probationary) OVERRIDE {
+    for (CandidateList::iterator it = probationary->begin();
+         it != probationary->end(); ++it) {
+      it->frequency = sketch_.Estimate(it->entry_hash);
+    }
+    std::sort(probationary->begin(), probationary->end(),
+              IsLessFrequentlyUsed);
+  }
+
+ private:
+  FrequencySketch sketch_;
+
+  DISALLOW_COPY_AND_ASSIGN(TinyLfuEvictionPolicy);
+};
+
+}  // namespace
+
+FrequencySketch::FrequencySketch(size_t width)
+    : counters_(kDepth * width),
+      width_mask_(width - 1),
+      sample_size_(10 * width),
+      increments_(0) {
+  DCHECK_GT(width, 0U);
+  DCHECK_EQ(0U, width & width_mask_);
+}
+
+FrequencySketch::~FrequencySketch() {
+}
+
+void FrequencySketch::Increment(uint64 entry_hash) {
+  for (int row = 0; row < kDepth; ++row) {
+    uint8& counter = counters_[GetCounterIndex(entry_hash, row)];
+    if (counter < kMaxFrequency)
+      ++counter;
+  }
+  if (++increments_ >= sample_size_)
+    Age();
+}
+
+int FrequencySketch::Estimate(uint64 entry_hash) const {
+  int estimate = kMaxFrequency;
+  for (int row = 0; row < kDepth; ++row) {
+    estimate = std::min(estimate,
+                        static_cast<int>(
+                            counters_[GetCounterIndex(entry_hash, row)]));
+  }
+  return estimate;
+}
+
+size_t FrequencySketch::GetCounterIndex(uint64 entry_hash, int row) const {
+  // Each row hashes the entry hash with its own seed, so that entries sharing
+  // a counter in one row are unlikely to share one in the others.
+  static const uint64 kSeeds[kDepth] = {
+    GG_UINT64_C(0xc3a5c85c97cb3127), GG_UINT64_C(0xb492b66fbe98f273),
+    GG_UINT64_C(0x9ae16a3b2f90404f), GG_UINT64_C(0xcbf29ce484222325),
+  };
+  uint64 mixed = (entry_hash ^ kSeeds[row]) * GG_UINT64_C(0x9e3779b97f4a7c15);
+  mixed ^= mixed >> 32;
+  return row * (width_mask_ + 1) + (static_cast<size_t>(mixed) & width_mask_);
+}
+
+void FrequencySketch::Age() {
+  for (size_t i = 0; i < counters_.size(); ++i)
+    counters_[i] >>= 1;
+  increments_ /= 2;
+}
+
+// static
+scoped_ptr<SimpleEvictionPolicy> SimpleEvictionPolicy::Create(Type type) {
+  switch (type) {
+    case TYPE_LRU:
+      return scoped_ptr<SimpleEvictionPolicy>(new LruEvictionPolicy());
+    case TYPE_SEGMENTED_LRU:
+      return scoped_ptr<SimpleEvictionPolicy>(
+          new SegmentedLruEvictionPolicy());
+    case TYPE_TINY_LFU:
+      return scoped_ptr<SimpleEvictionPolicy>(new TinyLfuEvictionPolicy());
+  }
+  NOTREACHED();
+  return scoped_ptr<SimpleEvictionPolicy>();
+}
+
+// static
+SimpleEvictionPolicy::Type SimpleEvictionPolicy::GetTypeFromName(
+    const std::string& name) {
+  if (name == "SegmentedLRU")
+    return TYPE_SEGMENTED_LRU;
+  if (name == "TinyLFU")
+    return TYPE_TINY_LFU;
+  return TYPE_LRU;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,92 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_EVICTION_POLICY_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_EVICTION_POLICY_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+namespace disk_cache {
+
+// Estimates how often each entry hash was seen recently, in a fixed amount of
+// memory. This is a count-min sketch of counters saturating at kMaxFrequency:
+// an entry's estimate is the smallest of its counters, one per row. Once the
+// number of increments reaches ten times the width, all counters are halved so
+// that the estimates favour recent popularity.
+class NET_EXPORT_PRIVATE FrequencySketch {
+ public:
+  static const int kMaxFrequency = 15;
+
+  // |width| is the number of counters in each row, and must be a power of two.
+  explicit FrequencySketch(size_t width);
+  ~FrequencySketch();
+
+  void Increment(uint64 entry_hash);
+  int Estimate(uint64 entry_hash) const;
+
+ private:
+  static const int kDepth = 4;
+
+  size_t GetCounterIndex(uint64 entry_hash, int row) const;
+
+  // Halves all the counters.
+  void Age();
+
+  // kDepth rows of |width| counters.
+  std::vector<uint8> counters_;
+  const size_t width_mask_;
+  const size_t sample_size_;
+  size_t increments_;
+
+  DISALLOW_COPY_AND_ASSIGN(FrequencySketch);
+};
+
+// Decides which entries of a SimpleIndex to evict once the cache grows over
+// its size limit. The index reports every entry it inserts, uses or removes,
+// so that policies can keep state of their own alongside EntryMetadata.
+class NET_EXPORT_PRIVATE SimpleEvictionPolicy {
+ public:
+  enum Type {
+    // Evicts the least recently used entries first.
+    TYPE_LRU,
+    // Segmented LRU: entries used again after their creation are protected,
+    // and only evicted once no probationary entry is left.
+    TYPE_SEGMENTED_LRU,
+    // Segmented LRU with a TinyLFU admission filter: of the probationary
+    // entries, the ones requested least often recently are evicted first, so
+    // that one-off entries are not admitted at the expense of popular ones.
+    TYPE_TINY_LFU,
+  };
+
+  static scoped_ptr<SimpleEvictionPolicy> Create(Type type);
+
+  // Returns the type named |name| ("LRU", "SegmentedLRU" or "TinyLFU"), or
+  // TYPE_LRU for any other name.
+  static Type GetTypeFromName(const std::string& name);
+
+  virtual ~SimpleEvictionPolicy() {}
+
+  virtual void OnInsert(uint64 entry_hash) = 0;
+  // Called when an entry is requested again, i.e. opened or hit in an
+  // external cache. Reads and writes of an open entry are not reported.
+  virtual void OnUse(uint64 entry_hash) = 0;
+  virtual void OnRemove(uint64 entry_hash) = 0;
+
+  // Appends to |entry_hashes| the entries of |entries| to evict so that at
+  // least |bytes_to_evict| bytes are freed, or all of them if they are not
+  // enough. Returns the total size of the entries appended.
+  virtual uint64 SelectEntriesToEvict(const SimpleIndex::EntrySet& entries,
+                                      uint64 bytes_to_evict,
+                                      std::vector<uint64>* entry_hashes) = 0;
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_EVICTION_POLICY_H_
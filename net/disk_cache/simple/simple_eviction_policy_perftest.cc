@@ -0,0 +1,171 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_eviction_policy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const uint64 kCacheSize = 256 * 1024 * 1024;
+const int kNumRequests = 500000;
+
+// Most requests are for a set of popular resources of 4 to 64 KB, with a Zipf
+// popularity distribution...
+const int kNumPopularEntries = 20000;
+const double kZipfExponent = 0.9;
+const int kMinEntrySize = 4 * 1024;
+const int kMaxEntrySize = 64 * 1024;
+
+// ... interleaved with downloads of 2 to 8 MB that are never requested again.
+const int kOneOffInterval = 20;
+const int kMinOneOffSize = 2 * 1024 * 1024;
+const int kMaxOneOffSize = 8 * 1024 * 1024;
+
+struct Request {
+  Request(uint64 entry_hash, int entry_size)
+      : entry_hash(entry_hash), entry_size(entry_size) {}
+
+  uint64 entry_hash;
+  int entry_size;
+};
+
+// A deterministic pseudo random generator, so that every run replays the same
+// trace.
+class TraceRandom {
+ public:
+  TraceRandom() : state_(GG_UINT64_C(0x853c49e6748fea9b)) {}
+
+  uint64 Next() {
+    state_ = state_ * GG_UINT64_C(6364136223846793005) +
+             GG_UINT64_C(1442695040888963407);
+    return state_ >> 16;
+  }
+
+  // Returns a number in [0, 1).
+  double NextDouble() {
+    return static_cast<double>(Next() & ((GG_UINT64_C(1) << 48) - 1)) /
+           static_cast<double>(GG_UINT64_C(1) << 48);
+  }
+
+  int NextInRange(int min, int max) {
+    return min + static_cast<int>(Next() % (max - min + 1));
+  }
+
+ private:
+  uint64 state_;
+};
+
+std::vector<Request> MakeTrace() {
+  TraceRandom random;
+  std::vector<int> popular_sizes;
+  std::vector<double> cumulative_weights;
+  double total_weight = 0;
+  for (int i = 0; i < kNumPopularEntries; ++i) {
+    popular_sizes.push_back(random.NextInRange(kMinEntrySize, kMaxEntrySize));
+    total_weight += 1.0 / std::pow(i + 1.0, kZipfExponent);
+    cumulative_weights.push_back(total_weight);
+  }
+
+  std::vector<Request> trace;
+  trace.reserve(kNumRequests);
+  for (int i = 0; i < kNumRequests; ++i) {
+    if (i % kOneOffInterval == kOneOffInterval - 1) {
+      trace.push_back(Request((GG_UINT64_C(1) << 63) | i,
+                              random.NextInRange(kMinOneOffSize,
+                                                 kMaxOneOffSize)));
+      continue;
+    }
+    const double weight = random.NextDouble() * total_weight;
+    const int entry = std::upper_bound(cumulative_weights.begin(),
+                                       cumulative_weights.end(), weight) -
+                      cumulative_weights.begin();
+    trace.push_back(Request(entry + 1, popular_sizes[entry]));
+  }
+  return trace;
+}
+
+// Replays |trace| against a cache of kCacheSize bytes evicting with a policy
+// of |type| the way SimpleIndex does, and logs its hit ratios as |name|.
+void ReplayTrace(const std::string& name,
+                 SimpleEvictionPolicy::Type type,
+                 const std::vector<Request>& trace) {
+  scoped_ptr<SimpleEvictionPolicy> policy(SimpleEvictionPolicy::Create(type));
+  const uint64 high_watermark = kCacheSize - kCacheSize / 20;
+  const uint64 low_watermark = kCacheSize - 2 * (kCacheSize / 20);
+  const base::Time start_time =
+      base::Time::UnixEpoch() + base::TimeDelta::FromDays(20);
+
+  SimpleIndex::EntrySet entries;
+  uint64 cache_size = 0;
+  int hits = 0;
+  uint64 hit_bytes = 0;
+  uint64 requested_bytes = 0;
+  std::vector<uint64> entry_hashes;
+  for (size_t i = 0; i < trace.size(); ++i) {
+    const Request& request = trace[i];
+    // SimpleIndex keeps last used times in seconds, so a request per second
+    // keeps them all distinct.
+    const base::Time now = start_time + base::TimeDelta::FromSeconds(i);
+    requested_bytes += request.entry_size;
+
+    SimpleIndex::EntrySet::iterator it = entries.find(request.entry_hash);
+    if (it != entries.end()) {
+      ++hits;
+      hit_bytes += request.entry_size;
+      it->second.SetLastUsedTime(now);
+      policy->OnUse(request.entry_hash);
+      continue;
+    }
+
+    entries.insert(std::make_pair(request.entry_hash,
+                                  EntryMetadata(now, request.entry_size)));
+    policy->OnInsert(request.entry_hash);
+    cache_size += request.entry_size;
+    if (cache_size <= high_watermark)
+      continue;
+
+    entry_hashes.clear();
+    policy->SelectEntriesToEvict(entries, cache_size - low_watermark,
+                                 &entry_hashes);
+    for (size_t j = 0; j < entry_hashes.size(); ++j) {
+      it = entries.find(entry_hashes[j]);
+      ASSERT_TRUE(it != entries.end());
+      cache_size -= it->second.GetEntrySize();
+      entries.erase(it);
+      policy->OnRemove(entry_hashes[j]);
+    }
+  }
+
+  base::LogPerfResult((name + "_object_hit_ratio").c_str(),
+                      100.0 * hits / trace.size(), "%");
+  base::LogPerfResult((name + "_byte_hit_ratio").c_str(),
+                      100.0 * hit_bytes / requested_bytes, "%");
+}
+
+TEST(SimpleEvictionPolicyPerfTest, TraceReplay) {
+  const std::vector<Request> trace = MakeTrace();
+  ReplayTrace("SimpleCacheEviction_LRU", SimpleEvictionPolicy::TYPE_LRU,
+              trace);
+  ReplayTrace("SimpleCacheEviction_SegmentedLRU",
+              SimpleEvictionPolicy::TYPE_SEGMENTED_LRU, trace);
+  ReplayTrace("SimpleCacheEviction_TinyLFU",
+              SimpleEvictionPolicy::TYPE_TINY_LFU, trace);
+}
+
+}  // namespace
+
+}  // namespace disk_cache
@@ -0,0 +1,166 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_eviction_policy.h"
+
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const base::Time kBaseTime =
+    base::Time::UnixEpoch() + base::TimeDelta::FromDays(20);
+
+class SimpleEvictionPolicyTest : public testing::Test {
+ protected:
+  // Adds an entry of |entry_size| bytes last used |seconds| after kBaseTime.
+  void Insert(SimpleEvictionPolicy* policy,
+              uint64 entry_hash,
+              int seconds,
+              int entry_size) {
+    entries_.insert(std::make_pair(
+        entry_hash,
+        EntryMetadata(kBaseTime + base::TimeDelta::FromSeconds(seconds),
+                      entry_size)));
+    policy->OnInsert(entry_hash);
+  }
+
+  void Use(SimpleEvictionPolicy* policy, uint64 entry_hash, int seconds) {
+    SimpleIndex::EntrySet::iterator it = entries_.find(entry_hash);
+    ASSERT_TRUE(it != entries_.end());
+    it->second.SetLastUsedTime(kBaseTime +
+                               base::TimeDelta::FromSeconds(seconds));
+    policy->OnUse(entry_hash);
+  }
+
+  std::vector<uint64> SelectEntriesToEvict(SimpleEvictionPolicy* policy,
+                                           uint64 bytes_to_evict) {
+    std::vector<uint64> entry_hashes;
+    policy->SelectEntriesToEvict(entries_, bytes_to_evict, &entry_hashes);
+    return entry_hashes;
+  }
+
+  SimpleIndex::EntrySet entries_;
+};
+
+}  // namespace
+
+TEST(FrequencySketchTest, Estimate) {
+  FrequencySketch sketch(1024);
+  EXPECT_EQ(0, sketch.Estimate(1));
+
+  for (int i = 0; i < 5; ++i)
+    sketch.Increment(1);
+  sketch.Increment(2);
+  EXPECT_EQ(5, sketch.Estimate(1));
+  EXPECT_EQ(1, sketch.Estimate(2));
+  EXPECT_EQ(0, sketch.Estimate(3));
+}
+
+TEST(FrequencySketchTest, Saturates) {
+  FrequencySketch sketch(1024);
+  for (int i = 0; i < 2 * FrequencySketch::kMaxFrequency; ++i)
+    sketch.Increment(1);
+  EXPECT_EQ(FrequencySketch::kMaxFrequency, sketch.Estimate(1));
+}
+
+TEST(FrequencySketchTest, Ages) {
+  const size_t kWidth = 16;
+  FrequencySketch sketch(kWidth);
+  for (int i = 0; i < 8; ++i)
+    sketch.Increment(1);
+  EXPECT_EQ(8, sketch.Estimate(1));
+
+  // Counters are halved once there were ten increments per counter of a row.
+  for (size_t i = 8; i < 10 * kWidth; ++i)
+    sketch.Increment(2);
+  EXPECT_EQ(4, sketch.Estimate(1));
+}
+
+TEST_F(SimpleEvictionPolicyTest, GetTypeFromName) {
+  EXPECT_EQ(SimpleEvictionPolicy::TYPE_LRU,
+            SimpleEvictionPolicy::GetTypeFromName("LRU"));
+  EXPECT_EQ(SimpleEvictionPolicy::TYPE_SEGMENTED_LRU,
+            SimpleEvictionPolicy::GetTypeFromName("SegmentedLRU"));
+  EXPECT_EQ(SimpleEvictionPolicy::TYPE_TINY_LFU,
+            SimpleEvictionPolicy::GetTypeFromName("TinyLFU"));
+  EXPECT_EQ(SimpleEvictionPolicy::TYPE_LRU,
+            SimpleEvictionPolicy::GetTypeFromName(""));
+}
+
+TEST_F(SimpleEvictionPolicyTest, Lru) {
+  scoped_ptr<SimpleEvictionPolicy> policy(
+      SimpleEvictionPolicy::Create(SimpleEvictionPolicy::TYPE_LRU));
+  Insert(policy.get(), 1, 0, 100);
+  Insert(policy.get(), 2, 1, 100);
+  Insert(policy.get(), 3, 2, 100);
+  Use(policy.get(), 1, 3);
+
+  std::vector<uint64> evicted = SelectEntriesToEvict(policy.get(), 150);
+  ASSERT_EQ(2u, evicted.size());
+  EXPECT_EQ(2u, evicted[0]);
+  EXPECT_EQ(3u, evicted[1]);
+}
+
+TEST_F(SimpleEvictionPolicyTest, SegmentedLruProtectsUsedEntries) {
+  scoped_ptr<SimpleEvictionPolicy> policy(
+      SimpleEvictionPolicy::Create(SimpleEvictionPolicy::TYPE_SEGMENTED_LRU));
+  Insert(policy.get(), 1, 0, 100);
+  Insert(policy.get(), 2, 1, 100);
+  Use(policy.get(), 1, 2);
+  Insert(policy.get(), 3, 3, 100);
+
+  // Entry 1 is protected, so the more recently used entry 3 goes before it.
+  std::vector<uint64> evicted = SelectEntriesToEvict(policy.get(), 250);
+  ASSERT_EQ(3u, evicted.size());
+  EXPECT_EQ(2u, evicted[0]);
+  EXPECT_EQ(3u, evicted[1]);
+  EXPECT_EQ(1u, evicted[2]);
+}
+
+TEST_F(SimpleEvictionPolicyTest, SegmentedLruDemotesProtectedEntries) {
+  scoped_ptr<SimpleEvictionPolicy> policy(
+      SimpleEvictionPolicy::Create(SimpleEvictionPolicy::TYPE_SEGMENTED_LRU));
+  Insert(policy.get(), 1, 0, 100);
+  Insert(policy.get(), 2, 1, 100);
+  Insert(policy.get(), 3, 2, 100);
+  Use(policy.get(), 1, 3);
+  Use(policy.get(), 2, 4);
+
+  // Protected entries take up two thirds of the cache, within their share.
+  std::vector<uint64> evicted = SelectEntriesToEvict(policy.get(), 100);
+  ASSERT_EQ(1u, evicted.size());
+  EXPECT_EQ(3u, evicted[0]);
+
+  // Once they take up all of it, the least recently used one is demoted.
+  entries_.erase(3);
+  policy->OnRemove(3);
+  evicted = SelectEntriesToEvict(policy.get(), 100);
+  ASSERT_EQ(1u, evicted.size());
+  EXPECT_EQ(1u, evicted[0]);
+}
+
+TEST_F(SimpleEvictionPolicyTest, TinyLfuEvictsInfrequentEntriesFirst) {
+  scoped_ptr<SimpleEvictionPolicy> policy(
+      SimpleEvictionPolicy::Create(SimpleEvictionPolicy::TYPE_TINY_LFU));
+
+  // Entry 1 was requested three times and evicted since, so it is back on
+  // probation but still known to be popular.
+  for (int i = 0; i < 3; ++i)
+    policy->OnInsert(1);
+  Insert(policy.get(), 1, 0, 100);
+  Insert(policy.get(), 2, 1, 1000);
+
+  std::vector<uint64> evicted = SelectEntriesToEvict(policy.get(), 100);
+  ASSERT_EQ(1u, evicted.size());
+  EXPECT_EQ(2u, evicted[0]);
+}
+
+}  // namespace disk_cache
@@ -24,6 +24,7 @@
 #include "base/time/time.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
+#include "net/disk_cache/simple/simple_eviction_policy.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index_delegate.h"
 #include "net/disk_cache/simple/simple_index_file.h"
@@ -48,29 +49,12 @@ const uint32 kEvictionMarginDivisor = 20;
 
 const uint32 kBytesInKb = 1024;
 
-// Utility class used for timestamp comparisons in entry metadata while sorting.
-class CompareHashesForTimestamp {
-  typedef disk_cache::SimpleIndex SimpleIndex;
-  typedef disk_cache::SimpleIndex::EntrySet EntrySet;
- public:
-  explicit CompareHashesForTimestamp(const EntrySet& set);
+// Initial number of buckets of an EntryMetadataTable. Must be a power of two.
+const size_t kMinEntryTableBuckets = 16;
 
-  bool operator()(uint64 hash1, uint64 hash2);
- private:
-  const EntrySet& entry_set_;
-};
-
-CompareHashesForTimestamp::CompareHashesForTimestamp(const EntrySet& set)
-  : entry_set_(set) {
-}
-
-bool CompareHashesForTimestamp::operator()(uint64 hash1, uint64 hash2) {
-  EntrySet::const_iterator it1 = entry_set_.find(hash1);
-  DCHECK(it1 != entry_set_.end());
-  EntrySet::const_iterator it2 = entry_set_.find(hash2);
-  DCHECK(it2 != entry_set_.end());
-  return it1->second.GetLastUsedTime() < it2->second.GetLastUsedTime();
-}
+// The table grows when more than 3/4 of its buckets are in use.
+const size_t kEntryTableMaxLoadNumerator = 3;
+const size_t kEntryTableMaxLoadDenominator = 4;
 
 }  // namespace
 
@@ -135,6 +119,154 @@ bool EntryMetadata::Deserialize(PickleIterator* it) {
   return true;
 }
 
+EntryMetadataTable::EntryMetadataTable()
+    : slots_(kMinEntryTableBuckets + 1),
+      size_(0),
+      has_zero_hash_(false) {
+}
+
+EntryMetadataTable::~EntryMetadataTable() {
+}
+
+EntryMetadataTable::iterator EntryMetadataTable::find(uint64 entry_hash) {
+  return iterator(this, FindSlot(entry_hash));
+}
+
+EntryMetadataTable::const_iterator EntryMetadataTable::find(
+    uint64 entry_hash) const {
+  return const_iterator(this, FindSlot(entry_hash));
+}
+
+size_t EntryMetadataTable::count(uint64 entry_hash) const {
+  return FindSlot(entry_hash) == slots_.size() ? 0 : 1;
+}
+
+std::pair<EntryMetadataTable::iterator, bool> EntryMetadataTable::insert(
+    const value_type& value) {
+  if (value.first == 0) {
+    const size_t zero_slot = ZeroHashSlot();
+    if (has_zero_hash_)
+      return std::make_pair(iterator(this, zero_slot), false);
+    slots_[zero_slot] = value;
+    has_zero_hash_ = true;
+    ++size_;
+    return std::make_pair(iterator(this, zero_slot), true);
+  }
+
+  const size_t used_buckets = size_ - (has_zero_hash_ ? 1 : 0);
+  if ((used_buckets + 1) * kEntryTableMaxLoadDenominator >
+      (mask() + 1) * kEntryTableMaxLoadNumerator) {
+    Rehash(2 * (mask() + 1));
+  }
+
+  size_t index = IdealSlot(value.first);
+  while (slots_[index].first != 0) {
+    if (slots_[index].first == value.first)
+      return std::make_pair(iterator(this, index), false);
+    index = (index + 1) & mask();
+  }
+  slots_[index] = value;
+  ++size_;
+  return std::make_pair(iterator(this, index), true);
+}
+
+void EntryMetadataTable::erase(iterator it) {
+  DCHECK_EQ(this, it.table_);
+  size_t hole = it.index_;
+  DCHECK(IsSlotUsed(hole));
+  --size_;
+  if (hole == ZeroHashSlot()) {
+    has_zero_hash_ = false;
+    slots_[hole] = value_type();
+    return;
+  }
+
+  // Backward shift deletion: move every following entry of the probe run
+  // whose ideal slot is not between the hole and itself into the hole.
+  size_t index = hole;
+  for (;;) {
+    index = (index + 1) & mask();
+    if (slots_[index].first == 0)
+      break;
+    const size_t ideal = IdealSlot(slots_[index].first);
+    const bool can_move = hole <= index ? (ideal <= hole || ideal > index)
+                                        : (ideal <= hole && ideal > index);
+    if (can_move) {
+      slots_[hole] = slots_[index];
+      hole = index;
+    }
+  }
+  slots_[hole] = value_type();
+}
+
+size_t EntryMetadataTable::erase(uint64 entry_hash) {
+  iterator it = find(entry_hash);
+  if (it == end())
+    return 0;
+  erase(it);
+  return 1;
+}
+
+void EntryMetadataTable::clear() {
+  std::vector<value_type>(kMinEntryTableBuckets + 1).swap(slots_);
+  size_ = 0;
+  has_zero_hash_ = false;
+}
+
+void EntryMetadataTable::swap(EntryMetadataTable& other) {
+  slots_.swap(other.slots_);
+  std::swap(size_, other.size_);
+  std::swap(has_zero_hash_, other.has_zero_hash_);
+}
+
+void EntryMetadataTable::reserve(size_t num_entries) {
+  size_t bucket_count = mask() + 1;
+  while (num_entries * kEntryTableMaxLoadDenominator >
+         bucket_count * kEntryTableMaxLoadNumerator) {
+    bucket_count *= 2;
+  }
+  if (bucket_count > mask() + 1)
+    Rehash(bucket_count);
+}
+
+size_t EntryMetadataTable::FindSlot(uint64 entry_hash) const {
+  if (entry_hash == 0)
+    return has_zero_hash_ ? ZeroHashSlot() : slots_.size();
+  size_t index = IdealSlot(entry_hash);
+  while (slots_[index].first != 0) {
+    if (slots_[index].first == entry_hash)
+      return index;
+    index = (index + 1) & mask();
+  }
+  return slots_.size();
+}
+
+size_t EntryMetadataTable::IdealSlot(uint64 entry_hash) const {
+  // Entry hashes come from SHA-1 and are already well distributed, but tests
+  // and callers may use small sequential values, so mix the bits anyway.
+  uint64 mixed = entry_hash ^ (entry_hash >> 33);
+  mixed *= GG_UINT64_C(0xff51afd7ed558ccd);
+  mixed ^= mixed >> 33;
+  return static_cast<size_t>(mixed) & mask();
+}
+
+void EntryMetadataTable::Rehash(size_t new_bucket_count) {
+  DCHECK_EQ(0U, new_bucket_count & (new_bucket_count - 1));
+  std::vector<value_type> old_slots(new_bucket_count + 1);
+  old_slots.swap(slots_);
+  const size_t old_zero_slot = old_slots.size() - 1;
+  if (has_zero_hash_)
+    slots_[ZeroHashSlot()] = old_slots[old_zero_slot];
+  for (size_t i = 0; i < old_zero_slot; ++i) {
+    if (old_slots[i].first == 0)
+      continue;
+    size_t index = IdealSlot(old_slots[i].first);
+    while (slots_[index].first != 0)
+      index = (index + 1) & mask();
+    slots_[index] = old_slots[i];
+  }
+}
+
 SimpleIndex::SimpleIndex(
     const scoped_refptr<base::SingleThreadTaskRunner>& io_thread,
     SimpleIndexDelegate* delegate,
@@ -147,6 +279,8 @@ SimpleIndex::SimpleIndex(
       high_watermark_(0),
       low_watermark_(0),
       eviction_in_progress_(false),
+      eviction_policy_(
+          SimpleEvictionPolicy::Create(SimpleEvictionPolicy::TYPE_LRU)),
       initialized_(false),
       index_file_(index_file.Pass()),
       io_thread_(io_thread),
@@ -182,7 +316,11 @@ void SimpleIndex::Initialize(base::Time cache_mtime) {
       &SimpleIndex::MergeInitializingSet,
       AsWeakPtr(),
       base::Passed(&load_result_scoped));
-  index_file_->LoadIndexEntries(cache_mtime, reply, load_result);
+  index_file_->LoadIndexEntries(
+      cache_mtime,
+      reply,
+      base::Bind(&SimpleIndex::MergeRestoredShard, AsWeakPtr()),
+      load_result);
 }
 
 bool SimpleIndex::SetMaxSize(int max_bytes) {
@@ -199,6 +337,13 @@ bool SimpleIndex::SetMaxSize(int max_bytes) {
   return true;
 }
 
+void SimpleIndex::SetEvictionPolicy(
+    scoped_ptr<SimpleEvictionPolicy> eviction_policy) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  DCHECK(eviction_policy);
+  eviction_policy_ = eviction_policy.Pass();
+}
+
 int SimpleIndex::ExecuteWhenReady(const net::CompletionCallback& task) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   if (initialized_)
@@ -241,13 +386,26 @@ int32 SimpleIndex::GetEntryCount() const {
   return entries_set_.size();
 }
 
+int SimpleIndex::GetRestoredShardCount() const {
+  return initialized_ ? kRestoreShardCount : restored_shards_.count();
+}
+
 void SimpleIndex::Insert(uint64 entry_hash) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   // Upon insert we don't know yet the size of the entry.
   // It will be updated later when the SimpleEntryImpl finishes opening or
   // creating the new entry, and then UpdateEntrySize will be called.
-  InsertInEntrySet(
-      entry_hash, EntryMetadata(base::Time::Now(), 0), &entries_set_);
+  EntrySet::iterator it = entries_set_.find(entry_hash);
+  if (it == entries_set_.end()) {
+    InsertInEntrySet(
+        entry_hash, EntryMetadata(base::Time::Now(), 0), &entries_set_);
+  } else if (!initialized_) {
+    // The entry was restored from the disk, but this one replaces it.
+    UpdateEntryIteratorSize(&it, 0);
+    it->second.SetLastUsedTime(base::Time::Now());
+  }
+  eviction_policy_->OnInsert(entry_hash);
+  changed_entries_.insert(entry_hash);
   if (!initialized_)
     removed_entries_.erase(entry_hash);
   PostponeWritingToDisk();
@@ -259,6 +417,8 @@ void SimpleIndex::Remove(uint64 entry_hash) {
   if (it != entries_set_.end()) {
     UpdateEntryIteratorSize(&it, 0);
     entries_set_.erase(it);
+    eviction_policy_->OnRemove(entry_hash);
+    changed_entries_.insert(entry_hash);
   }
 
   if (!initialized_)
@@ -268,8 +428,9 @@ void SimpleIndex::Remove(uint64 entry_hash) {
 
 bool SimpleIndex::Has(uint64 hash) const {
   DCHECK(io_thread_checker_.CalledOnValidThread());
-  // If not initialized, always return true, forcing it to go to the disk.
-  return !initialized_ || entries_set_.count(hash) > 0;
+  // If not initialized, return true unless the shard of the hash has already
+  // been restored, forcing it to go to the disk.
+  return !IsLookupAuthoritative(hash) || entries_set_.count(hash) > 0;
 }
 
 bool SimpleIndex::UseIfExists(uint64 entry_hash) {
@@ -278,18 +439,33 @@ bool SimpleIndex::UseIfExists(uint64 entry_hash) {
   // It will be merged later.
   EntrySet::iterator it = entries_set_.find(entry_hash);
   if (it == entries_set_.end())
-    // If not initialized, always return true, forcing it to go to the disk.
-    return !initialized_;
+    // If not initialized, return true unless the shard of the hash has already
+    // been restored, forcing it to go to the disk.
+    return !IsLookupAuthoritative(entry_hash);
   it->second.SetLastUsedTime(base::Time::Now());
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   return true;
 }
 
+bool SimpleIndex::HitIfExists(uint64 entry_hash) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  if (!UseIfExists(entry_hash))
+    return false;
+  if (entries_set_.count(entry_hash) > 0)
+    eviction_policy_->OnUse(entry_hash);
+  return true;
+}
+
 void SimpleIndex::StartEvictionIfNeeded() {
   DCHECK(io_thread_checker_.CalledOnValidThread());
+  // Until the index is initialized, |cache_size_| and |entries_set_| only
+  // cover the shards restored so far, which must not be evicted from. The
+  // next update of an entry size after the merge starts the eviction.
+  if (!initialized_)
+    return;
   if (eviction_in_progress_ || cache_size_ <= high_watermark_)
     return;
-  // Take all live key hashes from the index and sort them by time.
   eviction_in_progress_ = true;
   eviction_start_time_ = base::TimeTicks::Now();
   SIMPLE_CACHE_UMA(MEMORY_KB,
@@ -298,29 +474,12 @@ void SimpleIndex::StartEvictionIfNeeded() {
   SIMPLE_CACHE_UMA(MEMORY_KB,
                    "Eviction.MaxCacheSizeOnStart2", cache_type_,
                    max_size_ / kBytesInKb);
-  std::vector<uint64> entry_hashes;
-  entry_hashes.reserve(entries_set_.size());
-  for (EntrySet::const_iterator it = entries_set_.begin(),
-       end = entries_set_.end(); it != end; ++it) {
-    entry_hashes.push_back(it->first);
-  }
-  std::sort(entry_hashes.begin(), entry_hashes.end(),
-            CompareHashesForTimestamp(entries_set_));
-
   // Remove as many entries from the index to get below |low_watermark_|.
-  std::vector<uint64>::iterator it = entry_hashes.begin();
-  uint64 evicted_so_far_size = 0;
-  while (evicted_so_far_size < cache_size_ - low_watermark_) {
-    DCHECK(it != entry_hashes.end());
-    EntrySet::iterator found_meta = entries_set_.find(*it);
-    DCHECK(found_meta != entries_set_.end());
-    uint64 to_evict_size = found_meta->second.GetEntrySize();
-    evicted_so_far_size += to_evict_size;
-    ++it;
-  }
+  std::vector<uint64> entry_hashes;
+  const uint64 evicted_so_far_size = eviction_policy_->SelectEntriesToEvict(
+      entries_set_, cache_size_ - low_watermark_, &entry_hashes);
+  DCHECK_GE(evicted_so_far_size, cache_size_ - low_watermark_);
 
-  // Take out the rest of hashes from the eviction list.
-  entry_hashes.erase(it, entry_hashes.end());
   SIMPLE_CACHE_UMA(COUNTS,
                    "Eviction.EntryCount", cache_type_, entry_hashes.size());
   SIMPLE_CACHE_UMA(TIMES,
@@ -341,6 +500,7 @@ bool SimpleIndex::UpdateEntrySize(uint64 entry_hash, int entry_size) {
     return false;
 
   UpdateEntryIteratorSize(&it, entry_size);
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   StartEvictionIfNeeded();
   return true;
@@ -402,6 +562,14 @@ void SimpleIndex::MergeInitializingSet(
   }
   removed_entries_.clear();
 
+  // The eviction policy has only been told of the entries inserted or
+  // restored so far, and must know of the others before it evicts any.
+  for (EntrySet::const_iterator it = index_file_entries->begin();
+       it != index_file_entries->end(); ++it) {
+    if (!entries_set_.count(it->first))
+      eviction_policy_->OnInsert(it->first);
+  }
+
   for (EntrySet::const_iterator it = entries_set_.begin();
        it != entries_set_.end(); ++it) {
     const uint64 entry_hash = it->first;
@@ -421,6 +589,7 @@ void SimpleIndex::MergeInitializingSet(
   entries_set_.swap(*index_file_entries);
   cache_size_ = merged_cache_size;
   initialized_ = true;
+  restored_shards_.set();
 
   // The actual IO is asynchronous, so calling WriteToDisk() shouldn't slow the
   // merge down much.
@@ -438,6 +607,28 @@ void SimpleIndex::MergeInitializingSet(
   to_run_when_initialized_.clear();
 }
 
+void SimpleIndex::MergeRestoredShard(int shard,
+                                     const EntrySet& shard_entries) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  if (initialized_)
+    return;
+
+  // Entries inserted or removed on the IO thread are more recent than the
+  // ones found on disk. The whole restored index is merged again by
+  // MergeInitializingSet(), which gives the same result.
+  for (EntrySet::const_iterator it = shard_entries.begin();
+       it != shard_entries.end(); ++it) {
+    DCHECK_EQ(shard, GetRestoreShard(it->first));
+    if (removed_entries_.count(it->first))
+      continue;
+    if (entries_set_.insert(*it).second) {
+      cache_size_ += it->second.GetEntrySize();
+      eviction_policy_->OnInsert(it->first);
+    }
+  }
+  restored_shards_.set(shard);
+}
+
 #if defined(OS_ANDROID)
 void SimpleIndex::OnApplicationStateChange(
     base::android::ApplicationState state) {
@@ -475,8 +666,9 @@ void SimpleIndex::WriteToDisk() {
   }
   last_write_to_disk_ = start;
 
-  index_file_->WriteToDisk(entries_set_, cache_size_,
+  index_file_->WriteToDisk(entries_set_, changed_entries_, cache_size_,
                            start, app_on_background_);
+  changed_entries_.clear();
 }
 
 }  // namespace disk_cache
@@ -5,7 +5,9 @@
 #ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_H_
 #define NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_H_
 
+#include <bitset>
 #include <list>
+#include <utility>
 #include <vector>
 
 #include "base/basictypes.h"
@@ -33,6 +35,7 @@ class PickleIterator;
 
 namespace disk_cache {
 
+class SimpleEvictionPolicy;
 class SimpleIndexDelegate;
 class SimpleIndexFile;
 struct SimpleIndexLoadResult;
@@ -71,12 +74,128 @@ class NET_EXPORT_PRIVATE EntryMetadata {
 };
 COMPILE_ASSERT(sizeof(EntryMetadata) == 8, metadata_size);
 
+// A flat open-addressing hash table mapping entry hashes to their
+// EntryMetadata. Slots are stored inline in a single array, so each entry
+// costs sizeof(value_type) == 16 bytes divided by the load factor instead of a
+// separately allocated hash_map node plus a bucket pointer. Collisions are
+// resolved with linear probing and removals use backward shift deletion, so
+// there are no tombstones. The interface is the subset of base::hash_map that
+// the simple cache uses. Inserting or erasing invalidates all iterators.
+class NET_EXPORT_PRIVATE EntryMetadataTable {
+ public:
+  typedef uint64 key_type;
+  typedef std::pair<uint64, EntryMetadata> value_type;
+
+  template <typename TableType, typename ValueType>
+  class IteratorImpl {
+   public:
+    IteratorImpl() : table_(NULL), index_(0) {}
+    IteratorImpl(TableType* table, size_t index)
+        : table_(table), index_(index) {
+      SkipEmptySlots();
+    }
+    // Allows conversion from iterator to const_iterator.
+    template <typename OtherTableType, typename OtherValueType>
+    IteratorImpl(const IteratorImpl<OtherTableType, OtherValueType>& other)
+        : table_(other.table_), index_(other.index_) {}
+
+    ValueType& operator*() const { return table_->slots_[index_]; }
+    ValueType* operator->() const { return &table_->slots_[index_]; }
+
+    IteratorImpl& operator++() {
+      ++index_;
+      SkipEmptySlots();
+      return *this;
+    }
+
+    bool operator==(const IteratorImpl& other) const {
+      return table_ == other.table_ && index_ == other.index_;
+    }
+    bool operator!=(const IteratorImpl& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class EntryMetadataTable;
+    template <typename, typename> friend class IteratorImpl;
+
+    void SkipEmptySlots() {
+      while (index_ < table_->slots_.size() && !table_->IsSlotUsed(index_))
+        ++index_;
+    }
+
+    TableType* table_;
+    size_t index_;
+  };
+
+  typedef IteratorImpl<EntryMetadataTable, value_type> iterator;
+  typedef IteratorImpl<const EntryMetadataTable, const value_type>
+      const_iterator;
+
+  EntryMetadataTable();
+  ~EntryMetadataTable();
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Number of slots allocated, including the one reserved for the zero hash.
+  size_t capacity() const { return slots_.size(); }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, slots_.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, slots_.size()); }
+
+  iterator find(uint64 entry_hash);
+  const_iterator find(uint64 entry_hash) const;
+  size_t count(uint64 entry_hash) const;
+
+  // Inserts |value| unless an entry with the same hash is already present.
+  // Returns an iterator to the entry for the hash and whether it was inserted.
+  std::pair<iterator, bool> insert(const value_type& value);
+
+  void erase(iterator it);
+  size_t erase(uint64 entry_hash);
+
+  void clear();
+  void swap(EntryMetadataTable& other);
+
+  // Grows the table so |num_entries| entries fit without rehashing.
+  void reserve(size_t num_entries);
+
+ private:
+  // Hash 0 marks an empty slot, so an entry with that hash lives in the
+  // extra slot at the end of |slots_|, flagged by |has_zero_hash_|.
+  bool IsSlotUsed(size_t index) const {
+    return index == ZeroHashSlot() ? has_zero_hash_ : slots_[index].first != 0;
+  }
+  size_t ZeroHashSlot() const { return slots_.size() - 1; }
+  size_t mask() const { return slots_.size() - 2; }
+  size_t FindSlot(uint64 entry_hash) const;
+  size_t IdealSlot(uint64 entry_hash) const;
+  void Rehash(size_t new_bucket_count);
+
+  std::vector<value_type> slots_;
+  size_t size_;
+  bool has_zero_hash_;
+};
+
 // This class is not Thread-safe.
 class NET_EXPORT_PRIVATE SimpleIndex
     : public base::SupportsWeakPtr<SimpleIndex> {
  public:
   typedef std::vector<uint64> HashList;
 
+  // When the index is restored from the entry files, entries are split into
+  // this many shards by the top bits of their hash, and each shard is usable
+  // for lookups as soon as it is restored.
+  static const int kRestoreShardBits = 4;
+  static const int kRestoreShardCount = 1 << kRestoreShardBits;
+
+  static int GetRestoreShard(uint64 entry_hash) {
+    return static_cast<int>(entry_hash >> (64 - kRestoreShardBits));
+  }
+
   SimpleIndex(const scoped_refptr<base::SingleThreadTaskRunner>& io_thread,
               SimpleIndexDelegate* delegate,
               net::CacheType cache_type,
@@ -89,6 +208,10 @@ class NET_EXPORT_PRIVATE SimpleIndex
   bool SetMaxSize(int max_bytes);
   int max_size() const { return max_size_; }
 
+  // Replaces the default LRU eviction policy. The policy only learns about
+  // entries inserted, used or removed after it is set.
+  void SetEvictionPolicy(scoped_ptr<SimpleEvictionPolicy> eviction_policy);
+
   void Insert(uint64 entry_hash);
   void Remove(uint64 entry_hash);
 
@@ -99,6 +222,11 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // iff the entry exist in the index.
   bool UseIfExists(uint64 entry_hash);
 
+  // Same as UseIfExists(), but also tells the eviction policy that the entry
+  // was requested again. Only called when an entry is opened or hit in an
+  // external cache, not on every read or write of an open entry.
+  bool HitIfExists(uint64 entry_hash);
+
   void WriteToDisk();
 
   // Update the size (in bytes) of an entry, in the metadata stored in the
@@ -106,7 +234,7 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // entry.
   bool UpdateEntrySize(uint64 entry_hash, int entry_size);
 
-  typedef base::hash_map<uint64, EntryMetadata> EntrySet;
+  typedef EntryMetadataTable EntrySet;
 
   static void InsertInEntrySet(uint64 entry_hash,
                                const EntryMetadata& entry_metadata,
@@ -131,11 +259,18 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // Returns whether the index has been initialized yet.
   bool initialized() const { return initialized_; }
 
+  // Returns how many of the kRestoreShardCount shards are usable for lookups,
+  // as a measure of the progress of initialization.
+  int GetRestoredShardCount() const;
+
  private:
   friend class SimpleIndexTest;
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, IndexSizeCorrectOnMerge);
+  FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, LookupsInRestoredShards);
+  FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, InsertInRestoredShard);
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWriteQueued);
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWriteExecuted);
+  FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWriteChangedEntries);
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWritePostponed);
 
   void StartEvictionIfNeeded();
@@ -148,6 +283,15 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // Must run on IO Thread.
   void MergeInitializingSet(scoped_ptr<SimpleIndexLoadResult> load_result);
 
+  // Merges the entries of a shard restored from the entry files before the
+  // whole index is initialized. Must run on IO Thread.
+  void MergeRestoredShard(int shard, const EntrySet& shard_entries);
+
+  // Whether lookups of |entry_hash| can be answered from |entries_set_|.
+  bool IsLookupAuthoritative(uint64 entry_hash) const {
+    return initialized_ || restored_shards_.test(GetRestoreShard(entry_hash));
+  }
+
 #if defined(OS_ANDROID)
   void OnApplicationStateChange(base::android::ApplicationState state);
 
@@ -166,12 +310,20 @@ class NET_EXPORT_PRIVATE SimpleIndex
   uint64 low_watermark_;
   bool eviction_in_progress_;
   base::TimeTicks eviction_start_time_;
+  scoped_ptr<SimpleEvictionPolicy> eviction_policy_;
 
   // This stores all the entry_hash of entries that are removed during
   // initialization.
   base::hash_set<uint64> removed_entries_;
   bool initialized_;
 
+  // Shards restored from the entry files and merged before initialization.
+  std::bitset<kRestoreShardCount> restored_shards_;
+
+  // The entry_hash of every entry inserted, updated or removed since the index
+  // was last written to disk.
+  base::hash_set<uint64> changed_entries_;
+
   scoped_ptr<SimpleIndexFile> index_file_;
 
   scoped_refptr<base::SingleThreadTaskRunner> io_thread_;
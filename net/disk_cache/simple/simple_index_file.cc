@@ -4,8 +4,11 @@
 
 #include "net/disk_cache/simple/simple_index_file.h"
 
+#include <algorithm>
+#include <utility>
 #include <vector>
 
+#include "base/files/file.h"
 #include "base/files/file_util.h"
 #include "base/files/memory_mapped_file.h"
 #include "base/hash.h"
@@ -65,6 +68,22 @@ void UmaRecordIndexInitMethod(IndexInitMethod method,
                    method, INITIALIZE_METHOD_MAX);
 }
 
+bool AppendPickleToFile(Pickle* pickle, const base::FilePath& file_name) {
+  base::File file(file_name, base::File::FLAG_OPEN_ALWAYS |
+                             base::File::FLAG_APPEND);
+  if (!file.IsValid())
+    return false;
+  const int64 original_length = file.GetLength();
+  const int bytes_written = file.WriteAtCurrentPos(
+      static_cast<const char*>(pickle->data()), pickle->size());
+  if (bytes_written == implicit_cast<int>(pickle->size()))
+    return true;
+  // Do not leave a torn chunk behind to be appended to.
+  if (original_length >= 0)
+    file.SetLength(original_length);
+  return false;
+}
+
 bool WritePickleFile(Pickle* pickle, const base::FilePath& file_name) {
   int bytes_written = base::WriteFile(
       file_name, static_cast<const char*>(pickle->data()), pickle->size());
@@ -75,9 +94,12 @@ bool WritePickleFile(Pickle* pickle, const base::FilePath& file_name) {
   return true;
 }
 
+}  // namespace
+
 // Called for each cache directory traversal iteration.
-void ProcessEntryFile(SimpleIndex::EntrySet* entries,
-                      const base::FilePath& file_path) {
+// static
+void SimpleIndexFile::ListEntryFile(EntryFileListing* listing,
+                                    const base::FilePath& file_path) {
   static const size_t kEntryFilesLength =
       kEntryFilesHashLength + kEntryFilesSuffixLength;
   // Converting to std::string is OK since we never use UTF8 wide chars in our
@@ -95,6 +117,22 @@ void ProcessEntryFile(SimpleIndex::EntrySet* entries,
     return;
   }
 
+  EntryFileName entry_file;
+  COMPILE_ASSERT(arraysize(entry_file.suffix) == kEntryFilesSuffixLength,
+                 entry_file_suffix_length_mismatch);
+  entry_file.entry_hash = hash_key;
+  std::copy(file_name.begin() + kEntryFilesHashLength, file_name.end(),
+            entry_file.suffix);
+  listing->shards[SimpleIndex::GetRestoreShard(hash_key)].push_back(
+      entry_file);
+}
+
+namespace {
+
+// Adds the size of one entry file to the metadata of its entry.
+void RestoreEntryFile(SimpleIndex::EntrySet* entries,
+                      uint64 hash_key,
+                      const base::FilePath& file_path) {
   base::File::Info file_info;
   if (!base::GetFileInfo(file_path, &file_info)) {
     LOG(ERROR) << "Could not get file info for " << file_path.value();
@@ -124,6 +162,14 @@ void ProcessEntryFile(SimpleIndex::EntrySet* entries,
 
 }  // namespace
 
+SimpleIndexFile::EntryFileListing::EntryFileListing()
+    : restore_required(false),
+      index_file_existed(false) {
+}
+
+SimpleIndexFile::EntryFileListing::~EntryFileListing() {
+}
+
 SimpleIndexLoadResult::SimpleIndexLoadResult() : did_load(false),
                                                  flush_required(false) {
 }
@@ -143,6 +189,8 @@ const char SimpleIndexFile::kIndexFileName[] = "the-real-index";
 const char SimpleIndexFile::kIndexDirectory[] = "index-dir";
 // static
 const char SimpleIndexFile::kTempIndexFileName[] = "temp-index";
+// static
+const char SimpleIndexFile::kJournalFileName[] = "index-journal";
 
 SimpleIndexFile::IndexMetadata::IndexMetadata()
     : magic_number_(kSimpleIndexMagicNumber),
@@ -183,6 +231,159 @@ bool SimpleIndexFile::IndexMetadata::Deserialize(PickleIterator* it) {
       it->ReadUInt64(&cache_size_);
 }
 
+// static
+scoped_ptr<Pickle> SimpleIndexFile::SerializeJournalChunk(
+    const SimpleIndex::EntrySet& entries,
+    const base::hash_set<uint64>& changed_entries) {
+  scoped_ptr<Pickle> pickle(new Pickle(sizeof(SimpleIndexFile::PickleHeader)));
+
+  pickle->WriteUInt64(kSimpleIndexJournalMagicNumber);
+  pickle->WriteUInt64(changed_entries.size());
+  for (base::hash_set<uint64>::const_iterator it = changed_entries.begin();
+       it != changed_entries.end(); ++it) {
+    SimpleIndex::EntrySet::const_iterator found = entries.find(*it);
+    const bool is_present = found != entries.end();
+    pickle->WriteUInt64(*it);
+    pickle->WriteBool(is_present);
+    if (is_present)
+      found->second.Serialize(pickle.get());
+  }
+  return pickle.Pass();
+}
+
+// static
+bool SimpleIndexFile::SerializeJournalFinalData(base::Time cache_modified,
+                                                uint32 index_crc,
+                                                Pickle* pickle) {
+  if (!pickle->WriteInt64(cache_modified.ToInternalValue()) ||
+      !pickle->WriteUInt32(index_crc)) {
+    return false;
+  }
+  SimpleIndexFile::PickleHeader* header_p = pickle->headerT<PickleHeader>();
+  header_p->crc = CalculatePickleCRC(*pickle);
+  return true;
+}
+
+// static
+int SimpleIndexFile::ReplayJournal(const char* data, int data_len,
+                                   uint32 index_crc,
+                                   base::Time* out_cache_last_modified,
+                                   SimpleIndex::EntrySet* entries) {
+  DCHECK(data);
+  DCHECK(entries);
+
+  int chunks_applied = 0;
+  std::vector<std::pair<uint64, EntryMetadata> > updates;
+  std::vector<uint64> removals;
+  int offset = 0;
+  while (data_len - offset >= static_cast<int>(sizeof(PickleHeader))) {
+    const PickleHeader* header_p =
+        reinterpret_cast<const PickleHeader*>(data + offset);
+    if (header_p->payload_size >
+        data_len - offset - sizeof(PickleHeader)) {
+      LOG(WARNING) << "Truncated chunk in Simple Index journal.";
+      break;
+    }
+    const int chunk_size = sizeof(PickleHeader) + header_p->payload_size;
+    Pickle pickle(data + offset, chunk_size);
+    if (!pickle.data() || header_p->crc != CalculatePickleCRC(pickle)) {
+      LOG(WARNING) << "Invalid CRC in Simple Index journal.";
+      break;
+    }
+
+    PickleIterator pickle_it(pickle);
+    uint64 magic_number;
+    uint64 entry_count;
+    if (!pickle_it.ReadUInt64(&magic_number) ||
+        magic_number != kSimpleIndexJournalMagicNumber ||
+        !pickle_it.ReadUInt64(&entry_count)) {
+      LOG(WARNING) << "Invalid Simple Index journal chunk.";
+      break;
+    }
+    updates.clear();
+    removals.clear();
+    bool chunk_valid = true;
+    for (uint64 i = 0; chunk_valid && i < entry_count; ++i) {
+      uint64 hash_key;
+      bool is_present;
+      EntryMetadata entry_metadata;
+      if (!pickle_it.ReadUInt64(&hash_key) || !pickle_it.ReadBool(&is_present))
+        chunk_valid = false;
+      else if (!is_present)
+        removals.push_back(hash_key);
+      else if (!entry_metadata.Deserialize(&pickle_it))
+        chunk_valid = false;
+      else
+        updates.push_back(std::make_pair(hash_key, entry_metadata));
+    }
+    int64 cache_last_modified;
+    uint32 chunk_index_crc;
+    if (!chunk_valid ||
+        !pickle_it.ReadInt64(&cache_last_modified) ||
+        !pickle_it.ReadUInt32(&chunk_index_crc)) {
+      LOG(WARNING) << "Invalid EntryMetadata in Simple Index journal.";
+      break;
+    }
+    // A chunk written on top of a previous index file means that the index
+    // file was replaced after the journal was last truncated.
+    if (chunk_index_crc != index_crc)
+      break;
+
+    for (size_t i = 0; i < removals.size(); ++i)
+      entries->erase(removals[i]);
+    for (size_t i = 0; i < updates.size(); ++i) {
+      std::pair<SimpleIndex::EntrySet::iterator, bool> insert_result =
+          entries->insert(updates[i]);
+      insert_result.first->second = updates[i].second;
+    }
+    DCHECK(out_cache_last_modified);
+    *out_cache_last_modified =
+        base::Time::FromInternalValue(cache_last_modified);
+    ++chunks_applied;
+    offset += chunk_size;
+  }
+  return chunks_applied;
+}
+
+// static
+void SimpleIndexFile::SyncAppendToJournal(
+    net::CacheType cache_type,
+    const base::FilePath& cache_directory,
+    const base::FilePath& index_filename,
+    scoped_ptr<Pickle> pickle,
+    const base::TimeTicks& start_time,
+    bool app_on_background) {
+  PickleHeader index_header;
+  if (base::ReadFile(index_filename, reinterpret_cast<char*>(&index_header),
+                     sizeof(index_header)) != sizeof(index_header)) {
+    // Without an index file the next startup restores the index from the
+    // entry files anyway.
+    return;
+  }
+  base::Time cache_dir_mtime;
+  if (!simple_util::GetCacheMTime(cache_directory, &cache_dir_mtime)) {
+    LOG(ERROR) << "Could obtain information about cache age";
+    return;
+  }
+  SerializeJournalFinalData(cache_dir_mtime, index_header.crc, pickle.get());
+  if (!AppendPickleToFile(pickle.get(),
+                          index_filename.DirName().AppendASCII(
+                              kJournalFileName))) {
+    LOG(ERROR) << "Failed to append to the index journal";
+    return;
+  }
+
+  if (app_on_background) {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexJournalWriteTime.Background", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  } else {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexJournalWriteTime.Foreground", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  }
+}
+
 void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
                                       const base::FilePath& cache_directory,
                                       const base::FilePath& index_filename,
@@ -196,7 +397,7 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   // flush delay. This simple approach will be reconsidered if it does not allow
   // for maintaining freshness.
   base::Time cache_dir_mtime;
-  if (!simple_util::GetMTime(cache_directory, &cache_dir_mtime)) {
+  if (!simple_util::GetCacheMTime(cache_directory, &cache_dir_mtime)) {
     LOG(ERROR) << "Could obtain information about cache age";
     return;
   }
@@ -204,17 +405,32 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   if (!WritePickleFile(pickle.get(), temp_index_filename)) {
     if (!base::CreateDirectory(temp_index_filename.DirName())) {
       LOG(ERROR) << "Could not create a directory to hold the index file";
+      base::DeleteFile(index_filename, /* recursive = */ false);
       return;
     }
     if (!WritePickleFile(pickle.get(), temp_index_filename)) {
       LOG(ERROR) << "Failed to write the temporary index file";
+      // Journal chunks appended to the old index file would miss the changes
+      // in this write, so do not let them apply to anything.
+      base::DeleteFile(index_filename, /* recursive = */ false);
       return;
     }
   }
 
   // Atomically rename the temporary index file to become the real one.
-  bool result = base::ReplaceFile(temp_index_filename, index_filename, NULL);
-  DCHECK(result);
+  if (!base::ReplaceFile(temp_index_filename, index_filename, NULL)) {
+    LOG(ERROR) << "Failed to replace the index file";
+    base::DeleteFile(index_filename, /* recursive = */ false);
+    return;
+  }
+
+  // The journal describes changes since the index file just replaced, and
+  // following chunks are appended on top of the new one. It is only deleted
+  // now so that a crash before the rename still finds the old index file with
+  // its journal, and the chunks of a journal left behind by a crash after the
+  // rename do not match the CRC of the new index file.
+  base::DeleteFile(index_filename.DirName().AppendASCII(kJournalFileName),
+                   /* recursive = */ false);
 
   if (app_on_background) {
     SIMPLE_CACHE_UMA(TIMES,
@@ -236,34 +452,170 @@ bool SimpleIndexFile::IndexMetadata::CheckIndexMetadata() {
 SimpleIndexFile::SimpleIndexFile(
     const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread,
     const scoped_refptr<base::TaskRunner>& worker_pool,
+    const scoped_refptr<SimplePackStore>& pack_store,
     net::CacheType cache_type,
     const base::FilePath& cache_directory)
     : cache_thread_(cache_thread),
       worker_pool_(worker_pool),
+      pack_store_(pack_store),
       cache_type_(cache_type),
       cache_directory_(cache_directory),
       index_file_(cache_directory_.AppendASCII(kIndexDirectory)
                       .AppendASCII(kIndexFileName)),
       temp_index_file_(cache_directory_.AppendASCII(kIndexDirectory)
-                           .AppendASCII(kTempIndexFileName)) {
+                           .AppendASCII(kTempIndexFileName)),
+      index_written_(false),
+      journal_entry_count_(0),
+      restore_result_(NULL),
+      pending_restore_shards_(0),
+      restore_index_file_existed_(false),
+      weak_ptr_factory_(this) {
 }
 
 SimpleIndexFile::~SimpleIndexFile() {}
 
-void SimpleIndexFile::LoadIndexEntries(base::Time cache_last_modified,
-                                       const base::Closure& callback,
-                                       SimpleIndexLoadResult* out_result) {
+void SimpleIndexFile::LoadIndexEntries(
+    base::Time cache_last_modified,
+    const base::Closure& callback,
+    const RestoredShardCallback& shard_callback,
+    SimpleIndexLoadResult* out_result) {
+  EntryFileListing* listing = new EntryFileListing();
   base::Closure task = base::Bind(&SimpleIndexFile::SyncLoadIndexEntries,
                                   cache_type_,
                                   cache_last_modified, cache_directory_,
-                                  index_file_, out_result);
-  worker_pool_->PostTaskAndReply(FROM_HERE, task, callback);
+                                  index_file_, pack_store_, out_result,
+                                  listing);
+  // The reply owns |out_result| through |callback| until the task is done.
+  base::Closure reply = base::Bind(&SimpleIndexFile::RestoreShards,
+                                   weak_ptr_factory_.GetWeakPtr(),
+                                   callback,
+                                   shard_callback,
+                                   out_result,
+                                   base::Owned(listing));
+  worker_pool_->PostTaskAndReply(FROM_HERE, task, reply);
 }
 
-void SimpleIndexFile::WriteToDisk(const SimpleIndex::EntrySet& entry_set,
-                                  uint64 cache_size,
-                                  const base::TimeTicks& start,
-                                  bool app_on_background) {
+void SimpleIndexFile::RestoreShards(
+    const base::Closure& callback,
+    const RestoredShardCallback& shard_callback,
+    SimpleIndexLoadResult* out_result,
+    EntryFileListing* listing) {
+  if (!listing->restore_required) {
+    callback.Run();
+    return;
+  }
+
+  // Only the IO thread uses |out_result| from now on, so it is fine for it to
+  // be owned by |restore_callback_| and go away with |this|.
+  DCHECK(restore_callback_.is_null());
+  restore_callback_ = callback;
+  restore_shard_callback_ = shard_callback;
+  restore_result_ = out_result;
+  restore_index_file_existed_ = listing->index_file_existed;
+  restore_start_time_ = listing->start_time;
+  pending_restore_shards_ = SimpleIndex::kRestoreShardCount;
+  SimpleIndex::EntrySet* shard_entries_list[SimpleIndex::kRestoreShardCount];
+  for (int shard = 0; shard < SimpleIndex::kRestoreShardCount; ++shard) {
+    shard_entries_list[shard] = new SimpleIndex::EntrySet();
+    shard_entries_list[shard]->reserve(listing->shards[shard].size());
+  }
+  // Packed entries have no entry files, their shards start out with them.
+  for (size_t i = 0; i < listing->packed_entries.size(); ++i) {
+    const SimplePackStore::PackedEntry& packed_entry =
+        listing->packed_entries[i];
+    SimpleIndex::InsertInEntrySet(
+        packed_entry.entry_hash,
+        EntryMetadata(packed_entry.last_modified, packed_entry.size),
+        shard_entries_list[SimpleIndex::GetRestoreShard(
+            packed_entry.entry_hash)]);
+  }
+  for (int shard = 0; shard < SimpleIndex::kRestoreShardCount; ++shard) {
+    EntryFileList* entry_files = new EntryFileList();
+    entry_files->swap(listing->shards[shard]);
+    SimpleIndex::EntrySet* shard_entries = shard_entries_list[shard];
+    worker_pool_->PostTaskAndReply(
+        FROM_HERE,
+        base::Bind(&SimpleIndexFile::SyncRestoreShard,
+                   cache_type_,
+                   cache_directory_,
+                   base::Owned(entry_files),
+                   shard_entries),
+        base::Bind(&SimpleIndexFile::OnShardRestored,
+                   weak_ptr_factory_.GetWeakPtr(),
+                   shard,
+                   base::Owned(shard_entries)));
+  }
+}
+
+void SimpleIndexFile::OnShardRestored(
+    int shard,
+    const SimpleIndex::EntrySet* shard_entries) {
+  DCHECK_LT(0, pending_restore_shards_);
+  if (!restore_shard_callback_.is_null())
+    restore_shard_callback_.Run(shard, *shard_entries);
+
+  SimpleIndex::EntrySet* entries = &restore_result_->entries;
+  for (SimpleIndex::EntrySet::const_iterator it = shard_entries->begin();
+       it != shard_entries->end(); ++it) {
+    SimpleIndex::InsertInEntrySet(it->first, it->second, entries);
+  }
+  if (--pending_restore_shards_ > 0)
+    return;
+
+  restore_result_->did_load = true;
+  // When we restore from disk we write the merged index file to disk right
+  // away, this might save us from having to restore again next time.
+  restore_result_->flush_required = true;
+
+  SIMPLE_CACHE_UMA(MEDIUM_TIMES, "IndexRestoreTime", cache_type_,
+                   base::TimeTicks::Now() - restore_start_time_);
+  SIMPLE_CACHE_UMA(COUNTS, "IndexEntriesRestored", cache_type_,
+                   entries->size());
+  if (restore_index_file_existed_) {
+    UmaRecordIndexInitMethod(INITIALIZE_METHOD_RECOVERED, cache_type_);
+  } else {
+    UmaRecordIndexInitMethod(INITIALIZE_METHOD_NEWCACHE, cache_type_);
+    SIMPLE_CACHE_UMA(COUNTS,
+                     "IndexCreatedEntryCount", cache_type_,
+                     entries->size());
+  }
+
+  base::Closure callback = restore_callback_;
+  restore_callback_.Reset();
+  restore_shard_callback_.Reset();
+  restore_result_ = NULL;
+  callback.Run();
+}
+
+void SimpleIndexFile::WriteToDisk(
+    const SimpleIndex::EntrySet& entry_set,
+    const base::hash_set<uint64>& changed_entries,
+    uint64 cache_size,
+    const base::TimeTicks& start,
+    bool app_on_background) {
+  const uint64 max_journal_entries =
+      std::max(kMinJournalEntriesBeforeRewrite,
+               static_cast<uint64>(entry_set.size() / 4));
+  if (index_written_ &&
+      journal_entry_count_ + changed_entries.size() <= max_journal_entries) {
+    if (changed_entries.empty())
+      return;
+    journal_entry_count_ += changed_entries.size();
+    scoped_ptr<Pickle> pickle = SerializeJournalChunk(entry_set,
+                                                      changed_entries);
+    cache_thread_->PostTask(FROM_HERE,
+                            base::Bind(&SimpleIndexFile::SyncAppendToJournal,
+                                       cache_type_,
+                                       cache_directory_,
+                                       index_file_,
+                                       base::Passed(&pickle),
+                                       base::TimeTicks::Now(),
+                                       app_on_background));
+    return;
+  }
+
+  index_written_ = true;
+  journal_entry_count_ = 0;
   IndexMetadata index_metadata(entry_set.size(), cache_size);
   scoped_ptr<Pickle> pickle = Serialize(index_metadata, entry_set);
   cache_thread_->PostTask(FROM_HERE,
@@ -283,7 +635,9 @@ void SimpleIndexFile::SyncLoadIndexEntries(
     base::Time cache_last_modified,
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
-    SimpleIndexLoadResult* out_result) {
+    const scoped_refptr<SimplePackStore>& pack_store,
+    SimpleIndexLoadResult* out_result,
+    EntryFileListing* out_listing) {
   // Load the index and find its age.
   base::Time last_cache_seen_by_index;
   SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
@@ -295,9 +649,7 @@ void SimpleIndexFile::SyncLoadIndexEntries(
       UmaRecordIndexFileState(INDEX_STATE_CORRUPT, cache_type);
   } else {
     if (cache_last_modified <= last_cache_seen_by_index) {
-      base::Time latest_dir_mtime;
-      simple_util::GetMTime(cache_directory, &latest_dir_mtime);
-      if (LegacyIsIndexFileStale(latest_dir_mtime, index_file_path)) {
+      if (LegacyIsIndexFileStale(cache_last_modified, index_file_path)) {
         UmaRecordIndexFileState(INDEX_STATE_FRESH_CONCURRENT_UPDATES,
                                 cache_type);
       } else {
@@ -309,21 +661,14 @@ void SimpleIndexFile::SyncLoadIndexEntries(
     UmaRecordIndexFileState(INDEX_STATE_STALE, cache_type);
   }
 
-  // Reconstruct the index by scanning the disk for entries.
-  const base::TimeTicks start = base::TimeTicks::Now();
-  SyncRestoreFromDisk(cache_directory, index_file_path, out_result);
-  SIMPLE_CACHE_UMA(MEDIUM_TIMES, "IndexRestoreTime", cache_type,
-                   base::TimeTicks::Now() - start);
-  SIMPLE_CACHE_UMA(COUNTS, "IndexEntriesRestored", cache_type,
-                   out_result->entries.size());
-  if (index_file_existed) {
-    UmaRecordIndexInitMethod(INITIALIZE_METHOD_RECOVERED, cache_type);
-  } else {
-    UmaRecordIndexInitMethod(INITIALIZE_METHOD_NEWCACHE, cache_type);
-    SIMPLE_CACHE_UMA(COUNTS,
-                     "IndexCreatedEntryCount", cache_type,
-                     out_result->entries.size());
-  }
+  // Reconstruct the index by scanning the disk for entries. Only the listing
+  // is done here, the entry files are examined in parallel by shard.
+  out_listing->start_time = base::TimeTicks::Now();
+  out_listing->index_file_existed = index_file_existed;
+  out_result->Reset();
+  SyncListEntryFiles(cache_directory, index_file_path, out_listing);
+  if (pack_store.get())
+    pack_store->GetPackedEntries(&out_listing->packed_entries);
 }
 
 // static
@@ -345,8 +690,26 @@ void SimpleIndexFile::SyncLoadFromDisk(const base::FilePath& index_filename,
       out_last_cache_seen_by_index,
       out_result);
 
-  if (!out_result->did_load)
+  const base::FilePath journal_filename =
+      index_filename.DirName().AppendASCII(kJournalFileName);
+  if (!out_result->did_load) {
     base::DeleteFile(index_filename, false);
+    base::DeleteFile(journal_filename, false);
+    return;
+  }
+
+  base::MemoryMappedFile journal_file_map;
+  if (!base::PathExists(journal_filename) ||
+      !journal_file_map.Initialize(journal_filename)) {
+    return;
+  }
+  const uint32 index_crc =
+      reinterpret_cast<const PickleHeader*>(index_file_map.data())->crc;
+  ReplayJournal(reinterpret_cast<const char*>(journal_file_map.data()),
+                journal_file_map.length(),
+                index_crc,
+                out_last_cache_seen_by_index,
+                &out_result->entries);
 }
 
 // static
@@ -401,10 +764,7 @@ void SimpleIndexFile::Deserialize(const char* data, int data_len,
     return;
   }
 
-#if !defined(OS_WIN)
-  // TODO(gavinp): Consider using std::unordered_map.
-  entries->resize(index_metadata.GetNumberOfEntries() + kExtraSizeForMerge);
-#endif
+  entries->reserve(index_metadata.GetNumberOfEntries() + kExtraSizeForMerge);
   while (entries->size() < index_metadata.GetNumberOfEntries()) {
     uint64 hash_key;
     EntryMetadata entry_metadata;
@@ -429,25 +789,49 @@ void SimpleIndexFile::Deserialize(const char* data, int data_len,
 }
 
 // static
-void SimpleIndexFile::SyncRestoreFromDisk(
+void SimpleIndexFile::SyncListEntryFiles(
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
-    SimpleIndexLoadResult* out_result) {
+    EntryFileListing* out_listing) {
   VLOG(1) << "Simple Cache Index is being restored from disk.";
   base::DeleteFile(index_file_path, /* recursive = */ false);
-  out_result->Reset();
-  SimpleIndex::EntrySet* entries = &out_result->entries;
+  base::DeleteFile(index_file_path.DirName().AppendASCII(kJournalFileName),
+                   /* recursive = */ false);
+
+  const EntryFileCallback list_entry_file =
+      base::Bind(&SimpleIndexFile::ListEntryFile, out_listing);
+  for (int i = 0; i < simple_util::kEntryDirectoryCount; ++i) {
+    const base::FilePath entry_directory =
+        simple_util::GetEntryDirectory(cache_directory, i);
+    // The entry subdirectories are only created along with their first entry.
+    if (!base::DirectoryExists(entry_directory))
+      continue;
+    if (!TraverseCacheDirectory(entry_directory, list_entry_file)) {
+      LOG(ERROR) << "Could not reconstruct index from disk";
+      return;
+    }
+  }
+  out_listing->restore_required = true;
+}
 
-  const bool did_succeed = TraverseCacheDirectory(
-      cache_directory, base::Bind(&ProcessEntryFile, entries));
-  if (!did_succeed) {
-    LOG(ERROR) << "Could not reconstruct index from disk";
-    return;
+// static
+void SimpleIndexFile::SyncRestoreShard(net::CacheType cache_type,
+                                       const base::FilePath& cache_directory,
+                                       const EntryFileList* entry_files,
+                                       SimpleIndex::EntrySet* out_entries) {
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (EntryFileList::const_iterator it = entry_files->begin();
+       it != entry_files->end(); ++it) {
+    const std::string file_name =
+        simple_util::ConvertEntryHashKeyToHexString(it->entry_hash) +
+        std::string(it->suffix, arraysize(it->suffix));
+    const base::FilePath entry_directory = simple_util::GetEntryDirectory(
+        cache_directory, simple_util::GetEntryDirectoryIndex(it->entry_hash));
+    RestoreEntryFile(out_entries, it->entry_hash,
+                     entry_directory.AppendASCII(file_name));
   }
-  out_result->did_load = true;
-  // When we restore from disk we write the merged index file to disk right
-  // away, this might save us from having to restore again next time.
-  out_result->flush_required = true;
+  SIMPLE_CACHE_UMA(TIMES, "IndexRestoreShardTime", cache_type,
+                   base::TimeTicks::Now() - start);
 }
 
 // static
@@ -14,11 +14,13 @@
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
 #include "base/pickle.h"
 #include "base/port.h"
 #include "net/base/cache_type.h"
 #include "net/base/net_export.h"
 #include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_pack_store.h"
 
 namespace base {
 class SingleThreadTaskRunner;
@@ -28,6 +30,7 @@ class TaskRunner;
 namespace disk_cache {
 
 const uint64 kSimpleIndexMagicNumber = GG_UINT64_C(0x656e74657220796f);
+const uint64 kSimpleIndexJournalMagicNumber = GG_UINT64_C(0x6a6f75726e616c21);
 
 struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
   SimpleIndexLoadResult();
@@ -46,6 +49,16 @@ struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
 // see SimpleIndexFile::Serialize() and SeeSimpleIndexFile::LoadFromDisk()
 // methods.
 //
+// Between two full writes of the index, changes are appended to a journal
+// file next to it, so that a periodic flush costs time proportional to the
+// number of entries changed since the previous flush. The journal is a
+// sequence of chunks, each a pickle with its own CRC holding the changed
+// entries, the cache modification time and the CRC of the index file the
+// chunk applies to. Loading replays the chunks on top of the index and stops
+// at the first chunk that is torn, corrupt or meant for another index file.
+// A full write deletes the journal once the new index file has replaced the
+// old one.
+//
 // The non-static methods must run on the IO thread. All the real
 // work is done in the static methods, which are run on the cache thread
 // or in worker threads. Synchronization between methods is the
@@ -74,20 +87,37 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
     uint64 cache_size_;  // Total cache storage size in bytes.
   };
 
+  // |pack_store| is NULL unless small entries are packed, in which case the
+  // packed entries are restored from it along with the entry files.
   SimpleIndexFile(
       const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread,
       const scoped_refptr<base::TaskRunner>& worker_pool,
+      const scoped_refptr<SimplePackStore>& pack_store,
       net::CacheType cache_type,
       const base::FilePath& cache_directory);
   virtual ~SimpleIndexFile();
 
-  // Get index entries based on current disk context.
+  // Called on the IO thread with the entries of one restore shard, see
+  // SimpleIndex::GetRestoreShard(), as soon as they are restored from the
+  // entry files.
+  typedef base::Callback<void(int, const SimpleIndex::EntrySet&)>
+      RestoredShardCallback;
+
+  // Get index entries based on current disk context. If the index has to be
+  // restored from the entry files, the shards are restored in parallel on the
+  // worker pool and each is passed to |shard_callback|, if not null, before
+  // all of them are returned in |out_result|.
   virtual void LoadIndexEntries(base::Time cache_last_modified,
                                 const base::Closure& callback,
+                                const RestoredShardCallback& shard_callback,
                                 SimpleIndexLoadResult* out_result);
 
-  // Write the specified set of entries to disk.
+  // Write the specified set of entries to disk. |changed_entries| holds the
+  // hashes of the entries inserted, updated or removed since the previous
+  // call, which are journaled instead of rewriting the whole index when there
+  // are few of them.
   virtual void WriteToDisk(const SimpleIndex::EntrySet& entry_set,
+                           const base::hash_set<uint64>& changed_entries,
                            uint64 cache_size,
                            const base::TimeTicks& start,
                            bool app_on_background);
@@ -98,18 +128,65 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   // Used for cache directory traversal.
   typedef base::Callback<void (const base::FilePath&)> EntryFileCallback;
 
+  // An entry file found while listing the cache directory, stored as the hash
+  // of its entry and the suffix of its file name rather than as a path to keep
+  // listings of large caches small.
+  struct EntryFileName {
+    uint64 entry_hash;
+    char suffix[2];
+  };
+  typedef std::vector<EntryFileName> EntryFileList;
+
+  // The entry files of the cache directory, split by restore shard.
+  struct EntryFileListing {
+    EntryFileListing();
+    ~EntryFileListing();
+
+    bool restore_required;
+    bool index_file_existed;
+    base::TimeTicks start_time;
+    EntryFileList shards[SimpleIndex::kRestoreShardCount];
+    std::vector<SimplePackStore::PackedEntry> packed_entries;
+  };
+
   // When loading the entries from disk, add this many extra hash buckets to
   // prevent reallocation on the IO thread when merging in new live entries.
   static const int kExtraSizeForMerge = 512;
 
-  // Synchronous (IO performing) implementation of LoadIndexEntries.
+  // The whole index is rewritten once the journal holds more entries than
+  // this, or more than a quarter of the entries in the index if that is
+  // larger.
+  static const uint64 kMinJournalEntriesBeforeRewrite = 1024;
+
+  // Synchronous (IO performing) implementation of LoadIndexEntries. If the
+  // index file is missing, corrupt or stale, lists the entry files into
+  // |out_listing| for the index to be restored from them.
   static void SyncLoadIndexEntries(net::CacheType cache_type,
                                    base::Time cache_last_modified,
                                    const base::FilePath& cache_directory,
                                    const base::FilePath& index_file_path,
-                                   SimpleIndexLoadResult* out_result);
-
-  // Load the index file from disk returning an EntrySet.
+                                   const scoped_refptr<SimplePackStore>&
+                                       pack_store,
+                                   SimpleIndexLoadResult* out_result,
+                                   EntryFileListing* out_listing);
+
+  // Adds the entry file at |file_path| to the shard of its entry hash in
+  // |listing|, if it is named like an entry file.
+  static void ListEntryFile(EntryFileListing* listing,
+                            const base::FilePath& file_path);
+
+  // Runs on the IO thread once the index is loaded or the entry files are
+  // listed, starting the restore of each shard if needed.
+  void RestoreShards(const base::Closure& callback,
+                     const RestoredShardCallback& shard_callback,
+                     SimpleIndexLoadResult* out_result,
+                     EntryFileListing* listing);
+
+  // Runs on the IO thread when the entries of |shard| are restored.
+  void OnShardRestored(int shard, const SimpleIndex::EntrySet* shard_entries);
+
+  // Load the index file and replay its journal from disk returning an
+  // EntrySet.
   static void SyncLoadFromDisk(const base::FilePath& index_filename,
                                base::Time* out_last_cache_seen_by_index,
                                SimpleIndexLoadResult* out_result);
@@ -128,6 +205,29 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   // worker thread.
   static bool SerializeFinalData(base::Time cache_modified, Pickle* pickle);
 
+  // Returns a newly allocated Pickle holding a journal chunk with the current
+  // metadata of each of the |changed_entries|, or a removal record for the
+  // ones no longer in |entries|. As with Serialize(), the chunk must be
+  // completed with SerializeJournalFinalData before being written.
+  static scoped_ptr<Pickle> SerializeJournalChunk(
+      const SimpleIndex::EntrySet& entries,
+      const base::hash_set<uint64>& changed_entries);
+
+  // Completes a journal chunk with the cache modification time and the CRC
+  // of the index file the chunk applies to.
+  static bool SerializeJournalFinalData(base::Time cache_modified,
+                                        uint32 index_crc,
+                                        Pickle* pickle);
+
+  // Applies the journal chunks in |data| that were written on top of the
+  // index file with CRC |index_crc| to |entries|, advancing
+  // |out_cache_last_modified| to the time stored in the last applied chunk.
+  // Returns the number of chunks applied.
+  static int ReplayJournal(const char* data, int data_len,
+                           uint32 index_crc,
+                           base::Time* out_cache_last_modified,
+                           SimpleIndex::EntrySet* entries);
+
   // Given the contents of an index file |data| of length |data_len|, returns
   // the corresponding EntrySet. Returns NULL on error.
   static void Deserialize(const char* data, int data_len,
@@ -143,7 +243,8 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
       const base::FilePath& cache_path,
       const EntryFileCallback& entry_file_callback);
 
-  // Writes the index file to disk atomically.
+  // Writes the index file to disk atomically, then discards the journal next
+  // to it.
   static void SyncWriteToDisk(net::CacheType cache_type,
                               const base::FilePath& cache_directory,
                               const base::FilePath& index_filename,
@@ -152,11 +253,27 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
                               const base::TimeTicks& start_time,
                               bool app_on_background);
 
-  // Scan the index directory for entries, returning an EntrySet of all entries
-  // found.
-  static void SyncRestoreFromDisk(const base::FilePath& cache_directory,
-                                  const base::FilePath& index_file_path,
-                                  SimpleIndexLoadResult* out_result);
+  // Appends a journal chunk to the journal next to |index_filename|. Does
+  // nothing if there is no index file for the chunk to apply to.
+  static void SyncAppendToJournal(net::CacheType cache_type,
+                                  const base::FilePath& cache_directory,
+                                  const base::FilePath& index_filename,
+                                  scoped_ptr<Pickle> pickle,
+                                  const base::TimeTicks& start_time,
+                                  bool app_on_background);
+
+  // Scan the entry subdirectories for entry files, splitting them by shard into
+  // |out_listing|. The index file is deleted, since it is to be restored.
+  static void SyncListEntryFiles(const base::FilePath& cache_directory,
+                                 const base::FilePath& index_file_path,
+                                 EntryFileListing* out_listing);
+
+  // Finds the size and last used time of the entries of one shard of entry
+  // files, returning them in |out_entries|.
+  static void SyncRestoreShard(net::CacheType cache_type,
+                               const base::FilePath& cache_directory,
+                               const EntryFileList* entry_files,
+                               SimpleIndex::EntrySet* out_entries);
 
   // Determines if an index file is stale relative to the time of last
   // modification of the cache directory. Obsolete, used only for a histogram to
@@ -171,14 +288,35 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
 
   const scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
   const scoped_refptr<base::TaskRunner> worker_pool_;
+  const scoped_refptr<SimplePackStore> pack_store_;
   const net::CacheType cache_type_;
   const base::FilePath cache_directory_;
   const base::FilePath index_file_;
   const base::FilePath temp_index_file_;
 
+  // Whether the whole index has been written in this session. Until then the
+  // journal may belong to an index file that does not match the entries in
+  // memory, so the first write is always a full one.
+  bool index_written_;
+
+  // Number of entry records appended to the journal since the index file was
+  // last written.
+  uint64 journal_entry_count_;
+
+  // State of the restore from the entry files, if one is running.
+  base::Closure restore_callback_;
+  RestoredShardCallback restore_shard_callback_;
+  SimpleIndexLoadResult* restore_result_;
+  int pending_restore_shards_;
+  bool restore_index_file_existed_;
+  base::TimeTicks restore_start_time_;
+
+  base::WeakPtrFactory<SimpleIndexFile> weak_ptr_factory_;
+
   static const char kIndexDirectory[];
   static const char kIndexFileName[];
   static const char kTempIndexFileName[];
+  static const char kJournalFileName[];
 
   DISALLOW_COPY_AND_ASSIGN(SimpleIndexFile);
 };
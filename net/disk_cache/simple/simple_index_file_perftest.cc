@@ -0,0 +1,206 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index_file.h"
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/containers/hash_tables.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/test/perf_time_logger.h"
+#include "base/thread_task_runner_handle.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/time/time.h"
+#include "net/base/cache_type.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Each journaled flush changes this fraction of the entries, and the index is
+// loaded after this many flushes.
+const int kChangedEntriesPerFlushDivisor = 200;
+const int kNumJournaledFlushes = 4;
+
+// The number of entry files the index is restored from, and the number of
+// worker threads restoring it, as for the simple cache backend.
+const int kNumRestoredEntries = 200000;
+const size_t kRestoreWorkerThreads = 4;
+
+// Returns the hash of the |i|-th entry, spread over the whole hash space.
+uint64 GetEntryHash(int i) {
+  return (i + 1) * GG_UINT64_C(0x9e3779b97f4a7c15);
+}
+
+void SetTrue(bool* called) {
+  *called = true;
+}
+
+scoped_ptr<SimpleIndexFile> CreateIndexFile(
+    const base::FilePath& path,
+    const scoped_refptr<base::TaskRunner>& worker_pool) {
+  return make_scoped_ptr(new SimpleIndexFile(
+      base::ThreadTaskRunnerHandle::Get(),
+      worker_pool,
+      NULL,
+      net::DISK_CACHE,
+      path));
+}
+
+scoped_ptr<SimpleIndexFile> CreateIndexFile(const base::FilePath& path) {
+  return CreateIndexFile(path, base::ThreadTaskRunnerHandle::Get());
+}
+
+void RecordShardRestored(const base::TimeTicks& start,
+                         std::vector<base::TimeDelta>* shard_times,
+                         int shard,
+                         const SimpleIndex::EntrySet& shard_entries) {
+  shard_times->push_back(base::TimeTicks::Now() - start);
+}
+
+// Loads the index in |path| as done at startup, logging how long it took.
+void TimeStartup(const base::FilePath& path,
+                 const std::string& name,
+                 size_t expected_entry_count) {
+  scoped_ptr<SimpleIndexFile> index_file = CreateIndexFile(path);
+  SimpleIndexLoadResult result;
+  bool loaded = false;
+  base::PerfTimeLogger timer(name.c_str());
+  index_file->LoadIndexEntries(base::Time(),
+                               base::Bind(&SetTrue, &loaded),
+                               SimpleIndexFile::RestoredShardCallback(),
+                               &result);
+  base::RunLoop().RunUntilIdle();
+  timer.Done();
+  ASSERT_TRUE(loaded);
+  EXPECT_TRUE(result.did_load);
+  EXPECT_EQ(expected_entry_count, result.entries.size());
+}
+
+void RunStartupTest(int num_entries) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+
+  SimpleIndex::EntrySet entries;
+  entries.reserve(num_entries);
+  const base::Time now = base::Time::Now();
+  for (int i = 0; i < num_entries; ++i) {
+    SimpleIndex::InsertInEntrySet(GetEntryHash(i),
+                                  EntryMetadata(now, 1000 + i % 50000),
+                                  &entries);
+  }
+
+  scoped_ptr<SimpleIndexFile> index_file = CreateIndexFile(cache_dir.path());
+  {
+    base::PerfTimeLogger timer(
+        base::StringPrintf("SimpleIndexFile_full_write_%d", num_entries)
+            .c_str());
+    index_file->WriteToDisk(entries, base::hash_set<uint64>(), 0,
+                            base::TimeTicks(), false);
+    base::RunLoop().RunUntilIdle();
+    timer.Done();
+  }
+  TimeStartup(cache_dir.path(),
+              base::StringPrintf("SimpleIndexFile_startup_%d", num_entries),
+              entries.size());
+
+  // Journal a few flushes of changes on top of the index, as between two full
+  // writes of a long running session.
+  const int changed_per_flush = num_entries / kChangedEntriesPerFlushDivisor;
+  for (int flush = 0; flush < kNumJournaledFlushes; ++flush) {
+    base::hash_set<uint64> changed_entries;
+    for (int i = 0; i < changed_per_flush; ++i) {
+      const uint64 entry_hash = GetEntryHash(flush * changed_per_flush + i);
+      entries.find(entry_hash)->second.SetLastUsedTime(
+          now + base::TimeDelta::FromMinutes(flush + 1));
+      changed_entries.insert(entry_hash);
+    }
+    index_file->WriteToDisk(entries, changed_entries, 0, base::TimeTicks(),
+                            false);
+    base::RunLoop().RunUntilIdle();
+  }
+  TimeStartup(cache_dir.path(),
+              base::StringPrintf("SimpleIndexFile_startup_with_journal_%d",
+                                 num_entries),
+              entries.size());
+}
+
+}  // namespace
+
+// Measures how long loading the index takes at startup for caches of 10k,
+// 100k and 1M entries, with and without journaled changes to replay.
+TEST(SimpleIndexFilePerfTest, Startup) {
+  base::MessageLoopForIO message_loop;
+  RunStartupTest(10000);
+  RunStartupTest(100000);
+  RunStartupTest(1000000);
+}
+
+// Measures how long restoring the index from 200k entry files takes when the
+// index file is missing, and how soon the first and last shards of the index
+// are available for lookups.
+TEST(SimpleIndexFilePerfTest, RestoreFromEntryFiles) {
+  base::MessageLoopForIO message_loop;
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+
+  for (int i = 0; i < simple_util::kEntryDirectoryCount; ++i) {
+    ASSERT_TRUE(base::CreateDirectory(
+        simple_util::GetEntryDirectory(cache_dir.path(), i)));
+  }
+  const char kEntryData[] = "entry data";
+  for (int i = 0; i < kNumRestoredEntries; ++i) {
+    const base::FilePath entry_file =
+        simple_util::GetFilePathFromEntryHashAndFileIndex(
+            cache_dir.path(), GetEntryHash(i), 0);
+    ASSERT_EQ(static_cast<int>(sizeof(kEntryData)),
+              base::WriteFile(entry_file, kEntryData, sizeof(kEntryData)));
+  }
+
+  scoped_refptr<base::SequencedWorkerPool> worker_pool(
+      new base::SequencedWorkerPool(kRestoreWorkerThreads,
+                                    "SimpleIndexFilePerfTest"));
+  scoped_ptr<SimpleIndexFile> index_file =
+      CreateIndexFile(cache_dir.path(), worker_pool);
+  SimpleIndexLoadResult result;
+  std::vector<base::TimeDelta> shard_times;
+  base::RunLoop run_loop;
+  const base::TimeTicks start = base::TimeTicks::Now();
+  index_file->LoadIndexEntries(
+      base::Time(),
+      run_loop.QuitClosure(),
+      base::Bind(&RecordShardRestored, start, &shard_times),
+      &result);
+  run_loop.Run();
+  const base::TimeDelta restore_time = base::TimeTicks::Now() - start;
+
+  EXPECT_TRUE(result.did_load);
+  EXPECT_EQ(static_cast<size_t>(kNumRestoredEntries), result.entries.size());
+  ASSERT_EQ(static_cast<size_t>(SimpleIndex::kRestoreShardCount),
+            shard_times.size());
+  base::LogPerfResult("SimpleIndexFile_restore_first_shard",
+                      shard_times.front().InMillisecondsF(), "ms");
+  base::LogPerfResult("SimpleIndexFile_restore_last_shard",
+                      shard_times.back().InMillisecondsF(), "ms");
+  base::LogPerfResult("SimpleIndexFile_restore",
+                      restore_time.InMillisecondsF(), "ms");
+
+  // Let the index written after the restore land before the directory goes.
+  base::RunLoop().RunUntilIdle();
+  worker_pool->Shutdown();
+}
+
+}  // namespace disk_cache
@@ -71,12 +71,16 @@ class WrappedSimpleIndexFile : public SimpleIndexFile {
  public:
   using SimpleIndexFile::Deserialize;
   using SimpleIndexFile::LegacyIsIndexFileStale;
+  using SimpleIndexFile::ReplayJournal;
   using SimpleIndexFile::Serialize;
   using SimpleIndexFile::SerializeFinalData;
+  using SimpleIndexFile::SerializeJournalChunk;
+  using SimpleIndexFile::SerializeJournalFinalData;
 
   explicit WrappedSimpleIndexFile(const base::FilePath& index_file_directory)
       : SimpleIndexFile(base::ThreadTaskRunnerHandle::Get(),
                         base::ThreadTaskRunnerHandle::Get(),
+                        NULL,
                         net::DISK_CACHE,
                         index_file_directory) {}
   virtual ~WrappedSimpleIndexFile() {
@@ -110,6 +114,18 @@ class SimpleIndexFileTest : public testing::Test {
 
   bool callback_called() { return callback_called_; }
 
+  static void OnShardRestored(std::vector<int>* restored_shards,
+                              SimpleIndex::EntrySet* all_entries,
+                              int shard,
+                              const SimpleIndex::EntrySet& shard_entries) {
+    restored_shards->push_back(shard);
+    for (SimpleIndex::EntrySet::const_iterator it = shard_entries.begin();
+         it != shard_entries.end(); ++it) {
+      EXPECT_EQ(shard, SimpleIndex::GetRestoreShard(it->first));
+      all_entries->insert(*it);
+    }
+  }
+
  private:
   void LoadIndexEntriesCallback() {
     EXPECT_FALSE(callback_called_);
@@ -156,6 +172,80 @@ TEST_F(SimpleIndexFileTest, Serialize) {
   }
 }
 
+TEST_F(SimpleIndexFileTest, ReplayJournal) {
+  const uint32 kIndexCrc = 0x12345678;
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(11, EntryMetadata(Time(), 11), &entries);
+  SimpleIndex::InsertInEntrySet(22, EntryMetadata(Time(), 22), &entries);
+
+  // The first chunk updates 11, adds 33 and removes 22.
+  SimpleIndex::EntrySet current_entries = entries;
+  current_entries.find(11)->second.SetEntrySize(111);
+  current_entries.erase(22);
+  SimpleIndex::InsertInEntrySet(33, EntryMetadata(Time(), 33),
+                                &current_entries);
+  base::hash_set<uint64> changed_entries;
+  changed_entries.insert(11);
+  changed_entries.insert(22);
+  changed_entries.insert(33);
+  scoped_ptr<Pickle> first_chunk =
+      WrappedSimpleIndexFile::SerializeJournalChunk(current_entries,
+                                                    changed_entries);
+  const base::Time first_time = base::Time::Now();
+  EXPECT_TRUE(WrappedSimpleIndexFile::SerializeJournalFinalData(
+      first_time, kIndexCrc, first_chunk.get()));
+
+  // The second chunk removes 33.
+  current_entries.erase(33);
+  changed_entries.clear();
+  changed_entries.insert(33);
+  scoped_ptr<Pickle> second_chunk =
+      WrappedSimpleIndexFile::SerializeJournalChunk(current_entries,
+                                                    changed_entries);
+  const base::Time second_time = first_time + base::TimeDelta::FromSeconds(1);
+  EXPECT_TRUE(WrappedSimpleIndexFile::SerializeJournalFinalData(
+      second_time, kIndexCrc, second_chunk.get()));
+
+  std::string journal(static_cast<const char*>(first_chunk->data()),
+                      first_chunk->size());
+  journal.append(static_cast<const char*>(second_chunk->data()),
+                 second_chunk->size());
+
+  {
+    SimpleIndex::EntrySet replayed_entries = entries;
+    base::Time cache_last_modified;
+    EXPECT_EQ(2, WrappedSimpleIndexFile::ReplayJournal(
+        journal.data(), journal.size(), kIndexCrc, &cache_last_modified,
+        &replayed_entries));
+    EXPECT_EQ(second_time, cache_last_modified);
+    ASSERT_EQ(1U, replayed_entries.size());
+    EXPECT_EQ(111, replayed_entries.find(11)->second.GetEntrySize());
+  }
+
+  // A torn second chunk is ignored.
+  {
+    SimpleIndex::EntrySet replayed_entries = entries;
+    base::Time cache_last_modified;
+    EXPECT_EQ(1, WrappedSimpleIndexFile::ReplayJournal(
+        journal.data(), journal.size() - 4, kIndexCrc, &cache_last_modified,
+        &replayed_entries));
+    EXPECT_EQ(first_time, cache_last_modified);
+    EXPECT_EQ(2U, replayed_entries.size());
+    EXPECT_EQ(1U, replayed_entries.count(33));
+  }
+
+  // Chunks written for another index file are ignored.
+  {
+    SimpleIndex::EntrySet replayed_entries = entries;
+    base::Time cache_last_modified;
+    EXPECT_EQ(0, WrappedSimpleIndexFile::ReplayJournal(
+        journal.data(), journal.size(), kIndexCrc + 1, &cache_last_modified,
+        &replayed_entries));
+    EXPECT_EQ(2U, replayed_entries.size());
+    EXPECT_EQ(22, replayed_entries.find(22)->second.GetEntrySize());
+  }
+}
+
 TEST_F(SimpleIndexFileTest, LegacyIsIndexFileStale) {
   base::ScopedTempDir cache_dir;
   ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
@@ -207,7 +297,8 @@ TEST_F(SimpleIndexFileTest, DISABLED_WriteThenLoadIndex) {
   const uint64 kCacheSize = 456U;
   {
     WrappedSimpleIndexFile simple_index_file(cache_dir.path());
-    simple_index_file.WriteToDisk(entries, kCacheSize,
+    simple_index_file.WriteToDisk(entries, base::hash_set<uint64>(),
+                                  kCacheSize,
                                   base::TimeTicks(), false);
     base::RunLoop().RunUntilIdle();
     EXPECT_TRUE(base::PathExists(simple_index_file.GetIndexFilePath()));
@@ -218,9 +309,9 @@ TEST_F(SimpleIndexFileTest, DISABLED_WriteThenLoadIndex) {
   ASSERT_TRUE(simple_util::GetMTime(simple_index_file.GetIndexFilePath(),
                                     &fake_cache_mtime));
   SimpleIndexLoadResult load_index_result;
-  simple_index_file.LoadIndexEntries(fake_cache_mtime,
-                                     GetCallback(),
-                                     &load_index_result);
+  simple_index_file.LoadIndexEntries(
+      fake_cache_mtime, GetCallback(),
+      SimpleIndexFile::RestoredShardCallback(), &load_index_result);
   base::RunLoop().RunUntilIdle();
 
   EXPECT_TRUE(base::PathExists(simple_index_file.GetIndexFilePath()));
@@ -251,9 +342,9 @@ TEST_F(SimpleIndexFileTest, LoadCorruptIndex) {
                                                               index_path));
 
   SimpleIndexLoadResult load_index_result;
-  simple_index_file.LoadIndexEntries(fake_cache_mtime,
-                                     GetCallback(),
-                                     &load_index_result);
+  simple_index_file.LoadIndexEntries(
+      fake_cache_mtime, GetCallback(),
+      SimpleIndexFile::RestoredShardCallback(), &load_index_result);
   base::RunLoop().RunUntilIdle();
 
   EXPECT_FALSE(base::PathExists(index_path));
@@ -262,6 +353,105 @@ TEST_F(SimpleIndexFileTest, LoadCorruptIndex) {
   EXPECT_TRUE(load_index_result.flush_required);
 }
 
+// Tests that a full write of the index discards the journal of the index file
+// it replaces.
+TEST_F(SimpleIndexFileTest, FullWriteDiscardsJournal) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(11, EntryMetadata(Time(), 100), &entries);
+  SimpleIndex::InsertInEntrySet(22, EntryMetadata(Time(), 200), &entries);
+
+  base::FilePath journal_path;
+  {
+    WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+    journal_path =
+        simple_index_file.GetIndexFilePath().DirName().AppendASCII(
+            "index-journal");
+    simple_index_file.WriteToDisk(entries, base::hash_set<uint64>(), 0,
+                                  base::TimeTicks(), false);
+    base::RunLoop().RunUntilIdle();
+    EXPECT_FALSE(base::PathExists(journal_path));
+
+    base::hash_set<uint64> changed_entries;
+    SimpleIndex::InsertInEntrySet(33, EntryMetadata(Time(), 300), &entries);
+    changed_entries.insert(33);
+    simple_index_file.WriteToDisk(entries, changed_entries, 0,
+                                  base::TimeTicks(), false);
+    base::RunLoop().RunUntilIdle();
+    EXPECT_TRUE(base::PathExists(journal_path));
+  }
+
+  // The first write of a new SimpleIndexFile is a full one.
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+  simple_index_file.WriteToDisk(entries, base::hash_set<uint64>(), 0,
+                                base::TimeTicks(), false);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(base::PathExists(simple_index_file.GetIndexFilePath()));
+  EXPECT_FALSE(base::PathExists(journal_path));
+
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(
+      Time(), GetCallback(), SimpleIndexFile::RestoredShardCallback(),
+      &load_index_result);
+  base::RunLoop().RunUntilIdle();
+  ASSERT_TRUE(callback_called());
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_EQ(3U, load_index_result.entries.size());
+}
+
+// Without an index file, the index is restored from the entry files shard by
+// shard.
+TEST_F(SimpleIndexFileTest, RestoreIndexByShard) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  const base::FilePath cache_path = cache_dir.path();
+
+  static const uint64 kHashes[] = {
+    GG_UINT64_C(0x0000000000000011),
+    GG_UINT64_C(0x7000000000000022),
+    GG_UINT64_C(0x7000000000000033),
+    GG_UINT64_C(0xf000000000000044),
+  };
+  const std::string kData = "data";
+  for (size_t i = 0; i < arraysize(kHashes); ++i) {
+    const base::FilePath entry_file =
+        simple_util::GetFilePathFromEntryHashAndFileIndex(cache_path,
+                                                          kHashes[i], 0);
+    ASSERT_TRUE(base::CreateDirectory(entry_file.DirName()));
+    ASSERT_EQ(implicit_cast<int>(kData.size()),
+              base::WriteFile(entry_file, kData.data(), kData.size()));
+  }
+
+  WrappedSimpleIndexFile simple_index_file(cache_path);
+  ASSERT_TRUE(simple_index_file.CreateIndexFileDirectory());
+  std::vector<int> restored_shards;
+  SimpleIndex::EntrySet shard_entries;
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(
+      base::Time::Now(), GetCallback(),
+      base::Bind(&SimpleIndexFileTest::OnShardRestored,
+                 base::Unretained(&restored_shards),
+                 base::Unretained(&shard_entries)),
+      &load_index_result);
+  base::RunLoop().RunUntilIdle();
+
+  ASSERT_TRUE(callback_called());
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_TRUE(load_index_result.flush_required);
+  EXPECT_EQ(static_cast<size_t>(SimpleIndex::kRestoreShardCount),
+            restored_shards.size());
+  EXPECT_EQ(arraysize(kHashes), shard_entries.size());
+  EXPECT_EQ(arraysize(kHashes), load_index_result.entries.size());
+  for (size_t i = 0; i < arraysize(kHashes); ++i) {
+    SimpleIndex::EntrySet::const_iterator it =
+        load_index_result.entries.find(kHashes[i]);
+    ASSERT_TRUE(it != load_index_result.entries.end());
+    EXPECT_EQ(implicit_cast<int>(kData.size()), it->second.GetEntrySize());
+  }
+}
+
 // Tests that after an upgrade the backend has the index file put in place.
 TEST_F(SimpleIndexFileTest, SimpleCacheUpgrade) {
   base::ScopedTempDir cache_dir;
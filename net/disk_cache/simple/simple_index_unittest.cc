@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <map>
 
 #include "base/files/scoped_temp_dir.h"
 #include "base/hash.h"
@@ -16,6 +17,7 @@
 #include "base/threading/platform_thread.h"
 #include "base/time/time.h"
 #include "net/base/cache_type.h"
+#include "net/disk_cache/simple/simple_eviction_policy.h"
 #include "net/disk_cache/simple/simple_index.h"
 #include "net/disk_cache/simple/simple_index_delegate.h"
 #include "net/disk_cache/simple/simple_index_file.h"
@@ -30,6 +32,30 @@ const base::Time kTestLastUsedTime =
     base::Time::UnixEpoch() + base::TimeDelta::FromDays(20);
 const int kTestEntrySize = 789;
 
+// An eviction policy that counts the inserts of each entry, and never evicts.
+class CountingEvictionPolicy : public SimpleEvictionPolicy {
+ public:
+  explicit CountingEvictionPolicy(std::map<uint64, int>* insert_counts)
+      : insert_counts_(insert_counts) {}
+  virtual ~CountingEvictionPolicy() {}
+
+  // SimpleEvictionPolicy implementation.
+  virtual void OnInsert(uint64 entry_hash) OVERRIDE {
+    ++(*insert_counts_)[entry_hash];
+  }
+  virtual void OnUse(uint64 entry_hash) OVERRIDE {}
+  virtual void OnRemove(uint64 entry_hash) OVERRIDE {}
+  virtual uint64 SelectEntriesToEvict(
+      const SimpleIndex::EntrySet& entries,
+      uint64 bytes_to_evict,
+      std::vector<uint64>* entry_hashes) OVERRIDE {
+    return 0;
+  }
+
+ private:
+  std::map<uint64, int>* insert_counts_;
+};
+
 }  // namespace
 
 
@@ -52,7 +78,7 @@ class MockSimpleIndexFile : public SimpleIndexFile,
                             public base::SupportsWeakPtr<MockSimpleIndexFile> {
  public:
   MockSimpleIndexFile()
-      : SimpleIndexFile(NULL, NULL, net::DISK_CACHE, base::FilePath()),
+      : SimpleIndexFile(NULL, NULL, NULL, net::DISK_CACHE, base::FilePath()),
         load_result_(NULL),
         load_index_entries_calls_(0),
         disk_writes_(0) {}
@@ -60,35 +86,48 @@ class MockSimpleIndexFile : public SimpleIndexFile,
   virtual void LoadIndexEntries(
       base::Time cache_last_modified,
       const base::Closure& callback,
+      const RestoredShardCallback& shard_callback,
       SimpleIndexLoadResult* out_load_result) OVERRIDE {
     load_callback_ = callback;
+    shard_callback_ = shard_callback;
     load_result_ = out_load_result;
     ++load_index_entries_calls_;
   }
 
   virtual void WriteToDisk(const SimpleIndex::EntrySet& entry_set,
+                           const base::hash_set<uint64>& changed_entries,
                            uint64 cache_size,
                            const base::TimeTicks& start,
                            bool app_on_background) OVERRIDE {
     disk_writes_++;
     disk_write_entry_set_ = entry_set;
+    disk_write_changed_entries_ = changed_entries;
   }
 
   void GetAndResetDiskWriteEntrySet(SimpleIndex::EntrySet* entry_set) {
     entry_set->swap(disk_write_entry_set_);
   }
 
+  const base::hash_set<uint64>& disk_write_changed_entries() const {
+    return disk_write_changed_entries_;
+  }
+
   const base::Closure& load_callback() const { return load_callback_; }
+  const RestoredShardCallback& shard_callback() const {
+    return shard_callback_;
+  }
   SimpleIndexLoadResult* load_result() const { return load_result_; }
   int load_index_entries_calls() const { return load_index_entries_calls_; }
   int disk_writes() const { return disk_writes_; }
 
  private:
   base::Closure load_callback_;
+  RestoredShardCallback shard_callback_;
   SimpleIndexLoadResult* load_result_;
   int load_index_entries_calls_;
   int disk_writes_;
   SimpleIndex::EntrySet disk_write_entry_set_;
+  base::hash_set<uint64> disk_write_changed_entries_;
 };
 
 class SimpleIndexTest  : public testing::Test, public SimpleIndexDelegate {
@@ -197,6 +236,92 @@ TEST_F(EntryMetadataTest, Serialize) {
   CheckEntryMetadataValues(new_entry_metadata);
 }
 
+TEST(EntryMetadataTableTest, InsertFindErase) {
+  EntryMetadataTable table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_TRUE(table.begin() == table.end());
+
+  // Include the zero hash, which is stored out of line.
+  const uint64 kHashes[] = { 0, 1, 17, 33, GG_UINT64_C(0xffffffffffffffff) };
+  for (size_t i = 0; i < arraysize(kHashes); ++i) {
+    EXPECT_TRUE(table.insert(std::make_pair(
+        kHashes[i], EntryMetadata(kTestLastUsedTime, i))).second);
+  }
+  EXPECT_EQ(arraysize(kHashes), table.size());
+  EXPECT_FALSE(table.insert(std::make_pair(
+      kHashes[2], EntryMetadata(kTestLastUsedTime, 100))).second);
+
+  for (size_t i = 0; i < arraysize(kHashes); ++i) {
+    EntryMetadataTable::iterator it = table.find(kHashes[i]);
+    ASSERT_TRUE(it != table.end());
+    EXPECT_EQ(kHashes[i], it->first);
+    EXPECT_EQ(static_cast<int>(i), it->second.GetEntrySize());
+  }
+  EXPECT_EQ(0U, table.count(2));
+
+  EXPECT_EQ(1U, table.erase(kHashes[0]));
+  EXPECT_EQ(0U, table.erase(kHashes[0]));
+  table.erase(table.find(kHashes[3]));
+  EXPECT_EQ(arraysize(kHashes) - 2, table.size());
+  EXPECT_EQ(0U, table.count(kHashes[0]));
+  EXPECT_EQ(0U, table.count(kHashes[3]));
+  EXPECT_EQ(1U, table.count(kHashes[1]));
+  EXPECT_EQ(1U, table.count(kHashes[2]));
+  EXPECT_EQ(1U, table.count(kHashes[4]));
+}
+
+// Grows and shrinks the table through many rehashes and backward shift
+// deletions, checking it against a reference std::map.
+TEST(EntryMetadataTableTest, MatchesReference) {
+  EntryMetadataTable table;
+  std::map<uint64, int> reference;
+  const uint64 kRange = 3000;
+  uint64 state = 1;
+  for (int i = 0; i < 50000; ++i) {
+    state = state * GG_UINT64_C(6364136223846793005) + 1;
+    const uint64 hash = (state >> 33) % kRange;
+    if ((state >> 20) % 3 == 0) {
+      EXPECT_EQ(reference.erase(hash), table.erase(hash));
+    } else {
+      const int size = static_cast<int>(hash);
+      EXPECT_EQ(reference.insert(std::make_pair(hash, size)).second,
+                table.insert(std::make_pair(
+                    hash, EntryMetadata(kTestLastUsedTime, size))).second);
+    }
+    ASSERT_EQ(reference.size(), table.size());
+  }
+
+  size_t iterated = 0;
+  const EntryMetadataTable& const_table = table;
+  for (EntryMetadataTable::const_iterator it = const_table.begin();
+       it != const_table.end(); ++it) {
+    ++iterated;
+    std::map<uint64, int>::const_iterator ref_it = reference.find(it->first);
+    ASSERT_TRUE(ref_it != reference.end());
+    EXPECT_EQ(ref_it->second, it->second.GetEntrySize());
+  }
+  EXPECT_EQ(reference.size(), iterated);
+}
+
+TEST(EntryMetadataTableTest, ReserveAndSwap) {
+  EntryMetadataTable table;
+  table.reserve(1000);
+  const size_t reserved_capacity = table.capacity();
+  for (uint64 hash = 1; hash <= 1000; ++hash)
+    table.insert(std::make_pair(hash, EntryMetadata()));
+  EXPECT_EQ(reserved_capacity, table.capacity());
+
+  EntryMetadataTable other;
+  other.swap(table);
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(1000U, other.size());
+  EXPECT_EQ(1U, other.count(500));
+
+  other.clear();
+  EXPECT_TRUE(other.empty());
+  EXPECT_TRUE(other.begin() == other.end());
+}
+
 TEST_F(SimpleIndexTest, IndexSizeCorrectOnMerge) {
   index()->SetMaxSize(100);
   index()->Insert(hashes_.at<2>());
@@ -515,6 +640,133 @@ TEST_F(SimpleIndexTest, AllInitConflicts) {
   EXPECT_EQ(100000, metadata.GetEntrySize());
 }
 
+// Lookups are answered from the index for the shards already restored from
+// the entry files, and go to the disk for the others.
+TEST_F(SimpleIndexTest, LookupsInRestoredShards) {
+  const uint64 kRestoredShardHash = (GG_UINT64_C(3) << 60) | 1;
+  const uint64 kRestoredShardMissingHash = (GG_UINT64_C(3) << 60) | 2;
+  const uint64 kRemovedHash = (GG_UINT64_C(3) << 60) | 3;
+  const uint64 kOtherShardHash = (GG_UINT64_C(5) << 60) | 1;
+  ASSERT_EQ(3, SimpleIndex::GetRestoreShard(kRestoredShardHash));
+
+  index()->Remove(kRemovedHash);
+  EXPECT_EQ(0, index()->GetRestoredShardCount());
+  EXPECT_TRUE(index()->Has(kRestoredShardMissingHash));
+
+  SimpleIndex::EntrySet shard_entries;
+  SimpleIndex::InsertInEntrySet(kRestoredShardHash,
+                                EntryMetadata(base::Time::Now(), 10),
+                                &shard_entries);
+  SimpleIndex::InsertInEntrySet(kRemovedHash,
+                                EntryMetadata(base::Time::Now(), 20),
+                                &shard_entries);
+  index_file_->shard_callback().Run(3, shard_entries);
+
+  EXPECT_FALSE(index()->initialized());
+  EXPECT_EQ(1, index()->GetRestoredShardCount());
+  EXPECT_TRUE(index()->Has(kRestoredShardHash));
+  EXPECT_FALSE(index()->Has(kRestoredShardMissingHash));
+  EXPECT_FALSE(index()->Has(kRemovedHash));
+  EXPECT_FALSE(index()->UseIfExists(kRestoredShardMissingHash));
+  EXPECT_TRUE(index()->Has(kOtherShardHash));
+  EXPECT_TRUE(index()->UseIfExists(kOtherShardHash));
+  EXPECT_EQ(10U, index()->cache_size_);
+
+  // The restored index also holds the entries of the shard.
+  InsertIntoIndexFileReturn(kRestoredShardHash, base::Time::Now(), 10);
+  InsertIntoIndexFileReturn(kRemovedHash, base::Time::Now(), 20);
+  ReturnIndexFile();
+  EXPECT_EQ(SimpleIndex::kRestoreShardCount, index()->GetRestoredShardCount());
+  EXPECT_EQ(1, index()->GetEntryCount());
+  EXPECT_EQ(10U, index()->cache_size_);
+  EXPECT_FALSE(index()->Has(kOtherShardHash));
+}
+
+// An entry created while its shard is already restored replaces the restored
+// one.
+TEST_F(SimpleIndexTest, InsertInRestoredShard) {
+  const uint64 kHash = (GG_UINT64_C(3) << 60) | 1;
+  const base::Time now = base::Time::Now();
+  const base::Time restored_last_used = now - base::TimeDelta::FromDays(2);
+
+  SimpleIndex::EntrySet shard_entries;
+  SimpleIndex::InsertInEntrySet(kHash, EntryMetadata(restored_last_used, 10),
+                                &shard_entries);
+  index_file_->shard_callback().Run(3, shard_entries);
+  EXPECT_EQ(10U, index()->cache_size_);
+
+  index()->Insert(kHash);
+  EntryMetadata metadata;
+  EXPECT_TRUE(GetEntryForTesting(kHash, &metadata));
+  EXPECT_EQ(0, metadata.GetEntrySize());
+  EXPECT_LT(now - base::TimeDelta::FromMinutes(1),
+            metadata.GetLastUsedTime());
+  EXPECT_EQ(0U, index()->cache_size_);
+
+  InsertIntoIndexFileReturn(kHash, restored_last_used, 10);
+  ReturnIndexFile();
+  EXPECT_TRUE(GetEntryForTesting(kHash, &metadata));
+  EXPECT_EQ(0, metadata.GetEntrySize());
+  EXPECT_EQ(0U, index()->cache_size_);
+}
+
+// Nothing is evicted while only part of the index has been restored.
+TEST_F(SimpleIndexTest, NoEvictionBeforeInit) {
+  const uint64 kRestoredHash = (GG_UINT64_C(3) << 60) | 1;
+  const uint64 kNewHash = (GG_UINT64_C(5) << 60) | 1;
+  const base::Time now = base::Time::Now();
+  index()->SetMaxSize(1000);
+
+  SimpleIndex::EntrySet shard_entries;
+  SimpleIndex::InsertInEntrySet(
+      kRestoredHash, EntryMetadata(now - base::TimeDelta::FromDays(2), 900),
+      &shard_entries);
+  index_file_->shard_callback().Run(3, shard_entries);
+  index()->Insert(kNewHash);
+  index()->UpdateEntrySize(kNewHash, 475);
+  EXPECT_EQ(0, doom_entries_calls());
+  EXPECT_TRUE(index()->Has(kRestoredHash));
+
+  InsertIntoIndexFileReturn(kRestoredHash,
+                            now - base::TimeDelta::FromDays(2), 900);
+  ReturnIndexFile();
+  EXPECT_EQ(0, doom_entries_calls());
+
+  // The first update after the merge starts the eviction.
+  index()->UpdateEntrySize(kNewHash, 475);
+  EXPECT_EQ(1, doom_entries_calls());
+  EXPECT_FALSE(index()->Has(kRestoredHash));
+  EXPECT_TRUE(index()->Has(kNewHash));
+}
+
+// Confirm the eviction policy is told once of each entry, whether it was
+// inserted, restored from a shard or loaded from the index file.
+TEST_F(SimpleIndexTest, EvictionPolicySeededOnMerge) {
+  std::map<uint64, int> insert_counts;
+  scoped_ptr<SimpleEvictionPolicy> policy(
+      new CountingEvictionPolicy(&insert_counts));
+  index()->SetEvictionPolicy(policy.Pass());
+
+  const base::Time now(base::Time::Now());
+  const uint64 kRestoredHash = hashes_.at<1>();
+  SimpleIndex::EntrySet shard_entries;
+  SimpleIndex::InsertInEntrySet(kRestoredHash, EntryMetadata(now, 100),
+                                &shard_entries);
+  index_file_->shard_callback().Run(
+      SimpleIndex::GetRestoreShard(kRestoredHash), shard_entries);
+  index()->Insert(hashes_.at<2>());
+
+  InsertIntoIndexFileReturn(kRestoredHash, now, 100);
+  InsertIntoIndexFileReturn(hashes_.at<2>(), now, 100);
+  InsertIntoIndexFileReturn(hashes_.at<3>(), now, 100);
+  ReturnIndexFile();
+
+  EXPECT_EQ(3u, insert_counts.size());
+  EXPECT_EQ(1, insert_counts[kRestoredHash]);
+  EXPECT_EQ(1, insert_counts[hashes_.at<2>()]);
+  EXPECT_EQ(1, insert_counts[hashes_.at<3>()]);
+}
+
 TEST_F(SimpleIndexTest, BasicEviction) {
   base::Time now(base::Time::Now());
   index()->SetMaxSize(1000);
@@ -548,6 +800,53 @@ TEST_F(SimpleIndexTest, BasicEviction) {
   ASSERT_EQ(2u, last_doom_entry_hashes().size());
 }
 
+// Confirm that the TinyLFU policy evicts a newer entry requested once rather
+// than an older one requested repeatedly.
+TEST_F(SimpleIndexTest, TinyLfuEviction) {
+  index()->SetMaxSize(1000);
+  index()->SetEvictionPolicy(
+      SimpleEvictionPolicy::Create(SimpleEvictionPolicy::TYPE_TINY_LFU));
+  ReturnIndexFile();
+
+  index()->Insert(hashes_.at<1>());
+  index()->UpdateEntrySize(hashes_.at<1>(), 200);
+  for (int i = 0; i < 3; ++i)
+    EXPECT_TRUE(index()->HitIfExists(hashes_.at<1>()));
+
+  WaitForTimeChange();
+
+  index()->Insert(hashes_.at<2>());
+  index()->UpdateEntrySize(hashes_.at<2>(), 800);
+  EXPECT_EQ(1, doom_entries_calls());
+  EXPECT_TRUE(index()->Has(hashes_.at<1>()));
+  EXPECT_FALSE(index()->Has(hashes_.at<2>()));
+  ASSERT_EQ(1u, last_doom_entry_hashes().size());
+  EXPECT_EQ(hashes_.at<2>(), last_doom_entry_hashes()[0]);
+}
+
+// Confirm that reads and writes of an open entry, which only go through
+// UseIfExists(), do not count as requests for the TinyLFU policy.
+TEST_F(SimpleIndexTest, TinyLfuIgnoresUses) {
+  index()->SetMaxSize(1000);
+  index()->SetEvictionPolicy(
+      SimpleEvictionPolicy::Create(SimpleEvictionPolicy::TYPE_TINY_LFU));
+  ReturnIndexFile();
+
+  index()->Insert(hashes_.at<1>());
+  index()->UpdateEntrySize(hashes_.at<1>(), 200);
+  for (int i = 0; i < 3; ++i)
+    EXPECT_TRUE(index()->UseIfExists(hashes_.at<1>()));
+
+  WaitForTimeChange();
+
+  index()->Insert(hashes_.at<2>());
+  index()->UpdateEntrySize(hashes_.at<2>(), 800);
+  EXPECT_EQ(1, doom_entries_calls());
+  EXPECT_FALSE(index()->Has(hashes_.at<1>()));
+  ASSERT_LE(1u, last_doom_entry_hashes().size());
+  EXPECT_EQ(hashes_.at<1>(), last_doom_entry_hashes()[0]);
+}
+
 // Confirm all the operations queue a disk write at some point in the
 // future.
 TEST_F(SimpleIndexTest, DiskWriteQueued) {
@@ -604,6 +903,34 @@ TEST_F(SimpleIndexTest, DiskWriteExecuted) {
   EXPECT_EQ(20, entry1.GetEntrySize());
 }
 
+// Only the entries changed since the previous write are reported as changed.
+TEST_F(SimpleIndexTest, DiskWriteChangedEntries) {
+  index()->SetMaxSize(1000);
+  InsertIntoIndexFileReturn(hashes_.at<1>(), base::Time::Now(), 10u);
+  InsertIntoIndexFileReturn(hashes_.at<2>(), base::Time::Now(), 10u);
+  ReturnIndexFile();
+
+  index()->Insert(hashes_.at<3>());
+  index()->WriteToDisk();
+  EXPECT_EQ(1, index_file_->disk_writes());
+  EXPECT_EQ(1U, index_file_->disk_write_changed_entries().size());
+  EXPECT_EQ(1U, index_file_->disk_write_changed_entries().count(
+      hashes_.at<3>()));
+
+  index()->UseIfExists(hashes_.at<1>());
+  index()->UpdateEntrySize(hashes_.at<1>(), 20);
+  index()->Remove(hashes_.at<2>());
+  index()->Remove(hashes_.at<4>());
+  index()->write_to_disk_timer_.Stop();
+  index()->WriteToDisk();
+  EXPECT_EQ(2, index_file_->disk_writes());
+  const base::hash_set<uint64>& changed =
+      index_file_->disk_write_changed_entries();
+  EXPECT_EQ(2U, changed.size());
+  EXPECT_EQ(1U, changed.count(hashes_.at<1>()));
+  EXPECT_EQ(1U, changed.count(hashes_.at<2>()));
+}
+
 TEST_F(SimpleIndexTest, DiskWritePostponed) {
   index()->SetMaxSize(1000);
   ReturnIndexFile();
@@ -0,0 +1,467 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_pack_store.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/stl_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/task_runner.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
+
+namespace {
+
+const char kPacksDirectory[] = "packs";
+const char kPackFileNamePrefix[] = "pack_";
+
+// The live records of the pack files being compacted are copied to this file,
+// which then becomes a pack file of its own.
+const char kCompactionFileName[] = "compaction";
+
+// Returns a record holding |data| as the packed contents of |entry_hash|.
+std::string MakeRecord(uint64 entry_hash,
+                       const std::string& data,
+                       base::Time last_modified) {
+  disk_cache::SimplePackRecordHeader header;
+  header.pack_record_magic_number = disk_cache::kSimplePackRecordMagicNumber;
+  header.entry_hash = entry_hash;
+  header.last_modified = last_modified.ToInternalValue();
+  header.data_size = data.size();
+  std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+  record.append(data);
+  return record;
+}
+
+// Reads the |size| bytes of data of the record at |offset| in |file|.
+bool ReadRecordData(base::File* file,
+                    int64 offset,
+                    int size,
+                    std::string* out_data) {
+  out_data->resize(size);
+  if (size == 0)
+    return true;
+  return file->Read(offset + sizeof(disk_cache::SimplePackRecordHeader),
+                    string_as_array(out_data), size) == size;
+}
+
+// Flags the record at |offset| in |file| as removed.
+bool FlagRecordRemoved(base::File* file, int64 offset) {
+  const uint32 flags = disk_cache::SimplePackRecordHeader::FLAG_REMOVED;
+  return file->Write(
+      offset + offsetof(disk_cache::SimplePackRecordHeader, flags),
+      reinterpret_cast<const char*>(&flags),
+      sizeof(flags)) == sizeof(flags);
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+struct SimplePackStore::PackFile {
+  PackFile() : size(0), removed_bytes(0) {}
+
+  base::File file;
+  int64 size;
+
+  // The bytes taken by the records which were removed.
+  int64 removed_bytes;
+};
+
+SimplePackStore::SimplePackStore(
+    const base::FilePath& cache_path,
+    const scoped_refptr<base::TaskRunner>& worker_pool)
+    : packs_path_(cache_path.AppendASCII(kPacksDirectory)),
+      worker_pool_(worker_pool),
+      compaction_pending_(false) {
+}
+
+SimplePackStore::~SimplePackStore() {
+  STLDeleteValues(&pack_files_);
+}
+
+bool SimplePackStore::Load() {
+  base::AutoLock auto_lock(lock_);
+  DCHECK(pack_files_.empty());
+  if (!base::DirectoryExists(packs_path_))
+    return true;
+  // Left behind by a compaction which was interrupted before it completed.
+  base::DeleteFile(packs_path_.AppendASCII(kCompactionFileName),
+                   /* recursive = */ false);
+
+  std::vector<uint32> pack_numbers;
+  base::FileEnumerator enumerator(packs_path_, /* recursive = */ false,
+                                  base::FileEnumerator::FILES);
+  for (base::FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    const std::string file_name = path.BaseName().MaybeAsASCII();
+    uint32 pack_number = 0;
+    if (!StartsWithASCII(file_name, kPackFileNamePrefix, true) ||
+        !base::HexStringToUInt(
+            base::StringPiece(file_name).substr(
+                arraysize(kPackFileNamePrefix) - 1),
+            &pack_number)) {
+      continue;
+    }
+    pack_numbers.push_back(pack_number);
+  }
+
+  // Records appended later replace the ones appended before for the same
+  // entry, so the pack files are loaded in the order they were written.
+  std::sort(pack_numbers.begin(), pack_numbers.end());
+  for (size_t i = 0; i < pack_numbers.size(); ++i) {
+    PackFile* pack_file = new PackFile();
+    pack_files_[pack_numbers[i]] = pack_file;
+    if (!LoadPackFile(pack_numbers[i], pack_file)) {
+      LOG(ERROR) << "Could not load the pack file "
+                 << GetPackFilePath(pack_numbers[i]).LossyDisplayName();
+      return false;
+    }
+  }
+  return true;
+}
+
+void SimplePackStore::GetPackedEntries(
+    std::vector<PackedEntry>* out_entries) const {
+  base::AutoLock auto_lock(lock_);
+  out_entries->reserve(out_entries->size() + entries_.size());
+  for (base::hash_map<uint64, RecordLocation>::const_iterator it =
+           entries_.begin();
+       it != entries_.end(); ++it) {
+    PackedEntry packed_entry;
+    packed_entry.entry_hash = it->first;
+    packed_entry.size = it->second.size;
+    packed_entry.last_modified = it->second.last_modified;
+    out_entries->push_back(packed_entry);
+  }
+}
+
+bool SimplePackStore::Contains(uint64 entry_hash) const {
+  base::AutoLock auto_lock(lock_);
+  return entries_.find(entry_hash) != entries_.end();
+}
+
+bool SimplePackStore::Read(uint64 entry_hash,
+                           std::string* out_data,
+                           base::Time* out_last_modified) {
+  base::AutoLock auto_lock(lock_);
+  base::hash_map<uint64, RecordLocation>::const_iterator it =
+      entries_.find(entry_hash);
+  if (it == entries_.end())
+    return false;
+  *out_last_modified = it->second.last_modified;
+  return ReadLocked(it->second, out_data);
+}
+
+bool SimplePackStore::Append(uint64 entry_hash,
+                             const std::string& data,
+                             base::Time last_modified) {
+  base::AutoLock auto_lock(lock_);
+  return AppendLocked(entry_hash, data, last_modified);
+}
+
+bool SimplePackStore::Remove(uint64 entry_hash) {
+  base::AutoLock auto_lock(lock_);
+  base::hash_map<uint64, RecordLocation>::iterator it =
+      entries_.find(entry_hash);
+  if (it == entries_.end())
+    return false;
+  const RecordLocation location = it->second;
+  entries_.erase(it);
+  RemoveLocked(location);
+  return true;
+}
+
+void SimplePackStore::Compact() {
+  // Find the records still in use in the pack files to compact. Those pack
+  // files are not appended to anymore, and only Compact() deletes them, so
+  // their records can be copied without holding |lock_|.
+  std::vector<uint32> pack_numbers;
+  std::vector<std::pair<uint64, RecordLocation> > records;
+  std::map<uint32, PackFile*> source_files;
+  {
+    base::AutoLock auto_lock(lock_);
+    for (PackFileMap::const_iterator it = pack_files_.begin();
+         it != pack_files_.end(); ++it) {
+      if (NeedsCompaction(it->first)) {
+        pack_numbers.push_back(it->first);
+        source_files[it->first] = it->second;
+      }
+    }
+    if (pack_numbers.empty()) {
+      compaction_pending_ = false;
+      return;
+    }
+    for (base::hash_map<uint64, RecordLocation>::const_iterator it =
+             entries_.begin();
+         it != entries_.end(); ++it) {
+      if (source_files.count(it->second.pack_number))
+        records.push_back(*it);
+    }
+  }
+
+  // Copy the records to the compaction file.
+  const base::FilePath compaction_path =
+      packs_path_.AppendASCII(kCompactionFileName);
+  base::File compaction_file(compaction_path,
+                             base::File::FLAG_CREATE_ALWAYS |
+                                 base::File::FLAG_READ |
+                                 base::File::FLAG_WRITE);
+  bool copied_all_records = compaction_file.IsValid();
+  std::vector<int64> new_offsets;
+  int64 compaction_file_size = 0;
+  for (size_t i = 0; copied_all_records && i < records.size(); ++i) {
+    const RecordLocation& location = records[i].second;
+    std::string data;
+    if (!ReadRecordData(&source_files[location.pack_number]->file,
+                        location.offset, location.size, &data)) {
+      copied_all_records = false;
+      break;
+    }
+    const std::string record =
+        MakeRecord(records[i].first, data, location.last_modified);
+    if (compaction_file.Write(compaction_file_size, record.data(),
+                              record.size()) !=
+        implicit_cast<int>(record.size())) {
+      copied_all_records = false;
+      break;
+    }
+    new_offsets.push_back(compaction_file_size);
+    compaction_file_size += record.size();
+  }
+
+  base::AutoLock auto_lock(lock_);
+  compaction_pending_ = false;
+
+  // The records removed or appended again while they were being copied must
+  // not come back once the compaction file is a pack file, even if the cache
+  // stops before the pack files it replaces are deleted.
+  std::vector<bool> moved(records.size(), false);
+  int64 removed_bytes = 0;
+  for (size_t i = 0; copied_all_records && i < records.size(); ++i) {
+    base::hash_map<uint64, RecordLocation>::const_iterator it =
+        entries_.find(records[i].first);
+    moved[i] = it != entries_.end() &&
+        it->second.pack_number == records[i].second.pack_number &&
+        it->second.offset == records[i].second.offset;
+    if (moved[i])
+      continue;
+    if (!FlagRecordRemoved(&compaction_file, new_offsets[i]))
+      copied_all_records = false;
+    removed_bytes += sizeof(SimplePackRecordHeader) + records[i].second.size;
+  }
+
+  // Pack files are loaded in the order they were written, and the moved
+  // records are the latest ones of their entries, so the compaction file goes
+  // after all the other pack files.
+  const uint32 pack_number = pack_files_.rbegin()->first + 1;
+  if (copied_all_records && !records.empty() &&
+      !base::ReplaceFile(compaction_path, GetPackFilePath(pack_number),
+                         NULL)) {
+    copied_all_records = false;
+  }
+  if (!copied_all_records || records.empty()) {
+    compaction_file.Close();
+    base::DeleteFile(compaction_path, /* recursive = */ false);
+  }
+  if (!copied_all_records) {
+    LOG(WARNING) << "Could not compact the pack files";
+    return;
+  }
+
+  if (!records.empty()) {
+    PackFile* pack_file = new PackFile();
+    pack_file->file = compaction_file.Pass();
+    pack_file->size = compaction_file_size;
+    pack_file->removed_bytes = removed_bytes;
+    pack_files_[pack_number] = pack_file;
+    for (size_t i = 0; i < records.size(); ++i) {
+      if (!moved[i])
+        continue;
+      RecordLocation* location = &entries_[records[i].first];
+      location->pack_number = pack_number;
+      location->offset = new_offsets[i];
+    }
+  }
+
+  for (size_t i = 0; i < pack_numbers.size(); ++i) {
+    PackFileMap::iterator pack_it = pack_files_.find(pack_numbers[i]);
+    delete pack_it->second;
+    pack_files_.erase(pack_it);
+    base::DeleteFile(GetPackFilePath(pack_numbers[i]),
+                     /* recursive = */ false);
+  }
+}
+
+base::FilePath SimplePackStore::GetPackFilePath(uint32 pack_number) const {
+  return packs_path_.AppendASCII(
+      base::StringPrintf("%s%08x", kPackFileNamePrefix, pack_number));
+}
+
+bool SimplePackStore::LoadPackFile(uint32 pack_number, PackFile* pack_file) {
+  pack_file->file.Initialize(GetPackFilePath(pack_number),
+                             base::File::FLAG_OPEN | base::File::FLAG_READ |
+                                 base::File::FLAG_WRITE);
+  if (!pack_file->file.IsValid())
+    return false;
+  const int64 file_length = pack_file->file.GetLength();
+  if (file_length < 0)
+    return false;
+
+  int64 offset = 0;
+  while (offset + implicit_cast<int64>(sizeof(SimplePackRecordHeader)) <=
+         file_length) {
+    SimplePackRecordHeader header;
+    if (pack_file->file.Read(offset, reinterpret_cast<char*>(&header),
+                             sizeof(header)) != sizeof(header) ||
+        header.pack_record_magic_number != kSimplePackRecordMagicNumber) {
+      break;
+    }
+    const int64 record_size = sizeof(header) + header.data_size;
+    if (offset + record_size > file_length)
+      break;
+
+    if (header.flags & SimplePackRecordHeader::FLAG_REMOVED) {
+      pack_file->removed_bytes += record_size;
+    } else {
+      RecordLocation location;
+      location.pack_number = pack_number;
+      location.offset = offset;
+      location.size = header.data_size;
+      location.last_modified =
+          base::Time::FromInternalValue(header.last_modified);
+      std::pair<base::hash_map<uint64, RecordLocation>::iterator, bool>
+          insert_result = entries_.insert(
+              std::make_pair(header.entry_hash, location));
+      if (!insert_result.second) {
+        // The record was appended again, but flagging the previous one as
+        // removed was interrupted.
+        const RecordLocation previous_location = insert_result.first->second;
+        insert_result.first->second = location;
+        RemoveLocked(previous_location);
+      }
+    }
+    offset += record_size;
+  }
+
+  if (offset < file_length) {
+    // Drop the record which was being appended when the cache was last used.
+    LOG(WARNING) << "Truncating a torn record in the pack file "
+                 << GetPackFilePath(pack_number).LossyDisplayName();
+    pack_file->file.SetLength(offset);
+  }
+  pack_file->size = offset;
+  return true;
+}
+
+SimplePackStore::PackFile* SimplePackStore::GetPackFileForAppend(
+    uint32* out_pack_number) {
+  uint32 pack_number = 0;
+  if (!pack_files_.empty()) {
+    PackFileMap::reverse_iterator last = pack_files_.rbegin();
+    if (last->second->size < kMaxPackFileSize) {
+      *out_pack_number = last->first;
+      return last->second;
+    }
+    pack_number = last->first + 1;
+  }
+
+  if (!base::CreateDirectory(packs_path_))
+    return NULL;
+  scoped_ptr<PackFile> pack_file(new PackFile());
+  pack_file->file.Initialize(GetPackFilePath(pack_number),
+                             base::File::FLAG_CREATE_ALWAYS |
+                                 base::File::FLAG_READ |
+                                 base::File::FLAG_WRITE);
+  if (!pack_file->file.IsValid())
+    return NULL;
+  *out_pack_number = pack_number;
+  pack_files_[pack_number] = pack_file.get();
+  return pack_file.release();
+}
+
+bool SimplePackStore::AppendLocked(uint64 entry_hash,
+                                   const std::string& data,
+                                   base::Time last_modified) {
+  lock_.AssertAcquired();
+  uint32 pack_number = 0;
+  PackFile* pack_file = GetPackFileForAppend(&pack_number);
+  if (!pack_file)
+    return false;
+
+  const std::string record = MakeRecord(entry_hash, data, last_modified);
+  if (pack_file->file.Write(pack_file->size, record.data(), record.size()) !=
+      implicit_cast<int>(record.size())) {
+    pack_file->file.SetLength(pack_file->size);
+    return false;
+  }
+
+  RecordLocation location;
+  location.pack_number = pack_number;
+  location.offset = pack_file->size;
+  location.size = data.size();
+  location.last_modified = last_modified;
+  pack_file->size += record.size();
+
+  std::pair<base::hash_map<uint64, RecordLocation>::iterator, bool>
+      insert_result = entries_.insert(std::make_pair(entry_hash, location));
+  if (!insert_result.second) {
+    const RecordLocation previous_location = insert_result.first->second;
+    insert_result.first->second = location;
+    RemoveLocked(previous_location);
+  }
+  return true;
+}
+
+bool SimplePackStore::ReadLocked(const RecordLocation& location,
+                                 std::string* out_data) {
+  lock_.AssertAcquired();
+  PackFileMap::iterator it = pack_files_.find(location.pack_number);
+  DCHECK(it != pack_files_.end());
+  return ReadRecordData(&it->second->file, location.offset, location.size,
+                        out_data);
+}
+
+void SimplePackStore::RemoveLocked(const RecordLocation& location) {
+  lock_.AssertAcquired();
+  PackFileMap::iterator it = pack_files_.find(location.pack_number);
+  DCHECK(it != pack_files_.end());
+  PackFile* pack_file = it->second;
+  if (!FlagRecordRemoved(&pack_file->file, location.offset)) {
+    LOG(WARNING) << "Could not flag a removed record in the pack file "
+                 << GetPackFilePath(location.pack_number).LossyDisplayName();
+  }
+  pack_file->removed_bytes +=
+      sizeof(SimplePackRecordHeader) + location.size;
+  MaybeScheduleCompaction(location.pack_number);
+}
+
+bool SimplePackStore::NeedsCompaction(uint32 pack_number) const {
+  lock_.AssertAcquired();
+  PackFileMap::const_iterator it = pack_files_.find(pack_number);
+  if (it == pack_files_.end() || pack_number == pack_files_.rbegin()->first)
+    return false;
+  return it->second->removed_bytes * 2 >= it->second->size;
+}
+
+void SimplePackStore::MaybeScheduleCompaction(uint32 pack_number) {
+  lock_.AssertAcquired();
+  if (compaction_pending_ || !NeedsCompaction(pack_number))
+    return;
+  compaction_pending_ = true;
+  worker_pool_->PostTask(FROM_HERE,
+                         base::Bind(&SimplePackStore::Compact, this));
+}
+
+}  // namespace disk_cache
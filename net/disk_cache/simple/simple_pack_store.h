@@ -0,0 +1,139 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_PACK_STORE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_PACK_STORE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/files/file_path.h"
+#include "base/gtest_prod_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class TaskRunner;
+}
+
+namespace disk_cache {
+
+// Keeps small entries of the Simple cache packed together in shared pack
+// files, so they cost neither an inode nor an open and a close of their own.
+// A packed entry is stored as the exact contents its file 0 would have, see
+// simple_entry_format.h. Pack files are only ever appended to: removing an
+// entry flags its record, and the pack files made mostly of removed records
+// are compacted on the worker pool.
+//
+// All methods perform blocking IO and may be called from any thread but the
+// IO thread.
+class NET_EXPORT_PRIVATE SimplePackStore
+    : public base::RefCountedThreadSafe<SimplePackStore> {
+ public:
+  // Entries whose file 0 holds at most this many bytes, and which have no other
+  // files, are packed when they are closed.
+  static const int kMaxPackedEntrySize = 16 * 1024;
+
+  // Records are appended to a new pack file once the last one grows past this
+  // size.
+  static const int64 kMaxPackFileSize = 4 * 1024 * 1024;
+
+  struct PackedEntry {
+    uint64 entry_hash;
+    int size;
+    base::Time last_modified;
+  };
+
+  SimplePackStore(const base::FilePath& cache_path,
+                  const scoped_refptr<base::TaskRunner>& worker_pool);
+
+  // Reads the records of the pack files already on disk. Must be called before
+  // any entry of the cache is opened.
+  bool Load();
+
+  // Fills |out_entries| with all the entries currently packed.
+  void GetPackedEntries(std::vector<PackedEntry>* out_entries) const;
+
+  // Returns whether the entry |entry_hash| is packed.
+  bool Contains(uint64 entry_hash) const;
+
+  // Reads the packed contents of the entry |entry_hash| into |out_data|.
+  // Returns false if the entry is not packed or cannot be read.
+  bool Read(uint64 entry_hash,
+            std::string* out_data,
+            base::Time* out_last_modified);
+
+  // Packs |data| as the contents of the entry |entry_hash|, replacing the
+  // contents packed previously, if any.
+  bool Append(uint64 entry_hash,
+              const std::string& data,
+              base::Time last_modified);
+
+  // Removes the entry |entry_hash|. Returns whether it was packed.
+  bool Remove(uint64 entry_hash);
+
+  // Moves the records still in use out of the pack files that are mostly made
+  // of removed records, then deletes those files. The records are copied to a
+  // new pack file without holding the lock, so the other methods are not
+  // blocked for the duration of the copy.
+  void Compact();
+
+ private:
+  friend class base::RefCountedThreadSafe<SimplePackStore>;
+  FRIEND_TEST_ALL_PREFIXES(SimplePackStoreTest, CompactRemovedRecords);
+
+  struct PackFile;
+
+  struct RecordLocation {
+    uint32 pack_number;
+    int64 offset;
+    int size;
+    base::Time last_modified;
+  };
+
+  typedef std::map<uint32, PackFile*> PackFileMap;
+
+  ~SimplePackStore();
+
+  base::FilePath GetPackFilePath(uint32 pack_number) const;
+
+  // Reads the records of one pack file, dropping any torn record at its end.
+  bool LoadPackFile(uint32 pack_number, PackFile* pack_file);
+
+  // Returns the pack file new records go to, starting a new one if needed, and
+  // sets |out_pack_number| to its number. Returns NULL on failure.
+  PackFile* GetPackFileForAppend(uint32* out_pack_number);
+
+  bool AppendLocked(uint64 entry_hash,
+                    const std::string& data,
+                    base::Time last_modified);
+  bool ReadLocked(const RecordLocation& location, std::string* out_data);
+  void RemoveLocked(const RecordLocation& location);
+
+  // Returns whether the pack file |pack_number| is mostly made of removed
+  // records, and is not being appended to.
+  bool NeedsCompaction(uint32 pack_number) const;
+  void MaybeScheduleCompaction(uint32 pack_number);
+
+  const base::FilePath packs_path_;
+  const scoped_refptr<base::TaskRunner> worker_pool_;
+
+  // Guards all the members below.
+  mutable base::Lock lock_;
+
+  base::hash_map<uint64, RecordLocation> entries_;
+  PackFileMap pack_files_;
+  bool compaction_pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimplePackStore);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_PACK_STORE_H_
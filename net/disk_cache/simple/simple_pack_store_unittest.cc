@@ -0,0 +1,210 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_pack_store.h"
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/test/test_simple_task_runner.h"
+#include "base/time/time.h"
+#include "net/base/cache_type.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/simple/simple_synchronous_entry.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+class SimplePackStoreTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(cache_dir_.CreateUniqueTempDir());
+    task_runner_ = new base::TestSimpleTaskRunner();
+  }
+
+  scoped_refptr<SimplePackStore> CreatePackStore() {
+    scoped_refptr<SimplePackStore> pack_store(
+        new SimplePackStore(cache_dir_.path(), task_runner_));
+    EXPECT_TRUE(pack_store->Load());
+    return pack_store;
+  }
+
+  base::ScopedTempDir cache_dir_;
+  scoped_refptr<base::TestSimpleTaskRunner> task_runner_;
+};
+
+TEST_F(SimplePackStoreTest, AppendReadRemove) {
+  scoped_refptr<SimplePackStore> pack_store = CreatePackStore();
+  const base::Time now = base::Time::Now();
+
+  std::string data;
+  base::Time last_modified;
+  EXPECT_FALSE(pack_store->Read(1, &data, &last_modified));
+
+  ASSERT_TRUE(pack_store->Append(1, "first entry", now));
+  ASSERT_TRUE(pack_store->Append(2, "second entry", now));
+  ASSERT_TRUE(pack_store->Read(1, &data, &last_modified));
+  EXPECT_EQ("first entry", data);
+  EXPECT_EQ(now, last_modified);
+
+  // Appending again replaces the packed contents.
+  ASSERT_TRUE(pack_store->Append(1, "updated", now));
+  ASSERT_TRUE(pack_store->Read(1, &data, &last_modified));
+  EXPECT_EQ("updated", data);
+
+  EXPECT_TRUE(pack_store->Remove(1));
+  EXPECT_FALSE(pack_store->Remove(1));
+  EXPECT_FALSE(pack_store->Read(1, &data, &last_modified));
+  ASSERT_TRUE(pack_store->Read(2, &data, &last_modified));
+  EXPECT_EQ("second entry", data);
+
+  std::vector<SimplePackStore::PackedEntry> packed_entries;
+  pack_store->GetPackedEntries(&packed_entries);
+  ASSERT_EQ(1U, packed_entries.size());
+  EXPECT_EQ(2U, packed_entries[0].entry_hash);
+  EXPECT_EQ(static_cast<int>(data.size()), packed_entries[0].size);
+}
+
+TEST_F(SimplePackStoreTest, LoadAfterReopen) {
+  const base::Time now = base::Time::Now();
+  {
+    scoped_refptr<SimplePackStore> pack_store = CreatePackStore();
+    ASSERT_TRUE(pack_store->Append(1, "removed", now));
+    ASSERT_TRUE(pack_store->Append(2, "replaced", now));
+    ASSERT_TRUE(pack_store->Append(2, "kept", now));
+    ASSERT_TRUE(pack_store->Remove(1));
+  }
+
+  // A record torn by a crash while it was appended is dropped.
+  const base::FilePath pack_file_path =
+      cache_dir_.path().AppendASCII("packs").AppendASCII("pack_00000000");
+  {
+    base::File pack_file(pack_file_path,
+                         base::File::FLAG_OPEN | base::File::FLAG_APPEND);
+    ASSERT_TRUE(pack_file.IsValid());
+    const char kTornRecord[] = "torn";
+    ASSERT_EQ(4, pack_file.WriteAtCurrentPos(kTornRecord, 4));
+  }
+
+  scoped_refptr<SimplePackStore> pack_store = CreatePackStore();
+  std::string data;
+  base::Time last_modified;
+  EXPECT_FALSE(pack_store->Read(1, &data, &last_modified));
+  ASSERT_TRUE(pack_store->Read(2, &data, &last_modified));
+  EXPECT_EQ("kept", data);
+  EXPECT_EQ(now, last_modified);
+
+  // New records go after the dropped one.
+  ASSERT_TRUE(pack_store->Append(3, "appended", now));
+  pack_store = CreatePackStore();
+  ASSERT_TRUE(pack_store->Read(3, &data, &last_modified));
+  EXPECT_EQ("appended", data);
+}
+
+TEST_F(SimplePackStoreTest, CompactRemovedRecords) {
+  scoped_refptr<SimplePackStore> pack_store = CreatePackStore();
+  const base::Time now = base::Time::Now();
+  const std::string data(SimplePackStore::kMaxPackedEntrySize, 'x');
+
+  // Fill the first pack file, so that the next record starts a second one.
+  uint64 entry_hash = 1;
+  while (pack_store->pack_files_.size() < 2)
+    ASSERT_TRUE(pack_store->Append(entry_hash++, data, now));
+  const uint64 entries_in_first_pack = entry_hash - 2;
+
+  // Removing most records of the first pack file schedules its compaction.
+  for (uint64 i = 2; i <= entries_in_first_pack; ++i)
+    ASSERT_TRUE(pack_store->Remove(i));
+  EXPECT_TRUE(task_runner_->HasPendingTask());
+  task_runner_->RunPendingTasks();
+  EXPECT_FALSE(task_runner_->HasPendingTask());
+
+  EXPECT_EQ(0U, pack_store->pack_files_.count(0));
+  std::string read_data;
+  base::Time last_modified;
+  ASSERT_TRUE(pack_store->Read(1, &read_data, &last_modified));
+  EXPECT_EQ(data, read_data);
+
+  pack_store = CreatePackStore();
+  ASSERT_TRUE(pack_store->Read(1, &read_data, &last_modified));
+  EXPECT_EQ(data, read_data);
+  ASSERT_TRUE(pack_store->Read(entry_hash - 1, &read_data, &last_modified));
+  EXPECT_FALSE(pack_store->Read(2, &read_data, &last_modified));
+}
+
+// A compaction file left behind by an interrupted compaction is not loaded as
+// a pack file.
+TEST_F(SimplePackStoreTest, InterruptedCompaction) {
+  scoped_refptr<SimplePackStore> pack_store = CreatePackStore();
+  ASSERT_TRUE(pack_store->Append(1, "data", base::Time::Now()));
+  pack_store = NULL;
+
+  const base::FilePath compaction_path =
+      cache_dir_.path().AppendASCII("packs").AppendASCII("compaction");
+  const char kCompactionData[] = "torn";
+  ASSERT_EQ(static_cast<int>(sizeof(kCompactionData)),
+            base::WriteFile(compaction_path, kCompactionData,
+                            sizeof(kCompactionData)));
+
+  pack_store = CreatePackStore();
+  EXPECT_FALSE(base::PathExists(compaction_path));
+  std::string data;
+  base::Time last_modified;
+  ASSERT_TRUE(pack_store->Read(1, &data, &last_modified));
+  EXPECT_EQ("data", data);
+}
+
+// Creating an entry over a packed one fails, as over the files of an entry,
+// rather than leaving the packed entry to hide the new one on the next open.
+TEST_F(SimplePackStoreTest, CreateOverPackedEntry) {
+  scoped_refptr<SimplePackStore> pack_store = CreatePackStore();
+  const std::string key("http://www.example.com/packed");
+  const uint64 entry_hash = simple_util::GetEntryHashKey(key);
+  const int32 data_size[] = { 0, 0, 0 };
+  const SimpleEntryStat entry_stat(base::Time(), base::Time(), data_size, 0);
+
+  SimpleEntryCreationResults create_results(entry_stat);
+  SimpleSynchronousEntry::CreateEntry(net::DISK_CACHE, cache_dir_.path(),
+                                      pack_store, key, entry_hash, false,
+                                      &create_results);
+  ASSERT_EQ(net::OK, create_results.result);
+  scoped_ptr<std::vector<SimpleSynchronousEntry::CRCRecord> > crc32s(
+      new std::vector<SimpleSynchronousEntry::CRCRecord>());
+  crc32s->push_back(SimpleSynchronousEntry::CRCRecord(0, false, 0));
+  crc32s->push_back(SimpleSynchronousEntry::CRCRecord(1, false, 0));
+  scoped_refptr<net::GrowableIOBuffer> stream_0_data(
+      new net::GrowableIOBuffer());
+  create_results.sync_entry->Close(create_results.entry_stat, crc32s.Pass(),
+                                   stream_0_data.get(), false);
+  ASSERT_TRUE(pack_store->Contains(entry_hash));
+
+  SimpleEntryCreationResults recreate_results(entry_stat);
+  SimpleSynchronousEntry::CreateEntry(net::DISK_CACHE, cache_dir_.path(),
+                                      pack_store, key, entry_hash, false,
+                                      &recreate_results);
+  EXPECT_EQ(net::ERR_FILE_EXISTS, recreate_results.result);
+  EXPECT_TRUE(pack_store->Contains(entry_hash));
+
+  SimpleEntryCreationResults open_results(entry_stat);
+  SimpleSynchronousEntry::OpenEntry(net::DISK_CACHE, cache_dir_.path(),
+                                    pack_store, entry_hash, false,
+                                    &open_results);
+  ASSERT_EQ(net::OK, open_results.result);
+  EXPECT_EQ(key, open_results.sync_entry->key());
+  open_results.sync_entry->Close(
+      open_results.entry_stat,
+      make_scoped_ptr(new std::vector<SimpleSynchronousEntry::CRCRecord>()),
+      open_results.stream_0_data.get(), false);
+}
+
+}  // namespace disk_cache
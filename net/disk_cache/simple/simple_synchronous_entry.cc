@@ -6,7 +6,6 @@
 
 #include <algorithm>
 #include <cstring>
-#include <functional>
 #include <limits>
 
 #include "base/basictypes.h"
@@ -15,11 +14,13 @@
 #include "base/hash.h"
 #include "base/location.h"
 #include "base/sha1.h"
+#include "base/stl_util.h"
 #include "base/strings/stringprintf.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/simple/simple_backend_version.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
+#include "net/disk_cache/simple/simple_pack_store.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
 
@@ -52,6 +53,7 @@ enum WriteResult {
   WRITE_RESULT_LAZY_STREAM_ENTRY_DOOMED,
   WRITE_RESULT_LAZY_CREATE_FAILURE,
   WRITE_RESULT_LAZY_INITIALIZE_FAILURE,
+  WRITE_RESULT_UNPACK_FAILURE,
   WRITE_RESULT_MAX,
 };
 
@@ -109,13 +111,28 @@ bool CanOmitEmptyFile(int file_index) {
   return file_index == disk_cache::simple_util::GetFileIndexFromStreamIndex(2);
 }
 
+// Creates the new file |filename| in |file|. The entry subdirectories are
+// created on demand, so the first file created in one has to create it too.
+void CreateFileInEntryDirectory(const base::FilePath& filename,
+                                base::File* file) {
+  const int flags = base::File::FLAG_CREATE | base::File::FLAG_READ |
+                    base::File::FLAG_WRITE;
+  file->Initialize(filename, flags);
+  if (file->IsValid() ||
+      file->error_details() != base::File::FILE_ERROR_NOT_FOUND ||
+      !base::CreateDirectory(filename.DirName())) {
+    return;
+  }
+  file->Initialize(filename, flags);
+}
+
 }  // namespace
 
 namespace disk_cache {
 
 using simple_util::GetEntryHashKey;
-using simple_util::GetFilenameFromEntryHashAndFileIndex;
-using simple_util::GetSparseFilenameFromEntryHash;
+using simple_util::GetFilePathFromEntryHashAndFileIndex;
+using simple_util::GetSparseFilePathFromEntryHash;
 using simple_util::GetDataSizeFromKeyAndFileSize;
 using simple_util::GetFileSizeFromKeyAndDataSize;
 using simple_util::GetFileIndexFromStreamIndex;
@@ -211,11 +228,12 @@ SimpleSynchronousEntry::EntryOperationData::EntryOperationData(
 void SimpleSynchronousEntry::OpenEntry(
     net::CacheType cache_type,
     const FilePath& path,
+    const scoped_refptr<SimplePackStore>& pack_store,
     const uint64 entry_hash,
     bool had_index,
     SimpleEntryCreationResults *out_results) {
   SimpleSynchronousEntry* sync_entry =
-      new SimpleSynchronousEntry(cache_type, path, "", entry_hash);
+      new SimpleSynchronousEntry(cache_type, path, pack_store, "", entry_hash);
   out_results->result =
       sync_entry->InitializeForOpen(had_index,
                                     &out_results->entry_stat,
@@ -235,13 +253,14 @@ void SimpleSynchronousEntry::OpenEntry(
 void SimpleSynchronousEntry::CreateEntry(
     net::CacheType cache_type,
     const FilePath& path,
+    const scoped_refptr<SimplePackStore>& pack_store,
     const std::string& key,
     const uint64 entry_hash,
     bool had_index,
     SimpleEntryCreationResults *out_results) {
   DCHECK_EQ(entry_hash, GetEntryHashKey(key));
   SimpleSynchronousEntry* sync_entry =
-      new SimpleSynchronousEntry(cache_type, path, key, entry_hash);
+      new SimpleSynchronousEntry(cache_type, path, pack_store, key, entry_hash);
   out_results->result = sync_entry->InitializeForCreate(
       had_index, &out_results->entry_stat);
   if (out_results->result != net::OK) {
@@ -257,18 +276,24 @@ void SimpleSynchronousEntry::CreateEntry(
 // static
 int SimpleSynchronousEntry::DoomEntry(
     const FilePath& path,
+    const scoped_refptr<SimplePackStore>& pack_store,
     uint64 entry_hash) {
-  const bool deleted_well = DeleteFilesForEntryHash(path, entry_hash);
+  const bool deleted_well =
+      DeleteFilesForEntryHash(path, pack_store, entry_hash);
   return deleted_well ? net::OK : net::ERR_FAILED;
 }
 
 // static
 int SimpleSynchronousEntry::DoomEntrySet(
     const std::vector<uint64>* key_hashes,
-    const FilePath& path) {
-  const size_t did_delete_count = std::count_if(
-      key_hashes->begin(), key_hashes->end(), std::bind1st(
-          std::ptr_fun(SimpleSynchronousEntry::DeleteFilesForEntryHash), path));
+    const FilePath& path,
+    const scoped_refptr<SimplePackStore>& pack_store) {
+  size_t did_delete_count = 0;
+  for (std::vector<uint64>::const_iterator it = key_hashes->begin();
+       it != key_hashes->end(); ++it) {
+    if (DeleteFilesForEntryHash(path, pack_store, *it))
+      ++did_delete_count;
+  }
   return (did_delete_count == key_hashes->size()) ? net::OK : net::ERR_FAILED;
 }
 
@@ -286,9 +311,8 @@ void SimpleSynchronousEntry::ReadData(const EntryOperationData& in_entry_op,
   // be handled in the SimpleEntryImpl.
   DCHECK_LT(0, in_entry_op.buf_len);
   DCHECK(!empty_file_omitted_[file_index]);
-  File* file = const_cast<File*>(&files_[file_index]);
-  int bytes_read =
-      file->Read(file_offset, out_buf->data(), in_entry_op.buf_len);
+  int bytes_read = ReadFromFile(
+      file_index, file_offset, out_buf->data(), in_entry_op.buf_len);
   if (bytes_read > 0) {
     entry_stat->set_last_used(Time::Now());
     *out_crc32 = crc32(crc32(0L, Z_NULL, 0),
@@ -319,6 +343,13 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
       key_, in_entry_op.offset, in_entry_op.index);
   bool extending_by_write = offset + buf_len > out_entry_stat->data_size(index);
 
+  if (!Unpack()) {
+    RecordWriteResult(cache_type_, WRITE_RESULT_UNPACK_FAILURE);
+    Doom();
+    *out_result = net::ERR_CACHE_WRITE_FAILURE;
+    return;
+  }
+
   if (empty_file_omitted_[file_index]) {
     // Don't create a new file if the entry has been doomed, to avoid it being
     // mixed up with a newly-created entry with the same key.
@@ -464,6 +495,14 @@ void SimpleSynchronousEntry::WriteSparseData(
   int written_so_far = 0;
   int appended_so_far = 0;
 
+  // Packed entries have no sparse data, see MaybePack().
+  if (!Unpack()) {
+    RecordWriteResult(cache_type_, WRITE_RESULT_UNPACK_FAILURE);
+    Doom();
+    *out_result = net::ERR_CACHE_WRITE_FAILURE;
+    return;
+  }
+
   if (!sparse_file_open() && !CreateSparseFile()) {
     *out_result = net::ERR_CACHE_WRITE_FAILURE;
     return;
@@ -621,8 +660,28 @@ void SimpleSynchronousEntry::CheckEOFRecord(int index,
 void SimpleSynchronousEntry::Close(
     const SimpleEntryStat& entry_stat,
     scoped_ptr<std::vector<CRCRecord> > crc32s_to_write,
-    net::GrowableIOBuffer* stream_0_data) {
+    net::GrowableIOBuffer* stream_0_data,
+    bool doomed) {
   DCHECK(stream_0_data);
+  if (packed_) {
+    // Only stream 0 can have been written, the other writes unpack the entry.
+    // It is rewritten the usual way, and packed again below.
+    CloseResult result = CLOSE_RESULT_SUCCESS;
+    bool close_done = doomed || crc32s_to_write->empty();
+    if (!close_done && !Unpack()) {
+      DVLOG(1) << "Could not unpack entry.";
+      Doom();
+      result = CLOSE_RESULT_WRITE_FAILURE;
+      close_done = true;
+    }
+    if (close_done) {
+      RecordCloseResult(cache_type_, result);
+      have_open_files_ = false;
+      delete this;
+      return;
+    }
+  }
+
   // Write stream 0 data.
   int stream_0_offset = entry_stat.GetOffsetInFile(key_, 0, 0);
   if (files_[0].Write(stream_0_offset, stream_0_data->data(),
@@ -631,6 +690,7 @@ void SimpleSynchronousEntry::Close(
     RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
     DVLOG(1) << "Could not write stream 0 data.";
     Doom();
+    doomed = true;
   }
 
   for (std::vector<CRCRecord>::const_iterator it = crc32s_to_write->begin();
@@ -656,6 +716,7 @@ void SimpleSynchronousEntry::Close(
       RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
       DVLOG(1) << "Could not truncate stream 0 file.";
       Doom();
+      doomed = true;
       break;
     }
     if (files_[file_index].Write(eof_offset,
@@ -665,9 +726,11 @@ void SimpleSynchronousEntry::Close(
       RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
       DVLOG(1) << "Could not write eof record.";
       Doom();
+      doomed = true;
       break;
     }
   }
+  const bool packed_on_close = !doomed && MaybePack(entry_stat);
   for (int i = 0; i < kSimpleEntryFileCount; ++i) {
     if (empty_file_omitted_[i])
       continue;
@@ -686,6 +749,9 @@ void SimpleSynchronousEntry::Close(
   if (sparse_file_open())
     sparse_file_.Close();
 
+  if (packed_on_close)
+    DeleteFileForEntryHash(path_, entry_hash_, 0);
+
   if (files_created_) {
     const int stream2_file_index = GetFileIndexFromStreamIndex(2);
     SIMPLE_CACHE_UMA(BOOLEAN, "EntryCreatedAndStream2Omitted", cache_type_,
@@ -696,16 +762,20 @@ void SimpleSynchronousEntry::Close(
   delete this;
 }
 
-SimpleSynchronousEntry::SimpleSynchronousEntry(net::CacheType cache_type,
-                                               const FilePath& path,
-                                               const std::string& key,
-                                               const uint64 entry_hash)
+SimpleSynchronousEntry::SimpleSynchronousEntry(
+    net::CacheType cache_type,
+    const FilePath& path,
+    const scoped_refptr<SimplePackStore>& pack_store,
+    const std::string& key,
+    const uint64 entry_hash)
     : cache_type_(cache_type),
       path_(path),
+      pack_store_(pack_store),
       entry_hash_(entry_hash),
       key_(key),
       have_open_files_(false),
-      initialized_(false) {
+      initialized_(false),
+      packed_(false) {
   for (int i = 0; i < kSimpleEntryFileCount; ++i)
     empty_file_omitted_[i] = false;
 }
@@ -747,8 +817,7 @@ bool SimpleSynchronousEntry::MaybeCreateFile(
   }
 
   FilePath filename = GetFilenameFromFileIndex(file_index);
-  int flags = File::FLAG_CREATE | File::FLAG_READ | File::FLAG_WRITE;
-  files_[file_index].Initialize(filename, flags);
+  CreateFileInEntryDirectory(filename, &files_[file_index]);
   *out_error = files_[file_index].error_details();
 
   empty_file_omitted_[file_index] = false;
@@ -836,9 +905,96 @@ bool SimpleSynchronousEntry::OpenFiles(
   return true;
 }
 
+bool SimpleSynchronousEntry::OpenPackedFile(SimpleEntryStat* out_entry_stat) {
+  base::Time last_modified;
+  if (!pack_store_.get() ||
+      !pack_store_->Read(entry_hash_, &packed_data_, &last_modified)) {
+    return false;
+  }
+  packed_ = true;
+  have_open_files_ = true;
+  empty_file_omitted_[GetFileIndexFromStreamIndex(2)] = true;
+
+  out_entry_stat->set_last_used(base::Time::Now());
+  out_entry_stat->set_last_modified(last_modified);
+  // As in OpenFiles(), the size of file 0 is kept in |data_size(1)| until the
+  // key is read.
+  out_entry_stat->set_data_size(1, packed_data_.size());
+  out_entry_stat->set_data_size(2, 0);
+  files_created_ = false;
+  return true;
+}
+
+bool SimpleSynchronousEntry::Unpack() {
+  if (!packed_)
+    return true;
+  DCHECK(pack_store_.get());
+  // The entry leaves the pack store first, so it is never found in both.
+  pack_store_->Remove(entry_hash_);
+  packed_ = false;
+
+  File::Error error;
+  if (!MaybeCreateFile(0, FILE_REQUIRED, &error)) {
+    DLOG(WARNING) << "Could not create the file of a packed entry.";
+    return false;
+  }
+  const int packed_size = packed_data_.size();
+  if (files_[0].Write(0, packed_data_.data(), packed_size) != packed_size) {
+    DLOG(WARNING) << "Could not write the file of a packed entry.";
+    return false;
+  }
+  packed_data_.clear();
+  return true;
+}
+
+bool SimpleSynchronousEntry::MaybePack(const SimpleEntryStat& entry_stat) {
+  DCHECK(!packed_);
+  const int file_size = entry_stat.GetFileSize(key_, 0);
+  if (!pack_store_.get() ||
+      !empty_file_omitted_[GetFileIndexFromStreamIndex(2)] ||
+      sparse_file_open() || entry_stat.sparse_data_size() != 0 ||
+      file_size > SimplePackStore::kMaxPackedEntrySize) {
+    return false;
+  }
+
+  std::string data;
+  data.resize(file_size);
+  if (files_[0].Read(0, string_as_array(&data), file_size) != file_size)
+    return false;
+  const bool packed =
+      pack_store_->Append(entry_hash_, data, entry_stat.last_modified());
+  SIMPLE_CACHE_UMA(BOOLEAN, "EntryPackedOnClose", cache_type_, packed);
+  return packed;
+}
+
+int SimpleSynchronousEntry::ReadFromFile(int file_index,
+                                         int64 offset,
+                                         char* data,
+                                         int size) const {
+  if (!packed_ || file_index != 0) {
+    File* file = const_cast<File*>(&files_[file_index]);
+    return file->Read(offset, data, size);
+  }
+  const int64 packed_size = packed_data_.size();
+  if (offset < 0 || size < 0)
+    return -1;
+  if (offset >= packed_size)
+    return 0;
+  const int bytes_read =
+      static_cast<int>(std::min<int64>(size, packed_size - offset));
+  memcpy(data, packed_data_.data() + offset, bytes_read);
+  return bytes_read;
+}
+
 bool SimpleSynchronousEntry::CreateFiles(
     bool had_index,
     SimpleEntryStat* out_entry_stat) {
+  // Like entry files already on disk, a packed entry is not replaced by a new
+  // one, which it would otherwise hide on the next open.
+  if (pack_store_.get() && pack_store_->Contains(entry_hash_)) {
+    RecordSyncCreateResult(CREATE_ENTRY_PLATFORM_FILE_ERROR, had_index);
+    return false;
+  }
   for (int i = 0; i < kSimpleEntryFileCount; ++i) {
     File::Error error;
     if (!MaybeCreateFile(i, FILE_NOT_REQUIRED, &error)) {
@@ -880,6 +1036,9 @@ bool SimpleSynchronousEntry::CreateFiles(
 void SimpleSynchronousEntry::CloseFile(int index) {
   if (empty_file_omitted_[index]) {
     empty_file_omitted_[index] = false;
+  } else if (index == 0 && packed_) {
+    packed_ = false;
+    packed_data_.clear();
   } else {
     DCHECK(files_[index].IsValid());
     files_[index].Close();
@@ -900,7 +1059,8 @@ int SimpleSynchronousEntry::InitializeForOpen(
     scoped_refptr<net::GrowableIOBuffer>* stream_0_data,
     uint32* out_stream_0_crc32) {
   DCHECK(!initialized_);
-  if (!OpenFiles(had_index, out_entry_stat)) {
+  if (!OpenPackedFile(out_entry_stat) &&
+      !OpenFiles(had_index, out_entry_stat)) {
     DLOG(WARNING) << "Could not open platform files for entry.";
     return net::ERR_FAILED;
   }
@@ -910,7 +1070,7 @@ int SimpleSynchronousEntry::InitializeForOpen(
 
     SimpleFileHeader header;
     int header_read_result =
-        files_[i].Read(0, reinterpret_cast<char*>(&header), sizeof(header));
+        ReadFromFile(i, 0, reinterpret_cast<char*>(&header), sizeof(header));
     if (header_read_result != sizeof(header)) {
       DLOG(WARNING) << "Cannot read header from entry.";
       RecordSyncOpenResult(cache_type_, OPEN_ENTRY_CANT_READ_HEADER, had_index);
@@ -933,8 +1093,8 @@ int SimpleSynchronousEntry::InitializeForOpen(
     }
 
     scoped_ptr<char[]> key(new char[header.key_length]);
-    int key_read_result = files_[i].Read(sizeof(header), key.get(),
-                                         header.key_length);
+    int key_read_result =
+        ReadFromFile(i, sizeof(header), key.get(), header.key_length);
     if (key_read_result != implicit_cast<int>(header.key_length)) {
       DLOG(WARNING) << "Cannot read key from entry.";
       RecordSyncOpenResult(cache_type_, OPEN_ENTRY_CANT_READ_KEY, had_index);
@@ -967,8 +1127,9 @@ int SimpleSynchronousEntry::InitializeForOpen(
     }
   }
 
+  // Packed entries never have sparse data.
   int32 sparse_data_size = 0;
-  if (!OpenSparseFileIfExists(&sparse_data_size)) {
+  if (!packed_ && !OpenSparseFileIfExists(&sparse_data_size)) {
     RecordSyncOpenResult(
         cache_type_, OPEN_ENTRY_SPARSE_OPEN_FAILED, had_index);
     return net::ERR_FAILED;
@@ -1075,9 +1236,8 @@ int SimpleSynchronousEntry::ReadAndValidateStream0(
   *stream_0_data = new net::GrowableIOBuffer();
   (*stream_0_data)->SetCapacity(stream_0_size);
   int file_offset = out_entry_stat->GetOffsetInFile(key_, 0, 0);
-  File* file = const_cast<File*>(&files_[0]);
   int bytes_read =
-      file->Read(file_offset, (*stream_0_data)->data(), stream_0_size);
+      ReadFromFile(0, file_offset, (*stream_0_data)->data(), stream_0_size);
   if (bytes_read != stream_0_size)
     return net::ERR_FAILED;
 
@@ -1106,9 +1266,9 @@ int SimpleSynchronousEntry::GetEOFRecordData(int index,
   SimpleFileEOF eof_record;
   int file_offset = entry_stat.GetEOFOffsetInFile(key_, index);
   int file_index = GetFileIndexFromStreamIndex(index);
-  File* file = const_cast<File*>(&files_[file_index]);
-  if (file->Read(file_offset, reinterpret_cast<char*>(&eof_record),
-                 sizeof(eof_record)) !=
+  if (ReadFromFile(file_index, file_offset,
+                   reinterpret_cast<char*>(&eof_record),
+                   sizeof(eof_record)) !=
       sizeof(eof_record)) {
     RecordCheckEOFResult(cache_type_, CHECK_EOF_RESULT_READ_FAILURE);
     return net::ERR_CACHE_CHECKSUM_READ_FAILURE;
@@ -1129,7 +1289,7 @@ int SimpleSynchronousEntry::GetEOFRecordData(int index,
 }
 
 void SimpleSynchronousEntry::Doom() const {
-  DeleteFilesForEntryHash(path_, entry_hash_);
+  DeleteFilesForEntryHash(path_, pack_store_, entry_hash_);
 }
 
 // static
@@ -1137,22 +1297,26 @@ bool SimpleSynchronousEntry::DeleteFileForEntryHash(
     const FilePath& path,
     const uint64 entry_hash,
     const int file_index) {
-  FilePath to_delete = path.AppendASCII(
-      GetFilenameFromEntryHashAndFileIndex(entry_hash, file_index));
+  FilePath to_delete =
+      GetFilePathFromEntryHashAndFileIndex(path, entry_hash, file_index);
   return base::DeleteFile(to_delete, false);
 }
 
 // static
 bool SimpleSynchronousEntry::DeleteFilesForEntryHash(
     const FilePath& path,
+    const scoped_refptr<SimplePackStore>& pack_store,
     const uint64 entry_hash) {
+  // A packed entry has no file 0 to delete.
+  const bool was_packed = pack_store.get() && pack_store->Remove(entry_hash);
   bool result = true;
   for (int i = 0; i < kSimpleEntryFileCount; ++i) {
-    if (!DeleteFileForEntryHash(path, entry_hash, i) && !CanOmitEmptyFile(i))
+    if (!DeleteFileForEntryHash(path, entry_hash, i) && !CanOmitEmptyFile(i) &&
+        !was_packed) {
       result = false;
+    }
   }
-  FilePath to_delete = path.AppendASCII(
-      GetSparseFilenameFromEntryHash(entry_hash));
+  FilePath to_delete = GetSparseFilePathFromEntryHash(path, entry_hash);
   base::DeleteFile(to_delete, false);
   return result;
 }
@@ -1174,16 +1338,14 @@ void SimpleSynchronousEntry::RecordSyncCreateResult(CreateEntryResult result,
 }
 
 FilePath SimpleSynchronousEntry::GetFilenameFromFileIndex(int file_index) {
-  return path_.AppendASCII(
-      GetFilenameFromEntryHashAndFileIndex(entry_hash_, file_index));
+  return GetFilePathFromEntryHashAndFileIndex(path_, entry_hash_, file_index);
 }
 
 bool SimpleSynchronousEntry::OpenSparseFileIfExists(
     int32* out_sparse_data_size) {
   DCHECK(!sparse_file_open());
 
-  FilePath filename = path_.AppendASCII(
-      GetSparseFilenameFromEntryHash(entry_hash_));
+  FilePath filename = GetSparseFilePathFromEntryHash(path_, entry_hash_);
   int flags = File::FLAG_OPEN | File::FLAG_READ | File::FLAG_WRITE;
   sparse_file_.Initialize(filename, flags);
   if (sparse_file_.IsValid())
@@ -1195,10 +1357,8 @@ bool SimpleSynchronousEntry::OpenSparseFileIfExists(
 bool SimpleSynchronousEntry::CreateSparseFile() {
   DCHECK(!sparse_file_open());
 
-  FilePath filename = path_.AppendASCII(
-      GetSparseFilenameFromEntryHash(entry_hash_));
-  int flags = File::FLAG_CREATE | File::FLAG_READ | File::FLAG_WRITE;
-  sparse_file_.Initialize(filename, flags);
+  FilePath filename = GetSparseFilePathFromEntryHash(path_, entry_hash_);
+  CreateFileInEntryDirectory(filename, &sparse_file_);
   if (!sparse_file_.IsValid())
     return false;
 
@@ -1229,7 +1389,7 @@ bool SimpleSynchronousEntry::InitializeSparseFile() {
 
   SimpleFileHeader header;
   header.initial_magic_number = kSimpleInitialMagicNumber;
-  header.version = kSimpleVersion;
+  header.version = kSimpleSparseFileVersionOnDisk;
   header.key_length = key_.size();
   header.key_hash = base::Hash(key_);
 
@@ -1271,7 +1431,7 @@ bool SimpleSynchronousEntry::ScanSparseFile(int32* out_sparse_data_size) {
     return false;
   }
 
-  if (header.version != kSimpleVersion) {
+  if (header.version != kSimpleSparseFileVersionOnDisk) {
     DLOG(WARNING) << "Sparse file unreadable version.";
     return false;
   }
@@ -27,6 +27,7 @@ class IOBuffer;
 
 namespace disk_cache {
 
+class SimplePackStore;
 class SimpleSynchronousEntry;
 
 // This class handles the passing of data about the entry between
@@ -112,14 +113,18 @@ class SimpleSynchronousEntry {
     bool doomed;
   };
 
+  // |pack_store| is NULL unless small entries are packed, see
+  // simple_pack_store.h.
   static void OpenEntry(net::CacheType cache_type,
                         const base::FilePath& path,
+                        const scoped_refptr<SimplePackStore>& pack_store,
                         uint64 entry_hash,
                         bool had_index,
                         SimpleEntryCreationResults* out_results);
 
   static void CreateEntry(net::CacheType cache_type,
                           const base::FilePath& path,
+                          const scoped_refptr<SimplePackStore>& pack_store,
                           const std::string& key,
                           uint64 entry_hash,
                           bool had_index,
@@ -129,13 +134,15 @@ class SimpleSynchronousEntry {
   // corresponding instance, if any (allowing operations to continue to be
   // executed through that instance). Returns a net error code.
   static int DoomEntry(const base::FilePath& path,
+                       const scoped_refptr<SimplePackStore>& pack_store,
                        uint64 entry_hash);
 
   // Like |DoomEntry()| above. Deletes all entries corresponding to the
   // |key_hashes|. Succeeds only when all entries are deleted. Returns a net
   // error code.
   static int DoomEntrySet(const std::vector<uint64>* key_hashes,
-                          const base::FilePath& path);
+                          const base::FilePath& path,
+                          const scoped_refptr<SimplePackStore>& pack_store);
 
   // N.B. ReadData(), WriteData(), CheckEOFRecord() and Close() may block on IO.
   void ReadData(const EntryOperationData& in_entry_op,
@@ -166,10 +173,12 @@ class SimpleSynchronousEntry {
                          int* out_result);
 
   // Close all streams, and add write EOF records to streams indicated by the
-  // CRCRecord entries in |crc32s_to_write|.
+  // CRCRecord entries in |crc32s_to_write|. Entries small enough are packed,
+  // unless |doomed|.
   void Close(const SimpleEntryStat& entry_stat,
              scoped_ptr<std::vector<CRCRecord> > crc32s_to_write,
-             net::GrowableIOBuffer* stream_0_data);
+             net::GrowableIOBuffer* stream_0_data,
+             bool doomed);
 
   const base::FilePath& path() const { return path_; }
   std::string key() const { return key_; }
@@ -202,6 +211,7 @@ class SimpleSynchronousEntry {
   SimpleSynchronousEntry(
       net::CacheType cache_type,
       const base::FilePath& path,
+      const scoped_refptr<SimplePackStore>& pack_store,
       const std::string& key,
       uint64 entry_hash);
 
@@ -222,6 +232,23 @@ class SimpleSynchronousEntry {
                        base::File::Error* out_error);
   bool OpenFiles(bool had_index,
                  SimpleEntryStat* out_entry_stat);
+
+  // Reads the contents of file 0 from the pack store, if the entry is packed
+  // there. Returns true if it is.
+  bool OpenPackedFile(SimpleEntryStat* out_entry_stat);
+
+  // Writes the contents of a packed entry back to its file 0 and removes it
+  // from the pack store, so the entry can be modified. Succeeds trivially if
+  // the entry is not packed.
+  bool Unpack();
+
+  // Packs file 0 of the entry, if the entry qualifies. Returns true if it was
+  // packed, in which case file 0 can be deleted once closed.
+  bool MaybePack(const SimpleEntryStat& entry_stat);
+
+  // Reads from one of the entry files, or from the contents of file 0 if the
+  // entry is packed.
+  int ReadFromFile(int file_index, int64 offset, char* data, int size) const;
   bool CreateFiles(bool had_index,
                    SimpleEntryStat* out_entry_stat);
   void CloseFile(int index);
@@ -297,8 +324,10 @@ class SimpleSynchronousEntry {
   static bool DeleteFileForEntryHash(const base::FilePath& path,
                                      uint64 entry_hash,
                                      int file_index);
-  static bool DeleteFilesForEntryHash(const base::FilePath& path,
-                                      uint64 entry_hash);
+  static bool DeleteFilesForEntryHash(
+      const base::FilePath& path,
+      const scoped_refptr<SimplePackStore>& pack_store,
+      uint64 entry_hash);
 
   void RecordSyncCreateResult(CreateEntryResult result, bool had_index);
 
@@ -310,6 +339,7 @@ class SimpleSynchronousEntry {
 
   const net::CacheType cache_type_;
   const base::FilePath path_;
+  const scoped_refptr<SimplePackStore> pack_store_;
   const uint64 entry_hash_;
   std::string key_;
 
@@ -330,6 +360,11 @@ class SimpleSynchronousEntry {
   // written).
   int64 sparse_tail_offset_;
 
+  // True while the contents of file 0 come from |pack_store_| rather than from
+  // |files_[0]|. They are then kept in |packed_data_|.
+  bool packed_;
+  std::string packed_data_;
+
   // True if the entry was created, or false if it was opened. Used to log
   // SimpleCache.*.EntryCreatedWithStream2Omitted only for created entries.
   bool files_created_;
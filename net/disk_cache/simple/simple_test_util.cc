@@ -6,6 +6,7 @@
 
 #include "base/files/file.h"
 #include "base/files/file_path.h"
+#include "base/files/file_util.h"
 #include "net/disk_cache/simple/simple_util.h"
 
 namespace disk_cache {
@@ -13,8 +14,11 @@ namespace simple_util {
 
 bool CreateCorruptFileForTests(const std::string& key,
                                const base::FilePath& cache_path) {
-  base::FilePath entry_file_path = cache_path.AppendASCII(
-      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0));
+  base::FilePath entry_file_path =
+      disk_cache::simple_util::GetFilePathFromKeyAndFileIndex(
+          cache_path, key, 0);
+  if (!base::CreateDirectory(entry_file_path.DirName()))
+    return false;
   int flags = base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_WRITE;
   base::File entry_file(entry_file_path, flags);
 
@@ -6,6 +6,7 @@
 
 #include <limits>
 
+#include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/format_macros.h"
 #include "base/logging.h"
@@ -79,6 +80,40 @@ uint64 GetEntryHashKey(const std::string& key) {
   return u.key_hash;
 }
 
+int GetEntryDirectoryIndex(uint64 entry_hash) {
+  COMPILE_ASSERT(kEntryDirectoryCount == 256, entry_directory_count_mismatch);
+  return static_cast<int>(entry_hash >> 56);
+}
+
+base::FilePath GetEntryDirectory(const base::FilePath& cache_path,
+                                 int directory_index) {
+  DCHECK_LE(0, directory_index);
+  DCHECK_GT(kEntryDirectoryCount, directory_index);
+  return cache_path.AppendASCII(base::StringPrintf("%02x", directory_index));
+}
+
+base::FilePath GetFilePathFromKeyAndFileIndex(const base::FilePath& cache_path,
+                                              const std::string& key,
+                                              int file_index) {
+  return GetFilePathFromEntryHashAndFileIndex(
+      cache_path, GetEntryHashKey(key), file_index);
+}
+
+base::FilePath GetFilePathFromEntryHashAndFileIndex(
+    const base::FilePath& cache_path,
+    uint64 entry_hash,
+    int file_index) {
+  return GetEntryDirectory(cache_path, GetEntryDirectoryIndex(entry_hash))
+      .AppendASCII(GetFilenameFromEntryHashAndFileIndex(entry_hash,
+                                                        file_index));
+}
+
+base::FilePath GetSparseFilePathFromEntryHash(const base::FilePath& cache_path,
+                                              uint64 entry_hash) {
+  return GetEntryDirectory(cache_path, GetEntryDirectoryIndex(entry_hash))
+      .AppendASCII(GetSparseFilenameFromEntryHash(entry_hash));
+}
+
 std::string GetFilenameFromEntryHashAndFileIndex(uint64 entry_hash,
                                                  int file_index) {
   return base::StringPrintf("%016" PRIx64 "_%1d", entry_hash, file_index);
@@ -88,12 +123,6 @@ std::string GetSparseFilenameFromEntryHash(uint64 entry_hash) {
   return base::StringPrintf("%016" PRIx64 "_s", entry_hash);
 }
 
-std::string GetFilenameFromKeyAndFileIndex(const std::string& key,
-                                           int file_index) {
-  return GetEntryHashKeyAsHexString(key) +
-         base::StringPrintf("_%1d", file_index);
-}
-
 int32 GetDataSizeFromKeyAndFileSize(const std::string& key, int64 file_size) {
   int64 data_size = file_size - key.size() - sizeof(SimpleFileHeader) -
                     sizeof(SimpleFileEOF);
@@ -134,6 +163,22 @@ bool GetMTime(const base::FilePath& path, base::Time* out_mtime) {
   return true;
 }
 
+bool GetCacheMTime(const base::FilePath& cache_path, base::Time* out_mtime) {
+  DCHECK(out_mtime);
+  if (!GetMTime(cache_path, out_mtime))
+    return false;
+  for (int i = 0; i < kEntryDirectoryCount; ++i) {
+    // The entry subdirectories are created lazily, a missing one holds no
+    // files.
+    base::Time directory_mtime;
+    if (GetMTime(GetEntryDirectory(cache_path, i), &directory_mtime) &&
+        directory_mtime > *out_mtime) {
+      *out_mtime = directory_mtime;
+    }
+  }
+  return true;
+}
+
 }  // namespace simple_backend
 
 }  // namespace disk_cache
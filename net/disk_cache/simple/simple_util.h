@@ -8,11 +8,11 @@
 #include <string>
 
 #include "base/basictypes.h"
+#include "base/files/file_path.h"
 #include "base/strings/string_piece.h"
 #include "net/base/net_export.h"
 
 namespace base {
-class FilePath;
 class Time;
 }
 
@@ -37,18 +37,49 @@ NET_EXPORT_PRIVATE bool GetEntryHashKeyFromHexString(
     const base::StringPiece& hash_key,
     uint64* hash_key_out);
 
+// The entry files are spread over this many subdirectories of the cache
+// directory, named after the top byte of the entry hash, so that no single
+// directory holds all the files of a large cache.
+const int kEntryDirectoryCount = 256;
+
+// Returns which of the |kEntryDirectoryCount| subdirectories holds the files
+// of the entry with |entry_hash|.
+NET_EXPORT_PRIVATE int GetEntryDirectoryIndex(uint64 entry_hash);
+
+// Returns the path of the entry subdirectory |directory_index| of the cache
+// directory |cache_path|.
+NET_EXPORT_PRIVATE base::FilePath GetEntryDirectory(
+    const base::FilePath& cache_path,
+    int directory_index);
+
 // Given a |key| for a (potential) entry in the simple backend and the |index|
-// of a stream on that entry, returns the filename in which that stream would be
-// stored.
-NET_EXPORT_PRIVATE std::string GetFilenameFromKeyAndFileIndex(
+// of a stream on that entry, returns the path of the file in which that stream
+// would be stored.
+NET_EXPORT_PRIVATE base::FilePath GetFilePathFromKeyAndFileIndex(
+    const base::FilePath& cache_path,
     const std::string& key,
     int file_index);
 
-// Same as |GetFilenameFromKeyAndIndex| above, but using a hex string.
+// Same as |GetFilePathFromKeyAndFileIndex| above, but using the hash of the
+// key.
+NET_EXPORT_PRIVATE base::FilePath GetFilePathFromEntryHashAndFileIndex(
+    const base::FilePath& cache_path,
+    uint64 entry_hash,
+    int file_index);
+
+// Given the hash of the key of an entry, returns the path of its sparse data
+// file.
+NET_EXPORT_PRIVATE base::FilePath GetSparseFilePathFromEntryHash(
+    const base::FilePath& cache_path,
+    uint64 entry_hash);
+
+// Returns the name of the file in which the stream |file_index| of an entry is
+// stored, within the entry subdirectory.
 std::string GetFilenameFromEntryHashAndFileIndex(uint64 entry_hash,
                                                  int file_index);
 
-// Given a |key| for an entry, returns the name of the sparse data file.
+// Returns the name of the sparse data file of an entry, within the entry
+// subdirectory.
 std::string GetSparseFilenameFromEntryHash(uint64 entry_hash);
 
 // Given the size of a file holding a stream in the simple backend and the key
@@ -69,6 +100,12 @@ NET_EXPORT_PRIVATE int GetFileIndexFromStreamIndex(int stream_index);
 // functions in file.h, the time resolution is milliseconds.
 NET_EXPORT_PRIVATE bool GetMTime(const base::FilePath& path,
                                  base::Time* out_mtime);
+
+// Fills |out_mtime| with the latest last modified time of the cache directory
+// |cache_path| and of its entry subdirectories, which changes whenever an
+// entry file is created or deleted.
+NET_EXPORT_PRIVATE bool GetCacheMTime(const base::FilePath& cache_path,
+                                      base::Time* out_mtime);
 }  // namespace simple_backend
 
 }  // namespace disk_cache
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "base/files/file_path.h"
 #include "base/logging.h"
 #include "base/port.h"
 #include "net/disk_cache/simple/simple_util.h"
@@ -13,6 +14,8 @@ using disk_cache::simple_util::GetEntryHashKeyFromHexString;
 using disk_cache::simple_util::GetEntryHashKey;
 using disk_cache::simple_util::GetFileSizeFromKeyAndDataSize;
 using disk_cache::simple_util::GetDataSizeFromKeyAndFileSize;
+using disk_cache::simple_util::GetFilePathFromEntryHashAndFileIndex;
+using disk_cache::simple_util::GetSparseFilePathFromEntryHash;
 
 class SimpleUtilTest : public testing::Test {};
 
@@ -74,3 +77,16 @@ TEST_F(SimpleUtilTest, SizesAndOffsets) {
   const int file_size = GetFileSizeFromKeyAndDataSize(key, data_size);
   EXPECT_EQ(data_size, GetDataSizeFromKeyAndFileSize(key, file_size));
 }
+
+TEST_F(SimpleUtilTest, EntryFilesInSubdirectories) {
+  const base::FilePath cache_path(FILE_PATH_LITERAL("cache"));
+  EXPECT_EQ(cache_path.AppendASCII("7a").AppendASCII("7ac408c1dff9c84b_0"),
+            GetFilePathFromEntryHashAndFileIndex(
+                cache_path, GG_UINT64_C(0x7ac408c1dff9c84b), 0));
+  EXPECT_EQ(cache_path.AppendASCII("00").AppendASCII("0000000005f5e0ff_1"),
+            GetFilePathFromEntryHashAndFileIndex(
+                cache_path, GG_UINT64_C(99999999), 1));
+  EXPECT_EQ(cache_path.AppendASCII("ff").AppendASCII("ffffffffffffffff_s"),
+            GetSparseFilePathFromEntryHash(
+                cache_path, GG_UINT64_C(18446744073709551615)));
+}
@@ -4,9 +4,11 @@
 
 #include "net/disk_cache/simple/simple_version_upgrade.h"
 
+#include <bitset>
 #include <cstring>
 
 #include "base/files/file.h"
+#include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/files/memory_mapped_file.h"
@@ -14,6 +16,7 @@
 #include "base/pickle.h"
 #include "net/disk_cache/simple/simple_backend_version.h"
 #include "net/disk_cache/simple/simple_entry_format_history.h"
+#include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
 
 namespace {
@@ -107,6 +110,48 @@ bool UpgradeIndexV5V6(const base::FilePath& cache_directory) {
   return true;
 }
 
+// Migrates the entry files from version 6 to version 7.
+// Returns true iff it succeeds.
+//
+// The V6 cache keeps all entry files directly in the cache directory, the V7
+// one spreads them over subdirectories named after the top byte of the entry
+// hash:
+//   V6: $cachedir/<entry-hash>_<suffix>
+//   V7: $cachedir/<top-byte-of-entry-hash>/<entry-hash>_<suffix>
+//
+// The files are moved one by one. If the upgrade is interrupted the fake index
+// still holds version 6, and the next run moves the files that remain.
+bool UpgradeEntryFilesV6V7(const base::FilePath& cache_directory) {
+  const size_t kEntryFileNameLength = 2 * sizeof(uint64) + 2;
+  std::bitset<simple_util::kEntryDirectoryCount> created_directories;
+  base::FileEnumerator entry_files(cache_directory, /* recursive = */ false,
+                                   base::FileEnumerator::FILES);
+  for (base::FilePath file = entry_files.Next(); !file.empty();
+       file = entry_files.Next()) {
+    const base::FilePath::StringType base_name = file.BaseName().value();
+    const std::string file_name(base_name.begin(), base_name.end());
+    uint64 entry_hash = 0;
+    if (file_name.size() != kEntryFileNameLength ||
+        file_name[kEntryFileNameLength - 2] != '_' ||
+        !simple_util::GetEntryHashKeyFromHexString(
+            base::StringPiece(file_name).substr(0, kEntryFileNameLength - 2),
+            &entry_hash)) {
+      continue;
+    }
+    const int directory_index = simple_util::GetEntryDirectoryIndex(entry_hash);
+    const base::FilePath entry_directory =
+        simple_util::GetEntryDirectory(cache_directory, directory_index);
+    if (!created_directories.test(directory_index)) {
+      if (!base::CreateDirectory(entry_directory))
+        return false;
+      created_directories.set(directory_index);
+    }
+    if (!base::Move(file, entry_directory.Append(file.BaseName())))
+      return false;
+  }
+  return true;
+}
+
 // Some points about the Upgrade process are still not clear:
 // 1. if the upgrade path requires dropping cache it would be faster to just
 //    return an initialization error here and proceed with asynchronous cache
@@ -120,8 +165,9 @@ bool UpgradeIndexV5V6(const base::FilePath& cache_directory) {
 //    upgrade codes need to ensure they can continue after being stopped in the
 //    middle. It also means that the "fake index" must be flushed in between the
 //    upgrade steps. Atomicity of this is an interesting research topic. The
-//    intermediate fake index flushing must be added as soon as we add more
-//    upgrade steps.
+//    upgrade steps so far can all be safely repeated, so an interrupted
+//    upgrade restarts from the version in the fake index without flushing it
+//    in between.
 bool UpgradeSimpleCacheOnDisk(const base::FilePath& path) {
   // There is a convention among disk cache backends: looking at the magic in
   // the file "index" it should be sufficient to determine if the cache belongs
@@ -170,6 +216,13 @@ bool UpgradeSimpleCacheOnDisk(const base::FilePath& path) {
     }
     version_from++;
   }
+  if (version_from == 6) {
+    if (!UpgradeEntryFilesV6V7(path)) {
+      LogMessageFailedUpgradeFromVersion(file_header.version);
+      return false;
+    }
+    version_from++;
+  }
   if (version_from == kSimpleVersion) {
     if (!upgrade_needed) {
       return true;
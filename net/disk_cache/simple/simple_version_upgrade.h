@@ -45,6 +45,10 @@ struct NET_EXPORT_PRIVATE FakeIndexData {
 // Exposed for testing.
 NET_EXPORT_PRIVATE bool UpgradeIndexV5V6(const base::FilePath& cache_directory);
 
+// Exposed for testing.
+NET_EXPORT_PRIVATE bool UpgradeEntryFilesV6V7(
+    const base::FilePath& cache_directory);
+
 }  // namespace disk_cache
 
 #endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_VERSION_UPGRADE_H_
@@ -13,6 +13,7 @@
 #include "net/base/net_errors.h"
 #include "net/disk_cache/simple/simple_backend_version.h"
 #include "net/disk_cache/simple/simple_entry_format_history.h"
+#include "net/disk_cache/simple/simple_util.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 // The migration process relies on ability to rename newly created files, which
@@ -135,6 +136,59 @@ TEST(SimpleVersionUpgradeTest, UpgradeV5V6IndexMustDisappear) {
   }
 }
 
+TEST(SimpleVersionUpgradeTest, UpgradeV6V7EntryFilesMoveToSubdirectories) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  const base::FilePath cache_path = cache_dir.path();
+
+  static const uint64 kHashes[] = {
+    GG_UINT64_C(0x0000000000000001),
+    GG_UINT64_C(0x0100000000000002),
+    GG_UINT64_C(0xff00000000000003),
+  };
+  static const char* const kSuffixes[] = { "_0", "_1", "_s" };
+  for (size_t i = 0; i < arraysize(kHashes); ++i) {
+    for (size_t j = 0; j < arraysize(kSuffixes); ++j) {
+      const std::string file_name =
+          base::StringPrintf("%016" PRIx64, kHashes[i]) + kSuffixes[j];
+      ASSERT_EQ(implicit_cast<int>(file_name.size()),
+                base::WriteFile(cache_path.AppendASCII(file_name),
+                                file_name.data(), file_name.size()));
+    }
+  }
+  // Files not named like entry files stay where they are.
+  const base::FilePath fake_index = cache_path.AppendASCII(kFakeIndexFileName);
+  ASSERT_TRUE(WriteFakeIndexFileV5(cache_path));
+
+  // Simulate an interrupted upgrade which moved one of the files already.
+  const base::FilePath moved_file =
+      disk_cache::simple_util::GetFilePathFromEntryHashAndFileIndex(
+          cache_path, kHashes[0], 0);
+  ASSERT_TRUE(base::CreateDirectory(moved_file.DirName()));
+  ASSERT_TRUE(base::Move(cache_path.AppendASCII(
+                             moved_file.BaseName().MaybeAsASCII()),
+                         moved_file));
+
+  ASSERT_TRUE(disk_cache::UpgradeEntryFilesV6V7(cache_path));
+
+  EXPECT_TRUE(base::PathExists(fake_index));
+  for (size_t i = 0; i < arraysize(kHashes); ++i) {
+    const base::FilePath entry_directory =
+        disk_cache::simple_util::GetEntryDirectory(
+            cache_path,
+            disk_cache::simple_util::GetEntryDirectoryIndex(kHashes[i]));
+    for (size_t j = 0; j < arraysize(kSuffixes); ++j) {
+      const std::string file_name =
+          base::StringPrintf("%016" PRIx64, kHashes[i]) + kSuffixes[j];
+      EXPECT_FALSE(base::PathExists(cache_path.AppendASCII(file_name)));
+      std::string contents;
+      EXPECT_TRUE(base::ReadFileToString(entry_directory.AppendASCII(file_name),
+                                         &contents));
+      EXPECT_EQ(file_name, contents);
+    }
+  }
+}
+
 }  // namespace
 
 #endif  // defined(OS_POSIX)
@@ -31,6 +31,17 @@ HostCache::Entry::Entry(int error, const AddressList& addrlist)
 HostCache::Entry::~Entry() {
 }
 
+HostCache::EntrySnapshot::EntrySnapshot(const Key& key,
+                                        const Entry& entry,
+                                        base::TimeTicks expiration)
+    : key(key),
+      entry(entry),
+      expiration(expiration) {
+}
+
+HostCache::EntrySnapshot::~EntrySnapshot() {
+}
+
 //-----------------------------------------------------------------------------
 
 HostCache::HostCache(size_t max_entries)
@@ -40,20 +51,52 @@ HostCache::HostCache(size_t max_entries)
 HostCache::~HostCache() {
 }
 
-const HostCache::Entry* HostCache::Lookup(const Key& key,
-                                          base::TimeTicks now) {
-  DCHECK(CalledOnValidThread());
+bool HostCache::Lookup(const Key& key, base::TimeTicks now, Entry* entry) {
+  DCHECK(entry);
+  base::AutoLock lock(lock_);
+  if (caching_is_disabled())
+    return false;
+
+  const Entry* cached_entry = entries_.Get(key, now);
+  if (!cached_entry)
+    return false;
+
+  *entry = *cached_entry;
+  return true;
+}
+
+bool HostCache::LookupStale(const Key& key,
+                            base::TimeTicks now,
+                            base::TimeDelta max_stale,
+                            Entry* entry,
+                            bool* stale) {
+  DCHECK(entry);
+  DCHECK(stale);
+  base::AutoLock lock(lock_);
   if (caching_is_disabled())
-    return NULL;
+    return false;
+
+  base::TimeTicks expiration;
+  const Entry* cached_entry = entries_.Peek(key, &expiration);
+  if (!cached_entry)
+    return false;
+
+  if (now >= expiration + max_stale) {
+    // Let the cache drop the entry, as a regular lookup would have.
+    entries_.Get(key, now);
+    return false;
+  }
 
-  return entries_.Get(key, now);
+  *entry = *cached_entry;
+  *stale = now >= expiration;
+  return true;
 }
 
 void HostCache::Set(const Key& key,
                     const Entry& entry,
                     base::TimeTicks now,
                     base::TimeDelta ttl) {
-  DCHECK(CalledOnValidThread());
+  base::AutoLock lock(lock_);
   if (caching_is_disabled())
     return;
 
@@ -61,24 +104,27 @@ void HostCache::Set(const Key& key,
 }
 
 void HostCache::clear() {
-  DCHECK(CalledOnValidThread());
+  base::AutoLock lock(lock_);
   entries_.Clear();
 }
 
 size_t HostCache::size() const {
-  DCHECK(CalledOnValidThread());
+  base::AutoLock lock(lock_);
   return entries_.size();
 }
 
 size_t HostCache::max_entries() const {
-  DCHECK(CalledOnValidThread());
+  base::AutoLock lock(lock_);
   return entries_.max_entries();
 }
 
-// Note that this map may contain expired entries.
-const HostCache::EntryMap& HostCache::entries() const {
-  DCHECK(CalledOnValidThread());
-  return entries_;
+HostCache::EntryList HostCache::entries() const {
+  base::AutoLock lock(lock_);
+  EntryList entries;
+  entries.reserve(entries_.size());
+  for (EntryMap::Iterator it(entries_); it.HasNext(); it.Advance())
+    entries.push_back(EntrySnapshot(it.key(), it.value(), it.expiration()));
+  return entries;
 }
 
 // static
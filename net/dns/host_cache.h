@@ -7,10 +7,11 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "base/gtest_prod_util.h"
 #include "base/memory/scoped_ptr.h"
-#include "base/threading/non_thread_safe.h"
+#include "base/synchronization/lock.h"
 #include "base/time/time.h"
 #include "net/base/address_family.h"
 #include "net/base/address_list.h"
@@ -20,7 +21,11 @@
 namespace net {
 
 // Cache used by HostResolver to map hostnames to their resolved result.
-class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
+//
+// Thread safety: All methods may be called from any thread. Lookups and
+// entries() return copies, which remain valid while other threads modify the
+// cache.
+class NET_EXPORT HostCache {
  public:
   // Stores the latest address list that was looked up for a hostname.
   struct NET_EXPORT Entry {
@@ -73,14 +78,38 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
                         std::less<base::TimeTicks>,
                         EvictionHandler> EntryMap;
 
+  // A copy of an entry of the cache with its key and expiration, as returned
+  // by entries().
+  struct NET_EXPORT EntrySnapshot {
+    EntrySnapshot(const Key& key,
+                  const Entry& entry,
+                  base::TimeTicks expiration);
+    ~EntrySnapshot();
+
+    Key key;
+    Entry entry;
+    base::TimeTicks expiration;
+  };
+  typedef std::vector<EntrySnapshot> EntryList;
+
   // Constructs a HostCache that stores up to |max_entries|.
   explicit HostCache(size_t max_entries);
 
   ~HostCache();
 
-  // Returns a pointer to the entry for |key|, which is valid at time
-  // |now|. If there is no such entry, returns NULL.
-  const Entry* Lookup(const Key& key, base::TimeTicks now);
+  // Copies the entry for |key| into |*entry| and returns true if there is one
+  // which is valid at time |now|. Otherwise returns false.
+  bool Lookup(const Key& key, base::TimeTicks now, Entry* entry);
+
+  // Copies the entry for |key| into |*entry| and returns true if there is one
+  // which is valid at time |now|, or which expired less than |max_stale|
+  // before |now|. |*stale| is set to whether the entry has expired. Returns
+  // false, removing the entry, if it expired longer ago than that.
+  bool LookupStale(const Key& key,
+                   base::TimeTicks now,
+                   base::TimeDelta max_stale,
+                   Entry* entry,
+                   bool* stale);
 
   // Overwrites or creates an entry for |key|.
   // |entry| is the value to set, |now| is the current time
@@ -99,7 +128,8 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   // Following are used by net_internals UI.
   size_t max_entries() const;
 
-  const EntryMap& entries() const;
+  // Returns a copy of all the entries, which may include expired ones.
+  EntryList entries() const;
 
   // Creates a default cache.
   static scoped_ptr<HostCache> CreateDefaultCache();
@@ -112,6 +142,9 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
     return entries_.max_entries() == 0;
   }
 
+  // Guards |entries_|.
+  mutable base::Lock lock_;
+
   // Map from hostname (presumably in lowercase canonicalized format) to
   // a resolved result entry.
   EntryMap entries_;
@@ -31,6 +31,7 @@ TEST(HostCacheTest, Basic) {
 
   // Start at t=0.
   base::TimeTicks now;
+  HostCache::Entry cached_entry(ERR_UNEXPECTED, AddressList());
 
   HostCache::Key key1 = Key("foobar.com");
   HostCache::Key key2 = Key("foobar2.com");
@@ -39,10 +40,10 @@ TEST(HostCacheTest, Basic) {
   EXPECT_EQ(0U, cache.size());
 
   // Add an entry for "foobar.com" at t=0.
-  EXPECT_FALSE(cache.Lookup(key1, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
   cache.Set(key1, entry, now, kTTL);
-  EXPECT_TRUE(cache.Lookup(key1, now));
-  EXPECT_TRUE(cache.Lookup(key1, now)->error == entry.error);
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
+  EXPECT_EQ(entry.error, cached_entry.error);
 
   EXPECT_EQ(1U, cache.size());
 
@@ -50,39 +51,77 @@ TEST(HostCacheTest, Basic) {
   now += base::TimeDelta::FromSeconds(5);
 
   // Add an entry for "foobar2.com" at t=5.
-  EXPECT_FALSE(cache.Lookup(key2, now));
+  EXPECT_FALSE(cache.Lookup(key2, now, &cached_entry));
   cache.Set(key2, entry, now, kTTL);
-  EXPECT_TRUE(cache.Lookup(key2, now));
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
   EXPECT_EQ(2U, cache.size());
 
   // Advance to t=9
   now += base::TimeDelta::FromSeconds(4);
 
   // Verify that the entries we added are still retrievable, and usable.
-  EXPECT_TRUE(cache.Lookup(key1, now));
-  EXPECT_TRUE(cache.Lookup(key2, now));
-  EXPECT_NE(cache.Lookup(key1, now), cache.Lookup(key2, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
 
   // Advance to t=10; key is now expired.
   now += base::TimeDelta::FromSeconds(1);
 
-  EXPECT_FALSE(cache.Lookup(key1, now));
-  EXPECT_TRUE(cache.Lookup(key2, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
 
   // Update key1, so it is no longer expired.
   cache.Set(key1, entry, now, kTTL);
-  EXPECT_TRUE(cache.Lookup(key1, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
   EXPECT_EQ(2U, cache.size());
 
   // Both entries should still be retrievable and usable.
-  EXPECT_TRUE(cache.Lookup(key1, now));
-  EXPECT_TRUE(cache.Lookup(key2, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
 
   // Advance to t=20; both entries are now expired.
   now += base::TimeDelta::FromSeconds(10);
 
-  EXPECT_FALSE(cache.Lookup(key1, now));
-  EXPECT_FALSE(cache.Lookup(key2, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
+  EXPECT_FALSE(cache.Lookup(key2, now, &cached_entry));
+}
+
+// Expired entries are returned by LookupStale() until they are |max_stale|
+// past their expiration.
+TEST(HostCacheTest, LookupStale) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+  const base::TimeDelta kMaxStale = base::TimeDelta::FromSeconds(5);
+
+  HostCache cache(kMaxCacheEntries);
+
+  // Start at t=0.
+  base::TimeTicks now;
+
+  HostCache::Key key1 = Key("foobar.com");
+  HostCache::Entry entry(ERR_UNEXPECTED, AddressList());
+  bool stale = true;
+
+  EXPECT_FALSE(cache.LookupStale(key1, now, kMaxStale, &entry, &stale));
+  cache.Set(key1, HostCache::Entry(OK, AddressList()), now, kTTL);
+  EXPECT_TRUE(cache.LookupStale(key1, now, kMaxStale, &entry, &stale));
+  EXPECT_EQ(OK, entry.error);
+  EXPECT_FALSE(stale);
+
+  // Advance to t=12; the entry has expired but may still be used.
+  now += base::TimeDelta::FromSeconds(12);
+  EXPECT_TRUE(cache.LookupStale(key1, now, kMaxStale, &entry, &stale));
+  EXPECT_TRUE(stale);
+  EXPECT_EQ(1U, cache.size());
+
+  // Without a stale allowance the expired entry is dropped.
+  EXPECT_FALSE(cache.LookupStale(key1, now, base::TimeDelta(), &entry, &stale));
+  EXPECT_EQ(0U, cache.size());
+
+  // Re-add the entry at t=12, then advance to t=27; the entry expired at t=22
+  // and is now too old to be used.
+  cache.Set(key1, HostCache::Entry(OK, AddressList()), now, kTTL);
+  now += base::TimeDelta::FromSeconds(15);
+  EXPECT_FALSE(cache.LookupStale(key1, now, kMaxStale, &entry, &stale));
+  EXPECT_EQ(0U, cache.size());
 }
 
 // Try caching entries for a failed resolve attempt -- since we set the TTL of
@@ -95,24 +134,25 @@ TEST(HostCacheTest, NoCacheZeroTTL) {
 
   // Set t=0.
   base::TimeTicks now;
+  HostCache::Entry cached_entry(ERR_UNEXPECTED, AddressList());
 
   HostCache::Key key1 = Key("foobar.com");
   HostCache::Key key2 = Key("foobar2.com");
   HostCache::Entry entry = HostCache::Entry(OK, AddressList());
 
-  EXPECT_FALSE(cache.Lookup(key1, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
   cache.Set(key1, entry, now, kFailureEntryTTL);
   EXPECT_EQ(1U, cache.size());
 
   // We disallow use of negative entries.
-  EXPECT_FALSE(cache.Lookup(key1, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
 
   // Now overwrite with a valid entry, and then overwrite with negative entry
   // again -- the valid entry should be kicked out.
   cache.Set(key1, entry, now, kSuccessEntryTTL);
-  EXPECT_TRUE(cache.Lookup(key1, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
   cache.Set(key1, entry, now, kFailureEntryTTL);
-  EXPECT_FALSE(cache.Lookup(key1, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
 }
 
 // Try caching entries for a failed resolves for 10 seconds.
@@ -123,6 +163,7 @@ TEST(HostCacheTest, CacheNegativeEntry) {
 
   // Start at t=0.
   base::TimeTicks now;
+  HostCache::Entry cached_entry(ERR_UNEXPECTED, AddressList());
 
   HostCache::Key key1 = Key("foobar.com");
   HostCache::Key key2 = Key("foobar2.com");
@@ -131,48 +172,48 @@ TEST(HostCacheTest, CacheNegativeEntry) {
   EXPECT_EQ(0U, cache.size());
 
   // Add an entry for "foobar.com" at t=0.
-  EXPECT_FALSE(cache.Lookup(key1, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
   cache.Set(key1, entry, now, kFailureEntryTTL);
-  EXPECT_TRUE(cache.Lookup(key1, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
   EXPECT_EQ(1U, cache.size());
 
   // Advance to t=5.
   now += base::TimeDelta::FromSeconds(5);
 
   // Add an entry for "foobar2.com" at t=5.
-  EXPECT_FALSE(cache.Lookup(key2, now));
+  EXPECT_FALSE(cache.Lookup(key2, now, &cached_entry));
   cache.Set(key2, entry, now, kFailureEntryTTL);
-  EXPECT_TRUE(cache.Lookup(key2, now));
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
   EXPECT_EQ(2U, cache.size());
 
   // Advance to t=9
   now += base::TimeDelta::FromSeconds(4);
 
   // Verify that the entries we added are still retrievable, and usable.
-  EXPECT_TRUE(cache.Lookup(key1, now));
-  EXPECT_TRUE(cache.Lookup(key2, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
 
   // Advance to t=10; key1 is now expired.
   now += base::TimeDelta::FromSeconds(1);
 
-  EXPECT_FALSE(cache.Lookup(key1, now));
-  EXPECT_TRUE(cache.Lookup(key2, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
 
   // Update key1, so it is no longer expired.
   cache.Set(key1, entry, now, kFailureEntryTTL);
   // Re-uses existing entry storage.
-  EXPECT_TRUE(cache.Lookup(key1, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
   EXPECT_EQ(2U, cache.size());
 
   // Both entries should still be retrievable and usable.
-  EXPECT_TRUE(cache.Lookup(key1, now));
-  EXPECT_TRUE(cache.Lookup(key2, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
 
   // Advance to t=20; both entries are now expired.
   now += base::TimeDelta::FromSeconds(10);
 
-  EXPECT_FALSE(cache.Lookup(key1, now));
-  EXPECT_FALSE(cache.Lookup(key2, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
+  EXPECT_FALSE(cache.Lookup(key2, now, &cached_entry));
 }
 
 // Tests that the same hostname can be duplicated in the cache, so long as
@@ -184,6 +225,7 @@ TEST(HostCacheTest, AddressFamilyIsPartOfKey) {
 
   // t=0.
   base::TimeTicks now;
+  HostCache::Entry cached_entry(ERR_UNEXPECTED, AddressList());
 
   HostCache::Key key1("foobar.com", ADDRESS_FAMILY_UNSPECIFIED, 0);
   HostCache::Key key2("foobar.com", ADDRESS_FAMILY_IPV4, 0);
@@ -192,20 +234,18 @@ TEST(HostCacheTest, AddressFamilyIsPartOfKey) {
   EXPECT_EQ(0U, cache.size());
 
   // Add an entry for ("foobar.com", UNSPECIFIED) at t=0.
-  EXPECT_FALSE(cache.Lookup(key1, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
   cache.Set(key1, entry, now, kSuccessEntryTTL);
-  EXPECT_TRUE(cache.Lookup(key1, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
   EXPECT_EQ(1U, cache.size());
 
   // Add an entry for ("foobar.com", IPV4_ONLY) at t=0.
-  EXPECT_FALSE(cache.Lookup(key2, now));
+  EXPECT_FALSE(cache.Lookup(key2, now, &cached_entry));
   cache.Set(key2, entry, now, kSuccessEntryTTL);
-  EXPECT_TRUE(cache.Lookup(key2, now));
-  EXPECT_EQ(2U, cache.size());
-
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
   // Even though the hostnames were the same, we should have two unique
   // entries (because the address families differ).
-  EXPECT_NE(cache.Lookup(key1, now), cache.Lookup(key2, now));
+  EXPECT_EQ(2U, cache.size());
 }
 
 // Tests that the same hostname can be duplicated in the cache, so long as
@@ -217,6 +257,7 @@ TEST(HostCacheTest, HostResolverFlagsArePartOfKey) {
 
   // t=0.
   base::TimeTicks now;
+  HostCache::Entry cached_entry(ERR_UNEXPECTED, AddressList());
 
   HostCache::Key key1("foobar.com", ADDRESS_FAMILY_IPV4, 0);
   HostCache::Key key2("foobar.com", ADDRESS_FAMILY_IPV4,
@@ -228,28 +269,24 @@ TEST(HostCacheTest, HostResolverFlagsArePartOfKey) {
   EXPECT_EQ(0U, cache.size());
 
   // Add an entry for ("foobar.com", IPV4, NONE) at t=0.
-  EXPECT_FALSE(cache.Lookup(key1, now));
+  EXPECT_FALSE(cache.Lookup(key1, now, &cached_entry));
   cache.Set(key1, entry, now, kTTL);
-  EXPECT_TRUE(cache.Lookup(key1, now));
+  EXPECT_TRUE(cache.Lookup(key1, now, &cached_entry));
   EXPECT_EQ(1U, cache.size());
 
   // Add an entry for ("foobar.com", IPV4, CANONNAME) at t=0.
-  EXPECT_FALSE(cache.Lookup(key2, now));
+  EXPECT_FALSE(cache.Lookup(key2, now, &cached_entry));
   cache.Set(key2, entry, now, kTTL);
-  EXPECT_TRUE(cache.Lookup(key2, now));
+  EXPECT_TRUE(cache.Lookup(key2, now, &cached_entry));
   EXPECT_EQ(2U, cache.size());
 
   // Add an entry for ("foobar.com", IPV4, LOOPBACK_ONLY) at t=0.
-  EXPECT_FALSE(cache.Lookup(key3, now));
+  EXPECT_FALSE(cache.Lookup(key3, now, &cached_entry));
   cache.Set(key3, entry, now, kTTL);
-  EXPECT_TRUE(cache.Lookup(key3, now));
-  EXPECT_EQ(3U, cache.size());
-
-  // Even though the hostnames were the same, we should have two unique
+  EXPECT_TRUE(cache.Lookup(key3, now, &cached_entry));
+  // Even though the hostnames were the same, we should have three unique
   // entries (because the HostResolverFlags differ).
-  EXPECT_NE(cache.Lookup(key1, now), cache.Lookup(key2, now));
-  EXPECT_NE(cache.Lookup(key1, now), cache.Lookup(key3, now));
-  EXPECT_NE(cache.Lookup(key2, now), cache.Lookup(key3, now));
+  EXPECT_EQ(3U, cache.size());
 }
 
 TEST(HostCacheTest, NoCache) {
@@ -261,17 +298,44 @@ TEST(HostCacheTest, NoCache) {
 
   // Set t=0.
   base::TimeTicks now;
+  HostCache::Entry cached_entry(ERR_UNEXPECTED, AddressList());
 
   HostCache::Entry entry = HostCache::Entry(OK, AddressList());
 
   // Lookup and Set should have no effect.
-  EXPECT_FALSE(cache.Lookup(Key("foobar.com"),now));
+  EXPECT_FALSE(cache.Lookup(Key("foobar.com"), now, &cached_entry));
   cache.Set(Key("foobar.com"), entry, now, kTTL);
-  EXPECT_FALSE(cache.Lookup(Key("foobar.com"), now));
+  EXPECT_FALSE(cache.Lookup(Key("foobar.com"), now, &cached_entry));
 
   EXPECT_EQ(0U, cache.size());
 }
 
+// Tests that entries() returns copies, which outlive the entries of the cache.
+TEST(HostCacheTest, Entries) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+
+  HostCache cache(kMaxCacheEntries);
+
+  // Set t=0.
+  base::TimeTicks now;
+
+  cache.Set(Key("foobar1.com"), HostCache::Entry(OK, AddressList()), now,
+            kTTL);
+  cache.Set(Key("foobar2.com"), HostCache::Entry(ERR_NAME_NOT_RESOLVED,
+                                                 AddressList()),
+            now, kTTL);
+
+  const HostCache::EntryList entries = cache.entries();
+  cache.clear();
+
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ("foobar1.com", entries[0].key.hostname);
+  EXPECT_EQ(OK, entries[0].entry.error);
+  EXPECT_EQ(now + kTTL, entries[0].expiration);
+  EXPECT_EQ("foobar2.com", entries[1].key.hostname);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, entries[1].entry.error);
+}
+
 TEST(HostCacheTest, Clear) {
   const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
 
@@ -100,6 +100,10 @@ HostResolver::RequestInfo::RequestInfo(const HostPortPair& host_port_pair)
 HostResolver::~HostResolver() {
 }
 
+void HostResolver::Prefetch(const std::vector<RequestInfo>& infos,
+                            RequestPriority priority) {
+}
+
 AddressFamily HostResolver::GetDefaultAddressFamily() const {
   return ADDRESS_FAMILY_UNSPECIFIED;
 }
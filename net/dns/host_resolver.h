@@ -6,8 +6,10 @@
 #define NET_DNS_HOST_RESOLVER_H_
 
 #include <string>
+#include <vector>
 
 #include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
 #include "net/base/address_family.h"
 #include "net/base/completion_callback.h"
 #include "net/base/host_port_pair.h"
@@ -46,6 +48,9 @@ class NET_EXPORT HostResolver {
   // resolution. Pass HostResolver::kDefaultRetryAttempts to choose a default
   // value.
   // |enable_caching| controls whether a HostCache is used.
+  // |max_stale| is how long past its TTL a successful cached result may still
+  // be returned, while it is refreshed in the background. Zero disables
+  // serving stale results.
   struct NET_EXPORT Options {
     Options();
 
@@ -54,6 +59,7 @@ class NET_EXPORT HostResolver {
     size_t max_concurrent_resolves;
     size_t max_retry_attempts;
     bool enable_caching;
+    base::TimeDelta max_stale;
   };
 
   // The parameters for doing a Resolve(). A hostname and port are
@@ -166,6 +172,12 @@ class NET_EXPORT HostResolver {
   // has already run or the request was canceled.
   virtual void CancelRequest(RequestHandle req) = 0;
 
+  // Starts resolving each of |infos| that is not already cached, so that
+  // later calls to Resolve() for them can complete synchronously. The results
+  // are only stored in the cache; there is no way to cancel a prefetch.
+  virtual void Prefetch(const std::vector<RequestInfo>& infos,
+                        RequestPriority priority);
+
   // Sets the default AddressFamily to use when requests have left it
   // unspecified. For example, this could be used to restrict resolution
   // results to AF_INET by passing in ADDRESS_FAMILY_IPV4, or to
@@ -1206,6 +1206,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
         priority_tracker_(priority),
         had_non_speculative_request_(false),
         had_dns_config_(false),
+        is_background_(false),
         num_occupied_job_slots_(0),
         dns_task_error_(OK),
         creation_time_(base::TimeTicks::Now()),
@@ -1300,8 +1301,15 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
     UpdatePriority();
   }
 
-  // Marks |req| as cancelled. If it was the last active Request, also finishes
-  // this Job, marking it as cancelled, and deletes it.
+  // Keeps this Job running after its last Request is cancelled, or without
+  // any Request at all, so that its result still ends up in the cache.
+  void set_is_background() {
+    is_background_ = true;
+  }
+
+  // Marks |req| as cancelled. If it was the last active Request of a Job which
+  // is not a background Job, also finishes this Job, marking it as cancelled,
+  // and deletes it.
   void CancelRequest(Request* req) {
     DCHECK_EQ(key_.hostname, req->info().hostname());
     DCHECK(!req->was_canceled());
@@ -1317,7 +1325,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
                                  req->request_net_log().source(),
                                  priority()));
 
-    if (num_active_requests() > 0) {
+    if (num_active_requests() > 0 || is_background_) {
       UpdatePriority();
     } else {
       // If we were called from a Request's callback within CompleteRequests,
@@ -1359,11 +1367,14 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
   // Attempts to serve the job from HOSTS. Returns true if succeeded and
   // this Job was destroyed.
   bool ServeFromHosts() {
-    DCHECK_GT(num_active_requests(), 0u);
+    DCHECK(is_background_ || num_active_requests() > 0);
+    // Background Jobs might have no Request to take the port from; the port
+    // is replaced when the cached result is served anyway.
+    HostResolver::RequestInfo info(HostPortPair(key_.hostname, 0));
+    if (!requests_.empty())
+      info = requests_.front()->info();
     AddressList addr_list;
-    if (resolver_->ServeFromHosts(key(),
-                                  requests_.front()->info(),
-                                  &addr_list)) {
+    if (resolver_->ServeFromHosts(key(), info, &addr_list)) {
       // This will destroy the Job.
       CompleteRequests(
           HostCache::Entry(OK, MakeAddressListForRequest(addr_list)),
@@ -1666,7 +1677,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
       handle_.Reset();
     }
 
-    if (num_active_requests() == 0) {
+    if (num_active_requests() == 0 && !is_background_) {
       net_log_.AddEvent(NetLog::TYPE_CANCELLED);
       net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HOST_RESOLVER_IMPL_JOB,
                                         OK);
@@ -1676,7 +1687,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
     net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HOST_RESOLVER_IMPL_JOB,
                                       entry.error);
 
-    DCHECK(!requests_.empty());
+    DCHECK(is_background_ || !requests_.empty());
 
     if (entry.error == OK) {
       // Record this histogram here, when we know the system has a valid DNS
@@ -1751,6 +1762,9 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
   // Distinguishes measurements taken while DnsClient was fully configured.
   bool had_dns_config_;
 
+  // True if this Job was started to fill the cache rather than for a Request.
+  bool is_background_;
+
   // Number of slots occupied by this Job in resolver's PrioritizedDispatcher.
   unsigned num_occupied_job_slots_;
 
@@ -1794,6 +1808,7 @@ HostResolverImpl::ProcTaskParams::~ProcTaskParams() {}
 
 HostResolverImpl::HostResolverImpl(const Options& options, NetLog* net_log)
     : max_queued_jobs_(0),
+      max_stale_(options.max_stale),
       proc_params_(NULL, options.max_retry_attempts),
       net_log_(net_log),
       default_address_family_(ADDRESS_FAMILY_UNSPECIFIED),
@@ -1894,22 +1909,12 @@ int HostResolverImpl::Resolve(const RequestInfo& info,
   JobMap::iterator jobit = jobs_.find(key);
   Job* job;
   if (jobit == jobs_.end()) {
-    job =
-        new Job(weak_ptr_factory_.GetWeakPtr(), key, priority, request_net_log);
-    job->Schedule(false);
-
-    // Check for queue overflow.
-    if (dispatcher_->num_queued_jobs() > max_queued_jobs_) {
-      Job* evicted = static_cast<Job*>(dispatcher_->EvictOldestLowest());
-      DCHECK(evicted);
-      evicted->OnEvicted();  // Deletes |evicted|.
-      if (evicted == job) {
-        rv = ERR_HOST_RESOLVER_QUEUE_TOO_LARGE;
-        LogFinishRequest(source_net_log, request_net_log, info, rv);
-        return rv;
-      }
+    job = CreateAndScheduleJob(key, priority, request_net_log);
+    if (!job) {
+      rv = ERR_HOST_RESOLVER_QUEUE_TOO_LARGE;
+      LogFinishRequest(source_net_log, request_net_log, info, rv);
+      return rv;
     }
-    jobs_.insert(jobit, std::make_pair(key, job));
   } else {
     job = jobit->second;
   }
@@ -1938,8 +1943,11 @@ int HostResolverImpl::ResolveHelper(const Key& key,
   int net_error = ERR_UNEXPECTED;
   if (ResolveAsIP(key, info, &net_error, addresses))
     return net_error;
-  if (ServeFromCache(key, info, &net_error, addresses)) {
+  bool stale = false;
+  if (ServeFromCache(key, info, &net_error, addresses, &stale)) {
     request_net_log.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_CACHE_HIT);
+    if (stale)
+      StartBackgroundJob(key, IDLE, request_net_log);
     return net_error;
   }
   // TODO(szym): Do not do this if nsswitch.conf instructs not to.
@@ -1980,6 +1988,27 @@ void HostResolverImpl::CancelRequest(RequestHandle req_handle) {
   job->CancelRequest(req);
 }
 
+void HostResolverImpl::Prefetch(const std::vector<RequestInfo>& infos,
+                                RequestPriority priority) {
+  DCHECK(CalledOnValidThread());
+  for (size_t i = 0; i < infos.size(); ++i) {
+    const RequestInfo& info = infos[i];
+    std::string labeled_hostname;
+    if (!DNSDomainFromDot(info.hostname(), &labeled_hostname))
+      continue;
+
+    BoundNetLog request_net_log = BoundNetLog::Make(net_log_,
+        NetLog::SOURCE_HOST_RESOLVER_IMPL_REQUEST);
+    Key key = GetEffectiveKeyForRequest(info, request_net_log);
+
+    AddressList addresses;
+    if (ResolveHelper(key, info, &addresses, request_net_log) ==
+        ERR_DNS_CACHE_MISS) {
+      StartBackgroundJob(key, priority, request_net_log);
+    }
+  }
+}
+
 void HostResolverImpl::SetDefaultAddressFamily(AddressFamily address_family) {
   DCHECK(CalledOnValidThread());
   default_address_family_ = address_family;
@@ -2057,22 +2086,29 @@ bool HostResolverImpl::ResolveAsIP(const Key& key,
 bool HostResolverImpl::ServeFromCache(const Key& key,
                                       const RequestInfo& info,
                                       int* net_error,
-                                      AddressList* addresses) {
+                                      AddressList* addresses,
+                                      bool* stale) {
   DCHECK(addresses);
   DCHECK(net_error);
+  DCHECK(stale);
   if (!info.allow_cached_response() || !cache_.get())
     return false;
 
-  const HostCache::Entry* cache_entry = cache_->Lookup(
-      key, base::TimeTicks::Now());
-  if (!cache_entry)
+  HostCache::Entry cache_entry(ERR_UNEXPECTED, AddressList());
+  if (!cache_->LookupStale(key, base::TimeTicks::Now(), max_stale_,
+                           &cache_entry, stale)) {
     return false;
+  }
 
-  *net_error = cache_entry->error;
+  // Failures are never served stale.
+  if (*stale && cache_entry.error != OK)
+    return false;
+
+  *net_error = cache_entry.error;
   if (*net_error == OK) {
-    if (cache_entry->has_ttl())
-      RecordTTL(cache_entry->ttl);
-    *addresses = EnsurePortOnAddressList(cache_entry->addrlist, info.port());
+    if (cache_entry.has_ttl())
+      RecordTTL(cache_entry.ttl);
+    *addresses = EnsurePortOnAddressList(cache_entry.addrlist, info.port());
   }
   return true;
 }
@@ -2139,6 +2175,37 @@ void HostResolverImpl::RemoveJob(Job* job) {
     jobs_.erase(it);
 }
 
+HostResolverImpl::Job* HostResolverImpl::CreateAndScheduleJob(
+    const Key& key,
+    RequestPriority priority,
+    const BoundNetLog& request_net_log) {
+  DCHECK(jobs_.find(key) == jobs_.end());
+  Job* job =
+      new Job(weak_ptr_factory_.GetWeakPtr(), key, priority, request_net_log);
+  job->Schedule(false);
+
+  // Check for queue overflow.
+  if (dispatcher_->num_queued_jobs() > max_queued_jobs_) {
+    Job* evicted = static_cast<Job*>(dispatcher_->EvictOldestLowest());
+    DCHECK(evicted);
+    evicted->OnEvicted();  // Deletes |evicted|.
+    if (evicted == job)
+      return NULL;
+  }
+  jobs_.insert(std::make_pair(key, job));
+  return job;
+}
+
+void HostResolverImpl::StartBackgroundJob(const Key& key,
+                                          RequestPriority priority,
+                                          const BoundNetLog& request_net_log) {
+  if (jobs_.find(key) != jobs_.end())
+    return;
+  Job* job = CreateAndScheduleJob(key, priority, request_net_log);
+  if (job)
+    job->set_is_background();
+}
+
 void HostResolverImpl::SetHaveOnlyLoopbackAddresses(bool result) {
   if (result) {
     additional_resolver_flags_ |= HOST_RESOLVER_LOOPBACK_ONLY;
@@ -6,6 +6,7 @@
 #define NET_DNS_HOST_RESOLVER_IMPL_H_
 
 #include <map>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/gtest_prod_util.h"
@@ -134,6 +135,8 @@ class NET_EXPORT HostResolverImpl
                                AddressList* addresses,
                                const BoundNetLog& source_net_log) OVERRIDE;
   virtual void CancelRequest(RequestHandle req) OVERRIDE;
+  virtual void Prefetch(const std::vector<RequestInfo>& infos,
+                        RequestPriority priority) OVERRIDE;
   virtual void SetDefaultAddressFamily(AddressFamily address_family) OVERRIDE;
   virtual AddressFamily GetDefaultAddressFamily() const OVERRIDE;
   virtual void SetDnsClientEnabled(bool enabled) OVERRIDE;
@@ -163,6 +166,7 @@ class NET_EXPORT HostResolverImpl
   // literal, cache and HOSTS lookup (if enabled), returns OK if successful,
   // ERR_NAME_NOT_RESOLVED if either hostname is invalid or IP literal is
   // incompatible, ERR_DNS_CACHE_MISS if entry was not found in cache and HOSTS.
+  // If a stale cache entry is served, starts refreshing it in the background.
   int ResolveHelper(const Key& key,
                     const RequestInfo& info,
                     AddressList* addresses,
@@ -177,11 +181,13 @@ class NET_EXPORT HostResolverImpl
 
   // If |key| is not found in cache returns false, otherwise returns
   // true, sets |net_error| to the cached error code and fills |addresses|
-  // if it is a positive entry.
+  // if it is a positive entry. Sets |stale| if the entry has expired but is
+  // within |max_stale_|.
   bool ServeFromCache(const Key& key,
                       const RequestInfo& info,
                       int* net_error,
-                      AddressList* addresses);
+                      AddressList* addresses,
+                      bool* stale);
 
   // If we have a DnsClient with a valid DnsConfig, and |key| is found in the
   // HOSTS file, returns true and fills |addresses|. Otherwise returns false.
@@ -206,6 +212,18 @@ class NET_EXPORT HostResolverImpl
   // Removes |job| from |jobs_|, only if it exists.
   void RemoveJob(Job* job);
 
+  // Creates a Job for |key|, schedules it and adds it to |jobs_|. Returns
+  // NULL if the queue was full and the new Job was evicted right away.
+  Job* CreateAndScheduleJob(const Key& key,
+                            RequestPriority priority,
+                            const BoundNetLog& request_net_log);
+
+  // Resolves |key| into the cache without a Request waiting for the result,
+  // unless a Job for |key| is already in progress.
+  void StartBackgroundJob(const Key& key,
+                          RequestPriority priority,
+                          const BoundNetLog& request_net_log);
+
   // Aborts all in progress jobs with ERR_NETWORK_CHANGED and notifies their
   // requests. Might start new jobs.
   void AbortAllInProgressJobs();
@@ -251,6 +269,10 @@ class NET_EXPORT HostResolverImpl
   // Limit on the maximum number of jobs queued in |dispatcher_|.
   size_t max_queued_jobs_;
 
+  // How long past their TTL successful cache entries may be served while
+  // they are refreshed.
+  base::TimeDelta max_stale_;
+
   // Parameters for ProcTask.
   ProcTaskParams proc_params_;
 
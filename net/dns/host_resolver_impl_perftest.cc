@@ -0,0 +1,152 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/dns/host_resolver_impl.h"
+
+#include <string>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "net/base/address_list.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/test_completion_callback.h"
+#include "net/dns/host_cache.h"
+#include "net/dns/mock_host_resolver.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumHosts = 100;
+const int kNumResolutions = 100000;
+const int kNumLookupThreads = 4;
+
+std::string HostName(int i) {
+  return base::StringPrintf("host%d.example.com", i);
+}
+
+class HostResolverImplPerfTest : public testing::Test {
+ protected:
+  HostResolverImplPerfTest() {
+    HostResolver::Options options;
+    options.max_concurrent_resolves = 8;
+    options.max_retry_attempts = 0;
+    resolver_.reset(new HostResolverImpl(options, NULL));
+    resolver_->set_proc_params_for_test(HostResolverImpl::ProcTaskParams(
+        CreateCatchAllHostResolverProc(), 0));
+    // Avoid probing for IPv6 support on every resolution.
+    resolver_->SetDefaultAddressFamily(ADDRESS_FAMILY_IPV4);
+  }
+
+  // Prefetches all hostnames and waits for them to be cached.
+  void FillCache() {
+    std::vector<HostResolver::RequestInfo> infos;
+    for (int i = 0; i < kNumHosts; ++i)
+      infos.push_back(HostResolver::RequestInfo(HostPortPair(HostName(i), 80)));
+    resolver_->Prefetch(infos, MEDIUM);
+
+    for (int i = 0; i < kNumHosts; ++i) {
+      TestCompletionCallback callback;
+      AddressList addresses;
+      int rv = resolver_->Resolve(infos[i], MEDIUM, &addresses,
+                                  callback.callback(), NULL, BoundNetLog());
+      ASSERT_EQ(OK, callback.GetResult(rv));
+    }
+  }
+
+  base::MessageLoopForIO message_loop_;
+  scoped_ptr<HostResolverImpl> resolver_;
+};
+
+// Looks up each of |keys| in turn, repeatedly, from its own thread.
+class LookupThread : public base::DelegateSimpleThread::Delegate {
+ public:
+  LookupThread(HostCache* cache, const std::vector<HostCache::Key>& keys)
+      : cache_(cache), keys_(keys), num_hits_(0) {}
+  virtual ~LookupThread() {}
+
+  virtual void Run() OVERRIDE {
+    HostCache::Entry entry(ERR_UNEXPECTED, AddressList());
+    bool stale = false;
+    for (int i = 0; i < kNumResolutions; ++i) {
+      if (cache_->LookupStale(keys_[i % keys_.size()], base::TimeTicks::Now(),
+                              base::TimeDelta(), &entry, &stale)) {
+        ++num_hits_;
+      }
+    }
+  }
+
+  int num_hits() const { return num_hits_; }
+
+ private:
+  HostCache* cache_;
+  const std::vector<HostCache::Key> keys_;
+  int num_hits_;
+};
+
+TEST_F(HostResolverImplPerfTest, CachedResolutions) {
+  ASSERT_NO_FATAL_FAILURE(FillCache());
+
+  // Every resolution is served from the cache, so |callback| never runs.
+  TestCompletionCallback callback;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumResolutions; ++i) {
+    HostResolver::RequestInfo info(HostPortPair(HostName(i % kNumHosts), 80));
+    AddressList addresses;
+    ASSERT_EQ(OK, resolver_->Resolve(info, MEDIUM, &addresses,
+                                     callback.callback(), NULL,
+                                     BoundNetLog()));
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  base::LogPerfResult("HostResolverImpl_cached_resolutions",
+                      kNumResolutions / elapsed.InSecondsF(),
+                      "resolutions/s");
+}
+
+TEST_F(HostResolverImplPerfTest, ConcurrentCacheLookups) {
+  ASSERT_NO_FATAL_FAILURE(FillCache());
+  HostCache* cache = resolver_->GetHostCache();
+  ASSERT_EQ(static_cast<size_t>(kNumHosts), cache->size());
+  const HostCache::EntryList entries = cache->entries();
+  std::vector<HostCache::Key> keys;
+  for (HostCache::EntryList::const_iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    keys.push_back(it->key);
+  }
+
+  ScopedVector<LookupThread> lookups;
+  ScopedVector<base::DelegateSimpleThread> threads;
+  for (int i = 0; i < kNumLookupThreads; ++i) {
+    lookups.push_back(new LookupThread(cache, keys));
+    threads.push_back(new base::DelegateSimpleThread(
+        lookups.back(), base::StringPrintf("HostCacheLookup%d", i)));
+  }
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumLookupThreads; ++i)
+    threads[i]->Start();
+  for (int i = 0; i < kNumLookupThreads; ++i)
+    threads[i]->Join();
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  for (int i = 0; i < kNumLookupThreads; ++i)
+    EXPECT_EQ(kNumResolutions, lookups[i]->num_hits());
+  base::LogPerfResult("HostCache_concurrent_lookups",
+                      kNumLookupThreads * kNumResolutions /
+                          elapsed.InSecondsF(),
+                      "lookups/s");
+}
+
+}  // namespace
+
+}  // namespace net
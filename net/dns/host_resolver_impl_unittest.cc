@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/bind_helpers.h"
@@ -1282,6 +1283,87 @@ TEST_F(HostResolverImplTest, ResolveFromCache) {
   EXPECT_TRUE(requests_[2]->HasOneAddress("192.168.1.42", 80));
 }
 
+// Expired results are served from the cache while they are being refreshed.
+TEST_F(HostResolverImplTest, ServeStaleWhileRefreshing) {
+  HostResolver::Options options = DefaultOptions();
+  options.max_stale = base::TimeDelta::FromHours(1);
+  resolver_.reset(new HostResolverImpl(options, NULL));
+  resolver_->set_proc_params_for_test(DefaultParams(proc_.get()));
+
+  proc_->AddRuleForAllFamilies("just.testing", "192.168.1.42");
+  proc_->SignalMultiple(2u);  // One to fill the cache, one to refresh it.
+
+  Request* req = CreateRequest("just.testing", 80);
+  EXPECT_EQ(ERR_IO_PENDING, req->Resolve());
+  EXPECT_EQ(OK, req->WaitForResult());
+
+  // Make the cached result expire ten minutes ago.
+  HostCache* cache = resolver_->GetHostCache();
+  ASSERT_EQ(1u, cache->size());
+  const HostCache::EntryList entries = cache->entries();
+  HostCache::Key key = entries[0].key;
+  HostCache::Entry entry = entries[0].entry;
+  cache->Set(key, entry,
+             base::TimeTicks::Now() - base::TimeDelta::FromMinutes(11),
+             base::TimeDelta::FromMinutes(1));
+
+  // The stale result is served synchronously and refreshed in the background.
+  req = CreateRequest("just.testing", 81);
+  EXPECT_EQ(OK, req->Resolve());
+  EXPECT_TRUE(req->HasOneAddress("192.168.1.42", 81));
+
+  // A request bypassing the cache joins the refresh.
+  HostResolver::RequestInfo info(HostPortPair("just.testing", 82));
+  info.set_allow_cached_response(false);
+  req = CreateRequest(info, DEFAULT_PRIORITY);
+  EXPECT_EQ(ERR_IO_PENDING, req->Resolve());
+  EXPECT_EQ(OK, req->WaitForResult());
+  EXPECT_EQ(2u, proc_->GetCaptureList().size());
+
+  bool stale = true;
+  EXPECT_TRUE(cache->LookupStale(key, base::TimeTicks::Now(),
+                                 base::TimeDelta(), &entry, &stale));
+  EXPECT_FALSE(stale);
+}
+
+// Prefetched hostnames are resolved into the cache, even if no request waits
+// for them.
+TEST_F(HostResolverImplTest, Prefetch) {
+  std::vector<HostResolver::RequestInfo> infos;
+  infos.push_back(HostResolver::RequestInfo(HostPortPair("a", 80)));
+  infos.push_back(HostResolver::RequestInfo(HostPortPair("b", 80)));
+  infos.push_back(HostResolver::RequestInfo(HostPortPair(std::string(), 80)));
+  resolver_->Prefetch(infos, LOW);
+
+  // Both lookups are blocked in |proc_|.
+  EXPECT_TRUE(proc_->WaitFor(2u));
+
+  // A request for "a" joins the prefetch and can be cancelled without
+  // stopping it.
+  Request* req = CreateRequest("a", 80);
+  EXPECT_EQ(ERR_IO_PENDING, req->Resolve());
+  req->Cancel();
+
+  proc_->SignalMultiple(2u);
+
+  req = CreateRequest("b", 81);
+  EXPECT_EQ(ERR_IO_PENDING, req->Resolve());
+  EXPECT_EQ(OK, req->WaitForResult());
+
+  req = CreateRequest("a", 82);
+  int rv = req->Resolve();
+  if (rv == ERR_IO_PENDING)
+    rv = req->WaitForResult();
+  EXPECT_EQ(OK, rv);
+  EXPECT_EQ(2u, proc_->GetCaptureList().size());
+
+  // Prefetching cached hostnames does not resolve them again.
+  resolver_->Prefetch(infos, LOW);
+  EXPECT_EQ(OK, CreateRequest("a", 83)->Resolve());
+  EXPECT_EQ(OK, CreateRequest("b", 83)->Resolve());
+  EXPECT_EQ(2u, proc_->GetCaptureList().size());
+}
+
 // Test the retry attempts simulating host resolver proc that takes too long.
 TEST_F(HostResolverImplTest, MultipleAttempts) {
   // Total number of attempts would be 3 and we want the 3rd attempt to resolve
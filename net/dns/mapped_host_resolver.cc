@@ -47,6 +47,17 @@ void MappedHostResolver::CancelRequest(RequestHandle req) {
   impl_->CancelRequest(req);
 }
 
+void MappedHostResolver::Prefetch(const std::vector<RequestInfo>& infos,
+                                  RequestPriority priority) {
+  std::vector<RequestInfo> mapped_infos;
+  for (size_t i = 0; i < infos.size(); ++i) {
+    RequestInfo info = infos[i];
+    if (ApplyRules(&info) == OK)
+      mapped_infos.push_back(info);
+  }
+  impl_->Prefetch(mapped_infos, priority);
+}
+
 void MappedHostResolver::SetDnsClientEnabled(bool enabled) {
   impl_->SetDnsClientEnabled(enabled);
 }
@@ -55,6 +55,8 @@ class NET_EXPORT MappedHostResolver : public HostResolver {
                                AddressList* addresses,
                                const BoundNetLog& net_log) OVERRIDE;
   virtual void CancelRequest(RequestHandle req) OVERRIDE;
+  virtual void Prefetch(const std::vector<RequestInfo>& infos,
+                        RequestPriority priority) OVERRIDE;
   virtual void SetDnsClientEnabled(bool enabled) OVERRIDE;
   virtual HostCache* GetHostCache() OVERRIDE;
   virtual base::Value* GetDnsConfigAsValue() const OVERRIDE;
@@ -171,11 +171,11 @@ int MockHostResolverBase::ResolveFromIPLiteralOrCache(const RequestInfo& info,
     HostCache::Key key(info.hostname(),
                        info.address_family(),
                        info.host_resolver_flags());
-    const HostCache::Entry* entry = cache_->Lookup(key, base::TimeTicks::Now());
-    if (entry) {
-      rv = entry->error;
+    HostCache::Entry entry(ERR_UNEXPECTED, AddressList());
+    if (cache_->Lookup(key, base::TimeTicks::Now(), &entry)) {
+      rv = entry.error;
       if (rv == OK)
-        *addresses = AddressList::CopyWithPort(entry->addrlist, info.port());
+        *addresses = AddressList::CopyWithPort(entry.addrlist, info.port());
     }
   }
   return rv;
@@ -344,6 +344,10 @@ Filter::FilterStatus Filter::CopyOut(char* dest_buffer, int* dest_len) {
   }
 }
 
+bool Filter::IsPassThrough() const {
+  return false;
+}
+
 // static
 Filter* Filter::InitGZipFilter(FilterType type_id, int buffer_size) {
   scoped_ptr<GZipFilter> gz_filter(new GZipFilter());
@@ -399,6 +403,13 @@ void Filter::InitBuffer(int buffer_size) {
 }
 
 void Filter::PushDataIntoNextFilter() {
+  if (IsPassThrough() && stream_data_len_ &&
+      !next_filter_->stream_data_len() &&
+      stream_buffer_size_ == next_filter_->stream_buffer_size()) {
+    HandOffStreamBuffer();
+    return;
+  }
+
   IOBuffer* next_buffer = next_filter_->stream_buffer();
   int next_size = next_filter_->stream_buffer_size();
   last_status_ = ReadFilteredData(next_buffer->data(), &next_size);
@@ -406,4 +417,16 @@ void Filter::PushDataIntoNextFilter() {
     next_filter_->FlushStreamBuffer(next_size);
 }
 
+void Filter::HandOffStreamBuffer() {
+  DCHECK(next_filter_.get());
+  DCHECK(stream_data_len_);
+  DCHECK(!next_filter_->stream_data_len());
+  stream_buffer_.swap(next_filter_->stream_buffer_);
+  next_filter_->next_stream_data_ = next_stream_data_;
+  next_filter_->stream_data_len_ = stream_data_len_;
+  next_stream_data_ = NULL;
+  stream_data_len_ = 0;
+  last_status_ = FILTER_NEED_MORE_DATA;
+}
+
 }  // namespace net
@@ -226,6 +226,11 @@ class NET_EXPORT_PRIVATE Filter {
   // Copy pre-filter data directly to destination buffer without decoding.
   FilterStatus CopyOut(char* dest_buffer, int* dest_len);
 
+  // Returns true if the filter has fallen back to passing its input through
+  // unaltered, so that a chain can hand the input on to the next filter
+  // instead of copying it.
+  virtual bool IsPassThrough() const;
+
   FilterStatus last_status() const { return last_status_; }
 
   // Buffer to hold the data to be filtered (the input queue).
@@ -264,6 +269,10 @@ class NET_EXPORT_PRIVATE Filter {
   // Helper function to empty our output into the next filter's input.
   void PushDataIntoNextFilter();
 
+  // Swaps stream_buffer_ with the next filter's empty one, handing the data
+  // still to be filtered over to the next filter without copying it.
+  void HandOffStreamBuffer();
+
   // Constructs a filter with an internal buffer of the given size.
   // Only meant to be called by unit tests that need to control the buffer size.
   static Filter* FactoryForTests(const std::vector<FilterType>& filter_types,
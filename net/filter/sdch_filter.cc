@@ -50,6 +50,48 @@ enum ResponseCorruptionDetectionCause {
   RESPONSE_MAX,
 };
 
+// Receives decoded output directly into the caller's buffer while there is
+// room for it, and appends the rest to |excess|.
+class DestBufferOutput : public open_vcdiff::OutputStringInterface {
+ public:
+  DestBufferOutput(char* dest_buffer, size_t capacity, std::string* excess)
+      : dest_buffer_(dest_buffer),
+        capacity_(capacity),
+        used_(0),
+        excess_(excess) {}
+  virtual ~DestBufferOutput() {}
+
+  // open_vcdiff::OutputStringInterface implementation.
+  virtual OutputStringInterface& append(const char* s, size_t n) OVERRIDE {
+    size_t amount = std::min(n, capacity_ - used_);
+    memcpy(dest_buffer_ + used_, s, amount);
+    used_ += amount;
+    excess_->append(s + amount, n - amount);
+    return *this;
+  }
+  virtual void clear() OVERRIDE {
+    used_ = 0;
+    excess_->clear();
+  }
+  virtual void push_back(char c) OVERRIDE { append(&c, 1); }
+  virtual void ReserveAdditionalBytes(size_t res_arg) OVERRIDE {
+    if (used_ + res_arg > capacity_)
+      excess_->reserve(excess_->size() + used_ + res_arg - capacity_);
+  }
+  virtual size_t size() const OVERRIDE { return used_ + excess_->size(); }
+
+  // Number of bytes written to the caller's buffer.
+  size_t used() const { return used_; }
+
+ private:
+  char* const dest_buffer_;
+  const size_t capacity_;
+  size_t used_;
+  std::string* const excess_;
+
+  DISALLOW_COPY_AND_ASSIGN(DestBufferOutput);
+};
+
 }  // namespace
 
 SdchFilter::SdchFilter(const FilterContext& filter_context)
@@ -347,13 +389,16 @@ Filter::FilterStatus SdchFilter::ReadFilteredData(char* dest_buffer,
   if (!next_stream_data_ || stream_data_len_ <= 0)
     return FILTER_NEED_MORE_DATA;
 
-  bool ret = vcdiff_streaming_decoder_->DecodeChunk(
-    next_stream_data_, stream_data_len_, &dest_buffer_excess_);
+  // Decode straight into |dest_buffer|, keeping only what does not fit in
+  // dest_buffer_excess_.
+  DestBufferOutput output(dest_buffer, available_space, &dest_buffer_excess_);
+  bool ret = vcdiff_streaming_decoder_->DecodeChunkToInterface(
+    next_stream_data_, stream_data_len_, &output);
   // Assume all data was used in decoding.
   next_stream_data_ = NULL;
   source_bytes_ += stream_data_len_;
   stream_data_len_ = 0;
-  output_bytes_ += dest_buffer_excess_.size();
+  output_bytes_ += output.size();
   if (!ret) {
     vcdiff_streaming_decoder_.reset(NULL);  // Don't call it again.
     decoding_status_ = DECODING_ERROR;
@@ -361,15 +406,16 @@ Filter::FilterStatus SdchFilter::ReadFilteredData(char* dest_buffer,
     return FILTER_ERROR;
   }
 
-  amount = OutputBufferExcess(dest_buffer, available_space);
-  *dest_len += amount;
-  dest_buffer += amount;
-  available_space -= amount;
-  if (0 == available_space && !dest_buffer_excess_.empty())
+  *dest_len += output.used();
+  if (!dest_buffer_excess_.empty())
       return FILTER_OK;
   return FILTER_NEED_MORE_DATA;
 }
 
+bool SdchFilter::IsPassThrough() const {
+  return decoding_status_ == PASS_THROUGH && dest_buffer_excess_.empty();
+}
+
 Filter::FilterStatus SdchFilter::InitializeDictionary() {
   const size_t kServerIdLength = 9;  // Dictionary hash plus null from server.
   size_t bytes_needed = kServerIdLength - dictionary_hash_.size();
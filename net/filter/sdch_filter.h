@@ -43,6 +43,10 @@ class NET_EXPORT_PRIVATE SdchFilter : public Filter {
   virtual FilterStatus ReadFilteredData(char* dest_buffer,
                                         int* dest_len) OVERRIDE;
 
+ protected:
+  // Filter overrides.
+  virtual bool IsPassThrough() const OVERRIDE;
+
  private:
   // Internal status.  Once we enter an error state, we stop processing data.
   enum DecodingStatus {
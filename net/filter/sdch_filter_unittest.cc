@@ -249,6 +249,38 @@ TEST_F(SdchFilterTest, PassThroughWhenTentative) {
   EXPECT_EQ(Filter::FILTER_NEED_MORE_DATA, status);
 }
 
+// Tests that a chain of filters that all pass their input through hands the
+// input from one filter to the next instead of copying it.
+TEST_F(SdchFilterTest, PassThroughChainHandsOffStreamBuffer) {
+  std::vector<Filter::FilterType> filter_types;
+  filter_types.push_back(Filter::FILTER_TYPE_GZIP_HELPING_SDCH);
+  filter_types.push_back(Filter::FILTER_TYPE_GZIP_HELPING_SDCH);
+  filter_context()->SetResponseCode(200);
+  filter_context()->SetURL(GURL("http://ignore.com"));
+  scoped_ptr<Filter> filter(Filter::Factory(filter_types, *filter_context()));
+  ASSERT_TRUE(filter.get());
+
+  const std::string kChunks[] = { "not GZIPed data, ", "more data, ", "end" };
+  std::string output;
+  for (size_t i = 0; i < arraysize(kChunks); ++i) {
+    IOBuffer* input_buffer = filter->stream_buffer();
+    memcpy(input_buffer->data(), kChunks[i].data(), kChunks[i].size());
+    filter->FlushStreamBuffer(kChunks[i].size());
+
+    char output_buffer[64];
+    int output_bytes_or_buffer_size = sizeof(output_buffer);
+    EXPECT_EQ(Filter::FILTER_NEED_MORE_DATA,
+              filter->ReadData(output_buffer, &output_bytes_or_buffer_size));
+    output.append(output_buffer, output_bytes_or_buffer_size);
+
+    // The first chunk is what tells the filters to pass their input through,
+    // every later one is handed off.
+    if (i > 0)
+      EXPECT_NE(input_buffer, filter->stream_buffer());
+  }
+  EXPECT_EQ(kChunks[0] + kChunks[1] + kChunks[2], output);
+}
+
 TEST_F(SdchFilterTest, RefreshBadReturnCode) {
   std::vector<Filter::FilterType> filter_types;
   // Selective a tentative filter (which can fall back to pass through).
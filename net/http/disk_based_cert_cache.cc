@@ -8,13 +8,11 @@
 
 #include "base/bind.h"
 #include "base/callback_helpers.h"
-#include "base/memory/ref_counted.h"
 #include "base/metrics/histogram.h"
 #include "base/stl_util.h"
 #include "base/strings/string_number_conversions.h"
-#include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
-#include "net/disk_cache/disk_cache.h"
+#include "net/http/disk_cache_entry_worker.h"
 
 namespace net {
 
@@ -80,44 +78,22 @@ class DiskBasedCertCache::WriteWorker {
   void Cancel();
 
  private:
-  enum State {
-    STATE_OPEN,
-    STATE_OPEN_COMPLETE,
-    STATE_CREATE,
-    STATE_CREATE_COMPLETE,
-    STATE_WRITE,
-    STATE_WRITE_COMPLETE,
-    STATE_NONE
-  };
-
-  void OnIOComplete(int rv);
-  int DoLoop(int rv);
-
-  int DoOpen();
-  int DoOpenComplete(int rv);
-  int DoCreate();
-  int DoCreateComplete(int rv);
-  int DoWrite();
-  int DoWriteComplete(int rv);
-
-  void Finish(int rv);
+  // Called by |entry_worker_| once the certificate is written.
+  void Finish(int rv, const std::string& data);
 
   // Invokes all of the |user_callbacks_|
   void RunCallbacks(int rv);
 
   disk_cache::Backend* backend_;
-  const X509Certificate::OSCertHandle cert_handle_;
   std::string key_;
-  bool canceled_;
+  std::string der_encoded_cert_;
+  bool encoded_;
 
-  disk_cache::Entry* entry_;
-  State next_state_;
-  scoped_refptr<IOBuffer> buffer_;
-  int io_buf_len_;
+  // Deletes itself once it is done.
+  DiskCacheEntryWorker* entry_worker_;
 
   base::Closure cleanup_callback_;
   std::vector<SetCallback> user_callbacks_;
-  CompletionCallback io_callback_;
 };
 
 DiskBasedCertCache::WriteWorker::WriteWorker(
@@ -126,34 +102,28 @@ DiskBasedCertCache::WriteWorker::WriteWorker(
     X509Certificate::OSCertHandle cert_handle,
     const base::Closure& cleanup_callback)
     : backend_(backend),
-      cert_handle_(X509Certificate::DupOSCertHandle(cert_handle)),
       key_(key),
-      canceled_(false),
-      entry_(NULL),
-      next_state_(STATE_NONE),
-      io_buf_len_(0),
-      cleanup_callback_(cleanup_callback),
-      io_callback_(
-          base::Bind(&WriteWorker::OnIOComplete, base::Unretained(this))) {
+      encoded_(X509Certificate::GetDEREncoded(cert_handle,
+                                              &der_encoded_cert_)),
+      entry_worker_(NULL),
+      cleanup_callback_(cleanup_callback) {
 }
 
 DiskBasedCertCache::WriteWorker::~WriteWorker() {
-  if (cert_handle_)
-    X509Certificate::FreeOSCertHandle(cert_handle_);
-  if (entry_)
-    entry_->Close();
 }
 
 void DiskBasedCertCache::WriteWorker::Start() {
-  DCHECK_EQ(STATE_NONE, next_state_);
+  DCHECK(!entry_worker_);
 
-  next_state_ = STATE_OPEN;
-  int rv = DoLoop(OK);
-
-  if (rv == ERR_IO_PENDING)
+  if (!encoded_) {
+    Finish(ERR_FAILED, std::string());
     return;
+  }
 
-  Finish(rv);
+  entry_worker_ = new DiskCacheEntryWorker(
+      backend_, key_, DiskCacheEntryWorker::WRITE, der_encoded_cert_);
+  entry_worker_->Start(
+      base::Bind(&WriteWorker::Finish, base::Unretained(this)));
 }
 
 void DiskBasedCertCache::WriteWorker::AddCallback(
@@ -162,113 +132,12 @@ void DiskBasedCertCache::WriteWorker::AddCallback(
 }
 
 void DiskBasedCertCache::WriteWorker::Cancel() {
-  canceled_ = true;
-}
-
-void DiskBasedCertCache::WriteWorker::OnIOComplete(int rv) {
-  if (canceled_) {
-    Finish(ERR_FAILED);
-    return;
-  }
-
-  rv = DoLoop(rv);
-
-  if (rv == ERR_IO_PENDING)
-    return;
-
-  Finish(rv);
-}
-
-int DiskBasedCertCache::WriteWorker::DoLoop(int rv) {
-  do {
-    State state = next_state_;
-    next_state_ = STATE_NONE;
-    switch (state) {
-      case STATE_OPEN:
-        rv = DoOpen();
-        break;
-      case STATE_OPEN_COMPLETE:
-        rv = DoOpenComplete(rv);
-        break;
-      case STATE_CREATE:
-        rv = DoCreate();
-        break;
-      case STATE_CREATE_COMPLETE:
-        rv = DoCreateComplete(rv);
-        break;
-      case STATE_WRITE:
-        rv = DoWrite();
-        break;
-      case STATE_WRITE_COMPLETE:
-        rv = DoWriteComplete(rv);
-        break;
-      case STATE_NONE:
-        NOTREACHED();
-        break;
-    }
-  } while (rv != ERR_IO_PENDING && next_state_ != STATE_NONE);
-
-  return rv;
-}
-
-int DiskBasedCertCache::WriteWorker::DoOpen() {
-  next_state_ = STATE_OPEN_COMPLETE;
-  return backend_->OpenEntry(key_, &entry_, io_callback_);
-}
-
-int DiskBasedCertCache::WriteWorker::DoOpenComplete(int rv) {
-  // The entry doesn't exist yet, so we should create it.
-  if (rv < 0) {
-    next_state_ = STATE_CREATE;
-    return OK;
-  }
-
-  next_state_ = STATE_WRITE;
-  return OK;
-}
-
-int DiskBasedCertCache::WriteWorker::DoCreate() {
-  next_state_ = STATE_CREATE_COMPLETE;
-  return backend_->CreateEntry(key_, &entry_, io_callback_);
-}
-
-int DiskBasedCertCache::WriteWorker::DoCreateComplete(int rv) {
-  if (rv < 0)
-    return rv;
-
-  next_state_ = STATE_WRITE;
-  return OK;
-}
-
-int DiskBasedCertCache::WriteWorker::DoWrite() {
-  std::string write_data;
-  bool encoded = X509Certificate::GetDEREncoded(cert_handle_, &write_data);
-
-  if (!encoded)
-    return ERR_FAILED;
-
-  buffer_ = new IOBuffer(write_data.size());
-  io_buf_len_ = write_data.size();
-  memcpy(buffer_->data(), write_data.data(), io_buf_len_);
-
-  next_state_ = STATE_WRITE_COMPLETE;
-
-  return entry_->WriteData(0 /* index */,
-                           0 /* offset */,
-                           buffer_.get(),
-                           write_data.size(),
-                           io_callback_,
-                           true /* truncate */);
-}
-
-int DiskBasedCertCache::WriteWorker::DoWriteComplete(int rv) {
-  if (rv < io_buf_len_)
-    return ERR_FAILED;
-
-  return OK;
+  if (entry_worker_)
+    entry_worker_->Cancel();
 }
 
-void DiskBasedCertCache::WriteWorker::Finish(int rv) {
+void DiskBasedCertCache::WriteWorker::Finish(int rv, const std::string& data) {
+  entry_worker_ = NULL;
   cleanup_callback_.Run();
   cleanup_callback_.Reset();
   RunCallbacks(rv);
@@ -319,21 +188,8 @@ class DiskBasedCertCache::ReadWorker {
   void Cancel();
 
  private:
-  enum State {
-    STATE_OPEN,
-    STATE_OPEN_COMPLETE,
-    STATE_READ,
-    STATE_READ_COMPLETE,
-    STATE_NONE
-  };
-
-  void OnIOComplete(int rv);
-  int DoLoop(int rv);
-  int DoOpen();
-  int DoOpenComplete(int rv);
-  int DoRead();
-  int DoReadComplete(int rv);
-  void Finish(int rv);
+  // Called by |entry_worker_| with the certificate read from the cache.
+  void Finish(int rv, const std::string& data);
 
   // Invokes all of |user_callbacks_|
   void RunCallbacks();
@@ -341,17 +197,12 @@ class DiskBasedCertCache::ReadWorker {
   disk_cache::Backend* backend_;
   X509Certificate::OSCertHandle cert_handle_;
   std::string key_;
-  bool canceled_;
 
-  disk_cache::Entry* entry_;
-
-  State next_state_;
-  scoped_refptr<IOBuffer> buffer_;
-  int io_buf_len_;
+  // Deletes itself once it is done.
+  DiskCacheEntryWorker* entry_worker_;
 
   GetCallback cleanup_callback_;
   std::vector<GetCallback> user_callbacks_;
-  CompletionCallback io_callback_;
 };
 
 DiskBasedCertCache::ReadWorker::ReadWorker(disk_cache::Backend* backend,
@@ -360,31 +211,20 @@ DiskBasedCertCache::ReadWorker::ReadWorker(disk_cache::Backend* backend,
     : backend_(backend),
       cert_handle_(NULL),
       key_(key),
-      canceled_(false),
-      entry_(NULL),
-      next_state_(STATE_NONE),
-      io_buf_len_(0),
-      cleanup_callback_(cleanup_callback),
-      io_callback_(
-          base::Bind(&ReadWorker::OnIOComplete, base::Unretained(this))) {
+      entry_worker_(NULL),
+      cleanup_callback_(cleanup_callback) {
 }
 
 DiskBasedCertCache::ReadWorker::~ReadWorker() {
-  if (entry_)
-    entry_->Close();
   if (cert_handle_)
     X509Certificate::FreeOSCertHandle(cert_handle_);
 }
 
 void DiskBasedCertCache::ReadWorker::Start() {
-  DCHECK_EQ(STATE_NONE, next_state_);
-  next_state_ = STATE_OPEN;
-  int rv = DoLoop(OK);
-
-  if (rv == ERR_IO_PENDING)
-    return;
-
-  Finish(rv);
+  DCHECK(!entry_worker_);
+  entry_worker_ = new DiskCacheEntryWorker(
+      backend_, key_, DiskCacheEntryWorker::READ, std::string());
+  entry_worker_->Start(base::Bind(&ReadWorker::Finish, base::Unretained(this)));
 }
 
 void DiskBasedCertCache::ReadWorker::AddCallback(
@@ -393,91 +233,20 @@ void DiskBasedCertCache::ReadWorker::AddCallback(
 }
 
 void DiskBasedCertCache::ReadWorker::Cancel() {
-  canceled_ = true;
-}
-
-void DiskBasedCertCache::ReadWorker::OnIOComplete(int rv) {
-  if (canceled_) {
-    Finish(ERR_FAILED);
-    return;
-  }
-
-  rv = DoLoop(rv);
-
-  if (rv == ERR_IO_PENDING)
-    return;
-
-  Finish(rv);
-}
-
-int DiskBasedCertCache::ReadWorker::DoLoop(int rv) {
-  do {
-    State state = next_state_;
-    next_state_ = STATE_NONE;
-    switch (state) {
-      case STATE_OPEN:
-        rv = DoOpen();
-        break;
-      case STATE_OPEN_COMPLETE:
-        rv = DoOpenComplete(rv);
-        break;
-      case STATE_READ:
-        rv = DoRead();
-        break;
-      case STATE_READ_COMPLETE:
-        rv = DoReadComplete(rv);
-        break;
-      case STATE_NONE:
-        NOTREACHED();
-        break;
-    }
-  } while (rv != ERR_IO_PENDING && next_state_ != STATE_NONE);
-
-  return rv;
-}
-
-int DiskBasedCertCache::ReadWorker::DoOpen() {
-  next_state_ = STATE_OPEN_COMPLETE;
-  return backend_->OpenEntry(key_, &entry_, io_callback_);
+  if (entry_worker_)
+    entry_worker_->Cancel();
 }
 
-int DiskBasedCertCache::ReadWorker::DoOpenComplete(int rv) {
-  if (rv < 0) {
+void DiskBasedCertCache::ReadWorker::Finish(int rv, const std::string& data) {
+  entry_worker_ = NULL;
+  if (rv == OK) {
+    cert_handle_ = X509Certificate::CreateOSCertHandleFromBytes(data.data(),
+                                                                data.size());
+    RecordCacheResult(cert_handle_ ? DISK_CACHE_HIT : DISK_CACHE_ENTRY_CORRUPT);
+  } else if (rv != ERR_ABORTED) {
     RecordCacheResult(DISK_CACHE_ERROR);
-    return rv;
   }
 
-  next_state_ = STATE_READ;
-  return OK;
-}
-
-int DiskBasedCertCache::ReadWorker::DoRead() {
-  next_state_ = STATE_READ_COMPLETE;
-  io_buf_len_ = entry_->GetDataSize(0 /* index */);
-  buffer_ = new IOBuffer(io_buf_len_);
-  return entry_->ReadData(
-      0 /* index */, 0 /* offset */, buffer_.get(), io_buf_len_, io_callback_);
-}
-
-int DiskBasedCertCache::ReadWorker::DoReadComplete(int rv) {
-  // The cache should return the entire buffer length. If it does not,
-  // it is probably indicative of an issue other than corruption.
-  if (rv < io_buf_len_) {
-    RecordCacheResult(DISK_CACHE_ERROR);
-    return ERR_FAILED;
-  }
-  cert_handle_ = X509Certificate::CreateOSCertHandleFromBytes(buffer_->data(),
-                                                              io_buf_len_);
-  if (!cert_handle_) {
-    RecordCacheResult(DISK_CACHE_ENTRY_CORRUPT);
-    return ERR_FAILED;
-  }
-
-  RecordCacheResult(DISK_CACHE_HIT);
-  return OK;
-}
-
-void DiskBasedCertCache::ReadWorker::Finish(int rv) {
   cleanup_callback_.Run(cert_handle_);
   cleanup_callback_.Reset();
   RunCallbacks();
@@ -0,0 +1,153 @@
+// Copyright (c) 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/disk_based_cert_verifier_cache.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "base/rand_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/http/disk_cache_entry_worker.h"
+
+namespace net {
+
+namespace {
+
+// The key of the entry holding the current generation.
+const char kGenerationKey[] = "certverify:generation";
+
+}  // namespace
+
+DiskBasedCertVerifierCache::DiskBasedCertVerifierCache(
+    disk_cache::Backend* backend)
+    : backend_(backend),
+      generation_loaded_(false),
+      generation_(0),
+      weak_factory_(this) {
+  DCHECK(backend_);
+  StartWorker(kGenerationKey, false, std::string(),
+              base::Bind(&DiskBasedCertVerifierCache::OnGenerationLoaded,
+                         weak_factory_.GetWeakPtr()));
+}
+
+DiskBasedCertVerifierCache::~DiskBasedCertVerifierCache() {
+  for (std::set<DiskCacheEntryWorker*>::iterator it = workers_.begin();
+       it != workers_.end();
+       ++it) {
+    (*it)->Cancel();
+  }
+}
+
+void DiskBasedCertVerifierCache::Load(const std::string& key,
+                                      const LoadCallback& callback) {
+  DCHECK(!callback.is_null());
+  if (!generation_loaded_) {
+    pending_operations_.push_back(
+        base::Bind(&DiskBasedCertVerifierCache::Load,
+                   base::Unretained(this), key, callback));
+    return;
+  }
+  StartWorker(GetEntryKey(key), false, std::string(), callback);
+}
+
+void DiskBasedCertVerifierCache::Store(const std::string& key,
+                                       const std::string& data) {
+  DCHECK(!data.empty());
+  if (!generation_loaded_) {
+    pending_operations_.push_back(
+        base::Bind(&DiskBasedCertVerifierCache::Store,
+                   base::Unretained(this), key, data));
+    return;
+  }
+  StartWorker(GetEntryKey(key), true, data, LoadCallback());
+}
+
+void DiskBasedCertVerifierCache::Clear() {
+  if (!generation_loaded_) {
+    pending_operations_.push_back(
+        base::Bind(&DiskBasedCertVerifierCache::Clear,
+                   base::Unretained(this)));
+    return;
+  }
+  StartNewGeneration();
+}
+
+std::string DiskBasedCertVerifierCache::GetEntryKey(
+    const std::string& key) const {
+  return "certverify:" + base::Uint64ToString(generation_) + ":" + key;
+}
+
+void DiskBasedCertVerifierCache::StartNewGeneration() {
+  // A random generation does not repeat one used before, even if the entry
+  // holding the current generation has been evicted.
+  uint64 generation;
+  do {
+    generation = base::RandUint64();
+  } while (generation == generation_);
+  generation_ = generation;
+  StartWorker(kGenerationKey, true, base::Uint64ToString(generation_),
+              LoadCallback());
+}
+
+void DiskBasedCertVerifierCache::StartWorker(const std::string& entry_key,
+                                             bool write,
+                                             const std::string& data,
+                                             const LoadCallback& callback) {
+  DiskCacheEntryWorker* worker = new DiskCacheEntryWorker(
+      backend_,
+      entry_key,
+      write ? DiskCacheEntryWorker::WRITE : DiskCacheEntryWorker::READ,
+      data);
+  workers_.insert(worker);
+  worker->Start(base::Bind(&DiskBasedCertVerifierCache::FinishedOperation,
+                           weak_factory_.GetWeakPtr(),
+                           worker,
+                           callback,
+                           generation_));
+}
+
+void DiskBasedCertVerifierCache::FinishedOperation(
+    DiskCacheEntryWorker* worker,
+    const LoadCallback& callback,
+    uint64 generation,
+    int rv,
+    const std::string& data) {
+  workers_.erase(worker);
+  if (callback.is_null())
+    return;
+  // The entry may have been read synchronously, but loads must complete
+  // asynchronously.
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&DiskBasedCertVerifierCache::RunLoadCallback,
+                 weak_factory_.GetWeakPtr(), callback, generation, data));
+}
+
+void DiskBasedCertVerifierCache::RunLoadCallback(const LoadCallback& callback,
+                                                 uint64 generation,
+                                                 const std::string& data) {
+  // A result read under a generation that Clear() has since left behind is
+  // no longer valid.
+  callback.Run(generation == generation_ ? data : std::string());
+}
+
+void DiskBasedCertVerifierCache::OnGenerationLoaded(const std::string& data) {
+  DCHECK(!generation_loaded_);
+  generation_loaded_ = true;
+  // Without a stored generation, the results stored under earlier ones can
+  // not be told apart from valid ones, so a fresh generation is started.
+  if (data.empty() || !base::StringToUint64(data, &generation_))
+    StartNewGeneration();
+
+  std::vector<base::Closure> operations;
+  operations.swap(pending_operations_);
+  for (std::vector<base::Closure>::const_iterator it = operations.begin();
+       it != operations.end();
+       ++it) {
+    it->Run();
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,99 @@
+// Copyright (c) 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_HTTP_DISK_BASED_CERT_VERIFIER_CACHE_H
+#define NET_HTTP_DISK_BASED_CERT_VERIFIER_CACHE_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/compiler_specific.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/cert/multi_threaded_cert_verifier.h"
+
+namespace disk_cache {
+class Backend;
+}  // namespace disk_cache
+
+namespace net {
+
+class DiskCacheEntryWorker;
+
+// DiskBasedCertVerifierCache stores the results of MultiThreadedCertVerifier
+// in the cache, next to the certificates of DiskBasedCertCache, so that the
+// certificates verified before a restart need not be verified again.
+//
+// Results are stored in entries keyed by "certverify:<generation>:<key>".
+// Clear() moves to a new, random generation, which is itself stored in the
+// cache, so that the results of earlier generations are never read again and
+// are left for the cache to evict. A new generation is also started when the
+// stored one is missing, e.g. after it was evicted. Operations made before the
+// generation has been read are queued until it is, and loads that complete
+// after a Clear() return no data.
+class NET_EXPORT_PRIVATE DiskBasedCertVerifierCache
+    : public MultiThreadedCertVerifier::PersistentCache {
+ public:
+  // Initializes a new DiskBasedCertVerifierCache that will access the disk
+  // cache via |backend|.
+  explicit DiskBasedCertVerifierCache(disk_cache::Backend* backend);
+  virtual ~DiskBasedCertVerifierCache();
+
+  // MultiThreadedCertVerifier::PersistentCache implementation:
+  virtual void Load(const std::string& key,
+                    const LoadCallback& callback) OVERRIDE;
+  virtual void Store(const std::string& key, const std::string& data) OVERRIDE;
+  virtual void Clear() OVERRIDE;
+
+ private:
+  // Returns the cache key of the entry holding the data of |key|.
+  std::string GetEntryKey(const std::string& key) const;
+
+  // Moves to a new random generation and stores it in the cache.
+  void StartNewGeneration();
+
+  // Starts a worker reading the entry of |entry_key|, or writing |data| to it
+  // if |write| is true. |callback| is run with the data read, or an empty
+  // string on failure or for writes.
+  void StartWorker(const std::string& entry_key,
+                   bool write,
+                   const std::string& data,
+                   const LoadCallback& callback);
+
+  // Called from the workers via callback once they are done. |generation|
+  // is the one current when |worker| was started.
+  void FinishedOperation(DiskCacheEntryWorker* worker,
+                         const LoadCallback& callback,
+                         uint64 generation,
+                         int rv,
+                         const std::string& data);
+
+  // Completes a load started under |generation| with |data|, unless Clear()
+  // has been called since.
+  void RunLoadCallback(const LoadCallback& callback,
+                       uint64 generation,
+                       const std::string& data);
+
+  // Sets the generation to the one read from the cache into |data|, and runs
+  // the operations queued meanwhile.
+  void OnGenerationLoaded(const std::string& data);
+
+  disk_cache::Backend* backend_;
+
+  std::set<DiskCacheEntryWorker*> workers_;
+
+  bool generation_loaded_;
+  uint64 generation_;
+  std::vector<base::Closure> pending_operations_;
+
+  base::WeakPtrFactory<DiskBasedCertVerifierCache> weak_factory_;
+  DISALLOW_COPY_AND_ASSIGN(DiskBasedCertVerifierCache);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_DISK_BASED_CERT_VERIFIER_CACHE_H
@@ -0,0 +1,131 @@
+// Copyright (c) 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/disk_based_cert_verifier_cache.h"
+
+#include <string>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/test/perf_time_logger.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/test_completion_callback.h"
+#include "net/base/test_data_directory.h"
+#include "net/cert/cert_verify_proc.h"
+#include "net/cert/cert_verify_result.h"
+#include "net/cert/multi_threaded_cert_verifier.h"
+#include "net/cert/x509_certificate.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/test/cert_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// The number of times the browser is restarted, and the number of hosts it
+// connects to after each restart.
+const int kNumRestarts = 10;
+const int kNumHosts = 200;
+
+// A CertVerifyProc that accepts every certificate, and counts how many it
+// verified.
+class CountingCertVerifyProc : public CertVerifyProc {
+ public:
+  CountingCertVerifyProc() : verify_count_(0) {}
+
+  int verify_count() const { return verify_count_; }
+
+ private:
+  virtual ~CountingCertVerifyProc() {}
+
+  // CertVerifyProc implementation
+  virtual bool SupportsAdditionalTrustAnchors() const OVERRIDE {
+    return false;
+  }
+
+  virtual int VerifyInternal(X509Certificate* cert,
+                             const std::string& hostname,
+                             int flags,
+                             CRLSet* crl_set,
+                             const CertificateList& additional_trust_anchors,
+                             CertVerifyResult* verify_result) OVERRIDE {
+    ++verify_count_;
+    verify_result->Reset();
+    verify_result->verified_cert = cert;
+    return OK;
+  }
+
+  // Only read once the verifications are done.
+  int verify_count_;
+};
+
+// Verifies the certificate of every host after each of |kNumRestarts|
+// restarts, and returns how many verifications were run.
+int RunRestarts(X509Certificate* cert,
+                disk_cache::Backend* backend,
+                const char* name) {
+  scoped_refptr<CountingCertVerifyProc> verify_proc(
+      new CountingCertVerifyProc());
+  base::PerfTimeLogger timer(name);
+  for (int restart = 0; restart < kNumRestarts; ++restart) {
+    scoped_ptr<DiskBasedCertVerifierCache> persistent_cache;
+    MultiThreadedCertVerifier verifier(verify_proc.get());
+    if (backend) {
+      persistent_cache.reset(new DiskBasedCertVerifierCache(backend));
+      verifier.SetPersistentCache(persistent_cache.get());
+    }
+    for (int i = 0; i < kNumHosts; ++i) {
+      CertVerifyResult verify_result;
+      TestCompletionCallback callback;
+      CertVerifier::RequestHandle request_handle;
+      int rv = verifier.Verify(cert,
+                               base::StringPrintf("host%d.example.com", i),
+                               0,
+                               NULL,
+                               &verify_result,
+                               callback.callback(),
+                               &request_handle,
+                               BoundNetLog());
+      EXPECT_EQ(OK, callback.GetResult(rv));
+    }
+  }
+  timer.Done();
+  return verify_proc->verify_count();
+}
+
+}  // namespace
+
+TEST(DiskBasedCertVerifierCachePerfTest, VerificationsAcrossRestarts) {
+  // Results are not kept past the expiry of the certificate, so this uses one
+  // that has not expired.
+  scoped_refptr<X509Certificate> cert(
+      ImportCertFromFile(GetTestCertsDirectory(), "ocsp-test-root.pem"));
+  ASSERT_TRUE(cert.get());
+
+  const int memory_only_verifications =
+      RunRestarts(cert.get(), NULL, "CertVerifier_memory_cache_only");
+
+  scoped_ptr<disk_cache::Backend> backend(
+      disk_cache::MemBackendImpl::CreateBackend(10 * 1024 * 1024, NULL));
+  ASSERT_TRUE(backend.get());
+  const int persistent_verifications =
+      RunRestarts(cert.get(), backend.get(), "CertVerifier_persistent_cache");
+
+  EXPECT_EQ(kNumRestarts * kNumHosts, memory_only_verifications);
+  EXPECT_EQ(kNumHosts, persistent_verifications);
+
+  base::LogPerfResult("CertVerifier_memory_cache_only_verifications",
+                      memory_only_verifications, "verifications");
+  base::LogPerfResult("CertVerifier_persistent_cache_verifications",
+                      persistent_verifications, "verifications");
+  base::LogPerfResult(
+      "CertVerifier_verifications_avoided",
+      memory_only_verifications - persistent_verifications, "verifications");
+}
+
+}  // namespace net
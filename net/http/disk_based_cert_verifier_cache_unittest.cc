@@ -0,0 +1,154 @@
+// Copyright (c) 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/disk_based_cert_verifier_cache.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+void CopyData(std::string* out, bool* done, const std::string& data) {
+  *out = data;
+  *done = true;
+}
+
+class DiskBasedCertVerifierCacheTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    backend_ = disk_cache::MemBackendImpl::CreateBackend(1024 * 1024, NULL);
+    ASSERT_TRUE(backend_.get());
+    Restart();
+  }
+
+  virtual void TearDown() OVERRIDE {
+    cache_.reset();
+    base::MessageLoop::current()->RunUntilIdle();
+  }
+
+ protected:
+  // Replaces the cache with a new one on the same backend, as done at
+  // startup.
+  void Restart() {
+    cache_.reset();
+    base::MessageLoop::current()->RunUntilIdle();
+    cache_.reset(new DiskBasedCertVerifierCache(backend_.get()));
+  }
+
+  // Returns the data stored for |key|, or an empty string if there is none.
+  std::string LoadData(const std::string& key) {
+    std::string data;
+    bool done = false;
+    cache_->Load(key, base::Bind(&CopyData, &data, &done));
+    base::MessageLoop::current()->RunUntilIdle();
+    EXPECT_TRUE(done);
+    return data;
+  }
+
+  // Removes the entry holding the generation, as the cache may evict it.
+  void DoomGeneration() {
+    TestCompletionCallback callback;
+    int rv = backend_->DoomEntry("certverify:generation", callback.callback());
+    EXPECT_EQ(OK, callback.GetResult(rv));
+  }
+
+  scoped_ptr<disk_cache::Backend> backend_;
+  scoped_ptr<DiskBasedCertVerifierCache> cache_;
+};
+
+}  // namespace
+
+TEST_F(DiskBasedCertVerifierCacheTest, StoreAndLoad) {
+  EXPECT_EQ(std::string(), LoadData("a"));
+
+  cache_->Store("a", "data a");
+  cache_->Store("b", "data b");
+  cache_->Store("b", "new data b");
+  EXPECT_EQ("data a", LoadData("a"));
+
+  Restart();
+  EXPECT_EQ("data a", LoadData("a"));
+  EXPECT_EQ("new data b", LoadData("b"));
+  EXPECT_EQ(std::string(), LoadData("c"));
+}
+
+// Tests that loads complete asynchronously even when the backend does not.
+TEST_F(DiskBasedCertVerifierCacheTest, LoadIsAsynchronous) {
+  cache_->Store("a", "data a");
+  base::MessageLoop::current()->RunUntilIdle();
+
+  std::string data;
+  bool done = false;
+  cache_->Load("a", base::Bind(&CopyData, &data, &done));
+  EXPECT_FALSE(done);
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_TRUE(done);
+  EXPECT_EQ("data a", data);
+}
+
+TEST_F(DiskBasedCertVerifierCacheTest, Clear) {
+  cache_->Store("a", "data a");
+  EXPECT_EQ("data a", LoadData("a"));
+
+  cache_->Clear();
+  EXPECT_EQ(std::string(), LoadData("a"));
+  cache_->Store("b", "data b");
+
+  // The results stored before Clear() are not used after a restart either.
+  Restart();
+  EXPECT_EQ(std::string(), LoadData("a"));
+  EXPECT_EQ("data b", LoadData("b"));
+}
+
+// Tests that the results stored before Clear() are not used again when the
+// generation is lost, even after further calls to Clear().
+TEST_F(DiskBasedCertVerifierCacheTest, GenerationLost) {
+  cache_->Store("a", "data a");
+  cache_->Clear();
+  cache_->Store("b", "data b");
+  EXPECT_EQ("data b", LoadData("b"));
+
+  cache_.reset();
+  base::MessageLoop::current()->RunUntilIdle();
+  DoomGeneration();
+  Restart();
+  EXPECT_EQ(std::string(), LoadData("a"));
+  EXPECT_EQ(std::string(), LoadData("b"));
+
+  cache_->Clear();
+  EXPECT_EQ(std::string(), LoadData("a"));
+  EXPECT_EQ(std::string(), LoadData("b"));
+}
+
+// Tests that operations made before the generation is read apply in order,
+// and that a load completing after Clear() returns no data.
+TEST_F(DiskBasedCertVerifierCacheTest, OperationsWhileStarting) {
+  cache_->Store("a", "data a");
+  base::MessageLoop::current()->RunUntilIdle();
+
+  cache_.reset(new DiskBasedCertVerifierCache(backend_.get()));
+  std::string data;
+  bool done = false;
+  cache_->Load("a", base::Bind(&CopyData, &data, &done));
+  cache_->Clear();
+  cache_->Store("b", "data b");
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_TRUE(done);
+  EXPECT_EQ(std::string(), data);
+
+  EXPECT_EQ(std::string(), LoadData("a"));
+  EXPECT_EQ("data b", LoadData("b"));
+}
+
+}  // namespace net
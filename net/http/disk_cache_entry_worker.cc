@@ -0,0 +1,184 @@
+// Copyright (c) 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/disk_cache_entry_worker.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace net {
+
+DiskCacheEntryWorker::DiskCacheEntryWorker(disk_cache::Backend* backend,
+                                           const std::string& key,
+                                           Operation operation,
+                                           const std::string& data)
+    : backend_(backend),
+      key_(key),
+      operation_(operation),
+      data_(data),
+      canceled_(false),
+      entry_(NULL),
+      next_state_(STATE_NONE),
+      io_buf_len_(0),
+      io_callback_(base::Bind(&DiskCacheEntryWorker::OnIOComplete,
+                              base::Unretained(this))) {
+}
+
+DiskCacheEntryWorker::~DiskCacheEntryWorker() {
+  if (entry_)
+    entry_->Close();
+}
+
+void DiskCacheEntryWorker::Start(const DoneCallback& done_callback) {
+  DCHECK_EQ(STATE_NONE, next_state_);
+  DCHECK(!done_callback.is_null());
+  done_callback_ = done_callback;
+
+  next_state_ = STATE_OPEN;
+  int rv = DoLoop(OK);
+
+  if (rv == ERR_IO_PENDING)
+    return;
+
+  Finish(rv);
+}
+
+void DiskCacheEntryWorker::Cancel() {
+  canceled_ = true;
+}
+
+void DiskCacheEntryWorker::OnIOComplete(int rv) {
+  if (canceled_) {
+    Finish(ERR_ABORTED);
+    return;
+  }
+
+  rv = DoLoop(rv);
+
+  if (rv == ERR_IO_PENDING)
+    return;
+
+  Finish(rv);
+}
+
+int DiskCacheEntryWorker::DoLoop(int rv) {
+  do {
+    State state = next_state_;
+    next_state_ = STATE_NONE;
+    switch (state) {
+      case STATE_OPEN:
+        rv = DoOpen();
+        break;
+      case STATE_OPEN_COMPLETE:
+        rv = DoOpenComplete(rv);
+        break;
+      case STATE_CREATE:
+        rv = DoCreate();
+        break;
+      case STATE_CREATE_COMPLETE:
+        rv = DoCreateComplete(rv);
+        break;
+      case STATE_READ:
+        rv = DoRead();
+        break;
+      case STATE_READ_COMPLETE:
+        rv = DoReadComplete(rv);
+        break;
+      case STATE_WRITE:
+        rv = DoWrite();
+        break;
+      case STATE_WRITE_COMPLETE:
+        rv = DoWriteComplete(rv);
+        break;
+      case STATE_NONE:
+        NOTREACHED();
+        break;
+    }
+  } while (rv != ERR_IO_PENDING && next_state_ != STATE_NONE);
+
+  return rv;
+}
+
+int DiskCacheEntryWorker::DoOpen() {
+  next_state_ = STATE_OPEN_COMPLETE;
+  return backend_->OpenEntry(key_, &entry_, io_callback_);
+}
+
+int DiskCacheEntryWorker::DoOpenComplete(int rv) {
+  if (rv < 0) {
+    // There is nothing to read, but the entry can be created to write it.
+    if (operation_ == READ)
+      return rv;
+    next_state_ = STATE_CREATE;
+    return OK;
+  }
+
+  next_state_ = operation_ == READ ? STATE_READ : STATE_WRITE;
+  return OK;
+}
+
+int DiskCacheEntryWorker::DoCreate() {
+  next_state_ = STATE_CREATE_COMPLETE;
+  return backend_->CreateEntry(key_, &entry_, io_callback_);
+}
+
+int DiskCacheEntryWorker::DoCreateComplete(int rv) {
+  if (rv < 0)
+    return rv;
+
+  next_state_ = STATE_WRITE;
+  return OK;
+}
+
+int DiskCacheEntryWorker::DoRead() {
+  next_state_ = STATE_READ_COMPLETE;
+  io_buf_len_ = entry_->GetDataSize(0 /* index */);
+  buffer_ = new IOBuffer(io_buf_len_);
+  return entry_->ReadData(
+      0 /* index */, 0 /* offset */, buffer_.get(), io_buf_len_, io_callback_);
+}
+
+int DiskCacheEntryWorker::DoReadComplete(int rv) {
+  // The cache should return the entire buffer length. If it does not,
+  // it is probably indicative of an issue other than corruption.
+  if (rv < io_buf_len_)
+    return ERR_FAILED;
+
+  data_.assign(buffer_->data(), io_buf_len_);
+  return OK;
+}
+
+int DiskCacheEntryWorker::DoWrite() {
+  io_buf_len_ = data_.size();
+  buffer_ = new IOBuffer(io_buf_len_);
+  memcpy(buffer_->data(), data_.data(), io_buf_len_);
+
+  next_state_ = STATE_WRITE_COMPLETE;
+
+  return entry_->WriteData(0 /* index */,
+                           0 /* offset */,
+                           buffer_.get(),
+                           io_buf_len_,
+                           io_callback_,
+                           true /* truncate */);
+}
+
+int DiskCacheEntryWorker::DoWriteComplete(int rv) {
+  if (rv < io_buf_len_)
+    return ERR_FAILED;
+
+  return OK;
+}
+
+void DiskCacheEntryWorker::Finish(int rv) {
+  if (rv < 0 || operation_ == WRITE)
+    data_.clear();
+  done_callback_.Run(rv < 0 ? rv : OK, data_);
+  delete this;
+}
+
+}  // namespace net
@@ -0,0 +1,104 @@
+// Copyright (c) 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_HTTP_DISK_CACHE_ENTRY_WORKER_H
+#define NET_HTTP_DISK_CACHE_ENTRY_WORKER_H
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/memory/ref_counted.h"
+#include "net/base/completion_callback.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+class Backend;
+class Entry;
+}  // namespace disk_cache
+
+namespace net {
+
+class IOBuffer;
+
+// DiskCacheEntryWorker reads the data stored in the first stream of a
+// disk_cache::Entry, or writes it, creating the entry if it doesn't exist yet.
+// It is used by the caches that keep their own entries in the backend of the
+// HTTP cache, e.g. DiskBasedCertCache. Each worker performs a single operation,
+// and deletes itself once it is done.
+class NET_EXPORT_PRIVATE DiskCacheEntryWorker {
+ public:
+  enum Operation {
+    READ,
+    WRITE,
+  };
+
+  // Runs on completion with a net error code, or OK, and with the data read by
+  // a successful READ.
+  typedef base::Callback<void(int rv, const std::string& data)> DoneCallback;
+
+  // |backend| is the backend holding the entry of |key|. |data| is what a
+  // WRITE stores, and is ignored by a READ.
+  DiskCacheEntryWorker(disk_cache::Backend* backend,
+                       const std::string& key,
+                       Operation operation,
+                       const std::string& data);
+
+  ~DiskCacheEntryWorker();
+
+  // Starts the operation. |done_callback| may be run, and the worker deleted,
+  // before this returns.
+  void Start(const DoneCallback& done_callback);
+
+  // Signals the worker to abort early. |done_callback| is run with ERR_ABORTED
+  // upon the completion of any pending IO, and the worker is then deleted.
+  void Cancel();
+
+ private:
+  enum State {
+    STATE_OPEN,
+    STATE_OPEN_COMPLETE,
+    STATE_CREATE,
+    STATE_CREATE_COMPLETE,
+    STATE_READ,
+    STATE_READ_COMPLETE,
+    STATE_WRITE,
+    STATE_WRITE_COMPLETE,
+    STATE_NONE
+  };
+
+  void OnIOComplete(int rv);
+  int DoLoop(int rv);
+
+  int DoOpen();
+  int DoOpenComplete(int rv);
+  int DoCreate();
+  int DoCreateComplete(int rv);
+  int DoRead();
+  int DoReadComplete(int rv);
+  int DoWrite();
+  int DoWriteComplete(int rv);
+
+  void Finish(int rv);
+
+  disk_cache::Backend* backend_;
+  const std::string key_;
+  const Operation operation_;
+  std::string data_;
+  bool canceled_;
+
+  disk_cache::Entry* entry_;
+  State next_state_;
+  scoped_refptr<IOBuffer> buffer_;
+  int io_buf_len_;
+
+  DoneCallback done_callback_;
+  CompletionCallback io_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(DiskCacheEntryWorker);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_DISK_CACHE_ENTRY_WORKER_H
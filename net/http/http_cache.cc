@@ -46,6 +46,10 @@
 
 namespace {
 
+// Size of the reads used to store a response fetched by a background
+// validation.
+const int kAsyncValidationBufferSize = 32 * 1024;
+
 bool UseCertCache() {
   return base::FieldTrialList::FindFullName("CertCacheTrial") ==
          "ExperimentGroup";
@@ -102,7 +106,10 @@ HttpCache::ActiveEntry::ActiveEntry(disk_cache::Entry* entry)
     : disk_entry(entry),
       writer(NULL),
       will_process_pending_queue(false),
-      doomed(false) {
+      doomed(false),
+      streaming(false),
+      stored_body_size(0),
+      body_complete(false) {
 }
 
 HttpCache::ActiveEntry::~ActiveEntry() {
@@ -276,6 +283,83 @@ void HttpCache::MetadataWriter::OnIOComplete(int result) {
 
 //-----------------------------------------------------------------------------
 
+// Validates a cache entry on behalf of a request that was given the stale
+// response, and stores the new response if the server sends one. The
+// validation is owned by the HttpCache.
+class HttpCache::AsyncValidation {
+ public:
+  AsyncValidation(HttpCache* cache,
+                  const HttpRequestInfo& request,
+                  const std::string& key)
+      : cache_(cache),
+        request_info_(request),
+        key_(key) {
+    request_info_.load_flags |= LOAD_VALIDATE_CACHE;
+  }
+
+  ~AsyncValidation() {}
+
+  void Start();
+
+ private:
+  void OnStartComplete(int result);
+  void Read();
+  void OnReadComplete(int result);
+  void Done();
+
+  HttpCache* cache_;
+  HttpRequestInfo request_info_;
+  std::string key_;
+  scoped_ptr<HttpCache::Transaction> transaction_;
+  scoped_refptr<IOBuffer> buf_;
+  DISALLOW_COPY_AND_ASSIGN(AsyncValidation);
+};
+
+void HttpCache::AsyncValidation::Start() {
+  transaction_.reset(new HttpCache::Transaction(IDLE, cache_));
+  int rv = transaction_->Start(
+      &request_info_,
+      base::Bind(&AsyncValidation::OnStartComplete, base::Unretained(this)),
+      BoundNetLog());
+  if (rv != ERR_IO_PENDING)
+    OnStartComplete(rv);
+}
+
+void HttpCache::AsyncValidation::OnStartComplete(int result) {
+  // Unless the server sent a new response that has to be stored, the entry is
+  // already up to date.
+  if (result != OK || transaction_->mode() != Transaction::WRITE)
+    return Done();
+
+  buf_ = new IOBuffer(kAsyncValidationBufferSize);
+  Read();
+}
+
+void HttpCache::AsyncValidation::Read() {
+  int rv;
+  do {
+    rv = transaction_->Read(
+        buf_.get(), kAsyncValidationBufferSize,
+        base::Bind(&AsyncValidation::OnReadComplete, base::Unretained(this)));
+  } while (rv > 0);
+
+  if (rv != ERR_IO_PENDING)
+    Done();
+}
+
+void HttpCache::AsyncValidation::OnReadComplete(int result) {
+  if (result > 0)
+    return Read();
+  Done();
+}
+
+void HttpCache::AsyncValidation::Done() {
+  // Deletes |this|.
+  cache_->OnAsyncValidationComplete(key_);
+}
+
+//-----------------------------------------------------------------------------
+
 class HttpCache::QuicServerInfoFactoryAdaptor : public QuicServerInfoFactory {
  public:
   QuicServerInfoFactoryAdaptor(HttpCache* http_cache)
@@ -336,6 +420,9 @@ HttpCache::~HttpCache() {
   // could see an inconsistent object (half destroyed).
   weak_factory_.InvalidateWeakPtrs();
 
+  // The transactions of background validations see the invalid cache as well.
+  STLDeleteValues(&async_validations_);
+
   // If we have any active entries remaining, then we need to deactivate them.
   // We may have some pending calls to OnProcessPendingQueue, but since those
   // won't run (due to our destruction), we can simply ignore the corresponding
@@ -345,6 +432,7 @@ HttpCache::~HttpCache() {
     entry->will_process_pending_queue = false;
     entry->pending_queue.clear();
     entry->readers.clear();
+    entry->streaming_readers.clear();
     entry->writer = NULL;
     DeactivateEntry(entry);
   }
@@ -825,13 +913,18 @@ int HttpCache::AddTransactionToEntry(ActiveEntry* entry, Transaction* trans) {
 
   // We implement a basic reader/writer lock for the disk cache entry.  If
   // there is already a writer, then everyone has to wait for the writer to
-  // finish before they can access the cache entry.  There can be multiple
-  // readers.
+  // finish before they can access the cache entry, except for transactions
+  // that can use the response the writer is storing: those read it as it
+  // arrives.  There can be multiple readers.
   //
   // NOTE: If the transaction can only write, then the entry should not be in
   // use (since any existing entry should have already been doomed).
 
   if (entry->writer || entry->will_process_pending_queue) {
+    if (entry->streaming && trans->CanStreamFrom(entry->writer)) {
+      entry->streaming_readers.push_back(trans);
+      return OK;
+    }
     entry->pending_queue.push_back(trans);
     return ERR_IO_PENDING;
   }
@@ -865,9 +958,7 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
   if (entry->will_process_pending_queue && entry->readers.empty())
     return;
 
-  if (entry->writer) {
-    DCHECK(trans == entry->writer);
-
+  if (entry->writer == trans) {
     // Assume there was a failure.
     bool success = false;
     if (cancel) {
@@ -889,6 +980,15 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
   DCHECK(entry->readers.empty());
 
   entry->writer = NULL;
+  entry->streaming = false;
+
+  // Transactions that were streaming the response go on reading whatever was
+  // stored, as regular readers.
+  entry->readers.swap(entry->streaming_readers);
+  for (TransactionList::iterator it = entry->readers.begin();
+       it != entry->readers.end(); ++it) {
+    (*it)->OnWriterProgress();
+  }
 
   if (success) {
     ProcessPendingQueue(entry);
@@ -899,8 +999,13 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
     TransactionList pending_queue;
     pending_queue.swap(entry->pending_queue);
 
-    entry->disk_entry->Doom();
-    DestroyEntry(entry);
+    if (entry->readers.empty()) {
+      entry->disk_entry->Doom();
+      DestroyEntry(entry);
+    } else if (!entry->doomed) {
+      // The readers keep the entry open, but nobody else should use it.
+      DoomEntry(entry->disk_entry->GetKey(), NULL);
+    }
 
     // We need to do something about these pending entries, which now need to
     // be added to a new entry.
@@ -913,7 +1018,15 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
 }
 
 void HttpCache::DoneReadingFromEntry(ActiveEntry* entry, Transaction* trans) {
-  DCHECK(!entry->writer);
+  // |trans| may be reading the response while it is being stored.
+  TransactionList::iterator streaming_it =
+      std::find(entry->streaming_readers.begin(),
+                entry->streaming_readers.end(), trans);
+  if (streaming_it != entry->streaming_readers.end()) {
+    DCHECK(entry->writer);
+    entry->streaming_readers.erase(streaming_it);
+    return;
+  }
 
   TransactionList::iterator it =
       std::find(entry->readers.begin(), entry->readers.end(), trans);
@@ -928,6 +1041,7 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   DCHECK(entry->writer);
   DCHECK(entry->writer->mode() == Transaction::READ_WRITE);
   DCHECK(entry->readers.empty());
+  DCHECK(entry->streaming_readers.empty());
 
   Transaction* trans = entry->writer;
 
@@ -937,6 +1051,68 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   ProcessPendingQueue(entry);
 }
 
+void HttpCache::OnResponseDataStored(ActiveEntry* entry,
+                                     int body_size,
+                                     bool body_complete) {
+  DCHECK(entry->writer);
+  DCHECK_GE(body_size, entry->stored_body_size);
+
+  entry->stored_body_size = body_size;
+  entry->body_complete = body_complete;
+  if (!entry->streaming) {
+    entry->streaming = true;
+
+    // Transactions that were queued behind the writer and can use its
+    // response no longer have to wait for it. They are started from a fresh
+    // stack, as we are within the writer's state machine.
+    base::MessageLoop::current()->PostTask(
+        FROM_HERE,
+        base::Bind(&HttpCache::OnStreamingStarted, GetWeakPtr(),
+                   entry->disk_entry->GetKey()));
+    return;
+  }
+
+  for (TransactionList::iterator it = entry->streaming_readers.begin();
+       it != entry->streaming_readers.end(); ++it) {
+    (*it)->OnWriterProgress();
+  }
+}
+
+void HttpCache::StopStreaming(ActiveEntry* entry, bool body_complete) {
+  DCHECK(entry->writer);
+  if (!entry->streaming)
+    return;
+
+  entry->streaming = false;
+  entry->body_complete = body_complete;
+  for (TransactionList::iterator it = entry->streaming_readers.begin();
+       it != entry->streaming_readers.end(); ++it) {
+    (*it)->OnWriterProgress();
+  }
+}
+
+void HttpCache::ValidateEntryInBackground(const HttpRequestInfo& request,
+                                          const std::string& key) {
+  if (async_validations_.find(key) != async_validations_.end())
+    return;
+
+  async_validations_[key] = new AsyncValidation(this, request, key);
+
+  // The validation has to wait for the transaction that is using the entry, so
+  // there is no need to start it right away.
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&HttpCache::OnStartAsyncValidation, GetWeakPtr(), key));
+}
+
+void HttpCache::OnAsyncValidationComplete(const std::string& key) {
+  AsyncValidationMap::iterator it = async_validations_.find(key);
+  DCHECK(it != async_validations_.end());
+  AsyncValidation* validation = it->second;
+  async_validations_.erase(it);
+  delete validation;
+}
+
 LoadState HttpCache::GetLoadStateForPendingTransaction(
       const Transaction* trans) {
   ActiveEntriesMap::const_iterator i = active_entries_.find(trans->key());
@@ -1062,6 +1238,35 @@ void HttpCache::OnProcessPendingQueue(ActiveEntry* entry) {
   }
 }
 
+void HttpCache::OnStartAsyncValidation(const std::string& key) {
+  AsyncValidationMap::iterator it = async_validations_.find(key);
+  if (it != async_validations_.end())
+    it->second->Start();
+}
+
+void HttpCache::OnStreamingStarted(const std::string& key) {
+  // Starting a transaction may end the writer, or destroy the entry, so look
+  // it up again before starting the next one.
+  for (;;) {
+    ActiveEntry* entry = FindActiveEntry(key);
+    if (!entry || !entry->streaming)
+      return;
+
+    TransactionList::iterator it = entry->pending_queue.begin();
+    while (it != entry->pending_queue.end() &&
+           !(*it)->CanStreamFrom(entry->writer)) {
+      ++it;
+    }
+    if (it == entry->pending_queue.end())
+      return;
+
+    Transaction* next = *it;
+    entry->pending_queue.erase(it);
+    entry->streaming_readers.push_back(next);
+    next->io_callback().Run(OK);
+  }
+}
+
 void HttpCache::OnIOComplete(int result, PendingOp* pending_op) {
   WorkItemOperation op = pending_op->writer->operation();
 
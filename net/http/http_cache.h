@@ -230,6 +230,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     kNumCacheEntryDataIndices
   };
 
+  class AsyncValidation;
   class MetadataWriter;
   class QuicServerInfoFactoryAdaptor;
   class Transaction;
@@ -251,12 +252,25 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     TransactionList    pending_queue;
     bool               will_process_pending_queue;
     bool               doomed;
+
+    // Transactions reading the response while |writer| is still storing it.
+    // They become regular |readers| once the writer is done.
+    TransactionList    streaming_readers;
+    // True while |writer| is storing a response body that other transactions
+    // may read as it arrives.
+    bool               streaming;
+    // Size of the response body stored by |writer| so far. Streaming readers
+    // don't read past this point.
+    int                stored_body_size;
+    // True once |writer| has stored the whole response body.
+    bool               body_complete;
   };
 
   typedef base::hash_map<std::string, ActiveEntry*> ActiveEntriesMap;
   typedef base::hash_map<std::string, PendingOp*> PendingOpsMap;
   typedef std::set<ActiveEntry*> ActiveEntriesSet;
   typedef base::hash_map<std::string, int> PlaybackCacheMap;
+  typedef base::hash_map<std::string, AsyncValidation*> AsyncValidationMap;
 
   // Methods ------------------------------------------------------------------
 
@@ -353,6 +367,29 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // transactions can start reading from this entry.
   void ConvertWriterToReader(ActiveEntry* entry);
 
+  // Called by the writer of |entry| every time it appends to the response
+  // body; |body_size| is the size of the body stored so far, and
+  // |body_complete| is true once it is the whole body. The first call lets the
+  // transactions that can use the response stop waiting for the writer and
+  // read the body as it is stored.
+  void OnResponseDataStored(ActiveEntry* entry,
+                            int body_size,
+                            bool body_complete);
+
+  // Called by the writer of |entry| when it won't store any more of the
+  // response body. |body_complete| is true if the whole body was stored.
+  void StopStreaming(ActiveEntry* entry, bool body_complete);
+
+  // Validates the entry selected by |key| in the background, using |request|,
+  // unless that is already being done. This is used to update a stale response
+  // that was returned without validation (stale-while-revalidate).
+  void ValidateEntryInBackground(const HttpRequestInfo& request,
+                                 const std::string& key);
+
+  // Called when the background validation of the entry selected by |key| is
+  // done.
+  void OnAsyncValidationComplete(const std::string& key);
+
   // Returns the LoadState of the provided pending transaction.
   LoadState GetLoadStateForPendingTransaction(const Transaction* trans);
 
@@ -378,6 +415,12 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
 
   void OnProcessPendingQueue(ActiveEntry* entry);
 
+  void OnStartAsyncValidation(const std::string& key);
+
+  // Starts the transactions in the pending queue of the entry for |key| that
+  // can read the response its writer is storing.
+  void OnStreamingStarted(const std::string& key);
+
   // Callbacks ----------------------------------------------------------------
 
   // Processes BackendCallback notifications.
@@ -426,6 +469,9 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
 
   scoped_ptr<PlaybackCacheMap> playback_cache_map_;
 
+  // The validations running in the background, indexed by cache key.
+  AsyncValidationMap async_validations_;
+
   base::WeakPtrFactory<HttpCache> weak_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(HttpCache);
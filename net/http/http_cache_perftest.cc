@@ -0,0 +1,140 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_cache.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/http/http_transaction.h"
+#include "net/http/http_transaction_test_util.h"
+#include "net/http/mock_http_cache.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumTransactions = 10;
+const int kBodySize = 4 * 1024 * 1024;
+const int kReadSize = 32 * 1024;
+
+// Reads a whole response through the cache, recording when the first byte of
+// the body arrived.
+class CacheReader {
+ public:
+  CacheReader(MockHttpCache* cache, const MockHttpRequest* request)
+      : cache_(cache),
+        request_(request),
+        buf_(new IOBuffer(kReadSize)),
+        bytes_read_(0),
+        result_(ERR_IO_PENDING) {}
+
+  void Start() {
+    ASSERT_EQ(OK, cache_->CreateTransaction(&trans_));
+    int rv = trans_->Start(request_,
+                           base::Bind(&CacheReader::OnStartComplete,
+                                      base::Unretained(this)),
+                           BoundNetLog());
+    if (rv != ERR_IO_PENDING)
+      OnStartComplete(rv);
+  }
+
+  bool done() const { return result_ != ERR_IO_PENDING; }
+  int result() const { return result_; }
+  int bytes_read() const { return bytes_read_; }
+  base::TimeTicks first_byte_time() const { return first_byte_time_; }
+
+ private:
+  void OnStartComplete(int rv) {
+    if (rv != OK) {
+      result_ = rv;
+      return;
+    }
+    Read();
+  }
+
+  void Read() {
+    for (;;) {
+      int rv = trans_->Read(buf_.get(), kReadSize,
+                            base::Bind(&CacheReader::OnReadComplete,
+                                       base::Unretained(this)));
+      if (rv == ERR_IO_PENDING || !HandleRead(rv))
+        return;
+    }
+  }
+
+  void OnReadComplete(int rv) {
+    if (HandleRead(rv))
+      Read();
+  }
+
+  // Returns true if there is more to read.
+  bool HandleRead(int rv) {
+    if (rv <= 0) {
+      result_ = rv;
+      return false;
+    }
+    if (first_byte_time_.is_null())
+      first_byte_time_ = base::TimeTicks::Now();
+    bytes_read_ += rv;
+    return true;
+  }
+
+  MockHttpCache* cache_;
+  const MockHttpRequest* request_;
+  scoped_ptr<HttpTransaction> trans_;
+  scoped_refptr<IOBuffer> buf_;
+  int bytes_read_;
+  int result_;
+  base::TimeTicks first_byte_time_;
+};
+
+// Measures how long concurrent requests for the same resource wait for the
+// first byte of the body, while the first one is downloading it.
+TEST(HttpCachePerfTest, ConcurrentReadersTimeToFirstByte) {
+  base::MessageLoopForIO message_loop;
+  MockHttpCache cache;
+
+  const std::string body(kBodySize, 'x');
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.data = body.c_str();
+  MockHttpRequest request(transaction);
+
+  ScopedVector<CacheReader> readers;
+  for (int i = 0; i < kNumTransactions; ++i)
+    readers.push_back(new CacheReader(&cache, &request));
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumTransactions; ++i)
+    readers[i]->Start();
+  base::MessageLoop::current()->RunUntilIdle();
+
+  base::TimeDelta total_wait;
+  for (int i = 0; i < kNumTransactions; ++i) {
+    ASSERT_TRUE(readers[i]->done());
+    EXPECT_EQ(OK, readers[i]->result());
+    EXPECT_EQ(kBodySize, readers[i]->bytes_read());
+    if (i > 0)
+      total_wait += readers[i]->first_byte_time() - start;
+  }
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+
+  base::LogPerfResult("HttpCache_concurrent_readers_time_to_first_byte",
+                      total_wait.InMillisecondsF() / (kNumTransactions - 1),
+                      "ms");
+}
+
+}  // namespace
+
+}  // namespace net
@@ -332,6 +332,8 @@ HttpCache::Transaction::Transaction(
       vary_mismatch_(false),
       couldnt_conditionalize_request_(false),
       bypass_lock_for_test_(false),
+      streaming_(false),
+      waiting_for_writer_(false),
       io_buf_len_(0),
       read_offset_(0),
       effective_load_flags_(0),
@@ -420,6 +422,34 @@ const BoundNetLog& HttpCache::Transaction::net_log() const {
   return net_log_;
 }
 
+bool HttpCache::Transaction::CanStreamFrom(const Transaction* writer) const {
+  if (partial_.get() || request_->method != "GET")
+    return false;
+
+  // The writer may be storing a response that was validated by its consumer,
+  // and not the one we would get.
+  if (writer->external_validation_.initialized)
+    return false;
+
+  // The response is not complete yet, so the only way to use it is as is.
+  if (mode_ == READ)
+    return true;
+  return mode_ == READ_WRITE &&
+         !ResponseRequiresValidation(writer->response_, NULL);
+}
+
+void HttpCache::Transaction::OnWriterProgress() {
+  if (!waiting_for_writer_)
+    return;
+
+  // Don't resume reading from within the writer's state machine.
+  waiting_for_writer_ = false;
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&HttpCache::Transaction::OnIOComplete,
+                 weak_factory_.GetWeakPtr(), OK));
+}
+
 int HttpCache::Transaction::Start(const HttpRequestInfo* request,
                                   const CompletionCallback& callback,
                                   const BoundNetLog& net_log) {
@@ -582,6 +612,7 @@ void HttpCache::Transaction::StopCaching() {
   if (cache_.get() && entry_ && (mode_ & WRITE) && network_trans_.get() &&
       !is_sparse_ && !range_requested_) {
     mode_ = NONE;
+    cache_->StopStreaming(entry_, false);
   }
 }
 
@@ -627,6 +658,10 @@ const HttpResponseInfo* HttpCache::Transaction::GetResponseInfo() const {
 }
 
 LoadState HttpCache::Transaction::GetLoadState() const {
+  // While we wait for more of the response, we are as busy as the writer.
+  if (waiting_for_writer_ && cache_.get())
+    return entry_->writer->GetWriterLoadState();
+
   LoadState state = GetWriterLoadState();
   if (state != LOAD_STATE_WAITING_FOR_CACHE)
     return state;
@@ -855,6 +890,13 @@ int HttpCache::Transaction::DoLoop(int result) {
       case STATE_NETWORK_READ_COMPLETE:
         rv = DoNetworkReadComplete(rv);
         break;
+      case STATE_RESUME_STREAMING:
+        DCHECK_EQ(OK, rv);
+        rv = DoResumeStreaming();
+        break;
+      case STATE_RESUME_STREAMING_COMPLETE:
+        rv = DoResumeStreamingComplete(rv);
+        break;
       case STATE_INIT_ENTRY:
         DCHECK_EQ(OK, rv);
         rv = DoInitEntry();
@@ -1254,6 +1296,49 @@ int HttpCache::Transaction::DoNetworkReadComplete(int result) {
   return result;
 }
 
+int HttpCache::Transaction::DoResumeStreaming() {
+  DCHECK_EQ(NONE, mode_);
+  DCHECK(!network_trans_.get());
+
+  if (!cache_.get())
+    return ERR_UNEXPECTED;
+
+  int rv = cache_->network_layer_->CreateTransaction(priority_,
+                                                     &network_trans_);
+  if (rv != OK)
+    return rv;
+
+  next_state_ = STATE_RESUME_STREAMING_COMPLETE;
+  return network_trans_->Start(request_, io_callback_, net_log_);
+}
+
+int HttpCache::Transaction::DoResumeStreamingComplete(int result) {
+  if (result != OK)
+    return result;
+
+  // We can only go on if the server sent exactly the part of the response we
+  // don't have.
+  const HttpResponseHeaders* headers =
+      network_trans_->GetResponseInfo()->headers.get();
+  if (read_offset_ == 0) {
+    if (headers->response_code() != 200)
+      return ERR_CACHE_READ_FAILURE;
+  } else {
+    int64 first_byte_position;
+    int64 last_byte_position;
+    int64 instance_length;
+    if (headers->response_code() != 206 ||
+        !headers->GetContentRange(&first_byte_position, &last_byte_position,
+                                  &instance_length) ||
+        first_byte_position != read_offset_) {
+      return ERR_CACHE_READ_FAILURE;
+    }
+  }
+
+  next_state_ = STATE_NETWORK_READ;
+  return OK;
+}
+
 int HttpCache::Transaction::DoInitEntry() {
   DCHECK(!new_entry_);
 
@@ -1457,6 +1542,14 @@ int HttpCache::Transaction::DoAddToEntryComplete(int result) {
     return result;
   }
 
+  if (entry_->writer && entry_->writer != this) {
+    // The writer is still storing the response; we read it as it arrives,
+    // without validating it again.
+    DCHECK(mode_ & READ);
+    streaming_ = true;
+    mode_ = READ;
+  }
+
   if (mode_ == WRITE) {
     if (partial_.get())
       partial_->RestoreHeaders(&custom_request_->extra_headers);
@@ -1796,6 +1889,21 @@ int HttpCache::Transaction::DoCacheQueryDataComplete(int result) {
 
 int HttpCache::Transaction::DoCacheReadData() {
   DCHECK(entry_);
+
+  if (entry_->writer && !entry_->body_complete) {
+    // The response is still being stored; only read what is there already.
+    DCHECK(streaming_);
+    int available = entry_->stored_body_size - read_offset_;
+    if (available <= 0) {
+      if (!entry_->streaming)
+        return ResumeStreamingFromNetwork();
+      waiting_for_writer_ = true;
+      next_state_ = STATE_CACHE_READ_DATA;
+      return ERR_IO_PENDING;
+    }
+    io_buf_len_ = std::min(io_buf_len_, available);
+  }
+
   next_state_ = STATE_CACHE_READ_DATA_COMPLETE;
 
   if (net_log_.IsLogging())
@@ -1829,6 +1937,9 @@ int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
   if (result > 0) {
     read_offset_ += result;
   } else if (result == 0) {  // End of file.
+    // The writer may have left before storing the whole response.
+    if (streaming_ && !entry_->body_complete)
+      return ResumeStreamingFromNetwork();
     RecordHistograms();
     cache_->DoneReadingFromEntry(entry_, this);
     entry_ = NULL;
@@ -1867,11 +1978,20 @@ int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
     // We want to ignore errors writing to disk and just keep reading from
     // the network.
     result = write_len_;
-  } else if (!done_reading_ && entry_) {
+  } else if (entry_) {
     int current_size = entry_->disk_entry->GetDataSize(kResponseContentIndex);
-    int64 body_size = response_.headers->GetContentLength();
-    if (body_size >= 0 && body_size <= current_size)
-      done_reading_ = true;
+    if (!done_reading_) {
+      int64 body_size = response_.headers->GetContentLength();
+      if (body_size >= 0 && body_size <= current_size)
+        done_reading_ = true;
+    }
+
+    // Let other requests for this resource read what we just stored.
+    if (result > 0 && mode_ == WRITE && !partial_.get() &&
+        request_->method == "GET" &&
+        response_.headers->response_code() == 200) {
+      cache_->OnResponseDataStored(entry_, current_size, done_reading_);
+    }
   }
 
   if (partial_.get()) {
@@ -1885,8 +2005,11 @@ int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
     // End of file. This may be the result of a connection problem so see if we
     // have to keep the entry around to be flagged as truncated later on.
     if (done_reading_ || !entry_ || partial_.get() ||
-        response_.headers->GetContentLength() <= 0)
+        response_.headers->GetContentLength() <= 0) {
+      if (entry_)
+        cache_->StopStreaming(entry_, true);
       DoneWritingToEntry(true);
+    }
   }
 
   return result;
@@ -2112,6 +2235,13 @@ int HttpCache::Transaction::BeginCacheValidation() {
 
   bool skip_validation = !RequiresValidation();
 
+  if (!skip_validation && CanServeStaleWhileRevalidating()) {
+    // Return the stale response right away, and let the cache update the
+    // entry on its own.
+    skip_validation = true;
+    cache_->ValidateEntryInBackground(*request_, cache_key_);
+  }
+
   if (request_->method == "HEAD" &&
       (truncated_ || response_.headers->response_code() == 206)) {
     DCHECK(!partial_);
@@ -2296,6 +2426,12 @@ int HttpCache::Transaction::RestartNetworkRequestWithAuth(
 }
 
 bool HttpCache::Transaction::RequiresValidation() {
+  return ResponseRequiresValidation(response_, &vary_mismatch_);
+}
+
+bool HttpCache::Transaction::ResponseRequiresValidation(
+    const HttpResponseInfo& response,
+    bool* vary_mismatch) const {
   // TODO(darin): need to do more work here:
   //  - make sure we have a matching request method
   //  - watch out for cached responses that depend on authentication
@@ -2304,10 +2440,11 @@ bool HttpCache::Transaction::RequiresValidation() {
   if (cache_->mode() == net::HttpCache::PLAYBACK)
     return false;
 
-  if (response_.vary_data.is_valid() &&
-      !response_.vary_data.MatchesRequest(*request_,
-                                          *response_.headers.get())) {
-    vary_mismatch_ = true;
+  if (response.vary_data.is_valid() &&
+      !response.vary_data.MatchesRequest(*request_,
+                                         *response.headers.get())) {
+    if (vary_mismatch)
+      *vary_mismatch = true;
     return true;
   }
 
@@ -2320,14 +2457,43 @@ bool HttpCache::Transaction::RequiresValidation() {
   if (request_->method == "PUT" || request_->method == "DELETE")
     return true;
 
-  if (response_.headers->RequiresValidation(
-          response_.request_time, response_.response_time, Time::Now())) {
+  if (response.headers->RequiresValidation(
+          response.request_time, response.response_time, Time::Now())) {
     return true;
   }
 
   return false;
 }
 
+bool HttpCache::Transaction::CanServeStaleWhileRevalidating() const {
+  if (cache_->mode() != NORMAL || partial_.get() || truncated_ ||
+      vary_mismatch_ || external_validation_.initialized ||
+      request_->method != "GET" ||
+      (effective_load_flags_ & LOAD_VALIDATE_CACHE)) {
+    return false;
+  }
+
+  if (response_.headers->response_code() != 200 ||
+      response_.headers->HasHeaderValue("cache-control", "no-cache") ||
+      response_.headers->HasHeaderValue("cache-control", "must-revalidate") ||
+      response_.headers->HasHeaderValue("pragma", "no-cache")) {
+    return false;
+  }
+
+  TimeDelta stale_while_revalidate;
+  if (!response_.headers->GetStaleWhileRevalidateValue(
+          &stale_while_revalidate) ||
+      stale_while_revalidate <= TimeDelta()) {
+    return false;
+  }
+
+  TimeDelta lifetime =
+      response_.headers->GetFreshnessLifetime(response_.response_time);
+  TimeDelta current_age = response_.headers->GetCurrentAge(
+      response_.request_time, response_.response_time, Time::Now());
+  return current_age < lifetime + stale_while_revalidate;
+}
+
 bool HttpCache::Transaction::ConditionalizeRequest() {
   DCHECK(response_.headers.get());
 
@@ -2713,6 +2879,43 @@ int HttpCache::Transaction::OnCacheReadError(int result, bool restart) {
   return ERR_CACHE_READ_FAILURE;
 }
 
+int HttpCache::Transaction::ResumeStreamingFromNetwork() {
+  DCHECK(streaming_);
+  DCHECK(entry_);
+
+  // Once we returned part of the body, we can only ask for the rest of the
+  // same response.
+  std::string validator;
+  if (read_offset_ > 0) {
+    if (response_.headers->GetHttpVersion() >= HttpVersion(1, 1))
+      response_.headers->EnumerateHeader(NULL, "etag", &validator);
+    if (validator.empty())
+      response_.headers->EnumerateHeader(NULL, "last-modified", &validator);
+    if (validator.empty() || !response_.headers->HasStrongValidators())
+      return ERR_CACHE_READ_FAILURE;
+  }
+
+  UpdateTransactionPattern(PATTERN_NOT_COVERED);
+  cache_->DoneReadingFromEntry(entry_, this);
+  entry_ = NULL;
+  mode_ = NONE;
+
+  if (read_offset_ > 0) {
+    if (!custom_request_.get()) {
+      custom_request_.reset(new HttpRequestInfo(*request_));
+      request_ = custom_request_.get();
+    }
+    custom_request_->extra_headers.SetHeader(
+        HttpRequestHeaders::kRange,
+        base::StringPrintf("bytes=%d-", read_offset_));
+    custom_request_->extra_headers.SetHeader(HttpRequestHeaders::kIfRange,
+                                             validator);
+  }
+
+  next_state_ = STATE_RESUME_STREAMING;
+  return OK;
+}
+
 void HttpCache::Transaction::OnAddToEntryTimeout(base::TimeTicks start_time) {
   if (entry_lock_waiting_since_ != start_time)
     return;
@@ -101,6 +101,15 @@ class HttpCache::Transaction : public HttpTransaction {
 
   const CompletionCallback& io_callback() { return io_callback_; }
 
+  // Returns true if this transaction can use the response that |writer| is
+  // storing, and read it while it is stored instead of waiting for the writer
+  // to finish.
+  bool CanStreamFrom(const Transaction* writer) const;
+
+  // Called by the cache when the writer of the entry this transaction is
+  // streaming from stores more data, or stops storing it.
+  void OnWriterProgress();
+
   const BoundNetLog& net_log() const;
 
   // Bypasses the cache lock whenever there is lock contention.
@@ -163,6 +172,8 @@ class HttpCache::Transaction : public HttpTransaction {
     STATE_SUCCESSFUL_SEND_REQUEST,
     STATE_NETWORK_READ,
     STATE_NETWORK_READ_COMPLETE,
+    STATE_RESUME_STREAMING,
+    STATE_RESUME_STREAMING_COMPLETE,
     STATE_INIT_ENTRY,
     STATE_OPEN_ENTRY,
     STATE_OPEN_ENTRY_COMPLETE,
@@ -234,6 +245,8 @@ class HttpCache::Transaction : public HttpTransaction {
   int DoSuccessfulSendRequest();
   int DoNetworkRead();
   int DoNetworkReadComplete(int result);
+  int DoResumeStreaming();
+  int DoResumeStreamingComplete(int result);
   int DoInitEntry();
   int DoOpenEntry();
   int DoOpenEntryComplete(int result);
@@ -314,6 +327,17 @@ class HttpCache::Transaction : public HttpTransaction {
   // Called to determine if we need to validate the cache entry before using it.
   bool RequiresValidation();
 
+  // Returns true if |response| has to be validated before it can be used for
+  // this request. Sets |*vary_mismatch|, if given, when the request doesn't
+  // match the vary data of |response|.
+  bool ResponseRequiresValidation(const HttpResponseInfo& response,
+                                  bool* vary_mismatch) const;
+
+  // Returns true if the cached response, although stale, may be used while it
+  // is validated in the background, as allowed by its stale-while-revalidate
+  // Cache-Control directive.
+  bool CanServeStaleWhileRevalidating() const;
+
   // Called to make the request conditional (to ask the server if the cached
   // copy is valid).  Returns true if able to make the request conditional.
   bool ConditionalizeRequest();
@@ -365,6 +389,11 @@ class HttpCache::Transaction : public HttpTransaction {
   // transaction should be restarted.
   int OnCacheReadError(int result, bool restart);
 
+  // Called when we were reading the response while it was being stored, and
+  // the writer stopped before storing all of it. Requests the rest of the
+  // response from the network, without storing it.
+  int ResumeStreamingFromNetwork();
+
   // Called when the cache lock timeout fires.
   void OnAddToEntryTimeout(base::TimeTicks start_time);
 
@@ -431,6 +460,8 @@ class HttpCache::Transaction : public HttpTransaction {
   bool vary_mismatch_;  // The request doesn't match the stored vary data.
   bool couldnt_conditionalize_request_;
   bool bypass_lock_for_test_;  // A test is exercising the cache lock.
+  bool streaming_;  // We read the response while the writer was storing it.
+  bool waiting_for_writer_;  // We need more data than the writer has stored.
   scoped_refptr<IOBuffer> read_buf_;
   int io_buf_len_;
   int read_offset_;
@@ -1217,6 +1217,130 @@ TEST(HttpCache, SimpleGET_LoadValidateCache_Implicit) {
   EXPECT_EQ(1, cache.disk_cache()->create_count());
 }
 
+// Returns the ETag of the response of |trans|.
+std::string GetResponseETag(net::HttpTransaction* trans) {
+  std::string etag;
+  trans->GetResponseInfo()->headers->EnumerateHeader(NULL, "etag", &etag);
+  return etag;
+}
+
+// Tests that a stale response is returned without waiting for the network
+// while it is within its stale-while-revalidate window, and that the entry is
+// validated in the background.
+TEST(HttpCache, SimpleGET_StaleWhileRevalidate) {
+  MockHttpCache cache;
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers =
+      "Cache-Control: max-age=0, stale-while-revalidate=3600\n"
+      "Etag: \"1\"\n";
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  // The server has a new version of the resource.
+  transaction.response_headers =
+      "Cache-Control: max-age=0, stale-while-revalidate=3600\n"
+      "Etag: \"2\"\n";
+
+  MockHttpRequest request(transaction);
+  Context c;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&c.trans));
+  c.result = c.trans->Start(&request, c.callback.callback(),
+                            net::BoundNetLog());
+  EXPECT_EQ(net::OK, c.callback.GetResult(c.result));
+
+  // The validation has to wait for this transaction to be done with the entry,
+  // so it has not reached the network yet.
+  EXPECT_TRUE(c.trans->GetResponseInfo()->was_cached);
+  EXPECT_EQ("\"1\"", GetResponseETag(c.trans.get()));
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  ReadAndVerifyTransaction(c.trans.get(), transaction);
+  c.trans.reset();
+
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+
+  // The entry was updated in the background.
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&c.trans));
+  c.result = c.trans->Start(&request, c.callback.callback(),
+                            net::BoundNetLog());
+  EXPECT_EQ(net::OK, c.callback.GetResult(c.result));
+  EXPECT_TRUE(c.trans->GetResponseInfo()->was_cached);
+  EXPECT_EQ("\"2\"", GetResponseETag(c.trans.get()));
+  ReadAndVerifyTransaction(c.trans.get(), transaction);
+  c.trans.reset();
+
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that requests served a stale response while it is being validated in
+// the background don't start validations of their own.
+TEST(HttpCache, SimpleGET_StaleWhileRevalidate_SingleValidation) {
+  MockHttpCache cache;
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers =
+      "Cache-Control: max-age=0, stale-while-revalidate=3600\n"
+      "Etag: \"1\"\n";
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  MockHttpRequest request(transaction);
+  std::vector<Context*> context_list;
+  const int kNumTransactions = 3;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+
+    c->result = cache.CreateTransaction(&c->trans);
+    ASSERT_EQ(net::OK, c->result);
+
+    c->result = c->trans->Start(
+        &request, c->callback.callback(), net::BoundNetLog());
+  }
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    EXPECT_EQ(net::OK, c->callback.GetResult(c->result));
+    EXPECT_TRUE(c->trans->GetResponseInfo()->was_cached);
+    ReadAndVerifyTransaction(c->trans.get(), transaction);
+    delete c;
+  }
+
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that a response that is past its stale-while-revalidate window is
+// validated before it is returned.
+TEST(HttpCache, SimpleGET_StaleWhileRevalidate_Expired) {
+  MockHttpCache cache;
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers =
+      "Cache-Control: max-age=0, stale-while-revalidate=3600\n"
+      "Etag: \"1\"\n";
+  transaction.request_time = Time::Now() - base::TimeDelta::FromHours(2);
+  transaction.response_time = transaction.request_time;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  transaction.response_headers =
+      "Cache-Control: max-age=0, stale-while-revalidate=3600\n"
+      "Etag: \"2\"\n";
+
+  net::HttpResponseInfo response;
+  RunTransactionTestWithResponseInfo(cache.http_cache(), transaction,
+                                     &response);
+  EXPECT_FALSE(response.was_cached);
+  std::string etag;
+  response.headers->EnumerateHeader(NULL, "etag", &etag);
+  EXPECT_EQ("\"2\"", etag);
+
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+}
+
 static void PreserveRequestHeaders_Handler(
     const net::HttpRequestInfo* request,
     std::string* response_status,
@@ -1328,6 +1452,329 @@ TEST(HttpCache, SimpleGET_ManyReaders) {
   }
 }
 
+// Tests that transactions queued behind the writer start reading the response
+// as soon as the writer stores part of it.
+TEST(HttpCache, SimpleGET_StreamingReaders) {
+  MockHttpCache cache;
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  std::vector<Context*> context_list;
+  const int kNumTransactions = 3;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+
+    c->result = cache.CreateTransaction(&c->trans);
+    ASSERT_EQ(net::OK, c->result);
+
+    c->result = c->trans->Start(
+        &request, c->callback.callback(), net::BoundNetLog());
+  }
+
+  // Allow all requests to move from the Create queue to the active entry.
+  base::MessageLoop::current()->RunUntilIdle();
+
+  Context* writer = context_list[0];
+  ASSERT_EQ(net::ERR_IO_PENDING, writer->result);
+  EXPECT_EQ(net::OK, writer->callback.WaitForResult());
+
+  // The writer has not stored any data yet.
+  for (int i = 1; i < kNumTransactions; ++i)
+    EXPECT_EQ(net::ERR_IO_PENDING, context_list[i]->result);
+
+  const int kPartialSize = 10;
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kPartialSize));
+  int rv = writer->trans->Read(buf.get(), kPartialSize,
+                               writer->callback.callback());
+  EXPECT_EQ(kPartialSize, writer->callback.GetResult(rv));
+
+  const std::string expected(kSimpleGET_Transaction.data);
+  for (int i = 1; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    EXPECT_EQ(net::OK, c->callback.WaitForResult());
+
+    // Only the first part of the response is available.
+    scoped_refptr<net::IOBuffer> reader_buf(new net::IOBuffer(256));
+    rv = c->trans->Read(reader_buf.get(), 256, c->callback.callback());
+    ASSERT_EQ(kPartialSize, c->callback.GetResult(rv));
+    EXPECT_EQ(expected.substr(0, kPartialSize),
+              std::string(reader_buf->data(), kPartialSize));
+
+    rv = c->trans->Read(reader_buf.get(), 256, c->callback.callback());
+    EXPECT_EQ(net::ERR_IO_PENDING, rv);
+    c->result = rv;
+  }
+
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(writer->trans.get(), &content));
+  EXPECT_EQ(expected.substr(kPartialSize), content);
+
+  // The readers get the rest of the response once it is stored.
+  for (int i = 1; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    EXPECT_EQ(static_cast<int>(expected.size()) - kPartialSize,
+              c->callback.WaitForResult());
+    EXPECT_EQ(net::OK, ReadTransaction(c->trans.get(), &content));
+    EXPECT_TRUE(content.empty());
+  }
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    delete c;
+  }
+}
+
+// Tests that a transaction reading the response while it is being stored fails
+// if the writer goes away before storing all of it, and the response has no
+// validator to request the rest of it with.
+TEST(HttpCache, SimpleGET_StreamingReaderWriterCancelled) {
+  MockHttpCache cache;
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  Context writer;
+  Context reader;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&reader.trans));
+  writer.result = writer.trans->Start(
+      &request, writer.callback.callback(), net::BoundNetLog());
+  reader.result = reader.trans->Start(
+      &request, reader.callback.callback(), net::BoundNetLog());
+  EXPECT_EQ(net::OK, writer.callback.GetResult(writer.result));
+
+  const int kPartialSize = 10;
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(256));
+  int rv = writer.trans->Read(buf.get(), kPartialSize,
+                              writer.callback.callback());
+  EXPECT_EQ(kPartialSize, writer.callback.GetResult(rv));
+
+  EXPECT_EQ(net::OK, reader.callback.GetResult(reader.result));
+  rv = reader.trans->Read(buf.get(), 256, reader.callback.callback());
+  EXPECT_EQ(kPartialSize, reader.callback.GetResult(rv));
+  rv = reader.trans->Read(buf.get(), 256, reader.callback.callback());
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+
+  writer.trans.reset();
+  EXPECT_EQ(net::ERR_CACHE_READ_FAILURE, reader.callback.WaitForResult());
+  reader.trans.reset();
+
+  // The incomplete entry was not kept.
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+}
+
+// Serves the requested byte range of the response of the mock transaction, or
+// the whole response if no range is requested.
+static void StreamingReaderResume_Handler(const net::HttpRequestInfo* request,
+                                          std::string* response_status,
+                                          std::string* response_headers,
+                                          std::string* response_data) {
+  std::string range_header;
+  if (!request->extra_headers.GetHeader(net::HttpRequestHeaders::kRange,
+                                        &range_header)) {
+    return;
+  }
+  EXPECT_TRUE(
+      request->extra_headers.HasHeader(net::HttpRequestHeaders::kIfRange));
+
+  std::vector<net::HttpByteRange> ranges;
+  ASSERT_TRUE(net::HttpUtil::ParseRangeHeader(range_header, &ranges));
+  ASSERT_EQ(1u, ranges.size());
+  const int size = static_cast<int>(response_data->size());
+  ASSERT_TRUE(ranges[0].ComputeBounds(size));
+  const int first = static_cast<int>(ranges[0].first_byte_position());
+  const int last = static_cast<int>(ranges[0].last_byte_position());
+
+  response_status->assign("HTTP/1.1 206 Partial Content");
+  response_headers->assign(base::StringPrintf(
+      "ETag: \"foo\"\n"
+      "Content-Range: bytes %d-%d/%d\n"
+      "Content-Length: %d\n",
+      first, last, size, last - first + 1));
+  *response_data = response_data->substr(first, last - first + 1);
+}
+
+// Starts a writer and a transaction that reads the response while it is being
+// stored, and makes the writer stop storing it partway through, either by
+// destroying it or, if |stop_caching| is true, by calling StopCaching(). The
+// reader must get the rest of the response from the network.
+static void StreamingReaderResumeHelper(bool stop_caching) {
+  MockHttpCache cache;
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers =
+      "ETag: \"foo\"\n"
+      "Cache-Control: max-age=10000\n"
+      "Content-Length: 40\n";
+  transaction.data = "0123456789abcdefghijklmnopqrstuvwxyzABCD";
+  transaction.handler = &StreamingReaderResume_Handler;
+  const std::string expected(transaction.data);
+
+  MockHttpRequest request(transaction);
+
+  Context writer;
+  Context reader;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&reader.trans));
+  writer.result = writer.trans->Start(
+      &request, writer.callback.callback(), net::BoundNetLog());
+  reader.result = reader.trans->Start(
+      &request, reader.callback.callback(), net::BoundNetLog());
+  EXPECT_EQ(net::OK, writer.callback.GetResult(writer.result));
+
+  const int kPartialSize = 10;
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(256));
+  int rv = writer.trans->Read(buf.get(), kPartialSize,
+                              writer.callback.callback());
+  EXPECT_EQ(kPartialSize, writer.callback.GetResult(rv));
+
+  EXPECT_EQ(net::OK, reader.callback.GetResult(reader.result));
+  scoped_refptr<net::IOBuffer> reader_buf(new net::IOBuffer(256));
+  rv = reader.trans->Read(reader_buf.get(), 256, reader.callback.callback());
+  EXPECT_EQ(kPartialSize, reader.callback.GetResult(rv));
+  rv = reader.trans->Read(reader_buf.get(), 256, reader.callback.callback());
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+
+  if (stop_caching)
+    writer.trans->StopCaching();
+  else
+    writer.trans.reset();
+
+  const int remaining_size = static_cast<int>(expected.size()) - kPartialSize;
+  EXPECT_EQ(remaining_size, reader.callback.WaitForResult());
+  EXPECT_EQ(expected.substr(kPartialSize),
+            std::string(reader_buf->data(), remaining_size));
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(reader.trans.get(), &content));
+  EXPECT_TRUE(content.empty());
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+
+  if (stop_caching) {
+    EXPECT_EQ(net::OK, ReadTransaction(writer.trans.get(), &content));
+    EXPECT_EQ(expected.substr(kPartialSize), content);
+  }
+}
+
+// Tests that a transaction reading the response while it is being stored gets
+// the rest of it from the network if the writer is cancelled partway through.
+TEST(HttpCache, SimpleGET_StreamingReaderResumesAfterWriterCancelled) {
+  StreamingReaderResumeHelper(false);
+}
+
+// Tests that a transaction reading the response while it is being stored gets
+// the rest of it from the network if the writer stops caching partway through.
+TEST(HttpCache, SimpleGET_StreamingReaderResumesAfterStopCaching) {
+  StreamingReaderResumeHelper(true);
+}
+
+// Tests that a transaction reading the response while it is being stored gets
+// all of it if the writer goes away after storing the whole body, but before
+// reading the end of the stream.
+TEST(HttpCache, SimpleGET_StreamingReaderWriterDestroyedAfterBody) {
+  MockHttpCache cache;
+
+  MockTransaction transaction(kSimpleGET_Transaction);
+  const std::string expected(transaction.data);
+  const std::string response_headers = base::StringPrintf(
+      "Cache-Control: max-age=10000\nContent-Length: %d\n",
+      static_cast<int>(expected.size()));
+  transaction.response_headers = response_headers.c_str();
+  AddMockTransaction(&transaction);
+
+  MockHttpRequest request(transaction);
+
+  Context writer;
+  Context reader;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&reader.trans));
+  writer.result = writer.trans->Start(
+      &request, writer.callback.callback(), net::BoundNetLog());
+  reader.result = reader.trans->Start(
+      &request, reader.callback.callback(), net::BoundNetLog());
+  EXPECT_EQ(net::OK, writer.callback.GetResult(writer.result));
+
+  const int kPartialSize = 10;
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(256));
+  int rv = writer.trans->Read(buf.get(), kPartialSize,
+                              writer.callback.callback());
+  EXPECT_EQ(kPartialSize, writer.callback.GetResult(rv));
+
+  EXPECT_EQ(net::OK, reader.callback.GetResult(reader.result));
+  scoped_refptr<net::IOBuffer> reader_buf(new net::IOBuffer(256));
+  rv = reader.trans->Read(reader_buf.get(), 256, reader.callback.callback());
+  EXPECT_EQ(kPartialSize, reader.callback.GetResult(rv));
+  rv = reader.trans->Read(reader_buf.get(), 256, reader.callback.callback());
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+
+  // The writer stores the rest of the body, and goes away without reading the
+  // end of the stream.
+  const int remaining_size = static_cast<int>(expected.size()) - kPartialSize;
+  rv = writer.trans->Read(buf.get(), 256, writer.callback.callback());
+  EXPECT_EQ(remaining_size, writer.callback.GetResult(rv));
+  writer.trans.reset();
+
+  EXPECT_EQ(remaining_size, reader.callback.WaitForResult());
+  EXPECT_EQ(expected.substr(kPartialSize),
+            std::string(reader_buf->data(), remaining_size));
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(reader.trans.get(), &content));
+  EXPECT_TRUE(content.empty());
+  reader.trans.reset();
+
+  // The complete entry was kept.
+  RunTransactionTest(cache.http_cache(), transaction);
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  RemoveMockTransaction(&transaction);
+}
+
+// Tests that a transaction that has to validate the response keeps waiting
+// for the writer instead of reading the response while it is being stored.
+TEST(HttpCache, SimpleGET_ValidatingReaderDoesNotStream) {
+  MockHttpCache cache;
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+  MockHttpRequest validate_request(kSimpleGET_Transaction);
+  validate_request.load_flags = net::LOAD_VALIDATE_CACHE;
+
+  Context writer;
+  Context reader;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&reader.trans));
+  writer.result = writer.trans->Start(
+      &request, writer.callback.callback(), net::BoundNetLog());
+  reader.result = reader.trans->Start(
+      &validate_request, reader.callback.callback(), net::BoundNetLog());
+  EXPECT_EQ(net::OK, writer.callback.GetResult(writer.result));
+
+  const int kPartialSize = 10;
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kPartialSize));
+  int rv = writer.trans->Read(buf.get(), kPartialSize,
+                              writer.callback.callback());
+  EXPECT_EQ(kPartialSize, writer.callback.GetResult(rv));
+
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_FALSE(reader.callback.have_result());
+
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(writer.trans.get(), &content));
+
+  EXPECT_EQ(net::OK, reader.callback.WaitForResult());
+  ReadAndVerifyTransaction(reader.trans.get(), kSimpleGET_Transaction);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
 // This is a test for http://code.google.com/p/chromium/issues/detail?id=4769.
 // If cancelling a request is racing with another request for the same resource
 // finishing, we have to make sure that we remove both transactions from the
@@ -1335,8 +1782,15 @@ TEST(HttpCache, SimpleGET_ManyReaders) {
 TEST(HttpCache, SimpleGET_RacingReaders) {
   MockHttpCache cache;
 
-  MockHttpRequest request(kSimpleGET_Transaction);
-  MockHttpRequest reader_request(kSimpleGET_Transaction);
+  // The writer reads and stores the whole body without returning to the
+  // message loop, so the other transactions are still waiting for it when it
+  // is done, instead of reading the response while it is stored.
+  MockTransaction transaction(kSimpleGET_Transaction);
+  transaction.test_mode = TEST_MODE_SYNC_NET_READ | TEST_MODE_SYNC_CACHE_WRITE;
+  AddMockTransaction(&transaction);
+
+  MockHttpRequest request(transaction);
+  MockHttpRequest reader_request(transaction);
   reader_request.load_flags = net::LOAD_ONLY_FROM_CACHE;
 
   std::vector<Context*> context_list;
@@ -1407,6 +1861,90 @@ TEST(HttpCache, SimpleGET_RacingReaders) {
   EXPECT_EQ(0, cache.disk_cache()->open_count());
   EXPECT_EQ(1, cache.disk_cache()->create_count());
 
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    delete c;
+  }
+  RemoveMockTransaction(&transaction);
+}
+
+// Same as SimpleGET_RacingReaders, but with the other transactions reading the
+// response while the first one stores it. Cancelling one of them must not keep
+// the others from finishing.
+TEST(HttpCache, SimpleGET_RacingStreamingReaders) {
+  MockHttpCache cache;
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+  MockHttpRequest reader_request(kSimpleGET_Transaction);
+  reader_request.load_flags = net::LOAD_ONLY_FROM_CACHE;
+
+  std::vector<Context*> context_list;
+  const int kNumTransactions = 5;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+
+    c->result = cache.CreateTransaction(&c->trans);
+    ASSERT_EQ(net::OK, c->result);
+
+    MockHttpRequest* this_request = &request;
+    if (i == 1 || i == 2)
+      this_request = &reader_request;
+
+    c->result = c->trans->Start(
+        this_request, c->callback.callback(), net::BoundNetLog());
+  }
+
+  // Allow all requests to move from the Create queue to the active entry.
+  base::MessageLoop::current()->RunUntilIdle();
+
+  // The first request should be a writer at this point, and the subsequent
+  // requests should be pending.
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  Context* c = context_list[0];
+  ASSERT_EQ(net::ERR_IO_PENDING, c->result);
+  c->result = c->callback.WaitForResult();
+  ReadAndVerifyTransaction(c->trans.get(), kSimpleGET_Transaction);
+
+  // Now we have 4 active readers: the others started reading the response
+  // while the first transaction was storing it.
+
+  EXPECT_EQ(net::LOAD_STATE_IDLE,
+            context_list[2]->trans->GetLoadState());
+  EXPECT_EQ(net::LOAD_STATE_IDLE,
+            context_list[3]->trans->GetLoadState());
+
+  c = context_list[1];
+  ASSERT_EQ(net::ERR_IO_PENDING, c->result);
+  c->result = c->callback.WaitForResult();
+  if (c->result == net::OK)
+    ReadAndVerifyTransaction(c->trans.get(), kSimpleGET_Transaction);
+
+  // Now we cancel one of the readers, and expect the others to be able to
+  // finish reading the response.
+
+  c = context_list[2];
+  c->trans.reset();
+
+  for (int i = 3; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    if (c->result == net::ERR_IO_PENDING)
+      c->result = c->callback.WaitForResult();
+    if (c->result == net::OK)
+      ReadAndVerifyTransaction(c->trans.get(), kSimpleGET_Transaction);
+  }
+
+  // We should not have had to re-open the disk entry.
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
   for (int i = 0; i < kNumTransactions; ++i) {
     Context* c = context_list[i];
     delete c;
@@ -324,6 +324,36 @@ TEST(HttpChunkedDecoderTest, MultipleExtraDataBlocks) {
   RunTest(inputs, arraysize(inputs), "hello", true, 11);
 }
 
+// Tests that the bytes after the end of the body are moved right after the
+// decoded data, where HttpStreamParser expects them.
+TEST(HttpChunkedDecoderTest, ExtraDataFollowsDecodedData) {
+  std::string input = "5\r\nhello\r\n1\r\n \r\n5;ext\r\nworld\r\n0\r\n\r\n"
+                      "HTTP/1.1 200 OK";
+  HttpChunkedDecoder decoder;
+  int n = decoder.FilterBuf(&input[0], static_cast<int>(input.size()));
+  ASSERT_EQ(11, n);
+  EXPECT_TRUE(decoder.reached_eof());
+  ASSERT_EQ(15, decoder.bytes_after_eof());
+  EXPECT_EQ("hello world", input.substr(0, n));
+  EXPECT_EQ("HTTP/1.1 200 OK", input.substr(n, decoder.bytes_after_eof()));
+}
+
+TEST(HttpChunkedDecoderTest, ManySmallChunks) {
+  std::string input;
+  std::string expected;
+  for (int i = 0; i < 1000; ++i) {
+    input += "3\r\nabc\r\n";
+    expected += "abc";
+  }
+  input += "0\r\n\r\n";
+  HttpChunkedDecoder decoder;
+  int n = decoder.FilterBuf(&input[0], static_cast<int>(input.size()));
+  ASSERT_EQ(static_cast<int>(expected.size()), n);
+  EXPECT_EQ(expected, input.substr(0, n));
+  EXPECT_TRUE(decoder.reached_eof());
+  EXPECT_EQ(0, decoder.bytes_after_eof());
+}
+
 // Test when the line with the chunk length is too long.
 TEST(HttpChunkedDecoderTest, LongChunkLengthLine) {
   int big_chunk_length = HttpChunkedDecoder::kMaxLineBufLen;
@@ -26,6 +26,7 @@
 #include "net/socket/client_socket_factory.h"
 #include "net/socket/client_socket_pool_manager_impl.h"
 #include "net/socket/next_proto.h"
+#include "net/socket/transport_client_socket_pool.h"
 #include "net/spdy/hpack_huffman_aggregator.h"
 #include "net/spdy/spdy_session_pool.h"
 
@@ -76,6 +77,7 @@ HttpNetworkSession::Params::Params()
       testing_fixed_http_port(0),
       testing_fixed_https_port(0),
       enable_tcp_fast_open_for_ssl(false),
+      enable_tcp_connect_racing(false),
       force_spdy_single_domain(false),
       enable_spdy_compression(true),
       enable_spdy_ping_based_connection_checking(true),
@@ -188,6 +190,13 @@ HttpNetworkSession::HttpNetworkSession(const Params& params)
     }
   }
 
+  if (params.enable_tcp_connect_racing) {
+    TransportConnectRaceParams race_params;
+    race_params.enabled = true;
+    normal_socket_pool_manager_->GetTransportSocketPool()->SetConnectRaceParams(
+        race_params, http_server_properties_);
+  }
+
   if (HpackHuffmanAggregator::UseAggregator()) {
     huffman_aggregator_.reset(new HpackHuffmanAggregator());
   }
@@ -82,6 +82,10 @@ class NET_EXPORT HttpNetworkSession
     uint16 testing_fixed_http_port;
     uint16 testing_fixed_https_port;
     bool enable_tcp_fast_open_for_ssl;
+    // Connects to all addresses of a host with staggered, concurrent
+    // attempts, and remembers which address family won in
+    // |http_server_properties|.  See TransportConnectRaceParams.
+    bool enable_tcp_connect_racing;
 
     bool force_spdy_single_domain;
     bool enable_spdy_compression;
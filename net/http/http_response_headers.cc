@@ -109,6 +109,84 @@ bool ShouldUpdateHeader(const std::string::const_iterator& name_begin,
   return true;
 }
 
+// Header names that are common in responses or looked up for most of them.
+// A header with one of these names is identified by its index in this list,
+// so that finding it compares integers rather than strings. |non_coalescing|
+// caches HttpUtil::IsNonCoalescingHeader() for the name.
+struct WellKnownHeader {
+  const char* name;
+  size_t length;
+  bool non_coalescing;
+};
+
+#define WELL_KNOWN_HEADER(name, non_coalescing) \
+  { name, arraysize(name) - 1, non_coalescing }
+
+const WellKnownHeader kWellKnownHeaders[] = {
+  WELL_KNOWN_HEADER("accept-ranges", false),
+  WELL_KNOWN_HEADER("age", false),
+  WELL_KNOWN_HEADER("alternate-protocol", false),
+  WELL_KNOWN_HEADER("cache-control", false),
+  WELL_KNOWN_HEADER("connection", false),
+  WELL_KNOWN_HEADER("content-disposition", false),
+  WELL_KNOWN_HEADER("content-encoding", false),
+  WELL_KNOWN_HEADER("content-language", false),
+  WELL_KNOWN_HEADER("content-length", false),
+  WELL_KNOWN_HEADER("content-location", false),
+  WELL_KNOWN_HEADER("content-range", false),
+  WELL_KNOWN_HEADER("content-type", false),
+  WELL_KNOWN_HEADER("date", true),
+  WELL_KNOWN_HEADER("etag", false),
+  WELL_KNOWN_HEADER("expires", true),
+  WELL_KNOWN_HEADER("keep-alive", false),
+  WELL_KNOWN_HEADER("last-modified", true),
+  WELL_KNOWN_HEADER("location", true),
+  WELL_KNOWN_HEADER("p3p", false),
+  WELL_KNOWN_HEADER("pragma", false),
+  WELL_KNOWN_HEADER("proxy-authenticate", true),
+  WELL_KNOWN_HEADER("proxy-connection", false),
+  WELL_KNOWN_HEADER("public-key-pins", false),
+  WELL_KNOWN_HEADER("retry-after", true),
+  WELL_KNOWN_HEADER("server", false),
+  WELL_KNOWN_HEADER("set-cookie", true),
+  WELL_KNOWN_HEADER("set-cookie2", false),
+  WELL_KNOWN_HEADER("strict-transport-security", true),
+  WELL_KNOWN_HEADER("trailer", false),
+  WELL_KNOWN_HEADER("transfer-encoding", false),
+  WELL_KNOWN_HEADER("upgrade", false),
+  WELL_KNOWN_HEADER("vary", false),
+  WELL_KNOWN_HEADER("via", false),
+  WELL_KNOWN_HEADER("www-authenticate", true),
+  WELL_KNOWN_HEADER("x-content-type-options", false),
+  WELL_KNOWN_HEADER("x-frame-options", false),
+  WELL_KNOWN_HEADER("x-xss-protection", false),
+};
+
+#undef WELL_KNOWN_HEADER
+
+// The headers present in a response are recorded in a 64-bit mask.
+COMPILE_ASSERT(arraysize(kWellKnownHeaders) <= 64,
+               too_many_well_known_headers);
+
+const int kUnknownHeader = -1;
+
+// Returns the index of |name| in kWellKnownHeaders, or kUnknownHeader.
+int GetWellKnownHeaderId(const StringPiece& name) {
+  for (size_t i = 0; i < arraysize(kWellKnownHeaders); ++i) {
+    if (name.size() == kWellKnownHeaders[i].length &&
+        LowerCaseEqualsASCII(name.begin(), name.end(),
+                             kWellKnownHeaders[i].name)) {
+      return static_cast<int>(i);
+    }
+  }
+  return kUnknownHeader;
+}
+
+uint64 WellKnownHeaderBit(int id) {
+  DCHECK_NE(kUnknownHeader, id);
+  return static_cast<uint64>(1) << id;
+}
+
 void CheckDoesNotHaveEmbededNulls(const std::string& str) {
   // Care needs to be taken when adding values to the raw headers string to
   // make sure it does not contain embeded NULLs. Any embeded '\0' may be
@@ -125,6 +203,9 @@ struct HttpResponseHeaders::ParsedHeader {
   // preceding header.  (Header values are comma separated.)
   bool is_continuation() const { return name_begin == name_end; }
 
+  // Index of the name in kWellKnownHeaders, or kUnknownHeader. Continuations
+  // have no name, so they are unknown.
+  int name_id;
   std::string::const_iterator name_begin;
   std::string::const_iterator name_end;
   std::string::const_iterator value_begin;
@@ -134,7 +215,8 @@ struct HttpResponseHeaders::ParsedHeader {
 //-----------------------------------------------------------------------------
 
 HttpResponseHeaders::HttpResponseHeaders(const std::string& raw_input)
-    : response_code_(-1) {
+    : well_known_headers_(0),
+      response_code_(-1) {
   Parse(raw_input);
 
   // The most important thing to do with this histogram is find out
@@ -158,7 +240,8 @@ HttpResponseHeaders::HttpResponseHeaders(const std::string& raw_input)
 
 HttpResponseHeaders::HttpResponseHeaders(const Pickle& pickle,
                                          PickleIterator* iter)
-    : response_code_(-1) {
+    : well_known_headers_(0),
+      response_code_(-1) {
   std::string raw_input;
   if (pickle.ReadString(iter, &raw_input))
     Parse(raw_input);
@@ -191,6 +274,19 @@ void HttpResponseHeaders::Persist(Pickle* pickle, PersistOptions options) {
   if ((options & PERSIST_SANS_SECURITY_STATE) == PERSIST_SANS_SECURITY_STATE)
     AddSecurityStateHeaders(&filter_headers);
 
+  // Most of the names are well-known, so that they can be matched by id.
+  uint64 filter_ids = 0;
+  for (HeaderSet::iterator it = filter_headers.begin();
+       it != filter_headers.end();) {
+    int id = GetWellKnownHeaderId(*it);
+    if (id != kUnknownHeader) {
+      filter_ids |= WellKnownHeaderBit(id);
+      filter_headers.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+
   std::string blob;
   blob.reserve(raw_headers_.size());
 
@@ -207,10 +303,18 @@ void HttpResponseHeaders::Persist(Pickle* pickle, PersistOptions options) {
     while (++k < parsed_.size() && parsed_[k].is_continuation()) {}
     --k;
 
-    std::string header_name(parsed_[i].name_begin, parsed_[i].name_end);
-    base::StringToLowerASCII(&header_name);
+    bool filtered;
+    if (parsed_[i].name_id != kUnknownHeader) {
+      filtered = (filter_ids & WellKnownHeaderBit(parsed_[i].name_id)) != 0;
+    } else if (filter_headers.empty()) {
+      filtered = false;
+    } else {
+      std::string header_name(parsed_[i].name_begin, parsed_[i].name_end);
+      base::StringToLowerASCII(&header_name);
+      filtered = filter_headers.find(header_name) != filter_headers.end();
+    }
 
-    if (filter_headers.find(header_name) == filter_headers.end()) {
+    if (!filtered) {
       // Make sure there is a null after the value.
       blob.append(parsed_[i].name_begin, parsed_[k].value_end);
       blob.push_back('\0');
@@ -396,6 +500,8 @@ void HttpResponseHeaders::UpdateWithNewRange(
 }
 
 void HttpResponseHeaders::Parse(const std::string& raw_input) {
+  DCHECK(parsed_.empty());
+  well_known_headers_ = 0;
   raw_headers_.reserve(raw_input.size());
 
   // ParseStatusLine adds a normalized status line to raw_headers_
@@ -614,7 +720,9 @@ bool HttpResponseHeaders::HasHeader(const base::StringPiece& name) const {
   return FindHeader(0, name) != std::string::npos;
 }
 
-HttpResponseHeaders::HttpResponseHeaders() : response_code_(-1) {
+HttpResponseHeaders::HttpResponseHeaders()
+    : well_known_headers_(0),
+      response_code_(-1) {
 }
 
 HttpResponseHeaders::~HttpResponseHeaders() {
@@ -739,8 +847,20 @@ void HttpResponseHeaders::ParseStatusLine(
 
 size_t HttpResponseHeaders::FindHeader(size_t from,
                                        const base::StringPiece& search) const {
+  int id = GetWellKnownHeaderId(search);
+  if (id != kUnknownHeader) {
+    if (!(well_known_headers_ & WellKnownHeaderBit(id)))
+      return std::string::npos;
+    for (size_t i = from; i < parsed_.size(); ++i) {
+      if (parsed_[i].name_id == id)
+        return i;
+    }
+    return std::string::npos;
+  }
+
   for (size_t i = from; i < parsed_.size(); ++i) {
-    if (parsed_[i].is_continuation())
+    // A header with a well-known name can't match |search|.
+    if (parsed_[i].is_continuation() || parsed_[i].name_id != kUnknownHeader)
       continue;
     const std::string::const_iterator& name_begin = parsed_[i].name_begin;
     const std::string::const_iterator& name_end = parsed_[i].name_end;
@@ -783,25 +903,39 @@ void HttpResponseHeaders::AddHeader(std::string::const_iterator name_begin,
                                     std::string::const_iterator name_end,
                                     std::string::const_iterator values_begin,
                                     std::string::const_iterator values_end) {
+  int name_id = GetWellKnownHeaderId(StringPiece(name_begin, name_end));
+  bool non_coalescing;
+  if (name_id != kUnknownHeader) {
+    well_known_headers_ |= WellKnownHeaderBit(name_id);
+    non_coalescing = kWellKnownHeaders[name_id].non_coalescing;
+    DCHECK_EQ(HttpUtil::IsNonCoalescingHeader(name_begin, name_end),
+              non_coalescing);
+  } else {
+    non_coalescing = HttpUtil::IsNonCoalescingHeader(name_begin, name_end);
+  }
+
   // If the header can be coalesced, then we should split it up.
-  if (values_begin == values_end ||
-      HttpUtil::IsNonCoalescingHeader(name_begin, name_end)) {
-    AddToParsed(name_begin, name_end, values_begin, values_end);
+  if (values_begin == values_end || non_coalescing) {
+    AddToParsed(name_id, name_begin, name_end, values_begin, values_end);
   } else {
     HttpUtil::ValuesIterator it(values_begin, values_end, ',');
     while (it.GetNext()) {
-      AddToParsed(name_begin, name_end, it.value_begin(), it.value_end());
+      AddToParsed(name_id, name_begin, name_end, it.value_begin(),
+                  it.value_end());
       // clobber these so that subsequent values are treated as continuations
+      name_id = kUnknownHeader;
       name_begin = name_end = raw_headers_.end();
     }
   }
 }
 
-void HttpResponseHeaders::AddToParsed(std::string::const_iterator name_begin,
+void HttpResponseHeaders::AddToParsed(int name_id,
+                                      std::string::const_iterator name_begin,
                                       std::string::const_iterator name_end,
                                       std::string::const_iterator value_begin,
                                       std::string::const_iterator value_end) {
   ParsedHeader header;
+  header.name_id = name_id;
   header.name_begin = name_begin;
   header.name_end = name_end;
   header.value_begin = value_begin;
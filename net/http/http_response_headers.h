@@ -318,7 +318,8 @@ class NET_EXPORT HttpResponseHeaders
                        bool has_headers);
 
   // Find the header in our list (case-insensitive) starting with parsed_ at
-  // index |from|.  Returns string::npos if not found.
+  // index |from|.  Returns string::npos if not found.  Well-known names are
+  // matched by id, without comparing strings.
   size_t FindHeader(size_t from, const base::StringPiece& name) const;
 
   // Search the Cache-Control header for a directive matching |directive|. If
@@ -335,7 +336,8 @@ class NET_EXPORT HttpResponseHeaders
                  std::string::const_iterator value_end);
 
   // Add to parsed_ given the fields of a ParsedHeader object.
-  void AddToParsed(std::string::const_iterator name_begin,
+  void AddToParsed(int name_id,
+                   std::string::const_iterator name_begin,
                    std::string::const_iterator name_end,
                    std::string::const_iterator value_begin,
                    std::string::const_iterator value_end);
@@ -372,6 +374,10 @@ class NET_EXPORT HttpResponseHeaders
   // header-value pairs within raw_headers_.
   HeaderList parsed_;
 
+  // Bit i is set if parsed_ has a header with the well-known name of id i.
+  // Lets lookups of absent well-known headers return without scanning.
+  uint64 well_known_headers_;
+
   // The raw_headers_ consists of the normalized status line (terminated with a
   // null byte) and then followed by the raw null-terminated headers from the
   // input that was passed to our constructor.  We preserve the input [*] to
@@ -0,0 +1,212 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_response_headers.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/pickle.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kIterations = 20000;
+
+// Response headers as sent by popular sites, for a document, a script, an
+// image, a redirect and an API call.
+const char* const kResponses[] = {
+  "HTTP/1.1 200 OK\n"
+  "Date: Mon, 20 Oct 2014 18:02:09 GMT\n"
+  "Expires: -1\n"
+  "Cache-Control: private, max-age=0\n"
+  "Content-Type: text/html; charset=UTF-8\n"
+  "Set-Cookie: PREF=ID=1a2b3c4d5e6f7a8b:FF=0:TM=1413828129:LM=1413828129:"
+  "S=AbCdEfGhIjKlMnOp; expires=Wed, 19-Oct-2016 18:02:09 GMT; path=/; "
+  "domain=.example.com\n"
+  "Set-Cookie: NID=67=q1w2e3r4t5y6u7i8o9p0; expires=Tue, 21-Apr-2015 "
+  "18:02:09 GMT; path=/; domain=.example.com; HttpOnly\n"
+  "P3P: CP=\"This is not a P3P policy!\"\n"
+  "Server: gws\n"
+  "X-XSS-Protection: 1; mode=block\n"
+  "X-Frame-Options: SAMEORIGIN\n"
+  "Alternate-Protocol: 80:quic,p=0.01\n"
+  "Transfer-Encoding: chunked\n"
+  "Content-Encoding: gzip\n",
+
+  "HTTP/1.1 200 OK\n"
+  "Accept-Ranges: bytes\n"
+  "Vary: Accept-Encoding\n"
+  "Content-Encoding: gzip\n"
+  "Content-Type: text/javascript\n"
+  "Last-Modified: Thu, 16 Oct 2014 20:14:08 GMT\n"
+  "Date: Sun, 19 Oct 2014 08:04:13 GMT\n"
+  "Expires: Mon, 19 Oct 2015 08:04:13 GMT\n"
+  "X-Content-Type-Options: nosniff\n"
+  "Server: sffe\n"
+  "Content-Length: 38217\n"
+  "X-XSS-Protection: 1; mode=block\n"
+  "Cache-Control: public, max-age=31536000\n"
+  "Age: 122876\n",
+
+  "HTTP/1.1 200 OK\n"
+  "Content-Type: image/png\n"
+  "Content-Length: 4892\n"
+  "Connection: keep-alive\n"
+  "Date: Fri, 17 Oct 2014 11:38:01 GMT\n"
+  "Last-Modified: Tue, 02 Sep 2014 17:30:52 GMT\n"
+  "ETag: \"8f1c2d9e0b7a6f5e4d3c2b1a09f8e7d6\"\n"
+  "Cache-Control: max-age=604800\n"
+  "Accept-Ranges: bytes\n"
+  "Server: AmazonS3\n"
+  "Age: 283450\n"
+  "X-Cache: Hit from cloudfront\n"
+  "Via: 1.1 a1b2c3d4e5f6.cloudfront.net (CloudFront)\n"
+  "X-Amz-Cf-Id: Zx9Yw8Vu7Ts6Rq5Po4Nm3Lk2Ji1Hg0Fe==\n",
+
+  "HTTP/1.1 301 Moved Permanently\n"
+  "Location: https://www.example.com/\n"
+  "Content-Type: text/html; charset=UTF-8\n"
+  "Date: Mon, 20 Oct 2014 18:02:10 GMT\n"
+  "Expires: Wed, 19 Nov 2014 18:02:10 GMT\n"
+  "Cache-Control: public, max-age=2592000\n"
+  "Server: gws\n"
+  "Content-Length: 220\n"
+  "X-XSS-Protection: 1; mode=block\n"
+  "X-Frame-Options: SAMEORIGIN\n"
+  "Strict-Transport-Security: max-age=31536000\n",
+
+  "HTTP/1.1 200 OK\n"
+  "Server: nginx\n"
+  "Date: Mon, 20 Oct 2014 18:02:11 GMT\n"
+  "Content-Type: application/json; charset=utf-8\n"
+  "Content-Length: 1741\n"
+  "Connection: keep-alive\n"
+  "Status: 200 OK\n"
+  "X-RateLimit-Limit: 5000\n"
+  "X-RateLimit-Remaining: 4987\n"
+  "X-RateLimit-Reset: 1413831731\n"
+  "Cache-Control: private, max-age=60, s-maxage=60\n"
+  "Last-Modified: Mon, 20 Oct 2014 17:55:42 GMT\n"
+  "ETag: \"0f1e2d3c4b5a69788796a5b4c3d2e1f0\"\n"
+  "Vary: Accept, Authorization, Cookie, X-GitHub-OTP\n"
+  "Vary: Accept-Encoding\n"
+  "Access-Control-Allow-Credentials: true\n"
+  "Access-Control-Expose-Headers: ETag, Link, X-RateLimit-Limit, "
+  "X-RateLimit-Remaining, X-RateLimit-Reset\n"
+  "Access-Control-Allow-Origin: *\n"
+  "X-Content-Type-Options: nosniff\n"
+  "Content-Encoding: gzip\n",
+};
+
+// Transforms the \n-separated headers to the \0-separated format that
+// HttpResponseHeaders parses.
+std::string HeadersToRaw(const char* headers) {
+  std::string raw(headers);
+  std::replace(raw.begin(), raw.end(), '\n', '\0');
+  raw += '\0';
+  return raw;
+}
+
+class HttpResponseHeadersPerfTest : public testing::Test {
+ protected:
+  HttpResponseHeadersPerfTest() {
+    for (size_t i = 0; i < arraysize(kResponses); ++i)
+      raw_responses_.push_back(HeadersToRaw(kResponses[i]));
+  }
+
+  void LogResponsesPerSecond(const char* test_name, base::TimeDelta elapsed) {
+    base::LogPerfResult(
+        test_name,
+        kIterations * raw_responses_.size() / elapsed.InSecondsF(),
+        "responses/s");
+  }
+
+  // Looks the response up the way the network stack does for every response.
+  static void LookUpHeaders(const HttpResponseHeaders& headers) {
+    std::string value;
+    base::TimeDelta max_age;
+    headers.GetMimeType(&value);
+    headers.GetContentLength();
+    headers.IsKeepAlive();
+    headers.IsChunkEncoded();
+    headers.IsRedirect(&value);
+    headers.HasHeaderValue("cache-control", "no-store");
+    headers.HasHeaderValue("pragma", "no-cache");
+    headers.GetMaxAgeValue(&max_age);
+    headers.HasStrongValidators();
+    headers.EnumerateHeader(NULL, "content-encoding", &value);
+    headers.GetNormalizedHeader("vary", &value);
+    headers.HasHeader("strict-transport-security");
+    headers.HasHeader("public-key-pins");
+    headers.HasHeader("x-frame-options");
+  }
+
+  std::vector<std::string> raw_responses_;
+};
+
+TEST_F(HttpResponseHeadersPerfTest, Parse) {
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    for (size_t j = 0; j < raw_responses_.size(); ++j) {
+      scoped_refptr<HttpResponseHeaders> headers(
+          new HttpResponseHeaders(raw_responses_[j]));
+    }
+  }
+  LogResponsesPerSecond("HttpResponseHeaders_parse",
+                        base::TimeTicks::Now() - start);
+}
+
+TEST_F(HttpResponseHeadersPerfTest, LookUp) {
+  std::vector<scoped_refptr<HttpResponseHeaders> > parsed;
+  for (size_t i = 0; i < raw_responses_.size(); ++i)
+    parsed.push_back(new HttpResponseHeaders(raw_responses_[i]));
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    for (size_t j = 0; j < parsed.size(); ++j)
+      LookUpHeaders(*parsed[j]);
+  }
+  LogResponsesPerSecond("HttpResponseHeaders_lookup",
+                        base::TimeTicks::Now() - start);
+}
+
+TEST_F(HttpResponseHeadersPerfTest, PersistAndRestore) {
+  std::vector<scoped_refptr<HttpResponseHeaders> > parsed;
+  for (size_t i = 0; i < raw_responses_.size(); ++i)
+    parsed.push_back(new HttpResponseHeaders(raw_responses_[i]));
+
+  // The options used by the HTTP cache.
+  const HttpResponseHeaders::PersistOptions kOptions =
+      HttpResponseHeaders::PERSIST_SANS_COOKIES |
+      HttpResponseHeaders::PERSIST_SANS_CHALLENGES |
+      HttpResponseHeaders::PERSIST_SANS_HOP_BY_HOP |
+      HttpResponseHeaders::PERSIST_SANS_NON_CACHEABLE |
+      HttpResponseHeaders::PERSIST_SANS_RANGES |
+      HttpResponseHeaders::PERSIST_SANS_SECURITY_STATE;
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    for (size_t j = 0; j < parsed.size(); ++j) {
+      Pickle pickle;
+      parsed[j]->Persist(&pickle, kOptions);
+      PickleIterator iter(pickle);
+      scoped_refptr<HttpResponseHeaders> restored(
+          new HttpResponseHeaders(pickle, &iter));
+    }
+  }
+  LogResponsesPerSecond("HttpResponseHeaders_persist_and_restore",
+                        base::TimeTicks::Now() - start);
+}
+
+}  // namespace
+
+}  // namespace net
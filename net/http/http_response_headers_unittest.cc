@@ -321,6 +321,43 @@ TEST(HttpResponseHeadersTest, GetNormalizedHeader) {
   EXPECT_EQ("private, no-store", value);
 }
 
+// Tests that lookups of well-known and of other header names find the same
+// headers, also after the headers are modified.
+TEST(HttpResponseHeadersTest, WellKnownAndOtherHeaderNames) {
+  std::string headers =
+      "HTTP/1.1 200 OK\n"
+      "CONTENT-TYPE: text/html\n"
+      "X-Custom: a, b\n"
+      "x-custom-2: c\n"
+      "Cache-Control: private\n"
+      "Set-Cookie: a=b, c=d\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed(
+      new net::HttpResponseHeaders(headers));
+
+  std::string value;
+  EXPECT_TRUE(parsed->GetNormalizedHeader("content-type", &value));
+  EXPECT_EQ("text/html", value);
+  EXPECT_TRUE(parsed->GetNormalizedHeader("X-CUSTOM", &value));
+  EXPECT_EQ("a, b", value);
+  EXPECT_TRUE(parsed->HasHeaderValue("x-custom-2", "C"));
+  EXPECT_FALSE(parsed->HasHeader("x-custom-"));
+  EXPECT_FALSE(parsed->HasHeader("pragma"));
+
+  // Set-Cookie is not split on commas.
+  void* iter = NULL;
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "set-cookie", &value));
+  EXPECT_EQ("a=b, c=d", value);
+  EXPECT_FALSE(parsed->EnumerateHeader(&iter, "set-cookie", &value));
+
+  parsed->RemoveHeader("Content-Type");
+  parsed->AddHeader("Pragma: no-cache");
+  EXPECT_FALSE(parsed->HasHeader("content-type"));
+  EXPECT_TRUE(parsed->HasHeaderValue("pragma", "no-cache"));
+  EXPECT_TRUE(parsed->HasHeaderValue("cache-control", "private"));
+  EXPECT_TRUE(parsed->HasHeader("x-custom"));
+}
+
 struct PersistData {
   net::HttpResponseHeaders::PersistOptions options;
   const char* raw_headers;
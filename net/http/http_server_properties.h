@@ -11,6 +11,7 @@
 #include "base/containers/mru_cache.h"
 #include "base/memory/weak_ptr.h"
 #include "base/time/time.h"
+#include "net/base/address_family.h"
 #include "net/base/host_port_pair.h"
 #include "net/base/net_export.h"
 #include "net/socket/next_proto.h"
@@ -139,6 +140,7 @@ extern const char kAlternateProtocolHeader[];
 // * SPDY support (based on NPN results)
 // * Alternate-Protocol support
 // * Spdy Settings (like CWND ID field)
+// * Address family that connected first (for TCP connection racing)
 class NET_EXPORT HttpServerProperties {
  public:
   struct NetworkStats {
@@ -244,6 +246,14 @@ class NET_EXPORT HttpServerProperties {
   virtual const NetworkStats* GetServerNetworkStats(
       const HostPortPair& host_port_pair) const = 0;
 
+  // Returns the address family whose connect most recently won a connection
+  // race to |host_port_pair|, or ADDRESS_FAMILY_UNSPECIFIED if unknown.
+  virtual AddressFamily GetPreferredAddressFamily(
+      const HostPortPair& host_port_pair) const = 0;
+
+  virtual void SetPreferredAddressFamily(const HostPortPair& host_port_pair,
+                                         AddressFamily address_family) = 0;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(HttpServerProperties);
 };
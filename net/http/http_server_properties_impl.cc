@@ -168,6 +168,7 @@ void HttpServerPropertiesImpl::Clear() {
   canonical_host_to_origin_map_.clear();
   spdy_settings_map_.Clear();
   supports_quic_map_.clear();
+  preferred_address_family_map_.clear();
 }
 
 bool HttpServerPropertiesImpl::SupportsSpdy(
@@ -456,6 +457,24 @@ HttpServerPropertiesImpl::GetServerNetworkStats(
   return &it->second;
 }
 
+AddressFamily HttpServerPropertiesImpl::GetPreferredAddressFamily(
+    const HostPortPair& host_port_pair) const {
+  PreferredAddressFamilyMap::const_iterator it =
+      preferred_address_family_map_.find(host_port_pair);
+  if (it == preferred_address_family_map_.end())
+    return ADDRESS_FAMILY_UNSPECIFIED;
+  return it->second;
+}
+
+void HttpServerPropertiesImpl::SetPreferredAddressFamily(
+    const HostPortPair& host_port_pair,
+    AddressFamily address_family) {
+  if (address_family == ADDRESS_FAMILY_UNSPECIFIED)
+    preferred_address_family_map_.erase(host_port_pair);
+  else
+    preferred_address_family_map_[host_port_pair] = address_family;
+}
+
 void HttpServerPropertiesImpl::SetAlternateProtocolProbabilityThreshold(
     double threshold) {
   alternate_protocol_probability_threshold_ = threshold;
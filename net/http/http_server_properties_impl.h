@@ -159,11 +159,19 @@ class NET_EXPORT HttpServerPropertiesImpl
   virtual const NetworkStats* GetServerNetworkStats(
       const HostPortPair& host_port_pair) const OVERRIDE;
 
+  // Methods for preferred address families.
+  virtual AddressFamily GetPreferredAddressFamily(
+      const HostPortPair& host_port_pair) const OVERRIDE;
+
+  virtual void SetPreferredAddressFamily(const HostPortPair& host_port_pair,
+                                         AddressFamily address_family) OVERRIDE;
+
  private:
   // |spdy_servers_map_| has flattened representation of servers (host, port)
   // that either support or not support SPDY protocol.
   typedef base::MRUCache<std::string, bool> SpdyServerHostPortMap;
   typedef std::map<HostPortPair, NetworkStats> ServerNetworkStatsMap;
+  typedef std::map<HostPortPair, AddressFamily> PreferredAddressFamilyMap;
   typedef std::map<HostPortPair, HostPortPair> CanonicalHostMap;
   typedef std::vector<std::string> CanonicalSufficList;
   // List of broken host:ports and the times when they can be expired.
@@ -194,6 +202,7 @@ class NET_EXPORT HttpServerPropertiesImpl
   SpdySettingsMap spdy_settings_map_;
   SupportsQuicMap supports_quic_map_;
   ServerNetworkStatsMap server_network_stats_map_;
+  PreferredAddressFamilyMap preferred_address_family_map_;
   // Contains a map of servers which could share the same alternate protocol.
   // Map from a Canonical host/port (host is some postfix of host names) to an
   // actual origin, which has a plausible alternate protocol mapping.
@@ -716,6 +716,23 @@ TEST_F(SupportsQuicServerPropertiesTest, SetSupportsQuic) {
   EXPECT_FALSE(supports_quic2.used_quic);
   EXPECT_EQ("", supports_quic2.address);
 }
+
+typedef HttpServerPropertiesImplTest PreferredAddressFamilyServerPropertiesTest;
+
+TEST_F(PreferredAddressFamilyServerPropertiesTest, SetPreferredAddressFamily) {
+  HostPortPair test_host_port_pair("foo", 80);
+  EXPECT_EQ(ADDRESS_FAMILY_UNSPECIFIED,
+            impl_.GetPreferredAddressFamily(test_host_port_pair));
+  impl_.SetPreferredAddressFamily(test_host_port_pair, ADDRESS_FAMILY_IPV4);
+  EXPECT_EQ(ADDRESS_FAMILY_IPV4,
+            impl_.GetPreferredAddressFamily(test_host_port_pair));
+  EXPECT_EQ(ADDRESS_FAMILY_UNSPECIFIED,
+            impl_.GetPreferredAddressFamily(HostPortPair("foo", 443)));
+
+  impl_.Clear();
+  EXPECT_EQ(ADDRESS_FAMILY_UNSPECIFIED,
+            impl_.GetPreferredAddressFamily(test_host_port_pair));
+}
 }  // namespace
 
 }  // namespace net
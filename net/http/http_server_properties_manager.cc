@@ -301,6 +301,21 @@ HttpServerPropertiesManager::GetServerNetworkStats(
   return http_server_properties_impl_->GetServerNetworkStats(host_port_pair);
 }
 
+AddressFamily HttpServerPropertiesManager::GetPreferredAddressFamily(
+    const net::HostPortPair& host_port_pair) const {
+  DCHECK(network_task_runner_->RunsTasksOnCurrentThread());
+  return http_server_properties_impl_->GetPreferredAddressFamily(
+      host_port_pair);
+}
+
+void HttpServerPropertiesManager::SetPreferredAddressFamily(
+    const net::HostPortPair& host_port_pair,
+    AddressFamily address_family) {
+  DCHECK(network_task_runner_->RunsTasksOnCurrentThread());
+  http_server_properties_impl_->SetPreferredAddressFamily(host_port_pair,
+                                                          address_family);
+}
+
 //
 // Update the HttpServerPropertiesImpl's cache with data from preferences.
 //
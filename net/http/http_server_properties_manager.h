@@ -169,6 +169,12 @@ class NET_EXPORT HttpServerPropertiesManager : public HttpServerProperties {
   virtual const NetworkStats* GetServerNetworkStats(
       const HostPortPair& host_port_pair) const OVERRIDE;
 
+  virtual AddressFamily GetPreferredAddressFamily(
+      const HostPortPair& host_port_pair) const OVERRIDE;
+
+  virtual void SetPreferredAddressFamily(const HostPortPair& host_port_pair,
+                                         AddressFamily address_family) OVERRIDE;
+
  protected:
   // --------------------
   // SPDY related methods
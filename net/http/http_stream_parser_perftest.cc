@@ -0,0 +1,140 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_stream_parser.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/base/address_list.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/test_completion_callback.h"
+#include "net/http/http_request_headers.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_response_info.h"
+#include "net/socket/client_socket_handle.h"
+#include "net/socket/socket_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "url/gurl.h"
+
+namespace net {
+
+namespace {
+
+const int kSocketReadSize = 32 * 1024;
+const int kBodyReadSize = 64 * 1024;
+
+// Returns a response of |body_size| bytes, chunk-encoded in |chunk_size| byte
+// chunks, or sent with a Content-Length if |chunk_size| is 0.
+std::string MakeResponse(int body_size, int chunk_size) {
+  const std::string body(body_size, 'x');
+  if (chunk_size == 0) {
+    return base::StringPrintf("HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n",
+                              body_size) + body;
+  }
+
+  std::string response =
+      "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+  for (int offset = 0; offset < body_size; offset += chunk_size) {
+    int size = std::min(chunk_size, body_size - offset);
+    response += base::StringPrintf("%X\r\n", size);
+    response.append(body, offset, size);
+    response += "\r\n";
+  }
+  response += "0\r\n\r\n";
+  return response;
+}
+
+// Streams |response| through an HttpStreamParser in |kSocketReadSize| socket
+// reads, and logs the body throughput as |test_name|.
+void ReadResponse(const char* test_name,
+                  const std::string& response,
+                  int body_size) {
+  std::vector<MockRead> reads;
+  const int response_size = static_cast<int>(response.size());
+  for (int offset = 0; offset < response_size; offset += kSocketReadSize) {
+    reads.push_back(MockRead(SYNCHRONOUS, response.data() + offset,
+                             std::min(response_size - offset,
+                                      kSocketReadSize)));
+  }
+  reads.push_back(MockRead(SYNCHRONOUS, OK));
+
+  StaticSocketDataProvider data(&reads[0], reads.size(), NULL, 0);
+  data.set_connect_data(MockConnect(SYNCHRONOUS, OK));
+  scoped_ptr<MockTCPClientSocket> transport(
+      new MockTCPClientSocket(AddressList(), NULL, &data));
+  TestCompletionCallback callback;
+  ASSERT_EQ(OK, transport->Connect(callback.callback()));
+
+  ClientSocketHandle socket_handle;
+  socket_handle.SetSocket(transport.PassAs<StreamSocket>());
+
+  HttpRequestInfo request_info;
+  request_info.method = "GET";
+  request_info.url = GURL("http://example.com/");
+  scoped_refptr<GrowableIOBuffer> read_buffer(new GrowableIOBuffer);
+  HttpStreamParser parser(&socket_handle, &request_info, read_buffer.get(),
+                          BoundNetLog());
+
+  HttpResponseInfo response_info;
+  ASSERT_EQ(OK, parser.SendRequest("GET / HTTP/1.1\r\n", HttpRequestHeaders(),
+                                   &response_info, callback.callback()));
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  ASSERT_EQ(OK, parser.ReadResponseHeaders(callback.callback()));
+  scoped_refptr<IOBuffer> body_buffer(new IOBuffer(kBodyReadSize));
+  int bytes_read = 0;
+  for (;;) {
+    int rv = parser.ReadResponseBody(body_buffer.get(), kBodyReadSize,
+                                     callback.callback());
+    ASSERT_GE(rv, 0);
+    if (rv == 0)
+      break;
+    bytes_read += rv;
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  EXPECT_EQ(body_size, bytes_read);
+  EXPECT_TRUE(parser.IsResponseBodyComplete());
+  base::LogPerfResult(test_name,
+                      body_size / (1024.0 * 1024.0) / elapsed.InSecondsF(),
+                      "MB/s");
+}
+
+struct BodyTestCase {
+  const char* test_name;
+  int body_size;
+  int chunk_size;
+};
+
+const BodyTestCase kBodyTestCases[] = {
+  { "HttpStreamParser_1MB_content_length", 1024 * 1024, 0 },
+  { "HttpStreamParser_1MB_16B_chunks", 1024 * 1024, 16 },
+  { "HttpStreamParser_1MB_64KB_chunks", 1024 * 1024, 64 * 1024 },
+  { "HttpStreamParser_100MB_content_length", 100 * 1024 * 1024, 0 },
+  { "HttpStreamParser_100MB_16B_chunks", 100 * 1024 * 1024, 16 },
+  { "HttpStreamParser_100MB_64KB_chunks", 100 * 1024 * 1024, 64 * 1024 },
+};
+
+TEST(HttpStreamParserPerfTest, ReadResponseBody) {
+  for (size_t i = 0; i < arraysize(kBodyTestCases); ++i) {
+    const BodyTestCase& test = kBodyTestCases[i];
+    SCOPED_TRACE(test.test_name);
+    ReadResponse(test.test_name,
+                 MakeResponse(test.body_size, test.chunk_size),
+                 test.body_size);
+  }
+}
+
+}  // namespace
+
+}  // namespace net
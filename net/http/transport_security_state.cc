@@ -16,14 +16,18 @@
 #endif
 
 #include <algorithm>
+#include <map>
+#include <vector>
 
 #include "base/base64.h"
 #include "base/build_time.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/histogram.h"
 #include "base/sha1.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
 #include "base/strings/utf_string_conversions.h"
 #include "base/time/time.h"
@@ -561,81 +565,158 @@ struct HSTSPreload {
   SecondLevelDomainName second_level_domain_name;
 };
 
-static bool HasPreload(const struct HSTSPreload* entries,
-                       size_t num_entries,
-                       const std::string& canonicalized_host,
-                       size_t i,
-                       bool enable_static_pins,
-                       TransportSecurityState::DomainState* out,
-                       bool* ret) {
-  for (size_t j = 0; j < num_entries; j++) {
-    if (entries[j].length == canonicalized_host.size() - i &&
-        memcmp(entries[j].dns_name, &canonicalized_host[i],
-               entries[j].length) == 0) {
-      if (!entries[j].include_subdomains && i != 0) {
-        *ret = false;
-      } else {
-        out->sts.include_subdomains = entries[j].include_subdomains;
-        out->sts.last_observed = base::GetBuildTime();
-        *ret = true;
-        out->sts.upgrade_mode =
-            TransportSecurityState::DomainState::MODE_FORCE_HTTPS;
-        if (!entries[j].https_required)
-          out->sts.upgrade_mode =
-              TransportSecurityState::DomainState::MODE_DEFAULT;
-
-        if (enable_static_pins) {
-          out->pkp.include_subdomains = entries[j].include_subdomains;
-          out->pkp.last_observed = base::GetBuildTime();
-          if (entries[j].pins.required_hashes) {
-            const char* const* sha1_hash = entries[j].pins.required_hashes;
-            while (*sha1_hash) {
-              AddHash(*sha1_hash, &out->pkp.spki_hashes);
-              sha1_hash++;
-            }
-          }
-          if (entries[j].pins.excluded_hashes) {
-            const char* const* sha1_hash = entries[j].pins.excluded_hashes;
-            while (*sha1_hash) {
-              AddHash(*sha1_hash, &out->pkp.bad_spki_hashes);
-              sha1_hash++;
-            }
-          }
-        }
+// Fills |out| from the preloaded |entry|, which matched a suffix of the
+// host starting at offset |i| of its canonicalized form. Returns false if
+// |entry| does not apply to the host because it does not include
+// subdomains.
+static bool ApplyPreload(const struct HSTSPreload* entry,
+                         size_t i,
+                         bool enable_static_pins,
+                         TransportSecurityState::DomainState* out) {
+  if (!entry->include_subdomains && i != 0)
+    return false;
+
+  out->sts.include_subdomains = entry->include_subdomains;
+  out->sts.last_observed = base::GetBuildTime();
+  out->sts.upgrade_mode =
+      TransportSecurityState::DomainState::MODE_FORCE_HTTPS;
+  if (!entry->https_required)
+    out->sts.upgrade_mode =
+        TransportSecurityState::DomainState::MODE_DEFAULT;
+
+  if (enable_static_pins) {
+    out->pkp.include_subdomains = entry->include_subdomains;
+    out->pkp.last_observed = base::GetBuildTime();
+    if (entry->pins.required_hashes) {
+      const char* const* sha1_hash = entry->pins.required_hashes;
+      while (*sha1_hash) {
+        AddHash(*sha1_hash, &out->pkp.spki_hashes);
+        sha1_hash++;
+      }
+    }
+    if (entry->pins.excluded_hashes) {
+      const char* const* sha1_hash = entry->pins.excluded_hashes;
+      while (*sha1_hash) {
+        AddHash(*sha1_hash, &out->pkp.bad_spki_hashes);
+        sha1_hash++;
       }
-      return true;
     }
   }
-  return false;
+  return true;
 }
 
 #include "net/http/transport_security_state_static.h"
 
-// Returns the HSTSPreload entry for the |canonicalized_host| in |entries|,
-// or NULL if there is none. Prefers exact hostname matches to those that
-// match only because HSTSPreload.include_subdomains is true.
-//
-// |canonicalized_host| should be the hostname as canonicalized by
-// CanonicalizeHost.
-static const struct HSTSPreload* GetHSTSPreload(
-    const std::string& canonicalized_host,
-    const struct HSTSPreload* entries,
-    size_t num_entries) {
-  for (size_t i = 0; canonicalized_host[i]; i += canonicalized_host[i] + 1) {
-    for (size_t j = 0; j < num_entries; j++) {
-      const struct HSTSPreload* entry = entries + j;
+namespace {
+
+// A trie over the labels of the preloaded hostnames, starting from the
+// top-level domain, so that the preloaded entry for the longest suffix of a
+// host is found in one walk over its labels rather than by scanning
+// |kPreloadedSTS| once per label. The labels point into |kPreloadedSTS|.
+class PreloadTrie {
+ public:
+  PreloadTrie() : nodes_(1) {
+    for (size_t i = 0; i < kNumPreloadedSTS; ++i)
+      Insert(&kPreloadedSTS[i]);
+  }
 
-      if (i != 0 && !entry->include_subdomains)
-        continue;
+  // Returns the entry for the longest suffix of |canonicalized_host| that is
+  // preloaded, or NULL if there is none, and sets |*offset| to where that
+  // suffix starts in |canonicalized_host|. If |require_include_subdomains| is
+  // true, entries for proper suffixes are skipped unless they include
+  // subdomains.
+  //
+  // |canonicalized_host| should be the hostname as canonicalized by
+  // CanonicalizeHost.
+  const struct HSTSPreload* Find(const std::string& canonicalized_host,
+                                 bool require_include_subdomains,
+                                 size_t* offset) const {
+    // A canonicalized name is at most 255 bytes, so it has fewer than 128
+    // labels.
+    size_t label_offsets[128];
+    size_t num_labels = 0;
+    for (size_t i = 0; i < canonicalized_host.size() && canonicalized_host[i];
+         i += canonicalized_host[i] + 1) {
+      DCHECK_LT(num_labels, arraysize(label_offsets));
+      label_offsets[num_labels++] = i;
+    }
 
-      if (entry->length == canonicalized_host.size() - i &&
-          memcmp(entry->dns_name, &canonicalized_host[i], entry->length) == 0) {
-        return entry;
+    const struct HSTSPreload* match = NULL;
+    size_t node = 0;
+    while (num_labels > 0) {
+      const size_t i = label_offsets[--num_labels];
+      ChildMap::const_iterator it = nodes_[node].children.find(
+          base::StringPiece(&canonicalized_host[i + 1],
+                            canonicalized_host[i]));
+      if (it == nodes_[node].children.end())
+        break;
+      node = it->second;
+
+      const struct HSTSPreload* entry = nodes_[node].entry;
+      if (entry &&
+          (i == 0 || !require_include_subdomains ||
+           entry->include_subdomains)) {
+        match = entry;
+        *offset = i;
       }
     }
+    return match;
+  }
+
+ private:
+  typedef std::map<base::StringPiece, size_t> ChildMap;
+
+  struct Node {
+    Node() : entry(NULL) {}
+
+    ChildMap children;
+    const struct HSTSPreload* entry;
+  };
+
+  void Insert(const struct HSTSPreload* entry) {
+    std::vector<base::StringPiece> labels;
+    for (size_t i = 0; entry->dns_name[i]; i += entry->dns_name[i] + 1)
+      labels.push_back(base::StringPiece(&entry->dns_name[i + 1],
+                                         entry->dns_name[i]));
+
+    size_t node = 0;
+    for (std::vector<base::StringPiece>::reverse_iterator it = labels.rbegin();
+         it != labels.rend(); ++it) {
+      ChildMap::const_iterator child = nodes_[node].children.find(*it);
+      if (child == nodes_[node].children.end()) {
+        nodes_.push_back(Node());
+        child = nodes_[node].children.insert(
+            std::make_pair(*it, nodes_.size() - 1)).first;
+      }
+      node = child->second;
+    }
+
+    // Like a scan of |kPreloadedSTS|, the first entry for a name wins.
+    if (!nodes_[node].entry)
+      nodes_[node].entry = entry;
   }
 
-  return NULL;
+  // The root is |nodes_[0]|.
+  std::vector<Node> nodes_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreloadTrie);
+};
+
+base::LazyInstance<PreloadTrie>::Leaky g_preload_trie =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+// Returns the HSTSPreload entry for the |canonicalized_host|, or NULL if
+// there is none. Prefers exact hostname matches to those that match only
+// because HSTSPreload.include_subdomains is true.
+//
+// |canonicalized_host| should be the hostname as canonicalized by
+// CanonicalizeHost.
+static const struct HSTSPreload* GetHSTSPreload(
+    const std::string& canonicalized_host) {
+  size_t offset = 0;
+  return g_preload_trie.Get().Find(canonicalized_host, true, &offset);
 }
 
 bool TransportSecurityState::AddHSTSHeader(const std::string& host,
@@ -734,7 +815,7 @@ bool TransportSecurityState::AddHPKP(const std::string& host,
 bool TransportSecurityState::IsGooglePinnedProperty(const std::string& host) {
   std::string canonicalized_host = CanonicalizeHost(host);
   const struct HSTSPreload* entry =
-      GetHSTSPreload(canonicalized_host, kPreloadedSTS, kNumPreloadedSTS);
+      GetHSTSPreload(canonicalized_host);
 
   return entry && entry->pins.required_hashes == kGoogleAcceptableCerts;
 }
@@ -744,7 +825,7 @@ void TransportSecurityState::ReportUMAOnPinFailure(const std::string& host) {
   std::string canonicalized_host = CanonicalizeHost(host);
 
   const struct HSTSPreload* entry =
-      GetHSTSPreload(canonicalized_host, kPreloadedSTS, kNumPreloadedSTS);
+      GetHSTSPreload(canonicalized_host);
 
   if (!entry) {
     // We don't care to report pin failures for dynamic pins.
@@ -793,31 +874,28 @@ bool TransportSecurityState::GetStaticDomainState(const std::string& host,
   out->sts.include_subdomains = false;
   out->pkp.include_subdomains = false;
 
-  const bool is_build_timely = IsBuildTimely();
+  if (!IsBuildTimely())
+    return false;
 
-  for (size_t i = 0; canonicalized_host[i]; i += canonicalized_host[i] + 1) {
-    std::string host_sub_chunk(&canonicalized_host[i],
-                               canonicalized_host.size() - i);
-    out->domain = DNSDomainToString(host_sub_chunk);
-    bool ret;
-    if (is_build_timely && HasPreload(kPreloadedSTS,
-                                      kNumPreloadedSTS,
-                                      canonicalized_host,
-                                      i,
-                                      enable_static_pins_,
-                                      out,
-                                      &ret)) {
-      return ret;
-    }
-  }
+  size_t i = 0;
+  const struct HSTSPreload* entry =
+      g_preload_trie.Get().Find(canonicalized_host, false, &i);
+  if (!entry)
+    return false;
 
-  return false;
+  out->domain = DNSDomainToString(
+      base::StringPiece(&canonicalized_host[i], canonicalized_host.size() - i));
+  return ApplyPreload(entry, i, enable_static_pins_, out);
 }
 
 bool TransportSecurityState::GetDynamicDomainState(const std::string& host,
                                                    DomainState* result) {
   DCHECK(CalledOnValidThread());
 
+  // Avoid canonicalizing and hashing |host| when nothing has been learned.
+  if (enabled_hosts_.empty())
+    return false;
+
   DomainState state;
   const std::string canonicalized_host = CanonicalizeHost(host);
   if (canonicalized_host.empty())
@@ -0,0 +1,79 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/transport_security_state.h"
+
+#include <string>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_time_logger.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#if defined(USE_OPENSSL)
+#include "crypto/openssl_util.h"
+#else
+#include "crypto/nss_util.h"
+#endif
+
+namespace net {
+
+namespace {
+
+const int kNumHosts = 100000;
+
+// Returns |kNumHosts| hostnames: subdomains of preloaded domains, of
+// dynamically added domains, and of neither.
+std::vector<std::string> MakeHosts() {
+  const char* const kDomains[] = {
+    "google.com",
+    "apis.google.com",
+    "paypal.com",
+    "dynamic.example.com",
+    "example.com",
+    "example.org",
+    "static.example.net",
+    "news.example.co.uk",
+  };
+  std::vector<std::string> hosts;
+  for (int i = 0; i < kNumHosts; ++i) {
+    hosts.push_back(base::StringPrintf(
+        "host%d.%s", i % 1000, kDomains[i % arraysize(kDomains)]));
+  }
+  return hosts;
+}
+
+TEST(TransportSecurityStatePerfTest, ShouldUpgradeToSSL) {
+#if defined(USE_OPENSSL)
+  crypto::EnsureOpenSSLInit();
+#else
+  crypto::EnsureNSSInit();
+#endif
+  const std::vector<std::string> hosts = MakeHosts();
+  TransportSecurityState state;
+
+  // Builds the preload index, so that it is not part of the measurement.
+  state.ShouldUpgradeToSSL("www.google.com");
+
+  {
+    base::PerfTimeLogger timer("TransportSecurityState_static_only");
+    for (size_t i = 0; i < hosts.size(); ++i)
+      state.ShouldUpgradeToSSL(hosts[i]);
+    timer.Done();
+  }
+
+  state.AddHSTS("dynamic.example.com",
+                base::Time::Now() + base::TimeDelta::FromDays(365), true);
+  {
+    base::PerfTimeLogger timer("TransportSecurityState_static_and_dynamic");
+    for (size_t i = 0; i < hosts.size(); ++i)
+      state.ShouldUpgradeToSSL(hosts[i]);
+    timer.Done();
+  }
+}
+
+}  // namespace
+
+}  // namespace net
@@ -226,6 +226,28 @@ TEST_F(TransportSecurityStateTest, PreloadedDomainSet) {
   EXPECT_EQ(domain_state.domain, "market.android.com");
 }
 
+TEST_F(TransportSecurityStateTest, PreloadedLongestSuffixWins) {
+  TransportSecurityState state;
+  TransportSecurityState::DomainState domain_state;
+
+  EXPECT_TRUE(GetStaticDomainState(&state, "a.b.chart.apis.google.com",
+                                   &domain_state));
+  EXPECT_EQ("chart.apis.google.com", domain_state.domain);
+  EXPECT_FALSE(domain_state.ShouldUpgradeToSSL());
+
+  EXPECT_TRUE(GetStaticDomainState(&state, "a.b.apis.google.com",
+                                   &domain_state));
+  EXPECT_EQ("apis.google.com", domain_state.domain);
+  EXPECT_TRUE(domain_state.ShouldUpgradeToSSL());
+
+  // A name with many labels, none of which are preloaded.
+  std::string host;
+  for (int i = 0; i < 100; ++i)
+    host += "a.";
+  host += "example.com";
+  EXPECT_FALSE(GetStaticDomainState(&state, host, &domain_state));
+}
+
 static bool StaticShouldRedirect(const char* hostname) {
   TransportSecurityState state;
   TransportSecurityState::DomainState domain_state;
@@ -404,7 +404,7 @@ int ClientSocketPoolBaseHelper::RequestSocketInternal(
                     connect_job->connect_timing(), handle, base::TimeDelta(),
                     group, request.net_log());
     } else {
-      AddIdleSocket(connect_job->PassSocket(), group);
+      AddIdleSocket(connect_job->PassSocket(), group_name);
     }
   } else if (rv == ERR_IO_PENDING) {
     // If we don't have any sockets in this group, set a timer for potentially
@@ -451,7 +451,7 @@ bool ClientSocketPoolBaseHelper::AssignIdleSocketToRequest(
     if (!it->IsUsable()) {
       DecrementIdleCount();
       delete it->socket;
-      it = idle_sockets->erase(it);
+      it = RemoveIdleSocket(group, it);
       continue;
     }
 
@@ -474,7 +474,7 @@ bool ClientSocketPoolBaseHelper::AssignIdleSocketToRequest(
     base::TimeDelta idle_time =
         base::TimeTicks::Now() - idle_socket_it->start_time;
     IdleSocket idle_socket = *idle_socket_it;
-    idle_sockets->erase(idle_socket_it);
+    RemoveIdleSocket(group, idle_socket_it);
     // TODO(davidben): If |idle_time| is under some low watermark, consider
     // treating as UNUSED rather than UNUSED_IDLE. This will avoid
     // HttpNetworkTransaction retrying on some errors.
@@ -671,30 +671,29 @@ void ClientSocketPoolBaseHelper::CleanupIdleSockets(bool force) {
   // inside the inner loop, since it shouldn't change by any meaningful amount.
   base::TimeTicks now = base::TimeTicks::Now();
 
-  GroupMap::iterator i = group_map_.begin();
-  while (i != group_map_.end()) {
-    Group* group = i->second;
+  // Walk the idle sockets rather than the groups, as most groups may have
+  // none.
+  IdleSocketList::iterator i = idle_socket_list_.begin();
+  while (i != idle_socket_list_.end()) {
+    GroupMap::value_type* group_entry = *i;
+    Group* group = group_entry->second;
+    std::list<IdleSocket>::iterator j = group->FindIdleSocket(i);
+    // |i| may be erased below.
+    ++i;
+
+    base::TimeDelta timeout =
+        j->socket->WasEverUsed() ?
+        used_idle_socket_timeout_ : unused_idle_socket_timeout_;
+    if (!force && !j->ShouldCleanup(now, timeout))
+      continue;
 
-    std::list<IdleSocket>::iterator j = group->mutable_idle_sockets()->begin();
-    while (j != group->idle_sockets().end()) {
-      base::TimeDelta timeout =
-          j->socket->WasEverUsed() ?
-          used_idle_socket_timeout_ : unused_idle_socket_timeout_;
-      if (force || j->ShouldCleanup(now, timeout)) {
-        delete j->socket;
-        j = group->mutable_idle_sockets()->erase(j);
-        DecrementIdleCount();
-      } else {
-        ++j;
-      }
-    }
+    delete j->socket;
+    RemoveIdleSocket(group, j);
+    DecrementIdleCount();
 
     // Delete group if no longer needed.
-    if (group->IsEmpty()) {
-      RemoveGroup(i++);
-    } else {
-      ++i;
-    }
+    if (group->IsEmpty())
+      RemoveGroup(group_entry->first);
   }
 }
 
@@ -781,7 +780,7 @@ void ClientSocketPoolBaseHelper::ReleaseSocket(const std::string& group_name,
       id == pool_generation_number_;
   if (can_reuse) {
     // Add it to the idle list.
-    AddIdleSocket(socket.Pass(), group);
+    AddIdleSocket(socket.Pass(), group_name);
     OnAvailableSocketSlot(group_name, group);
   } else {
     socket.reset();
@@ -826,7 +825,7 @@ void ClientSocketPoolBaseHelper::CheckForStalledSocketGroups() {
 
 // Search for the highest priority pending request, amongst the groups that
 // are not at the |max_sockets_per_group_| limit. Note: for requests with
-// the same priority, the winner is based on group hash ordering (and not
+// the same priority, the winner is the group whose name sorts first (and not
 // insertion order).
 bool ClientSocketPoolBaseHelper::FindTopStalledGroup(
     Group** group,
@@ -845,7 +844,10 @@ bool ClientSocketPoolBaseHelper::FindTopStalledGroup(
         return true;
       has_stalled_group = true;
       bool has_higher_priority = !top_group ||
-          curr_group->TopPendingPriority() > top_group->TopPendingPriority();
+          curr_group->TopPendingPriority() > top_group->TopPendingPriority() ||
+          (curr_group->TopPendingPriority() ==
+               top_group->TopPendingPriority() &&
+           i->first < *top_group_name);
       if (has_higher_priority) {
         top_group = curr_group;
         top_group_name = &i->first;
@@ -893,7 +895,7 @@ void ClientSocketPoolBaseHelper::OnConnectJobComplete(
       request->net_log().EndEvent(NetLog::TYPE_SOCKET_POOL);
       InvokeUserCallbackLater(request->handle(), request->callback(), result);
     } else {
-      AddIdleSocket(socket.Pass(), group);
+      AddIdleSocket(socket.Pass(), group_name);
       OnAvailableSocketSlot(group_name, group);
       CheckForStalledSocketGroups();
     }
@@ -1003,16 +1005,29 @@ void ClientSocketPoolBaseHelper::HandOutSocket(
 
 void ClientSocketPoolBaseHelper::AddIdleSocket(
     scoped_ptr<StreamSocket> socket,
-    Group* group) {
+    const std::string& group_name) {
   DCHECK(socket);
+  GroupMap::iterator group_it = group_map_.find(group_name);
+  CHECK(group_it != group_map_.end());
+
   IdleSocket idle_socket;
   idle_socket.socket = socket.release();
   idle_socket.start_time = base::TimeTicks::Now();
+  idle_socket.position =
+      idle_socket_list_.insert(idle_socket_list_.end(), &*group_it);
 
-  group->mutable_idle_sockets()->push_back(idle_socket);
+  group_it->second->mutable_idle_sockets()->push_back(idle_socket);
   IncrementIdleCount();
 }
 
+std::list<ClientSocketPoolBaseHelper::IdleSocket>::iterator
+ClientSocketPoolBaseHelper::RemoveIdleSocket(
+    Group* group,
+    std::list<IdleSocket>::iterator it) {
+  idle_socket_list_.erase(it->position);
+  return group->mutable_idle_sockets()->erase(it);
+}
+
 void ClientSocketPoolBaseHelper::CancelAllConnectJobs() {
   for (GroupMap::iterator i = group_map_.begin(); i != group_map_.end();) {
     Group* group = i->second;
@@ -1076,21 +1091,23 @@ bool ClientSocketPoolBaseHelper::CloseOneIdleSocketExceptInGroup(
     const Group* exception_group) {
   CHECK_GT(idle_socket_count(), 0);
 
-  for (GroupMap::iterator i = group_map_.begin(); i != group_map_.end(); ++i) {
-    Group* group = i->second;
+  // |idle_socket_list_| is oldest first.  At most |max_sockets_per_group_|
+  // sockets of |exception_group| are skipped.
+  for (IdleSocketList::iterator i = idle_socket_list_.begin();
+       i != idle_socket_list_.end(); ++i) {
+    GroupMap::value_type* group_entry = *i;
+    Group* group = group_entry->second;
     if (exception_group == group)
       continue;
-    std::list<IdleSocket>* idle_sockets = group->mutable_idle_sockets();
 
-    if (!idle_sockets->empty()) {
-      delete idle_sockets->front().socket;
-      idle_sockets->pop_front();
-      DecrementIdleCount();
-      if (group->IsEmpty())
-        RemoveGroup(i);
+    std::list<IdleSocket>::iterator j = group->FindIdleSocket(i);
+    delete j->socket;
+    RemoveIdleSocket(group, j);
+    DecrementIdleCount();
+    if (group->IsEmpty())
+      RemoveGroup(group_entry->first);
 
-      return true;
-    }
+    return true;
   }
 
   return false;
@@ -1151,6 +1168,16 @@ ClientSocketPoolBaseHelper::Group::~Group() {
   DCHECK_EQ(0u, unassigned_job_count_);
 }
 
+std::list<ClientSocketPoolBaseHelper::IdleSocket>::iterator
+ClientSocketPoolBaseHelper::Group::FindIdleSocket(
+    IdleSocketList::iterator position) {
+  std::list<IdleSocket>::iterator it = idle_sockets_.begin();
+  while (it != idle_sockets_.end() && it->position != position)
+    ++it;
+  CHECK(it != idle_sockets_.end());
+  return it;
+}
+
 void ClientSocketPoolBaseHelper::Group::StartBackupJobTimer(
     const std::string& group_name,
     ClientSocketPoolBaseHelper* pool) {
@@ -31,6 +31,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
@@ -303,11 +304,7 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
   // sockets that timed out or can't be reused.  Made public for testing.
   void CleanupIdleSockets(bool force);
 
-  // Closes one idle socket.  Picks the first one encountered.
-  // TODO(willchan): Consider a better algorithm for doing this.  Perhaps we
-  // should keep an ordered list of idle sockets, and close them in order.
-  // Requires maintaining more state.  It's not clear if it's worth it since
-  // I'm not sure if we hit this situation often.
+  // Closes the socket that has been idle the longest.
   bool CloseOneIdleSocket();
 
   // Checks higher layered pools to see if they can close an idle connection.
@@ -335,6 +332,15 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
  private:
   friend class base::RefCounted<ClientSocketPoolBaseHelper>;
 
+  class Group;
+  typedef base::hash_map<std::string, Group*> GroupMap;
+
+  // All idle sockets of the pool, from the one that has been idle the longest
+  // to the most recent one, each given by the |group_map_| entry of its group.
+  // Entries of a hash_map are not moved when it rehashes, and a group is only
+  // removed once it has no idle sockets, so the pointers stay valid.
+  typedef std::list<GroupMap::value_type*> IdleSocketList;
+
   // Entry for a persistent socket which became idle at time |start_time|.
   struct IdleSocket {
     IdleSocket() : socket(NULL) {}
@@ -356,6 +362,8 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
 
     StreamSocket* socket;
     base::TimeTicks start_time;
+    // Position of this socket in |idle_socket_list_|.
+    IdleSocketList::iterator position;
   };
 
   typedef PriorityQueue<const Request*> RequestQueue;
@@ -453,6 +461,12 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
     int active_socket_count() const { return active_socket_count_; }
     std::list<IdleSocket>* mutable_idle_sockets() { return &idle_sockets_; }
 
+    // Returns the idle socket of this group at |position| in
+    // |idle_socket_list_|.  Linear in the number of idle sockets of the group,
+    // which is bounded by |max_sockets_per_group_|.
+    std::list<IdleSocket>::iterator FindIdleSocket(
+        IdleSocketList::iterator position);
+
    private:
     // Returns the iterator's pending request after removing it from
     // the queue.
@@ -484,8 +498,6 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
     base::OneShotTimer<Group> backup_job_timer_;
   };
 
-  typedef std::map<std::string, Group*> GroupMap;
-
   typedef std::set<ConnectJob*> ConnectJobSet;
 
   struct CallbackResultPair {
@@ -541,8 +553,16 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
                      Group* group,
                      const BoundNetLog& net_log);
 
-  // Adds |socket| to the list of idle sockets for |group|.
-  void AddIdleSocket(scoped_ptr<StreamSocket> socket, Group* group);
+  // Adds |socket| to the list of idle sockets for the group |group_name|,
+  // which must exist.
+  void AddIdleSocket(scoped_ptr<StreamSocket> socket,
+                     const std::string& group_name);
+
+  // Removes the idle socket at |it| from |group| and from |idle_socket_list_|
+  // without deleting it, and returns the next idle socket of |group|.
+  std::list<IdleSocket>::iterator RemoveIdleSocket(
+      Group* group,
+      std::list<IdleSocket>::iterator it);
 
   // Iterates through |group_map_|, canceling all ConnectJobs and deleting
   // groups if they are no longer needed.
@@ -607,6 +627,9 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
   // The total number of idle sockets in the system.
   int idle_socket_count_;
 
+  // Every idle socket, across all groups, in the order they became idle.
+  IdleSocketList idle_socket_list_;
+
   // Number of connecting sockets across all groups.
   int connecting_socket_count_;
 
@@ -0,0 +1,97 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/socket/client_socket_pool_base.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/test_completion_callback.h"
+#include "net/dns/mock_host_resolver.h"
+#include "net/socket/client_socket_handle.h"
+#include "net/socket/client_socket_pool_histograms.h"
+#include "net/socket/transport_client_socket_pool.h"
+#include "net/socket/transport_client_socket_pool_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumGroups = 10000;
+const int kNumCycles = 10;
+
+class ClientSocketPoolBasePerfTest : public testing::Test {
+ protected:
+  ClientSocketPoolBasePerfTest()
+      : histograms_("PerfTest"),
+        client_socket_factory_(NULL) {
+    host_resolver_.set_synchronous_mode(true);
+    for (int i = 0; i < kNumGroups; ++i) {
+      HostPortPair host_port_pair(
+          base::StringPrintf("host%d.example.com", i), 80);
+      group_names_.push_back(host_port_pair.ToString());
+      params_.push_back(new TransportSocketParams(
+          host_port_pair, false, false, OnHostResolutionCallback(),
+          TransportSocketParams::COMBINE_CONNECT_AND_WRITE_DEFAULT));
+    }
+  }
+
+  // Requests a socket from each group in turn and releases it right away,
+  // |kNumCycles| times over.  Sockets connect synchronously, so every request
+  // either reuses the group's idle socket or connects a new one.
+  void RunRequestReleaseCycles(int max_sockets, const char* test_name) {
+    TransportClientSocketPool pool(max_sockets, 6, &histograms_,
+                                   &host_resolver_, &client_socket_factory_,
+                                   NULL);
+    TestCompletionCallback callback;
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int cycle = 0; cycle < kNumCycles; ++cycle) {
+      for (int i = 0; i < kNumGroups; ++i) {
+        ClientSocketHandle handle;
+        ASSERT_EQ(OK, handle.Init(group_names_[i], params_[i], MEDIUM,
+                                  callback.callback(), &pool, BoundNetLog()));
+        handle.Reset();
+      }
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    EXPECT_EQ(std::min(max_sockets, kNumGroups), pool.IdleSocketCount());
+    base::LogPerfResult(test_name,
+                        kNumCycles * kNumGroups / elapsed.InSecondsF(),
+                        "cycles/s");
+  }
+
+  base::MessageLoopForIO message_loop_;
+  ClientSocketPoolHistograms histograms_;
+  MockHostResolver host_resolver_;
+  MockTransportClientSocketFactory client_socket_factory_;
+  std::vector<std::string> group_names_;
+  std::vector<scoped_refptr<TransportSocketParams> > params_;
+};
+
+// Every group keeps an idle socket, which all requests after the first cycle
+// reuse.
+TEST_F(ClientSocketPoolBasePerfTest, ReuseIdleSockets) {
+  RunRequestReleaseCycles(kNumGroups, "ClientSocketPoolBase_reuse_idle");
+}
+
+// Only a fraction of the groups fit under the socket limit, so every request
+// closes the longest idle socket of another group before connecting.
+TEST_F(ClientSocketPoolBasePerfTest, CloseIdleSocketsAtLimit) {
+  RunRequestReleaseCycles(256, "ClientSocketPoolBase_close_idle_at_limit");
+}
+
+}  // namespace
+
+}  // namespace net
@@ -1305,9 +1305,9 @@ TEST_F(ClientSocketPoolBaseTest, CloseIdleSocketAtSocketLimitDeleteGroup) {
   ClientSocketHandle handle;
   TestCompletionCallback callback;
 
-  // "0" is special here, since it should be the first entry in the sorted map,
-  // which is the one which we would close an idle socket for.  We shouldn't
-  // close an idle socket though, since we should reuse the idle socket.
+  // "0" is special here, since its socket has been idle the longest, so it is
+  // the one which we would close an idle socket for.  We shouldn't close an
+  // idle socket though, since we should reuse the idle socket.
   EXPECT_EQ(OK, handle.Init("0",
                             params_,
                             DEFAULT_PRIORITY,
@@ -1319,6 +1319,42 @@ TEST_F(ClientSocketPoolBaseTest, CloseIdleSocketAtSocketLimitDeleteGroup) {
   EXPECT_EQ(kDefaultMaxSockets - 1, pool_->IdleSocketCount());
 }
 
+// Check that the socket closed to make room for a new one is the one that has
+// been idle the longest, whichever group it is in.
+TEST_F(ClientSocketPoolBaseTest, CloseLongestIdleSocketAtSocketLimit) {
+  CreatePool(2, 2);
+  connect_job_factory_->set_job_type(TestConnectJob::kMockJob);
+
+  // Leave an idle socket in "b", then one in "a".
+  const char* const kGroups[] = { "b", "a" };
+  for (size_t i = 0; i < arraysize(kGroups); ++i) {
+    ClientSocketHandle handle;
+    TestCompletionCallback callback;
+    EXPECT_EQ(OK, handle.Init(kGroups[i],
+                              params_,
+                              DEFAULT_PRIORITY,
+                              callback.callback(),
+                              pool_.get(),
+                              BoundNetLog()));
+    handle.Reset();
+  }
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, pool_->IdleSocketCount());
+
+  ClientSocketHandle handle;
+  TestCompletionCallback callback;
+  EXPECT_EQ(OK, handle.Init("c",
+                            params_,
+                            DEFAULT_PRIORITY,
+                            callback.callback(),
+                            pool_.get(),
+                            BoundNetLog()));
+
+  EXPECT_EQ(3, client_socket_factory_.allocation_count());
+  EXPECT_FALSE(pool_->HasGroup("b"));
+  EXPECT_EQ(1, pool_->IdleSocketCountInGroup("a"));
+}
+
 TEST_F(ClientSocketPoolBaseTest, PendingRequests) {
   CreatePool(kDefaultMaxSockets, kDefaultMaxSocketsPerGroup);
 
@@ -3607,8 +3643,8 @@ TEST_F(ClientSocketPoolBaseTest, PreconnectClosesIdleSocketRemovesGroup) {
   CreatePool(kMaxTotalSockets, kMaxSocketsPerGroup);
   connect_job_factory_->set_job_type(TestConnectJob::kMockPendingJob);
 
-  // Note that group name ordering matters here.  "a" comes before "b", so
-  // CloseOneIdleSocket() will try to close "a"'s idle socket.
+  // Note that idle socket ordering matters here.  "a"'s socket becomes idle
+  // before "b"'s, so CloseOneIdleSocket() will try to close "a"'s idle socket.
 
   // Set up one idle socket in "a".
   ClientSocketHandle handle1;
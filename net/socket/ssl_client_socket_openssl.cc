@@ -29,7 +29,6 @@
 #include "net/cert/x509_certificate_net_log_param.h"
 #include "net/cert/x509_util_openssl.h"
 #include "net/http/transport_security_state.h"
-#include "net/socket/ssl_session_cache_openssl.h"
 #include "net/ssl/openssl_ssl_util.h"
 #include "net/ssl/ssl_cert_request_info.h"
 #include "net/ssl/ssl_connection_status_flags.h"
@@ -148,6 +147,14 @@ class SSLClientSocketOpenSSL::SSLContext {
   SSL_CTX* ssl_ctx() { return ssl_ctx_.get(); }
   SSLSessionCacheOpenSSL* session_cache() { return &session_cache_; }
 
+  // Starts over with an empty cache saving the sessions of
+  // |ssl_session_cache_shard| to |store|.
+  void SetSessionCacheStore(SSLSessionCacheOpenSSL::PersistentStore* store,
+                            const std::string& ssl_session_cache_shard) {
+    session_cache_.Reset(ssl_ctx_.get(), kDefaultSessionCacheConfig);
+    session_cache_.SetPersistentStore(store, "/" + ssl_session_cache_shard);
+  }
+
   SSLClientSocketOpenSSL* GetClientSocketFromSSL(const SSL* ssl) {
     DCHECK(ssl);
     SSLClientSocketOpenSSL* socket = static_cast<SSLClientSocketOpenSSL*>(
@@ -331,6 +338,14 @@ void SSLClientSocket::ClearSessionCache() {
   context->session_cache()->Flush();
 }
 
+// static
+void SSLClientSocketOpenSSL::SetSessionCacheStore(
+    SSLSessionCacheOpenSSL::PersistentStore* store,
+    const std::string& ssl_session_cache_shard) {
+  SSLContext::GetInstance()->SetSessionCacheStore(store,
+                                                  ssl_session_cache_shard);
+}
+
 SSLClientSocketOpenSSL::SSLClientSocketOpenSSL(
     scoped_ptr<ClientSocketHandle> transport_socket,
     const HostPortPair& host_and_port,
@@ -1135,7 +1150,7 @@ void SSLClientSocketOpenSSL::DoConnectCallback(int rv) {
 }
 
 void SSLClientSocketOpenSSL::UpdateServerCert() {
-  server_cert_chain_->Reset(SSL_get_peer_cert_chain(ssl_));
+  server_cert_chain_->Reset(SSLSessionCacheOpenSSL::GetPeerCertChain(ssl_));
   server_cert_ = server_cert_chain_->AsOSChain();
 
   if (server_cert_.get()) {
@@ -16,6 +16,7 @@
 #include "net/cert/ct_verify_result.h"
 #include "net/socket/client_socket_handle.h"
 #include "net/socket/ssl_client_socket.h"
+#include "net/socket/ssl_session_cache_openssl.h"
 #include "net/ssl/channel_id_service.h"
 #include "net/ssl/ssl_client_cert_type.h"
 #include "net/ssl/ssl_config_service.h"
@@ -58,6 +59,18 @@ class SSLClientSocketOpenSSL : public SSLClientSocket {
     return ssl_session_cache_shard_;
   }
 
+  // Sets the store that the session cache of all OpenSSL sockets saves good
+  // sessions to, so that they can be resumed after a restart. This flushes
+  // the sessions cached in memory, but not those of the store, which are
+  // loaded into the cache instead. Passing NULL unsets the store.
+  //
+  // Only the sessions of |ssl_session_cache_shard| are saved. It must be the
+  // shard of a profile whose state is kept on disk: the sessions of other
+  // shards, such as those of off-the-record profiles, are never saved.
+  static void SetSessionCacheStore(
+      SSLSessionCacheOpenSSL::PersistentStore* store,
+      const std::string& ssl_session_cache_shard);
+
   // SSLClientSocket implementation.
   virtual std::string GetSessionCacheKey() const OVERRIDE;
   virtual bool InSessionCache() const OVERRIDE;
@@ -5,7 +5,9 @@
 #include "net/socket/ssl_client_socket.h"
 
 #include "base/callback_helpers.h"
+#include "base/files/scoped_temp_dir.h"
 #include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop_proxy.h"
 #include "base/run_loop.h"
 #include "base/time/time.h"
 #include "net/base/address_list.h"
@@ -35,6 +37,11 @@
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
+#if defined(USE_OPENSSL)
+#include "net/socket/ssl_client_socket_openssl.h"
+#include "net/socket/ssl_session_persister.h"
+#endif
+
 //-----------------------------------------------------------------------------
 
 using testing::_;
@@ -2939,6 +2946,51 @@ TEST_F(SSLClientSocketFalseStartTest,
   ASSERT_NO_FATAL_FAILURE(TestFalseStart(server_options, client_config, true));
   ASSERT_TRUE(ran_handshake_completion_callback_);
 }
+
+// Tests that sessions saved to a persistent store are resumed by the sockets
+// of the next run, sparing them a full handshake.
+TEST_F(SSLClientSocketTest, PersistentSessionCacheResumesAfterRestart) {
+  SpawnedTestServer::SSLOptions ssl_options;
+  ASSERT_TRUE(StartTestServer(ssl_options));
+
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const base::FilePath path = temp_dir.path().AppendASCII("SSLSessions");
+  const std::string key(SSLSessionPersister::kKeySize, 'k');
+
+  const int kNumRuns = 5;
+  int handshakes_avoided = 0;
+  for (int i = 0; i < kNumRuns; ++i) {
+    // Each run starts with an empty cache, and loads what the previous run
+    // saved.
+    scoped_ptr<SSLSessionPersister> persister(new SSLSessionPersister(
+        path, key, base::MessageLoopProxy::current()));
+    SSLClientSocketOpenSSL::SetSessionCacheStore(
+        persister.get(), context_.ssl_session_cache_shard);
+    base::RunLoop().RunUntilIdle();
+
+    TestCompletionCallback callback;
+    scoped_ptr<StreamSocket> transport(
+        new TCPClientSocket(addr(), &log_, NetLog::Source()));
+    ASSERT_EQ(OK, callback.GetResult(transport->Connect(callback.callback())));
+    scoped_ptr<SSLClientSocket> sock = CreateSSLClientSocket(
+        transport.Pass(), test_server()->host_port_pair(), kDefaultSSLConfig);
+    ASSERT_EQ(OK, callback.GetResult(sock->Connect(callback.callback())));
+
+    SSLInfo ssl_info;
+    ASSERT_TRUE(sock->GetSSLInfo(&ssl_info));
+    if (ssl_info.handshake_type == SSLInfo::HANDSHAKE_RESUME)
+      handshakes_avoided++;
+    sock.reset();
+
+    SSLClientSocketOpenSSL::SetSessionCacheStore(NULL, std::string());
+    persister.reset();
+    base::RunLoop().RunUntilIdle();
+  }
+
+  // Only the first run does a full handshake.
+  EXPECT_EQ(kNumRuns - 1, handshakes_avoided);
+}
 #endif  // defined(USE_OPENSSL)
 
 TEST_F(SSLClientSocketFalseStartTest, FalseStartEnabled) {
@@ -9,16 +9,33 @@
 
 #include <openssl/rand.h>
 #include <openssl/ssl.h>
+#include <openssl/x509.h>
 
+#include "base/bind.h"
 #include "base/containers/hash_tables.h"
 #include "base/lazy_instance.h"
 #include "base/logging.h"
+#include "base/memory/weak_ptr.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_util.h"
 #include "base/synchronization/lock.h"
+#include "net/cert/x509_util_openssl.h"
 
 namespace net {
 
 namespace {
 
+// Called to destroy the certificate chain associated with an SSL_SESSION.
+void FreeCertChain(void* parent,
+                   void* ptr,
+                   CRYPTO_EX_DATA* ad,
+                   int index,
+                   long argl,
+                   void* argp) {
+  if (ptr)
+    sk_X509_pop_free(reinterpret_cast<STACK_OF(X509)*>(ptr), X509_free);
+}
+
 // A helper class to lazily create a new EX_DATA index to map SSL_CTX handles
 // to their corresponding SSLSessionCacheOpenSSLImpl object.
 class SSLContextExIndex {
@@ -28,14 +45,19 @@ public:
     DCHECK_NE(-1, context_index_);
     session_index_ = SSL_SESSION_get_ex_new_index(0, NULL, NULL, NULL, NULL);
     DCHECK_NE(-1, session_index_);
+    cert_chain_index_ =
+        SSL_SESSION_get_ex_new_index(0, NULL, NULL, NULL, FreeCertChain);
+    DCHECK_NE(-1, cert_chain_index_);
   }
 
   int context_index() const { return context_index_; }
   int session_index() const { return session_index_; }
+  int cert_chain_index() const { return cert_chain_index_; }
 
  private:
   int context_index_;
   int session_index_;
+  int cert_chain_index_;
 };
 
 // static
@@ -54,6 +76,12 @@ static int GetSSLSessionExIndex() {
   return s_ssl_context_ex_instance.Get().session_index();
 }
 
+// Retrieve the global EX_DATA index, created lazily on first call, holding
+// the peer certificate chain of the sessions loaded from a persistent store.
+static int GetSSLSessionCertChainExIndex() {
+  return s_ssl_context_ex_instance.Get().cert_chain_index();
+}
+
 // Helper struct used to store session IDs in a SessionIdIndex container
 // (see definition below). To save memory each entry only holds a pointer
 // to the session ID buffer, which must outlive the entry itself. On the
@@ -131,6 +159,12 @@ namespace net {
 //   means that their reference count is incremented when they are added, and
 //   decremented when they are removed.
 //
+//   If a persistent store is set, good sessions are also saved to it once
+//   they are in the cache, and removed from it when they leave the cache.
+//   OpenSSL does not encode the peer certificate chain with a session, so it
+//   is saved next to it, and attached to the sessions loaded from the store
+//   as EX_DATA.
+//
 // Assuming an average key size of 100 characters, each node requires the
 // following memory usage on 32-bit Android, when linked against STLport:
 //
@@ -154,7 +188,12 @@ class SSLSessionCacheOpenSSLImpl {
   // string, according to the client's preferences.
   SSLSessionCacheOpenSSLImpl(SSL_CTX* ctx,
                              const SSLSessionCacheOpenSSL::Config& config)
-      : ctx_(ctx), config_(config), expiration_check_(0) {
+      : ctx_(ctx),
+        config_(config),
+        store_(NULL),
+        loading_store_(false),
+        expiration_check_(0),
+        weak_factory_(this) {
     DCHECK(ctx);
 
     // NO_INTERNAL_STORE disables OpenSSL's builtin cache, and
@@ -176,6 +215,11 @@ class SSLSessionCacheOpenSSLImpl {
 
   // Destroy this instance. Must happen before |ctx_| is destroyed.
   ~SSLSessionCacheOpenSSLImpl() {
+    {
+      // The sessions are kept in the store for the next run.
+      base::AutoLock locked(lock_);
+      store_ = NULL;
+    }
     Flush();
     SSL_CTX_set_ex_data(ctx_, GetSSLContextExIndex(), NULL);
     SSL_CTX_sess_set_new_cb(ctx_, NULL);
@@ -256,14 +300,48 @@ class SSLSessionCacheOpenSSLImpl {
     SSL_SESSION* session = SSL_get_session(ssl);
     CHECK(session);
 
+    bool was_good = SSL_SESSION_get_ex_data(session, GetSSLSessionExIndex());
+
     // Mark the session as good, allowing it to be used for future connections.
     SSL_SESSION_set_ex_data(
         session, GetSSLSessionExIndex(), reinterpret_cast<void*>(1));
+
+    // The certificate may be verified before the handshake completes, in
+    // which case the session is saved once OpenSSL adds it to the cache.
+    base::AutoLock locked(lock_);
+    if (!store_ || was_good)
+      return;
+    std::string cache_key = config_.key_func(ssl);
+    KeyIndex::iterator it = key_index_.find(cache_key);
+    if (it != key_index_.end() && *it->second == session)
+      SaveSessionLocked(ssl, cache_key, session);
+  }
+
+  void SetPersistentStore(SSLSessionCacheOpenSSL::PersistentStore* store,
+                          const std::string& key_suffix) {
+    {
+      base::AutoLock locked(lock_);
+      store_ = store;
+      store_key_suffix_ = key_suffix;
+      // Drop the sessions of a previous store that are still being read.
+      weak_factory_.InvalidateWeakPtrs();
+      loading_store_ = store != NULL;
+    }
+    // The lock is not held, as the store may run the callback right away.
+    if (store) {
+      store->Load(
+          base::Bind(&SSLSessionCacheOpenSSLImpl::OnPersistentSessionsLoaded,
+                     weak_factory_.GetWeakPtr()));
+    }
   }
 
   // Flush all entries from the cache.
   void Flush() {
     base::AutoLock lock(lock_);
+    if (store_)
+      store_->RemoveAllSessions();
+    // Sessions still being read from the store would be flushed as well.
+    loading_store_ = false;
     id_index_.clear();
     key_index_.clear();
     while (!ordering_.empty()) {
@@ -312,6 +390,9 @@ class SSLSessionCacheOpenSSLImpl {
     DCHECK(key_it != key_index_.end());
     DCHECK_EQ(session, *key_it->second);
 
+    if (IsSavedLocked(key_it->first))
+      store_->RemoveSession(key_it->first);
+
     id_index_.erase(session_id);
     ordering_.erase(key_it->second);
     key_index_.erase(key_it);
@@ -418,6 +499,8 @@ class SSLSessionCacheOpenSSLImpl {
       if (old_session != session) {
         id_index_.erase(SessionId(old_session));
         SSL_SESSION_free(old_session);
+        if (IsSavedLocked(cache_key))
+          store_->RemoveSession(cache_key);
       }
       ordering_.erase(it->second);
       ordering_.push_front(session);
@@ -426,6 +509,9 @@ class SSLSessionCacheOpenSSLImpl {
 
     id_index_[SessionId(session)] = it;
 
+    if (store_ && SSL_SESSION_get_ex_data(session, GetSSLSessionExIndex()))
+      SaveSessionLocked(ssl, cache_key, session);
+
     if (key_index_.size() > config_.max_entries)
       ShrinkCacheLocked();
 
@@ -459,6 +545,121 @@ class SSLSessionCacheOpenSSLImpl {
     RemoveSessionLocked(session);
   }
 
+  // Returns true if the session of |cache_key| belongs in the persistent
+  // store. Lock must be held.
+  bool IsSavedLocked(const std::string& cache_key) const {
+    lock_.AssertAcquired();
+    return store_ && EndsWith(cache_key, store_key_suffix_, true);
+  }
+
+  // Saves |session|, the session of |ssl|, to the persistent store along with
+  // the peer certificate chain. Lock must be held.
+  void SaveSessionLocked(const SSL* ssl,
+                         const std::string& cache_key,
+                         SSL_SESSION* session) {
+    lock_.AssertAcquired();
+    if (!IsSavedLocked(cache_key))
+      return;
+
+    SSLSessionCacheOpenSSL::PersistentStore::Entry entry;
+    entry.cache_key = cache_key;
+    int length = i2d_SSL_SESSION(session, NULL);
+    if (length <= 0)
+      return;
+    entry.session.resize(length);
+    unsigned char* data = reinterpret_cast<unsigned char*>(&entry.session[0]);
+    if (i2d_SSL_SESSION(session, &data) != length)
+      return;
+    STACK_OF(X509)* chain = SSLSessionCacheOpenSSL::GetPeerCertChain(ssl);
+    for (size_t i = 0; chain && i < sk_X509_num(chain); ++i) {
+      base::StringPiece der;
+      if (!x509_util::GetDER(sk_X509_value(chain, i), &der))
+        return;
+      entry.cert_chain.push_back(der.as_string());
+    }
+    entry.expiration = base::Time::FromTimeT(session->time + session->timeout);
+    DVLOG(2) << "Save session " << session << " for " << cache_key;
+    store_->AddSession(entry);
+  }
+
+  // Decodes the certificate chain of |entry|. Returns NULL if it is empty or
+  // cannot be decoded.
+  static STACK_OF(X509)* DecodeCertChain(
+      const SSLSessionCacheOpenSSL::PersistentStore::Entry& entry) {
+    if (entry.cert_chain.empty())
+      return NULL;
+    STACK_OF(X509)* chain = sk_X509_new_null();
+    if (!chain)
+      return NULL;
+    for (size_t i = 0; i < entry.cert_chain.size(); ++i) {
+      const unsigned char* data =
+          reinterpret_cast<const unsigned char*>(entry.cert_chain[i].data());
+      X509* cert = d2i_X509(NULL, &data, entry.cert_chain[i].size());
+      if (!cert || !sk_X509_push(chain, cert)) {
+        X509_free(cert);
+        sk_X509_pop_free(chain, X509_free);
+        return NULL;
+      }
+    }
+    return chain;
+  }
+
+  // Adds the sessions read from the persistent store to the cache. They are
+  // older than any session cached since, so they go to the back of the MRU
+  // list, and are skipped if a session was cached for the same key.
+  void OnPersistentSessionsLoaded(
+      const std::vector<SSLSessionCacheOpenSSL::PersistentStore::Entry>&
+          entries) {
+    base::AutoLock locked(lock_);
+    if (!loading_store_)
+      return;
+    loading_store_ = false;
+
+    long now = static_cast<long>(::time(NULL));
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const std::string& cache_key = entries[i].cache_key;
+      if (!IsSavedLocked(cache_key) ||
+          key_index_.find(cache_key) != key_index_.end()) {
+        continue;
+      }
+
+      // The certificate of a resumed session is verified again, which needs
+      // its chain.
+      STACK_OF(X509)* chain = DecodeCertChain(entries[i]);
+      if (!chain)
+        continue;
+
+      const unsigned char* data =
+          reinterpret_cast<const unsigned char*>(entries[i].session.data());
+      SSL_SESSION* session =
+          d2i_SSL_SESSION(NULL, &data, entries[i].session.size());
+      if (!session) {
+        sk_X509_pop_free(chain, X509_free);
+        continue;
+      }
+      SSL_SESSION_set_ex_data(session, GetSSLSessionCertChainExIndex(), chain);
+      if (session->session_id_length == 0 ||
+          session->time + session->timeout <= now ||
+          id_index_.find(SessionId(session)) != id_index_.end()) {
+        SSL_SESSION_free(session);
+        continue;
+      }
+
+      DVLOG(2) << "Load session " << session << " for " << cache_key;
+      SSL_SESSION_set_ex_data(
+          session, GetSSLSessionExIndex(), reinterpret_cast<void*>(1));
+      ordering_.push_back(session);
+      KeyIndex::iterator it =
+          key_index_.insert(std::make_pair(cache_key, --ordering_.end())).first;
+      id_index_[SessionId(session)] = it;
+    }
+
+    if (key_index_.size() > config_.max_entries)
+      ShrinkCacheLocked();
+
+    DCHECK_EQ(key_index_.size(), id_index_.size());
+  }
+
   // See GenerateSessionIdStatic for a description of what this function does.
   bool OnGenerateSessionId(unsigned char* id, unsigned id_len) {
     base::AutoLock locked(lock_);
@@ -491,9 +692,21 @@ class SSLSessionCacheOpenSSLImpl {
   KeyIndex key_index_;
   SessionIdIndex id_index_;
 
+  SSLSessionCacheOpenSSL::PersistentStore* store_;
+  // Suffix of the cache keys whose sessions are saved to |store_|.
+  std::string store_key_suffix_;
+  // True while the sessions of |store_| are being read.
+  bool loading_store_;
+
   size_t expiration_check_;
+
+  base::WeakPtrFactory<SSLSessionCacheOpenSSLImpl> weak_factory_;
 };
 
+SSLSessionCacheOpenSSL::PersistentStore::Entry::Entry() {}
+
+SSLSessionCacheOpenSSL::PersistentStore::Entry::~Entry() {}
+
 SSLSessionCacheOpenSSL::~SSLSessionCacheOpenSSL() { delete impl_; }
 
 size_t SSLSessionCacheOpenSSL::size() const { return impl_->size(); }
@@ -524,6 +737,24 @@ void SSLSessionCacheOpenSSL::MarkSSLSessionAsGood(SSL* ssl) {
   return impl_->MarkSSLSessionAsGood(ssl);
 }
 
+void SSLSessionCacheOpenSSL::SetPersistentStore(
+    PersistentStore* store,
+    const std::string& key_suffix) {
+  impl_->SetPersistentStore(store, key_suffix);
+}
+
+// static
+STACK_OF(X509)* SSLSessionCacheOpenSSL::GetPeerCertChain(const SSL* ssl) {
+  STACK_OF(X509)* chain = SSL_get_peer_cert_chain(ssl);
+  if (chain)
+    return chain;
+  SSL_SESSION* session = SSL_get_session(ssl);
+  if (!session)
+    return NULL;
+  return reinterpret_cast<STACK_OF(X509)*>(
+      SSL_SESSION_get_ex_data(session, GetSSLSessionCertChainExIndex()));
+}
+
 void SSLSessionCacheOpenSSL::Flush() { impl_->Flush(); }
 
 }  // namespace net
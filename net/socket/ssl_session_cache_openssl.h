@@ -6,13 +6,17 @@
 #define NET_SOCKET_SSL_SESSION_CACHE_OPENSSL_H
 
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
+#include "base/callback_forward.h"
+#include "base/time/time.h"
 #include "net/base/net_export.h"
 
 // Avoid including OpenSSL headers here.
 typedef struct ssl_ctx_st SSL_CTX;
 typedef struct ssl_st SSL;
+struct stack_st_X509;
 
 namespace net {
 
@@ -44,6 +48,9 @@ class SSLSessionCacheOpenSSLImpl;
 //  - Clients can call Flush() to remove all sessions from the cache, this is
 //    useful when the system's certificate store has changed.
 //
+//  - Optionally, clients can call SetPersistentStore() to keep the sessions
+//    that were marked good across restarts.
+//
 // This class is thread-safe. There shouldn't be any issue with multiple
 // SSL connections being performed in parallel in multiple threads.
 class NET_EXPORT SSLSessionCacheOpenSSL {
@@ -66,6 +73,43 @@ class NET_EXPORT SSLSessionCacheOpenSSL {
     int timeout_seconds;
   };
 
+  // A store that keeps cached sessions across restarts. The cache adds good
+  // sessions to it once their handshake completed, and removes them as they
+  // leave the cache. The cache calls these methods with its lock held, so
+  // they must not call back into the cache synchronously, with the exception
+  // of the callback passed to Load().
+  class PersistentStore {
+   public:
+    // A saved session. |session| is the DER encoding of the SSL_SESSION, as
+    // returned by i2d_SSL_SESSION(), and |cert_chain| the DER encoding of
+    // the certificates the server sent, leaf first, which OpenSSL does not
+    // keep in the encoded session.
+    struct Entry {
+      Entry();
+      ~Entry();
+
+      std::string cache_key;
+      std::string session;
+      std::vector<std::string> cert_chain;
+      base::Time expiration;
+    };
+
+    typedef base::Callback<void(const std::vector<Entry>&)> LoadedCallback;
+
+    virtual ~PersistentStore() {}
+
+    // Reads the saved sessions, and runs |callback| with those that have not
+    // expired. Called once, when the store is set.
+    virtual void Load(const LoadedCallback& callback) = 0;
+
+    // Saves the session of |entry|, replacing any session saved for its
+    // cache key.
+    virtual void AddSession(const Entry& entry) = 0;
+
+    virtual void RemoveSession(const std::string& cache_key) = 0;
+    virtual void RemoveAllSessions() = 0;
+  };
+
   SSLSessionCacheOpenSSL() : impl_(NULL) {}
 
   // Construct a new cache instance.
@@ -84,9 +128,24 @@ class NET_EXPORT SSLSessionCacheOpenSSL {
   // is destroyed.
   ~SSLSessionCacheOpenSSL();
 
-  // Reset the cache configuration. This flushes any existing entries.
+  // Reset the cache configuration. This flushes any existing entries, and
+  // unsets the persistent store without touching the sessions it saved.
   void Reset(SSL_CTX* ctx, const Config& config);
 
+  // Sets the store that good sessions are saved to, which must outlive the
+  // cache or be unset first. Only the sessions whose cache key ends with
+  // |key_suffix| are saved and loaded, so that the others, such as those of
+  // off-the-record connections, never reach the store. An empty suffix
+  // matches every key.
+  //
+  // Loading the sessions the store already holds starts right away; they are
+  // added to the cache once they have been read, unless a session was cached
+  // for the same key in the meantime. Sessions saved without the chain of
+  // the server's certificates are not loaded, as they could not be verified
+  // again when resumed. Passing NULL unsets the store.
+  void SetPersistentStore(PersistentStore* store,
+                          const std::string& key_suffix);
+
   size_t size() const;
 
   // Lookup the unique cache key associated with |ssl| connection handle,
@@ -124,8 +183,14 @@ class NET_EXPORT SSLSessionCacheOpenSSL {
   // only validated sessions are resumed.
   void MarkSSLSessionAsGood(SSL* ssl);
 
-  // Flush removes all entries from the cache. This is typically called when
-  // the system's certificate store has changed.
+  // Returns the chain of certificates the server of |ssl| sent, leaf first,
+  // or NULL if there is none. Unlike SSL_get_peer_cert_chain(), this covers
+  // the sessions loaded from the persistent store, for which OpenSSL has no
+  // chain. The chain is owned by the session of |ssl|.
+  static struct stack_st_X509* GetPeerCertChain(const SSL* ssl);
+
+  // Flush removes all entries from the cache, and from the persistent store.
+  // This is typically called when the system's certificate store has changed.
   void Flush();
 
   // TODO(digit): Move to client code.
@@ -6,11 +6,18 @@
 
 #include <openssl/ssl.h>
 
+#include <map>
+#include <vector>
+
+#include "base/callback.h"
 #include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/strings/stringprintf.h"
 #include "crypto/openssl_util.h"
 #include "crypto/scoped_openssl_types.h"
+#include "net/base/test_data_directory.h"
+#include "net/cert/x509_certificate.h"
+#include "net/test/cert_test_util.h"
 
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -104,6 +111,67 @@ class SSLKeyHelper {
   int ex_index_;
 };
 
+// A PersistentStore that keeps sessions in memory. It outlives the cache
+// resets of a test, which stand for restarts.
+class FakePersistentStore : public SSLSessionCacheOpenSSL::PersistentStore {
+ public:
+  FakePersistentStore() : defer_load_(false) {}
+  virtual ~FakePersistentStore() {}
+
+  // Makes Load() wait for CompleteLoad() before running its callback.
+  void set_defer_load(bool defer_load) { defer_load_ = defer_load; }
+
+  // The sessions of these tests have no peer certificate chain, as they come
+  // from no handshake. Sessions saved from now on get |cert_chain| instead.
+  void set_cert_chain(const std::vector<std::string>& cert_chain) {
+    cert_chain_ = cert_chain;
+  }
+
+  // Runs the callback of Load() with the sessions saved when it was called.
+  void CompleteLoad() {
+    LoadedCallback callback = pending_load_;
+    pending_load_.Reset();
+    callback.Run(loaded_entries_);
+  }
+
+  size_t size() const { return entries_.size(); }
+  bool Contains(const std::string& cache_key) const {
+    return entries_.count(cache_key) != 0;
+  }
+
+  // SSLSessionCacheOpenSSL::PersistentStore implementation:
+  virtual void Load(const LoadedCallback& callback) OVERRIDE {
+    loaded_entries_.clear();
+    for (std::map<std::string, Entry>::const_iterator it = entries_.begin();
+         it != entries_.end(); ++it) {
+      loaded_entries_.push_back(it->second);
+    }
+    pending_load_ = callback;
+    if (!defer_load_)
+      CompleteLoad();
+  }
+
+  virtual void AddSession(const Entry& entry) OVERRIDE {
+    EXPECT_TRUE(entry.cert_chain.empty());
+    Entry& saved = entries_[entry.cache_key];
+    saved = entry;
+    saved.cert_chain = cert_chain_;
+  }
+
+  virtual void RemoveSession(const std::string& cache_key) OVERRIDE {
+    entries_.erase(cache_key);
+  }
+
+  virtual void RemoveAllSessions() OVERRIDE { entries_.clear(); }
+
+ private:
+  std::map<std::string, Entry> entries_;
+  bool defer_load_;
+  std::vector<std::string> cert_chain_;
+  std::vector<Entry> loaded_entries_;
+  LoadedCallback pending_load_;
+};
+
 }  // namespace
 
 class SSLSessionCacheOpenSSLTest : public testing::Test {
@@ -141,6 +209,17 @@ class SSLSessionCacheOpenSSLTest : public testing::Test {
     ssl_update_cache(ssl, ctx_.get()->session_cache_mode);
   }
 
+  // Returns a certificate chain for the sessions of the tests to be saved
+  // with.
+  static std::vector<std::string> GetTestCertChain() {
+    scoped_refptr<X509Certificate> cert =
+        ImportCertFromFile(GetTestCertsDirectory(), "ok_cert.pem");
+    std::string der;
+    EXPECT_TRUE(cert.get());
+    EXPECT_TRUE(X509Certificate::GetDEREncoded(cert->os_cert_handle(), &der));
+    return std::vector<std::string>(1, der);
+  }
+
   static const SSLSessionCacheOpenSSL::Config kDefaultConfig;
 
  protected:
@@ -377,4 +456,179 @@ TEST_F(SSLSessionCacheOpenSSLTest, CheckExpiration) {
   EXPECT_EQ(1U, cache_.size());
 }
 
+// Check that only sessions marked good are saved, whichever of being marked
+// good and being added to the cache comes first.
+TEST_F(SSLSessionCacheOpenSSLTest, PersistentStoreSavesGoodSessions) {
+  FakePersistentStore store;
+  cache_.SetPersistentStore(&store, std::string());
+
+  ScopedSSL ssl(NewSSL("hello"));
+  AddToCache(ssl.get());
+  EXPECT_EQ(0U, store.size());
+  cache_.MarkSSLSessionAsGood(ssl.get());
+  EXPECT_TRUE(store.Contains("hello"));
+
+  ScopedSSL ssl2(NewSSL("world"));
+  cache_.MarkSSLSessionAsGood(ssl2.get());
+  EXPECT_FALSE(store.Contains("world"));
+  AddToCache(ssl2.get());
+  EXPECT_TRUE(store.Contains("world"));
+
+  cache_.SetPersistentStore(NULL, std::string());
+}
+
+// Check that sessions saved before a restart are resumed after it, sparing
+// the corresponding full handshakes.
+TEST_F(SSLSessionCacheOpenSSLTest, PersistentStoreResumesAfterRestart) {
+  const int kNumHosts = 10;
+  FakePersistentStore store;
+  store.set_cert_chain(GetTestCertChain());
+  cache_.SetPersistentStore(&store, std::string());
+  for (int n = 0; n < kNumHosts; ++n) {
+    ScopedSSL ssl(NewSSL(base::StringPrintf("host%d:443", n)));
+    AddToCache(ssl.get());
+    cache_.MarkSSLSessionAsGood(ssl.get());
+  }
+  EXPECT_EQ(static_cast<size_t>(kNumHosts), store.size());
+
+  // Resetting the cache drops its sessions, but not those of the store.
+  ResetConfig(kDefaultConfig);
+  EXPECT_EQ(0U, cache_.size());
+  EXPECT_EQ(static_cast<size_t>(kNumHosts), store.size());
+
+  cache_.SetPersistentStore(&store, std::string());
+  EXPECT_EQ(static_cast<size_t>(kNumHosts), cache_.size());
+  int handshakes_avoided = 0;
+  for (int n = 0; n < kNumHosts; ++n) {
+    ScopedSSL ssl(NewSSL(base::StringPrintf("host%d:443", n)));
+    if (cache_.SetSSLSession(ssl.get()))
+      handshakes_avoided++;
+
+    // The peer certificate chain is restored with the session, so that the
+    // certificate can be verified again.
+    STACK_OF(X509)* chain = SSLSessionCacheOpenSSL::GetPeerCertChain(ssl.get());
+    ASSERT_TRUE(chain);
+    EXPECT_EQ(1u, static_cast<size_t>(sk_X509_num(chain)));
+  }
+  EXPECT_EQ(kNumHosts, handshakes_avoided);
+
+  cache_.SetPersistentStore(NULL, std::string());
+}
+
+// Check that a session cached while the store is being read is kept over the
+// one read for the same key.
+TEST_F(SSLSessionCacheOpenSSLTest, PersistentStoreKeepsNewerSessions) {
+  const std::string key("hello");
+  FakePersistentStore store;
+  store.set_cert_chain(GetTestCertChain());
+  cache_.SetPersistentStore(&store, std::string());
+  ScopedSSL ssl(NewSSL(key));
+  AddToCache(ssl.get());
+  cache_.MarkSSLSessionAsGood(ssl.get());
+  ssl.reset(NULL);
+
+  ResetConfig(kDefaultConfig);
+  store.set_defer_load(true);
+  cache_.SetPersistentStore(&store, std::string());
+
+  ScopedSSL ssl2(NewSSL(key));
+  SSL_SESSION* session2 = ssl2.get()->session;
+  AddToCache(ssl2.get());
+  cache_.MarkSSLSessionAsGood(ssl2.get());
+  ssl2.reset(NULL);
+
+  store.CompleteLoad();
+  EXPECT_EQ(1U, cache_.size());
+  ScopedSSL ssl3(NewSSL(key));
+  EXPECT_TRUE(cache_.SetSSLSession(ssl3.get()));
+  EXPECT_EQ(session2, ssl3.get()->session);
+
+  cache_.SetPersistentStore(NULL, std::string());
+}
+
+// Check that sessions leave the store as they leave the cache.
+TEST_F(SSLSessionCacheOpenSSLTest, PersistentStoreRemovesSessions) {
+  const size_t kMaxItems = 2;
+  SSLSessionCacheOpenSSL::Config config = kDefaultConfig;
+  config.max_entries = kMaxItems;
+  ResetConfig(config);
+
+  FakePersistentStore store;
+  cache_.SetPersistentStore(&store, std::string());
+  for (size_t n = 0; n < kMaxItems + 1; ++n) {
+    ScopedSSL ssl(NewSSL(base::StringPrintf("%d", static_cast<int>(n))));
+    AddToCache(ssl.get());
+    cache_.MarkSSLSessionAsGood(ssl.get());
+  }
+  EXPECT_EQ(kMaxItems, store.size());
+  EXPECT_FALSE(store.Contains("0"));
+
+  cache_.Flush();
+  EXPECT_EQ(0U, store.size());
+
+  cache_.SetPersistentStore(NULL, std::string());
+}
+
+// Check that expired sessions are not loaded from the store.
+TEST_F(SSLSessionCacheOpenSSLTest, PersistentStoreSkipsExpiredSessions) {
+  FakePersistentStore store;
+  store.set_cert_chain(GetTestCertChain());
+  cache_.SetPersistentStore(&store, std::string());
+  ScopedSSL ssl(NewSSL("hello"));
+  ssl.get()->session->time = 1;
+  AddToCache(ssl.get());
+  cache_.MarkSSLSessionAsGood(ssl.get());
+  EXPECT_EQ(1U, store.size());
+
+  ResetConfig(kDefaultConfig);
+  cache_.SetPersistentStore(&store, std::string());
+  EXPECT_EQ(0U, cache_.size());
+
+  cache_.SetPersistentStore(NULL, std::string());
+}
+
+// Check that sessions saved without a peer certificate chain are not loaded,
+// as their certificate could not be verified again when resumed.
+TEST_F(SSLSessionCacheOpenSSLTest, PersistentStoreSkipsSessionsWithoutChain) {
+  FakePersistentStore store;
+  cache_.SetPersistentStore(&store, std::string());
+  ScopedSSL ssl(NewSSL("hello"));
+  AddToCache(ssl.get());
+  cache_.MarkSSLSessionAsGood(ssl.get());
+  EXPECT_EQ(1U, store.size());
+
+  ResetConfig(kDefaultConfig);
+  cache_.SetPersistentStore(&store, std::string());
+  EXPECT_EQ(0U, cache_.size());
+
+  cache_.SetPersistentStore(NULL, std::string());
+}
+
+// Check that only the sessions of keys with the store's suffix are saved and
+// loaded.
+TEST_F(SSLSessionCacheOpenSSLTest, PersistentStoreKeySuffix) {
+  FakePersistentStore store;
+  store.set_cert_chain(GetTestCertChain());
+  cache_.SetPersistentStore(&store, "/profile");
+  ScopedSSL ssl(NewSSL("host:443/profile"));
+  AddToCache(ssl.get());
+  cache_.MarkSSLSessionAsGood(ssl.get());
+  ScopedSSL incognito_ssl(NewSSL("host:443/incognito"));
+  AddToCache(incognito_ssl.get());
+  cache_.MarkSSLSessionAsGood(incognito_ssl.get());
+  EXPECT_EQ(2U, cache_.size());
+  ASSERT_EQ(1U, store.size());
+  EXPECT_TRUE(store.Contains("host:443/profile"));
+
+  // Sessions saved under another suffix are not loaded.
+  ResetConfig(kDefaultConfig);
+  cache_.SetPersistentStore(&store, "/other");
+  EXPECT_EQ(0U, cache_.size());
+  ResetConfig(kDefaultConfig);
+  cache_.SetPersistentStore(&store, "/profile");
+  EXPECT_EQ(1U, cache_.size());
+
+  cache_.SetPersistentStore(NULL, std::string());
+}
+
 }  // namespace net
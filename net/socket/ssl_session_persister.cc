@@ -0,0 +1,235 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/socket/ssl_session_persister.h"
+
+#include <openssl/evp.h>
+
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "base/sequenced_task_runner.h"
+#include "base/stl_util.h"
+#include "base/task_runner_util.h"
+#include "crypto/openssl_util.h"
+#include "crypto/random.h"
+
+namespace {
+
+// Version of the serialization format, bumped whenever it changes so that
+// files in an older format are ignored.
+const int kVersion = 2;
+
+const size_t kNonceSize = 12;
+const size_t kAuthTagSize = 16;
+
+std::string ReadSessionFile(const base::FilePath& path) {
+  std::string data;
+  if (!base::ReadFileToString(path, &data))
+    return std::string();
+  return data;
+}
+
+}  // namespace
+
+namespace net {
+
+SSLSessionPersister::SSLSessionPersister(
+    const base::FilePath& path,
+    const std::string& key,
+    const scoped_refptr<base::SequencedTaskRunner>& background_runner)
+    : key_(key),
+      loading_(false),
+      removed_all_while_loading_(false),
+      writer_(path, background_runner),
+      background_runner_(background_runner),
+      weak_ptr_factory_(this) {
+  DCHECK_EQ(kKeySize, key_.size());
+}
+
+SSLSessionPersister::~SSLSessionPersister() {
+  // Writes are not scheduled while loading, so this never replaces a file
+  // that has not been read.
+  if (writer_.HasPendingWrite())
+    writer_.DoScheduledWrite();
+}
+
+void SSLSessionPersister::Load(const LoadedCallback& callback) {
+  DCHECK(!loading_);
+  loading_ = true;
+  base::PostTaskAndReplyWithResult(
+      background_runner_.get(),
+      FROM_HERE,
+      base::Bind(&ReadSessionFile, writer_.path()),
+      base::Bind(&SSLSessionPersister::CompleteLoad,
+                 weak_ptr_factory_.GetWeakPtr(), callback));
+}
+
+void SSLSessionPersister::AddSession(const Entry& entry) {
+  sessions_[entry.cache_key] = entry;
+  ScheduleWrite();
+}
+
+void SSLSessionPersister::RemoveSession(const std::string& cache_key) {
+  if (loading_)
+    removed_while_loading_.insert(cache_key);
+  if (sessions_.erase(cache_key))
+    ScheduleWrite();
+}
+
+void SSLSessionPersister::RemoveAllSessions() {
+  if (loading_)
+    removed_all_while_loading_ = true;
+  sessions_.clear();
+  ScheduleWrite();
+}
+
+bool SSLSessionPersister::SerializeData(std::string* data) {
+  DCHECK(!loading_);
+  const base::Time now = base::Time::Now();
+  Pickle pickle;
+  pickle.WriteInt(kVersion);
+  int count = 0;
+  for (SessionMap::const_iterator it = sessions_.begin();
+       it != sessions_.end(); ++it) {
+    if (it->second.expiration > now)
+      count++;
+  }
+  pickle.WriteInt(count);
+  for (SessionMap::const_iterator it = sessions_.begin();
+       it != sessions_.end(); ++it) {
+    if (it->second.expiration <= now)
+      continue;
+    const Entry& entry = it->second;
+    pickle.WriteString(entry.cache_key);
+    pickle.WriteString(entry.session);
+    pickle.WriteInt(static_cast<int>(entry.cert_chain.size()));
+    for (size_t i = 0; i < entry.cert_chain.size(); ++i)
+      pickle.WriteString(entry.cert_chain[i]);
+    pickle.WriteInt64(entry.expiration.ToInternalValue());
+  }
+
+  return Seal(std::string(static_cast<const char*>(pickle.data()),
+                          pickle.size()),
+              data);
+}
+
+void SSLSessionPersister::ScheduleWrite() {
+  if (!loading_)
+    writer_.ScheduleWrite(this);
+}
+
+bool SSLSessionPersister::Seal(const std::string& plaintext,
+                               std::string* sealed) const {
+  crypto::OpenSSLErrStackTracer err_tracer(FROM_HERE);
+  EVP_AEAD_CTX ctx;
+  if (!EVP_AEAD_CTX_init(&ctx, EVP_aead_aes_128_gcm(),
+                         reinterpret_cast<const uint8_t*>(key_.data()),
+                         key_.size(), kAuthTagSize, NULL)) {
+    return false;
+  }
+
+  // The file is written with a new nonce each time.
+  sealed->resize(kNonceSize + plaintext.size() + kAuthTagSize);
+  uint8_t* nonce = reinterpret_cast<uint8_t*>(string_as_array(sealed));
+  crypto::RandBytes(nonce, kNonceSize);
+  size_t sealed_size;
+  bool result = EVP_AEAD_CTX_seal(
+      &ctx, nonce + kNonceSize, &sealed_size, sealed->size() - kNonceSize,
+      nonce, kNonceSize,
+      reinterpret_cast<const uint8_t*>(plaintext.data()), plaintext.size(),
+      NULL, 0);
+  EVP_AEAD_CTX_cleanup(&ctx);
+  if (!result)
+    return false;
+  sealed->resize(kNonceSize + sealed_size);
+  return true;
+}
+
+bool SSLSessionPersister::Open(const std::string& sealed,
+                               std::string* plaintext) const {
+  if (sealed.size() < kNonceSize + kAuthTagSize)
+    return false;
+
+  crypto::OpenSSLErrStackTracer err_tracer(FROM_HERE);
+  EVP_AEAD_CTX ctx;
+  if (!EVP_AEAD_CTX_init(&ctx, EVP_aead_aes_128_gcm(),
+                         reinterpret_cast<const uint8_t*>(key_.data()),
+                         key_.size(), kAuthTagSize, NULL)) {
+    return false;
+  }
+
+  const uint8_t* nonce = reinterpret_cast<const uint8_t*>(sealed.data());
+  plaintext->resize(sealed.size() - kNonceSize);
+  size_t plaintext_size;
+  bool result = EVP_AEAD_CTX_open(
+      &ctx, reinterpret_cast<uint8_t*>(string_as_array(plaintext)),
+      &plaintext_size, plaintext->size(), nonce, kNonceSize,
+      nonce + kNonceSize, sealed.size() - kNonceSize, NULL, 0);
+  EVP_AEAD_CTX_cleanup(&ctx);
+  if (!result)
+    return false;
+  plaintext->resize(plaintext_size);
+  return true;
+}
+
+void SSLSessionPersister::CompleteLoad(const LoadedCallback& callback,
+                                       const std::string& data) {
+  DCHECK(loading_);
+  loading_ = false;
+
+  std::vector<Entry> entries;
+  std::string plaintext;
+  if (!data.empty() && !removed_all_while_loading_ &&
+      Open(data, &plaintext)) {
+    const base::Time now = base::Time::Now();
+    Pickle pickle(plaintext.data(), static_cast<int>(plaintext.size()));
+    PickleIterator iter(pickle);
+    int version;
+    int count;
+    if (iter.ReadInt(&version) && version == kVersion &&
+        iter.ReadInt(&count)) {
+      for (int i = 0; i < count; ++i) {
+        Entry entry;
+        int chain_length;
+        int64 expiration;
+        if (!iter.ReadString(&entry.cache_key) ||
+            !iter.ReadString(&entry.session) ||
+            !iter.ReadInt(&chain_length) || chain_length < 0) {
+          break;
+        }
+        bool chain_read = true;
+        for (int j = 0; j < chain_length && chain_read; ++j) {
+          entry.cert_chain.push_back(std::string());
+          chain_read = iter.ReadString(&entry.cert_chain.back());
+        }
+        if (!chain_read || !iter.ReadInt64(&expiration))
+          break;
+        entry.expiration = base::Time::FromInternalValue(expiration);
+        if (entry.expiration <= now ||
+            sessions_.count(entry.cache_key) ||
+            removed_while_loading_.count(entry.cache_key)) {
+          continue;
+        }
+        sessions_[entry.cache_key] = entry;
+        entries.push_back(entry);
+      }
+    }
+  } else if (!data.empty() && !removed_all_while_loading_) {
+    LOG(WARNING) << "Ignoring SSL sessions that could not be decrypted";
+  }
+
+  removed_all_while_loading_ = false;
+  removed_while_loading_.clear();
+
+  // Write the changes made while loading, and drop the expired sessions and
+  // those of an older format or key from the file.
+  ScheduleWrite();
+  callback.Run(entries);
+}
+
+}  // namespace net
@@ -0,0 +1,103 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SOCKET_SSL_SESSION_PERSISTER_H_
+#define NET_SOCKET_SSL_SESSION_PERSISTER_H_
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/files/file_path.h"
+#include "base/files/important_file_writer.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/socket/ssl_session_cache_openssl.h"
+
+namespace base {
+class SequencedTaskRunner;
+}
+
+namespace net {
+
+// Saves the sessions of an SSLSessionCacheOpenSSL to a file, so that the
+// connections made after a restart can resume them instead of doing a full
+// handshake.
+//
+// Sessions hold their master secret, so the file is encrypted with AES-128-GCM
+// under a key provided by the embedder, which should keep it somewhere else
+// than next to the file (e.g. in the system key store). A file that cannot be
+// decrypted with the key, such as one written with a previous key, is treated
+// as empty.
+//
+// Nothing is written while the file is being read, as that would drop the
+// sessions not read yet. The changes made meanwhile are written once it has
+// been read.
+//
+// All methods must be called on the thread the persister was created on.
+class NET_EXPORT SSLSessionPersister
+    : public SSLSessionCacheOpenSSL::PersistentStore,
+      public base::ImportantFileWriter::DataSerializer {
+ public:
+  // Size in bytes of the key the file is encrypted with.
+  static const size_t kKeySize = 16;
+
+  // |path| is the file the sessions are saved to. It is read and written on
+  // |background_runner|.
+  SSLSessionPersister(
+      const base::FilePath& path,
+      const std::string& key,
+      const scoped_refptr<base::SequencedTaskRunner>& background_runner);
+  virtual ~SSLSessionPersister();
+
+  // SSLSessionCacheOpenSSL::PersistentStore implementation:
+  virtual void Load(const LoadedCallback& callback) OVERRIDE;
+  virtual void AddSession(const Entry& entry) OVERRIDE;
+  virtual void RemoveSession(const std::string& cache_key) OVERRIDE;
+  virtual void RemoveAllSessions() OVERRIDE;
+
+  // ImportantFileWriter::DataSerializer implementation:
+  //
+  // Serializes the sessions that have not expired into |*data|, encrypted.
+  virtual bool SerializeData(std::string* data) OVERRIDE;
+
+ private:
+  typedef std::map<std::string, Entry> SessionMap;
+
+  // Schedules a write of the file, unless it is being read.
+  void ScheduleWrite();
+
+  // Encrypts |plaintext| into |*sealed|, or decrypts |sealed| into
+  // |*plaintext|. Returns false on failure.
+  bool Seal(const std::string& plaintext, std::string* sealed) const;
+  bool Open(const std::string& sealed, std::string* plaintext) const;
+
+  // Adds the sessions of the file, read into |data|, that were not replaced or
+  // removed since, and runs |callback| with them.
+  void CompleteLoad(const LoadedCallback& callback, const std::string& data);
+
+  const std::string key_;
+
+  SessionMap sessions_;
+
+  // Whether the file is being read, and which changes were made meanwhile.
+  bool loading_;
+  bool removed_all_while_loading_;
+  std::set<std::string> removed_while_loading_;
+
+  base::ImportantFileWriter writer_;
+  scoped_refptr<base::SequencedTaskRunner> background_runner_;
+
+  base::WeakPtrFactory<SSLSessionPersister> weak_ptr_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(SSLSessionPersister);
+};
+
+}  // namespace net
+
+#endif  // NET_SOCKET_SSL_SESSION_PERSISTER_H_
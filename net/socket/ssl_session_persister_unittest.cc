@@ -0,0 +1,207 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/socket/ssl_session_persister.h"
+
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+typedef SSLSessionCacheOpenSSL::PersistentStore::Entry Entry;
+
+const char kKey[] = "0123456789abcdef";
+const char kOtherKey[] = "fedcba9876543210";
+
+void CopyEntries(std::vector<Entry>* out, const std::vector<Entry>& entries) {
+  *out = entries;
+}
+
+Entry MakeEntry(const std::string& cache_key,
+                const std::string& session,
+                base::Time expiration) {
+  Entry entry;
+  entry.cache_key = cache_key;
+  entry.session = session;
+  entry.cert_chain.push_back("leaf of " + session);
+  entry.cert_chain.push_back("root of " + session);
+  entry.expiration = expiration;
+  return entry;
+}
+
+class SSLSessionPersisterTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("SSLSessions");
+  }
+
+  virtual void TearDown() OVERRIDE {
+    persister_.reset();
+    base::MessageLoopForIO::current()->RunUntilIdle();
+  }
+
+ protected:
+  // Creates a persister for the file, as done at startup, and returns the
+  // sessions it loads from it.
+  std::vector<Entry> Restart(const std::string& key) {
+    persister_.reset();
+    base::MessageLoopForIO::current()->RunUntilIdle();
+    persister_.reset(new SSLSessionPersister(
+        path_, key, base::MessageLoopForIO::current()->message_loop_proxy()));
+    std::vector<Entry> entries;
+    persister_->Load(base::Bind(&CopyEntries, &entries));
+    base::MessageLoopForIO::current()->RunUntilIdle();
+    return entries;
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+  scoped_ptr<SSLSessionPersister> persister_;
+};
+
+}  // namespace
+
+TEST_F(SSLSessionPersisterTest, SavesSessions) {
+  EXPECT_TRUE(Restart(kKey).empty());
+
+  const base::Time expiration =
+      base::Time::Now() + base::TimeDelta::FromHours(1);
+  persister_->AddSession(MakeEntry("a.com:443/", "session a", expiration));
+  persister_->AddSession(MakeEntry("b.com:443/", "session b", expiration));
+  persister_->AddSession(MakeEntry("b.com:443/", "new session b", expiration));
+
+  std::vector<Entry> entries = Restart(kKey);
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ("a.com:443/", entries[0].cache_key);
+  EXPECT_EQ("session a", entries[0].session);
+  ASSERT_EQ(2u, entries[0].cert_chain.size());
+  EXPECT_EQ("leaf of session a", entries[0].cert_chain[0]);
+  EXPECT_EQ("root of session a", entries[0].cert_chain[1]);
+  EXPECT_EQ(expiration, entries[0].expiration);
+  EXPECT_EQ("b.com:443/", entries[1].cache_key);
+  EXPECT_EQ("new session b", entries[1].session);
+
+  // Loaded sessions are saved again.
+  EXPECT_EQ(2u, Restart(kKey).size());
+}
+
+TEST_F(SSLSessionPersisterTest, EncryptsSessions) {
+  Restart(kKey);
+  persister_->AddSession(MakeEntry(
+      "a.com:443/", "session a",
+      base::Time::Now() + base::TimeDelta::FromHours(1)));
+  Restart(kKey);
+
+  std::string data;
+  ASSERT_TRUE(base::ReadFileToString(path_, &data));
+  EXPECT_EQ(std::string::npos, data.find("a.com"));
+  EXPECT_EQ(std::string::npos, data.find("session a"));
+
+  // The sessions cannot be read with another key.
+  EXPECT_TRUE(Restart(kOtherKey).empty());
+}
+
+TEST_F(SSLSessionPersisterTest, DropsExpiredSessions) {
+  Restart(kKey);
+  persister_->AddSession(MakeEntry(
+      "a.com:443/", "session a",
+      base::Time::Now() - base::TimeDelta::FromSeconds(1)));
+  persister_->AddSession(MakeEntry(
+      "b.com:443/", "session b",
+      base::Time::Now() + base::TimeDelta::FromHours(1)));
+
+  std::vector<Entry> entries = Restart(kKey);
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ("b.com:443/", entries[0].cache_key);
+}
+
+TEST_F(SSLSessionPersisterTest, RemovesSessions) {
+  Restart(kKey);
+  const base::Time expiration =
+      base::Time::Now() + base::TimeDelta::FromHours(1);
+  persister_->AddSession(MakeEntry("a.com:443/", "session a", expiration));
+  persister_->AddSession(MakeEntry("b.com:443/", "session b", expiration));
+  persister_->RemoveSession("a.com:443/");
+
+  std::vector<Entry> entries = Restart(kKey);
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ("b.com:443/", entries[0].cache_key);
+
+  persister_->RemoveAllSessions();
+  EXPECT_TRUE(Restart(kKey).empty());
+}
+
+// Sessions removed while the file is being read are not loaded from it.
+TEST_F(SSLSessionPersisterTest, RemovesSessionsWhileLoading) {
+  Restart(kKey);
+  const base::Time expiration =
+      base::Time::Now() + base::TimeDelta::FromHours(1);
+  persister_->AddSession(MakeEntry("a.com:443/", "session a", expiration));
+  persister_->AddSession(MakeEntry("b.com:443/", "session b", expiration));
+  persister_.reset();
+  base::MessageLoopForIO::current()->RunUntilIdle();
+
+  persister_.reset(new SSLSessionPersister(
+      path_, kKey, base::MessageLoopForIO::current()->message_loop_proxy()));
+  std::vector<Entry> entries;
+  persister_->Load(base::Bind(&CopyEntries, &entries));
+  persister_->RemoveSession("a.com:443/");
+  base::MessageLoopForIO::current()->RunUntilIdle();
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ("b.com:443/", entries[0].cache_key);
+
+  persister_.reset(new SSLSessionPersister(
+      path_, kKey, base::MessageLoopForIO::current()->message_loop_proxy()));
+  entries.clear();
+  persister_->Load(base::Bind(&CopyEntries, &entries));
+  persister_->RemoveAllSessions();
+  base::MessageLoopForIO::current()->RunUntilIdle();
+  EXPECT_TRUE(entries.empty());
+}
+
+// Nothing is written while the file is being read, and the changes made
+// meanwhile are written once it has been.
+TEST_F(SSLSessionPersisterTest, WritesAfterLoading) {
+  Restart(kKey);
+  const base::Time expiration =
+      base::Time::Now() + base::TimeDelta::FromHours(1);
+  persister_->AddSession(MakeEntry("a.com:443/", "session a", expiration));
+  persister_.reset();
+  base::MessageLoopForIO::current()->RunUntilIdle();
+
+  // Going away while loading does not replace the file.
+  persister_.reset(new SSLSessionPersister(
+      path_, kKey, base::MessageLoopForIO::current()->message_loop_proxy()));
+  std::vector<Entry> entries;
+  persister_->Load(base::Bind(&CopyEntries, &entries));
+  persister_->AddSession(MakeEntry("b.com:443/", "session b", expiration));
+  persister_.reset();
+  base::MessageLoopForIO::current()->RunUntilIdle();
+
+  persister_.reset(new SSLSessionPersister(
+      path_, kKey, base::MessageLoopForIO::current()->message_loop_proxy()));
+  persister_->Load(base::Bind(&CopyEntries, &entries));
+  persister_->AddSession(MakeEntry("b.com:443/", "session b", expiration));
+  base::MessageLoopForIO::current()->RunUntilIdle();
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ("a.com:443/", entries[0].cache_key);
+
+  entries = Restart(kKey);
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ("a.com:443/", entries[0].cache_key);
+  EXPECT_EQ("b.com:443/", entries[1].cache_key);
+}
+
+}  // namespace net
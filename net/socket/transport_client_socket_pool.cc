@@ -18,6 +18,7 @@
 #include "net/base/ip_endpoint.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_log.h"
+#include "net/http/http_server_properties.h"
 #include "net/socket/client_socket_factory.h"
 #include "net/socket/client_socket_handle.h"
 #include "net/socket/client_socket_pool_base.h"
@@ -35,6 +36,10 @@ const int TransportConnectJobHelper::kIPv6FallbackTimerInMs = 300;
 
 namespace {
 
+// Defaults for connection racing, per "Happy Eyeballs Version 2" (RFC 8305).
+const int kDefaultRaceAttemptDelayMs = 250;
+const size_t kDefaultMaxConcurrentRaceAttempts = 3;
+
 // Returns true iff all addresses in |list| are in the IPv6 family.
 bool AddressListOnlyContainsIPv6(const AddressList& list) {
   DCHECK(!list.empty());
@@ -79,6 +84,13 @@ TransportSocketParams::TransportSocketParams(
 
 TransportSocketParams::~TransportSocketParams() {}
 
+TransportConnectRaceParams::TransportConnectRaceParams()
+    : enabled(false),
+      attempt_delay(
+          base::TimeDelta::FromMilliseconds(kDefaultRaceAttemptDelayMs)),
+      max_concurrent_attempts(kDefaultMaxConcurrentRaceAttempts) {
+}
+
 // TransportConnectJobs will time out after this many seconds.  Note this is
 // the total time, including both host resolution and TCP connect() times.
 //
@@ -198,12 +210,21 @@ TransportConnectJob::TransportConnectJob(
     base::TimeDelta timeout_duration,
     ClientSocketFactory* client_socket_factory,
     HostResolver* host_resolver,
+    const TransportConnectRaceParams& race_params,
+    const base::WeakPtr<HttpServerProperties>& http_server_properties,
     Delegate* delegate,
     NetLog* net_log)
     : ConnectJob(group_name, timeout_duration, priority, delegate,
                  BoundNetLog::Make(net_log, NetLog::SOURCE_CONNECT_JOB)),
       helper_(params, client_socket_factory, host_resolver, &connect_timing_),
-      interval_between_connects_(CONNECT_INTERVAL_GT_20MS) {
+      interval_between_connects_(CONNECT_INTERVAL_GT_20MS),
+      race_params_(race_params),
+      http_server_properties_(http_server_properties),
+      preferred_family_(ADDRESS_FAMILY_UNSPECIFIED),
+      next_race_attempt_(0),
+      num_pending_race_attempts_(0),
+      last_race_error_(ERR_FAILED) {
+  DCHECK_GT(race_params_.max_concurrent_attempts, 0u);
   helper_.SetOnIOComplete(this);
 }
 
@@ -237,6 +258,33 @@ void TransportConnectJob::MakeAddressListStartWithIPv4(AddressList* list) {
   }
 }
 
+// static
+void TransportConnectJob::InterleaveAddressFamilies(AddressFamily first_family,
+                                                    AddressList* list) {
+  if (list->empty())
+    return;
+  if (first_family == ADDRESS_FAMILY_UNSPECIFIED)
+    first_family = list->front().GetFamily();
+
+  std::vector<IPEndPoint> first;
+  std::vector<IPEndPoint> rest;
+  for (AddressList::const_iterator it = list->begin(); it != list->end();
+       ++it) {
+    if (it->GetFamily() == first_family)
+      first.push_back(*it);
+    else
+      rest.push_back(*it);
+  }
+
+  list->clear();
+  for (size_t i = 0; i < std::max(first.size(), rest.size()); ++i) {
+    if (i < first.size())
+      list->push_back(first[i]);
+    if (i < rest.size())
+      list->push_back(rest[i]);
+  }
+}
+
 int TransportConnectJob::DoResolveHost() {
   return helper_.DoResolveHost(priority(), net_log());
 }
@@ -246,6 +294,9 @@ int TransportConnectJob::DoResolveHostComplete(int result) {
 }
 
 int TransportConnectJob::DoTransportConnect() {
+  if (race_params_.enabled && helper_.addresses().size() > 1)
+    return DoRaceTransportConnect();
+
   base::TimeTicks now = base::TimeTicks::Now();
   base::TimeTicks last_connect_time;
   {
@@ -411,6 +462,136 @@ void TransportConnectJob::DoIPv6FallbackTransportConnectComplete(int result) {
   NotifyDelegateOfCompletion(result);  // Deletes |this|
 }
 
+int TransportConnectJob::DoRaceTransportConnect() {
+  if (http_server_properties_) {
+    preferred_family_ = http_server_properties_->GetPreferredAddressFamily(
+        helper_.params()->destination().host_port_pair());
+  }
+  race_addresses_ = helper_.addresses();
+  InterleaveAddressFamilies(preferred_family_, &race_addresses_);
+  race_sockets_.resize(race_addresses_.size());
+
+  int rv = StartNextRaceAttempt();
+  // Attempts that complete asynchronously are handled by
+  // OnRaceAttemptComplete() rather than by the state machine.
+  helper_.set_next_state(
+      rv == ERR_IO_PENDING
+          ? TransportConnectJobHelper::STATE_TRANSPORT_CONNECT_COMPLETE
+          : TransportConnectJobHelper::STATE_NONE);
+  return rv;
+}
+
+// Starts connects to the remaining addresses, one after another, until one
+// of them is pending.  Returns OK if a connect succeeded synchronously,
+// ERR_IO_PENDING if any connect is still in flight, and the error of the
+// last attempt once all of them have failed.
+int TransportConnectJob::StartNextRaceAttempt() {
+  race_timer_.Stop();
+  while (next_race_attempt_ < race_addresses_.size()) {
+    size_t index = next_race_attempt_++;
+    race_sockets_[index] =
+        helper_.client_socket_factory()->CreateTransportClientSocket(
+            AddressList(race_addresses_[index]),
+            net_log().net_log(), net_log().source()).release();
+    // base::Unretained() is safe because |this| owns the socket.
+    int rv = race_sockets_[index]->Connect(
+        base::Bind(&TransportConnectJob::OnRaceAttemptComplete,
+                   base::Unretained(this), index));
+    if (rv == OK)
+      return OnRaceWon(index);
+    if (rv == ERR_IO_PENDING) {
+      ++num_pending_race_attempts_;
+      if (next_race_attempt_ < race_addresses_.size() &&
+          num_pending_race_attempts_ < race_params_.max_concurrent_attempts) {
+        race_timer_.Start(FROM_HERE, race_params_.attempt_delay, this,
+                          &TransportConnectJob::OnRaceAttemptDelayElapsed);
+      }
+      return ERR_IO_PENDING;
+    }
+    delete race_sockets_[index];
+    race_sockets_[index] = NULL;
+    last_race_error_ = rv;
+  }
+  return num_pending_race_attempts_ > 0 ? ERR_IO_PENDING : last_race_error_;
+}
+
+void TransportConnectJob::OnRaceAttemptDelayElapsed() {
+  DCHECK_EQ(TransportConnectJobHelper::STATE_TRANSPORT_CONNECT_COMPLETE,
+            helper_.next_state());
+  int rv = StartNextRaceAttempt();
+  if (rv != ERR_IO_PENDING) {
+    helper_.set_next_state(TransportConnectJobHelper::STATE_NONE);
+    NotifyDelegateOfCompletion(rv);  // Deletes |this|
+  }
+}
+
+void TransportConnectJob::OnRaceAttemptComplete(size_t index, int result) {
+  DCHECK_EQ(TransportConnectJobHelper::STATE_TRANSPORT_CONNECT_COMPLETE,
+            helper_.next_state());
+  DCHECK_NE(ERR_IO_PENDING, result);
+  DCHECK_GT(num_pending_race_attempts_, 0u);
+  --num_pending_race_attempts_;
+
+  int rv;
+  if (result == OK) {
+    rv = OnRaceWon(index);
+  } else {
+    delete race_sockets_[index];
+    race_sockets_[index] = NULL;
+    last_race_error_ = result;
+    // Don't wait for the delay to try the next address.
+    rv = StartNextRaceAttempt();
+  }
+  if (rv != ERR_IO_PENDING) {
+    helper_.set_next_state(TransportConnectJobHelper::STATE_NONE);
+    NotifyDelegateOfCompletion(rv);  // Deletes |this|
+  }
+}
+
+int TransportConnectJob::OnRaceWon(size_t index) {
+  race_timer_.Stop();
+  AddressFamily family = race_addresses_[index].GetFamily();
+
+  bool mixed_families = false;
+  for (AddressList::const_iterator it = race_addresses_.begin();
+       it != race_addresses_.end(); ++it) {
+    if (it->GetFamily() != family)
+      mixed_families = true;
+  }
+  TransportConnectJobHelper::ConnectionLatencyHistogram race_result;
+  if (family == ADDRESS_FAMILY_IPV4) {
+    race_result = mixed_families ?
+        TransportConnectJobHelper::CONNECTION_LATENCY_IPV4_WINS_RACE :
+        TransportConnectJobHelper::CONNECTION_LATENCY_IPV4_NO_RACE;
+  } else {
+    race_result = mixed_families ?
+        TransportConnectJobHelper::CONNECTION_LATENCY_IPV6_RACEABLE :
+        TransportConnectJobHelper::CONNECTION_LATENCY_IPV6_SOLO;
+  }
+  helper_.HistogramDuration(race_result);
+  UMA_HISTOGRAM_COUNTS_100("Net.TCP_Connection_Race_Attempts",
+                           static_cast<int>(next_race_attempt_));
+  UMA_HISTOGRAM_COUNTS_100("Net.TCP_Connection_Race_Winner_Index",
+                           static_cast<int>(index));
+  if (mixed_families && preferred_family_ != ADDRESS_FAMILY_UNSPECIFIED) {
+    UMA_HISTOGRAM_BOOLEAN("Net.TCP_Connection_Race_Preferred_Family_Won",
+                          family == preferred_family_);
+  }
+
+  if (http_server_properties_ && mixed_families) {
+    http_server_properties_->SetPreferredAddressFamily(
+        helper_.params()->destination().host_port_pair(), family);
+  }
+
+  scoped_ptr<StreamSocket> socket(race_sockets_[index]);
+  race_sockets_[index] = NULL;
+  // Cancels the attempts that lost.
+  race_sockets_.clear();
+  num_pending_race_attempts_ = 0;
+  SetSocket(socket.Pass());
+  return OK;
+}
+
 int TransportConnectJob::ConnectInternal() {
   return helper_.DoConnectInternal(this);
 }
@@ -427,6 +608,8 @@ TransportClientSocketPool::TransportConnectJobFactory::NewConnectJob(
                               ConnectionTimeout(),
                               client_socket_factory_,
                               host_resolver_,
+                              race_params_,
+                              http_server_properties_,
                               delegate,
                               net_log_));
 }
@@ -444,11 +627,13 @@ TransportClientSocketPool::TransportClientSocketPool(
     HostResolver* host_resolver,
     ClientSocketFactory* client_socket_factory,
     NetLog* net_log)
-    : base_(NULL, max_sockets, max_sockets_per_group, histograms,
+    : connect_job_factory_(new TransportConnectJobFactory(client_socket_factory,
+                                                          host_resolver,
+                                                          net_log)),
+      base_(NULL, max_sockets, max_sockets_per_group, histograms,
             ClientSocketPool::unused_idle_socket_timeout(),
             ClientSocketPool::used_idle_socket_timeout(),
-            new TransportConnectJobFactory(client_socket_factory,
-                                           host_resolver, net_log)) {
+            connect_job_factory_) {
   base_.EnableConnectBackupJobs();
 }
 
@@ -565,4 +750,11 @@ void TransportClientSocketPool::RemoveHigherLayeredPool(
   base_.RemoveHigherLayeredPool(higher_pool);
 }
 
+void TransportClientSocketPool::SetConnectRaceParams(
+    const TransportConnectRaceParams& race_params,
+    const base::WeakPtr<HttpServerProperties>& http_server_properties) {
+  connect_job_factory_->set_race_params(race_params);
+  connect_job_factory_->set_http_server_properties(http_server_properties);
+}
+
 }  // namespace net
@@ -10,8 +10,11 @@
 #include "base/basictypes.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/memory/weak_ptr.h"
 #include "base/time/time.h"
 #include "base/timer/timer.h"
+#include "net/base/address_family.h"
 #include "net/base/host_port_pair.h"
 #include "net/dns/host_resolver.h"
 #include "net/dns/single_request_host_resolver.h"
@@ -22,6 +25,7 @@
 namespace net {
 
 class ClientSocketFactory;
+class HttpServerProperties;
 
 typedef base::Callback<int(const AddressList&, const BoundNetLog& net_log)>
 OnHostResolutionCallback;
@@ -76,6 +80,23 @@ class NET_EXPORT_PRIVATE TransportSocketParams
   DISALLOW_COPY_AND_ASSIGN(TransportSocketParams);
 };
 
+// Configures how TransportConnectJob connects to hosts that resolve to more
+// than one address.
+struct NET_EXPORT_PRIVATE TransportConnectRaceParams {
+  TransportConnectRaceParams();
+
+  // When false, the transport socket tries the addresses one after another,
+  // and only a single IPv4 fallback connect is raced against a slow IPv6
+  // one.  When true, each address gets a connect of its own: the next
+  // address is tried after |attempt_delay|, or as soon as an attempt fails,
+  // and the first connect to succeed wins.
+  bool enabled;
+  base::TimeDelta attempt_delay;
+
+  // Upper bound on the number of connects in flight at once.
+  size_t max_concurrent_attempts;
+};
+
 // Common data and logic shared between TransportConnectJob and
 // WebSocketTransportConnectJob.
 class NET_EXPORT_PRIVATE TransportConnectJobHelper {
@@ -154,16 +175,24 @@ class NET_EXPORT_PRIVATE TransportConnectJobHelper {
 // (kIPv6FallbackTimerInMs) and start a connect() to a IPv4 address if the timer
 // fires. Then we race the IPv4 connect() against the IPv6 connect() (which has
 // a headstart) and return the one that completes first to the socket pool.
+//
+// When connection racing is enabled through TransportConnectRaceParams, the
+// addresses are instead interleaved by family, starting with the family that
+// last won for the destination, and connected to with staggered, concurrent
+// attempts.  The winning family is remembered in |http_server_properties|.
 class NET_EXPORT_PRIVATE TransportConnectJob : public ConnectJob {
  public:
-  TransportConnectJob(const std::string& group_name,
-                      RequestPriority priority,
-                      const scoped_refptr<TransportSocketParams>& params,
-                      base::TimeDelta timeout_duration,
-                      ClientSocketFactory* client_socket_factory,
-                      HostResolver* host_resolver,
-                      Delegate* delegate,
-                      NetLog* net_log);
+  TransportConnectJob(
+      const std::string& group_name,
+      RequestPriority priority,
+      const scoped_refptr<TransportSocketParams>& params,
+      base::TimeDelta timeout_duration,
+      ClientSocketFactory* client_socket_factory,
+      HostResolver* host_resolver,
+      const TransportConnectRaceParams& race_params,
+      const base::WeakPtr<HttpServerProperties>& http_server_properties,
+      Delegate* delegate,
+      NetLog* net_log);
   virtual ~TransportConnectJob();
 
   // ConnectJob methods.
@@ -173,6 +202,13 @@ class NET_EXPORT_PRIVATE TransportConnectJob : public ConnectJob {
   // WARNING: this method should only be used to implement the prefer-IPv4 hack.
   static void MakeAddressListStartWithIPv4(AddressList* addrlist);
 
+  // Reorders |addrlist| so that address families alternate, starting with
+  // |first_family|, or with the family of the first address if
+  // |first_family| is ADDRESS_FAMILY_UNSPECIFIED.  The relative order of
+  // addresses of the same family is preserved.
+  static void InterleaveAddressFamilies(AddressFamily first_family,
+                                        AddressList* addrlist);
+
  private:
   enum ConnectInterval {
     CONNECT_INTERVAL_LE_10MS,
@@ -191,6 +227,15 @@ class NET_EXPORT_PRIVATE TransportConnectJob : public ConnectJob {
   void DoIPv6FallbackTransportConnect();
   void DoIPv6FallbackTransportConnectComplete(int result);
 
+  // Connection racing, used instead of the IPv6 fallback when enabled.
+  // Also not part of the state machine, except for DoRaceTransportConnect(),
+  // which starts the race.
+  int DoRaceTransportConnect();
+  int StartNextRaceAttempt();
+  void OnRaceAttemptDelayElapsed();
+  void OnRaceAttemptComplete(size_t index, int result);
+  int OnRaceWon(size_t index);
+
   // Begins the host resolution and the TCP connect.  Returns OK on success
   // and ERR_IO_PENDING if it cannot immediately service the request.
   // Otherwise, it returns a net error code.
@@ -208,6 +253,22 @@ class NET_EXPORT_PRIVATE TransportConnectJob : public ConnectJob {
   // Track the interval between this connect and previous connect.
   ConnectInterval interval_between_connects_;
 
+  const TransportConnectRaceParams race_params_;
+  const base::WeakPtr<HttpServerProperties> http_server_properties_;
+
+  // The family that won the last race to this destination, if known.
+  AddressFamily preferred_family_;
+
+  // The addresses being raced, in the order they are tried, and the sockets
+  // connecting to each of them.  Sockets of attempts that have not started
+  // yet, or that failed, are NULL.
+  AddressList race_addresses_;
+  ScopedVector<StreamSocket> race_sockets_;
+  size_t next_race_attempt_;
+  size_t num_pending_race_attempts_;
+  int last_race_error_;
+  base::OneShotTimer<TransportConnectJob> race_timer_;
+
   DISALLOW_COPY_AND_ASSIGN(TransportConnectJob);
 };
 
@@ -261,6 +322,13 @@ class NET_EXPORT_PRIVATE TransportClientSocketPool : public ClientSocketPool {
   virtual void AddHigherLayeredPool(HigherLayeredPool* higher_pool) OVERRIDE;
   virtual void RemoveHigherLayeredPool(HigherLayeredPool* higher_pool) OVERRIDE;
 
+  // Applies to ConnectJobs started after the call.  |http_server_properties|
+  // is where the winning address family of each race is remembered, and may
+  // be null.
+  void SetConnectRaceParams(
+      const TransportConnectRaceParams& race_params,
+      const base::WeakPtr<HttpServerProperties>& http_server_properties);
+
  protected:
   // Methods shared with WebSocketTransportClientSocketPool
   void NetLogTcpClientSocketPoolRequestedSocket(
@@ -291,14 +359,28 @@ class NET_EXPORT_PRIVATE TransportClientSocketPool : public ClientSocketPool {
 
     virtual base::TimeDelta ConnectionTimeout() const OVERRIDE;
 
+    void set_race_params(const TransportConnectRaceParams& race_params) {
+      race_params_ = race_params;
+    }
+
+    void set_http_server_properties(
+        const base::WeakPtr<HttpServerProperties>& http_server_properties) {
+      http_server_properties_ = http_server_properties;
+    }
+
    private:
     ClientSocketFactory* const client_socket_factory_;
     HostResolver* const host_resolver_;
     NetLog* net_log_;
+    TransportConnectRaceParams race_params_;
+    base::WeakPtr<HttpServerProperties> http_server_properties_;
 
     DISALLOW_COPY_AND_ASSIGN(TransportConnectJobFactory);
   };
 
+  // Owned by |base_|.
+  TransportConnectJobFactory* const connect_job_factory_;
+
   PoolBase base_;
 
   DISALLOW_COPY_AND_ASSIGN(TransportClientSocketPool);
@@ -17,6 +17,7 @@
 #include "net/base/net_util.h"
 #include "net/base/test_completion_callback.h"
 #include "net/dns/mock_host_resolver.h"
+#include "net/http/http_server_properties_impl.h"
 #include "net/socket/client_socket_handle.h"
 #include "net/socket/client_socket_pool_histograms.h"
 #include "net/socket/socket_test_util.h"
@@ -176,6 +177,56 @@ TEST(TransportConnectJobTest, MakeAddrListStartWithIPv4) {
   EXPECT_EQ(ADDRESS_FAMILY_IPV6, addrlist[3].GetFamily());
 }
 
+TEST(TransportConnectJobTest, InterleaveAddressFamilies) {
+  IPAddressNumber ip_number;
+  ASSERT_TRUE(ParseIPLiteralToNumber("192.168.1.1", &ip_number));
+  IPEndPoint addrlist_v4_1(ip_number, 80);
+  ASSERT_TRUE(ParseIPLiteralToNumber("192.168.1.2", &ip_number));
+  IPEndPoint addrlist_v4_2(ip_number, 80);
+  ASSERT_TRUE(ParseIPLiteralToNumber("2001:4860:b006::64", &ip_number));
+  IPEndPoint addrlist_v6_1(ip_number, 80);
+  ASSERT_TRUE(ParseIPLiteralToNumber("2001:4860:b006::66", &ip_number));
+  IPEndPoint addrlist_v6_2(ip_number, 80);
+
+  AddressList addrlist;
+
+  // Test 1: IPv6, IPv6, IPv4, IPv4, no preference.  Expect the families to
+  // alternate, starting with IPv6.
+  addrlist.push_back(addrlist_v6_1);
+  addrlist.push_back(addrlist_v6_2);
+  addrlist.push_back(addrlist_v4_1);
+  addrlist.push_back(addrlist_v4_2);
+  TransportConnectJob::InterleaveAddressFamilies(ADDRESS_FAMILY_UNSPECIFIED,
+                                                 &addrlist);
+  ASSERT_EQ(4u, addrlist.size());
+  EXPECT_TRUE(addrlist[0] == addrlist_v6_1);
+  EXPECT_TRUE(addrlist[1] == addrlist_v4_1);
+  EXPECT_TRUE(addrlist[2] == addrlist_v6_2);
+  EXPECT_TRUE(addrlist[3] == addrlist_v4_2);
+
+  // Test 2: Same list, IPv4 preferred.  Expect IPv4 to go first.
+  TransportConnectJob::InterleaveAddressFamilies(ADDRESS_FAMILY_IPV4,
+                                                 &addrlist);
+  ASSERT_EQ(4u, addrlist.size());
+  EXPECT_TRUE(addrlist[0] == addrlist_v4_1);
+  EXPECT_TRUE(addrlist[1] == addrlist_v6_1);
+  EXPECT_TRUE(addrlist[2] == addrlist_v4_2);
+  EXPECT_TRUE(addrlist[3] == addrlist_v6_2);
+
+  // Test 3: IPv4, IPv6, IPv6, IPv6 preferred.  Expect the extra IPv6
+  // address at the end.
+  addrlist.clear();
+  addrlist.push_back(addrlist_v4_1);
+  addrlist.push_back(addrlist_v6_1);
+  addrlist.push_back(addrlist_v6_2);
+  TransportConnectJob::InterleaveAddressFamilies(ADDRESS_FAMILY_IPV6,
+                                                 &addrlist);
+  ASSERT_EQ(3u, addrlist.size());
+  EXPECT_TRUE(addrlist[0] == addrlist_v6_1);
+  EXPECT_TRUE(addrlist[1] == addrlist_v4_1);
+  EXPECT_TRUE(addrlist[2] == addrlist_v6_2);
+}
+
 TEST_F(TransportClientSocketPoolTest, Basic) {
   TestCompletionCallback callback;
   ClientSocketHandle handle;
@@ -1107,6 +1158,208 @@ TEST_F(TransportClientSocketPoolTest,
   EXPECT_FALSE(handle.socket()->UsingTCPFastOpen());
 }
 
+// Test that connection racing tries addresses of both families in turn, and
+// remembers the family that connected.
+TEST_F(TransportClientSocketPoolTest, RaceInterleavesAddressFamilies) {
+  // Create a pool without backup jobs.
+  ClientSocketPoolBaseHelper::set_connect_backup_jobs_enabled(false);
+  TransportClientSocketPool pool(kMaxSockets,
+                                 kMaxSocketsPerGroup,
+                                 histograms_.get(),
+                                 host_resolver_.get(),
+                                 &client_socket_factory_,
+                                 NULL);
+  HttpServerPropertiesImpl http_server_properties;
+  TransportConnectRaceParams race_params;
+  race_params.enabled = true;
+  race_params.attempt_delay = base::TimeDelta::FromMilliseconds(10);
+  pool.SetConnectRaceParams(race_params, http_server_properties.GetWeakPtr());
+
+  MockTransportClientSocketFactory::ClientSocketType case_types[] = {
+    // This is the first IPv6 socket.
+    MockTransportClientSocketFactory::MOCK_STALLED_CLIENT_SOCKET,
+    // This is the IPv4 socket.
+    MockTransportClientSocketFactory::MOCK_PENDING_CLIENT_SOCKET
+  };
+  client_socket_factory_.set_client_socket_types(case_types, 2);
+
+  // Resolve an AddressList with two IPv6 addresses first and then a IPv4
+  // address.
+  host_resolver_->rules()->AddIPLiteralRule(
+      "*", "2:abcd::3:4:ff,3:abcd::3:4:ff,2.2.2.2", std::string());
+
+  TestCompletionCallback callback;
+  ClientSocketHandle handle;
+  int rv = handle.Init("a", params_, LOW, callback.callback(), &pool,
+                       BoundNetLog());
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  IPEndPoint endpoint;
+  handle.socket()->GetLocalAddress(&endpoint);
+  EXPECT_EQ(kIPv4AddressSize, endpoint.address().size());
+  EXPECT_EQ(2, client_socket_factory_.allocation_count());
+  EXPECT_EQ(ADDRESS_FAMILY_IPV4,
+            http_server_properties.GetPreferredAddressFamily(
+                HostPortPair("www.google.com", 80)));
+}
+
+// Test that a failed attempt starts the next one without waiting for the
+// attempt delay.
+TEST_F(TransportClientSocketPoolTest, RaceStartsNextAttemptOnFailure) {
+  // Create a pool without backup jobs.
+  ClientSocketPoolBaseHelper::set_connect_backup_jobs_enabled(false);
+  TransportClientSocketPool pool(kMaxSockets,
+                                 kMaxSocketsPerGroup,
+                                 histograms_.get(),
+                                 host_resolver_.get(),
+                                 &client_socket_factory_,
+                                 NULL);
+  TransportConnectRaceParams race_params;
+  race_params.enabled = true;
+  race_params.attempt_delay = base::TimeDelta::FromMinutes(1);
+  pool.SetConnectRaceParams(race_params,
+                            base::WeakPtr<HttpServerProperties>());
+
+  MockTransportClientSocketFactory::ClientSocketType case_types[] = {
+    // This is the IPv6 socket.
+    MockTransportClientSocketFactory::MOCK_PENDING_FAILING_CLIENT_SOCKET,
+    // This is the IPv4 socket.
+    MockTransportClientSocketFactory::MOCK_PENDING_CLIENT_SOCKET
+  };
+  client_socket_factory_.set_client_socket_types(case_types, 2);
+
+  // Resolve an AddressList with a IPv6 address first and then a IPv4 address.
+  host_resolver_->rules()
+      ->AddIPLiteralRule("*", "2:abcd::3:4:ff,2.2.2.2", std::string());
+
+  TestCompletionCallback callback;
+  ClientSocketHandle handle;
+  int rv = handle.Init("a", params_, LOW, callback.callback(), &pool,
+                       BoundNetLog());
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  IPEndPoint endpoint;
+  handle.socket()->GetLocalAddress(&endpoint);
+  EXPECT_EQ(kIPv4AddressSize, endpoint.address().size());
+  EXPECT_EQ(2, client_socket_factory_.allocation_count());
+}
+
+// Test that an attempt which started earlier still wins if it connects
+// before the attempts started after it.
+TEST_F(TransportClientSocketPoolTest, RaceEarlierAttemptFinishesFirst) {
+  // Create a pool without backup jobs.
+  ClientSocketPoolBaseHelper::set_connect_backup_jobs_enabled(false);
+  TransportClientSocketPool pool(kMaxSockets,
+                                 kMaxSocketsPerGroup,
+                                 histograms_.get(),
+                                 host_resolver_.get(),
+                                 &client_socket_factory_,
+                                 NULL);
+  HttpServerPropertiesImpl http_server_properties;
+  TransportConnectRaceParams race_params;
+  race_params.enabled = true;
+  race_params.attempt_delay = base::TimeDelta::FromMilliseconds(10);
+  pool.SetConnectRaceParams(race_params, http_server_properties.GetWeakPtr());
+
+  MockTransportClientSocketFactory::ClientSocketType case_types[] = {
+    // This is the IPv6 socket.
+    MockTransportClientSocketFactory::MOCK_DELAYED_CLIENT_SOCKET,
+    // This is the IPv4 socket.
+    MockTransportClientSocketFactory::MOCK_STALLED_CLIENT_SOCKET
+  };
+  client_socket_factory_.set_client_socket_types(case_types, 2);
+  client_socket_factory_.set_delay(base::TimeDelta::FromMilliseconds(50));
+
+  // Resolve an AddressList with a IPv6 address first and then a IPv4 address.
+  host_resolver_->rules()
+      ->AddIPLiteralRule("*", "2:abcd::3:4:ff,2.2.2.2", std::string());
+
+  TestCompletionCallback callback;
+  ClientSocketHandle handle;
+  int rv = handle.Init("a", params_, LOW, callback.callback(), &pool,
+                       BoundNetLog());
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  IPEndPoint endpoint;
+  handle.socket()->GetLocalAddress(&endpoint);
+  EXPECT_EQ(kIPv6AddressSize, endpoint.address().size());
+  EXPECT_EQ(2, client_socket_factory_.allocation_count());
+  EXPECT_EQ(ADDRESS_FAMILY_IPV6,
+            http_server_properties.GetPreferredAddressFamily(
+                HostPortPair("www.google.com", 80)));
+}
+
+// Test that the race starts with the family that won the previous race.
+TEST_F(TransportClientSocketPoolTest, RaceStartsWithPreferredFamily) {
+  // Create a pool without backup jobs.
+  ClientSocketPoolBaseHelper::set_connect_backup_jobs_enabled(false);
+  TransportClientSocketPool pool(kMaxSockets,
+                                 kMaxSocketsPerGroup,
+                                 histograms_.get(),
+                                 host_resolver_.get(),
+                                 &client_socket_factory_,
+                                 NULL);
+  HttpServerPropertiesImpl http_server_properties;
+  http_server_properties.SetPreferredAddressFamily(
+      HostPortPair("www.google.com", 80), ADDRESS_FAMILY_IPV4);
+  TransportConnectRaceParams race_params;
+  race_params.enabled = true;
+  race_params.attempt_delay = base::TimeDelta::FromMinutes(1);
+  pool.SetConnectRaceParams(race_params, http_server_properties.GetWeakPtr());
+
+  client_socket_factory_.set_default_client_socket_type(
+      MockTransportClientSocketFactory::MOCK_PENDING_CLIENT_SOCKET);
+
+  // Resolve an AddressList with a IPv6 address first and then a IPv4 address.
+  host_resolver_->rules()
+      ->AddIPLiteralRule("*", "2:abcd::3:4:ff,2.2.2.2", std::string());
+
+  TestCompletionCallback callback;
+  ClientSocketHandle handle;
+  int rv = handle.Init("a", params_, LOW, callback.callback(), &pool,
+                       BoundNetLog());
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  IPEndPoint endpoint;
+  handle.socket()->GetLocalAddress(&endpoint);
+  EXPECT_EQ(kIPv4AddressSize, endpoint.address().size());
+  EXPECT_EQ(1, client_socket_factory_.allocation_count());
+}
+
+TEST_F(TransportClientSocketPoolTest, RaceAllAttemptsFail) {
+  // Create a pool without backup jobs.
+  ClientSocketPoolBaseHelper::set_connect_backup_jobs_enabled(false);
+  TransportClientSocketPool pool(kMaxSockets,
+                                 kMaxSocketsPerGroup,
+                                 histograms_.get(),
+                                 host_resolver_.get(),
+                                 &client_socket_factory_,
+                                 NULL);
+  HttpServerPropertiesImpl http_server_properties;
+  TransportConnectRaceParams race_params;
+  race_params.enabled = true;
+  race_params.attempt_delay = base::TimeDelta::FromMilliseconds(10);
+  pool.SetConnectRaceParams(race_params, http_server_properties.GetWeakPtr());
+
+  client_socket_factory_.set_default_client_socket_type(
+      MockTransportClientSocketFactory::MOCK_PENDING_FAILING_CLIENT_SOCKET);
+
+  host_resolver_->rules()->AddIPLiteralRule(
+      "*", "2:abcd::3:4:ff,2.2.2.2,3.3.3.3", std::string());
+
+  TestCompletionCallback callback;
+  ClientSocketHandle handle;
+  int rv = handle.Init("a", params_, LOW, callback.callback(), &pool,
+                       BoundNetLog());
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(ERR_CONNECTION_FAILED, callback.WaitForResult());
+  EXPECT_FALSE(handle.is_initialized());
+  EXPECT_EQ(3, client_socket_factory_.allocation_count());
+  EXPECT_EQ(ADDRESS_FAMILY_UNSPECIFIED,
+            http_server_properties.GetPreferredAddressFamily(
+                HostPortPair("www.google.com", 80)));
+}
+
 }  // namespace
 
 }  // namespace net
@@ -15,26 +15,102 @@ namespace net {
 
 using base::StringPiece;
 
-bool HpackHeaderTable::EntryComparator::operator() (
-    const HpackEntry* lhs, const HpackEntry* rhs) const {
-  int result = lhs->name().compare(rhs->name());
-  if (result != 0)
-    return result < 0;
-  result = lhs->value().compare(rhs->value());
-  if (result != 0)
-    return result < 0;
-  const size_t lhs_index = lhs->IsLookup() ? 0 : 1 + lhs->InsertionIndex();
-  const size_t rhs_index = rhs->IsLookup() ? 0 : 1 + rhs->InsertionIndex();
-  DCHECK(lhs == rhs || lhs_index != rhs_index)
-      << "lhs: (" << lhs->name() << ", " << rhs->value() << ") rhs: ("
-      << rhs->name() << ", " << rhs->value() << ")"
-      << " lhs index: " << lhs_index << " rhs index: " << rhs_index;
-  return lhs_index < rhs_index;
+namespace {
+
+typedef HpackHeaderTable::EntryIndex EntryIndex;
+
+size_t HashString(StringPiece str, size_t seed) {
+  size_t result = seed;
+  for (StringPiece::const_iterator it = str.begin(); it != str.end(); ++it)
+    result = (result * 131) + static_cast<uint8>(*it);
+  return result;
+}
+
+size_t NameHash(StringPiece name) {
+  return HashString(name, 0);
+}
+
+size_t NameAndValueHash(StringPiece name, StringPiece value) {
+  // Seeding with the length of |name| tells apart the representations which
+  // only differ by where the name stops and the value starts.
+  return HashString(value, HashString(name, name.size()));
+}
+
+bool EntryMatches(const HpackEntry* entry,
+                  StringPiece name,
+                  StringPiece value,
+                  bool match_value) {
+  return entry->name() == name && (!match_value || entry->value() == value);
+}
+
+// Returns the entry of |index| under |hash| having |name|, and also |value|
+// if |match_value| is true, or NULL.
+const HpackEntry* FindEntry(const EntryIndex& index,
+                            size_t hash,
+                            StringPiece name,
+                            StringPiece value,
+                            bool match_value) {
+  std::pair<EntryIndex::const_iterator, EntryIndex::const_iterator> range =
+      index.equal_range(hash);
+  for (EntryIndex::const_iterator it = range.first; it != range.second; ++it) {
+    if (EntryMatches(it->second, name, value, match_value))
+      return it->second;
+  }
+  return NULL;
+}
+
+// Points the entry of |index| under |hash| which matches |entry| at |entry|,
+// adding it if there is none.
+void ReplaceEntry(EntryIndex* index,
+                  size_t hash,
+                  const HpackEntry* entry,
+                  bool match_value) {
+  std::pair<EntryIndex::iterator, EntryIndex::iterator> range =
+      index->equal_range(hash);
+  for (EntryIndex::iterator it = range.first; it != range.second; ++it) {
+    if (EntryMatches(it->second, entry->name(), entry->value(), match_value)) {
+      it->second = entry;
+      return;
+    }
+  }
+  index->insert(std::make_pair(hash, entry));
+}
+
+// Removes |entry| from |index|, unless it has been replaced already.
+void RemoveEntry(EntryIndex* index, size_t hash, const HpackEntry* entry) {
+  std::pair<EntryIndex::iterator, EntryIndex::iterator> range =
+      index->equal_range(hash);
+  for (EntryIndex::iterator it = range.first; it != range.second; ++it) {
+    if (it->second == entry) {
+      index->erase(it);
+      return;
+    }
+  }
+}
+
+void DebugLogIndex(const EntryIndex& index) {
+  for (EntryIndex::const_iterator it = index.begin(); it != index.end(); ++it)
+    DVLOG(2) << "  " << it->second->GetDebugString();
+}
+
+}  // namespace
+
+// static
+void HpackHeaderTable::IndexEntry(const HpackEntry* entry,
+                                  EntryIndex* name_index,
+                                  EntryIndex* name_value_index) {
+  ReplaceEntry(name_index, NameHash(entry->name()), entry, false);
+  ReplaceEntry(name_value_index,
+               NameAndValueHash(entry->name(), entry->value()),
+               entry,
+               true);
 }
 
 HpackHeaderTable::HpackHeaderTable()
     : static_entries_(ObtainHpackStaticTable().GetStaticEntries()),
-      static_index_(ObtainHpackStaticTable().GetStaticIndex()),
+      static_name_index_(ObtainHpackStaticTable().GetStaticNameIndex()),
+      static_name_value_index_(
+          ObtainHpackStaticTable().GetStaticNameValueIndex()),
       settings_size_bound_(kDefaultHeaderTableSizeSetting),
       size_(0),
       max_size_(kDefaultHeaderTableSizeSetting),
@@ -58,42 +134,22 @@ const HpackEntry* HpackHeaderTable::GetByIndex(size_t index) {
 }
 
 const HpackEntry* HpackHeaderTable::GetByName(StringPiece name) {
-  HpackEntry query(name, "");
-  {
-    OrderedEntrySet::const_iterator it = static_index_.lower_bound(&query);
-    if (it != static_index_.end() && (*it)->name() == name) {
-      return *it;
-    }
-  }
-  {
-    OrderedEntrySet::const_iterator it = dynamic_index_.lower_bound(&query);
-    if (it != dynamic_index_.end() && (*it)->name() == name) {
-      return *it;
-    }
-  }
-  return NULL;
+  const size_t hash = NameHash(name);
+  const HpackEntry* entry =
+      FindEntry(static_name_index_, hash, name, StringPiece(), false);
+  if (entry == NULL)
+    entry = FindEntry(dynamic_name_index_, hash, name, StringPiece(), false);
+  return entry;
 }
 
 const HpackEntry* HpackHeaderTable::GetByNameAndValue(StringPiece name,
                                                       StringPiece value) {
-  HpackEntry query(name, value);
-  {
-    OrderedEntrySet::const_iterator it = static_index_.lower_bound(&query);
-    if (it != static_index_.end() &&
-        (*it)->name() == name &&
-        (*it)->value() == value) {
-      return *it;
-    }
-  }
-  {
-    OrderedEntrySet::const_iterator it = dynamic_index_.lower_bound(&query);
-    if (it != dynamic_index_.end() &&
-        (*it)->name() == name &&
-        (*it)->value() == value) {
-      return *it;
-    }
-  }
-  return NULL;
+  const size_t hash = NameAndValueHash(name, value);
+  const HpackEntry* entry =
+      FindEntry(static_name_value_index_, hash, name, value, true);
+  if (entry == NULL)
+    entry = FindEntry(dynamic_name_value_index_, hash, name, value, true);
+  return entry;
 }
 
 size_t HpackHeaderTable::IndexOf(const HpackEntry* entry) const {
@@ -159,7 +215,12 @@ void HpackHeaderTable::Evict(size_t count) {
     HpackEntry* entry = &dynamic_entries_.back();
 
     size_ -= entry->Size();
-    CHECK_EQ(1u, dynamic_index_.erase(entry));
+    // Entries are evicted oldest first, so |entry| is still indexed only if no
+    // newer entry has its name, or its name and value.
+    RemoveEntry(&dynamic_name_index_, NameHash(entry->name()), entry);
+    RemoveEntry(&dynamic_name_value_index_,
+                NameAndValueHash(entry->name(), entry->value()),
+                entry);
     dynamic_entries_.pop_back();
   }
 }
@@ -179,7 +240,10 @@ const HpackEntry* HpackHeaderTable::TryAddEntry(StringPiece name,
                                          value,
                                          false,  // is_static
                                          total_insertions_));
-  CHECK(dynamic_index_.insert(&dynamic_entries_.front()).second);
+  // The new entry has the lowest index of all dynamic entries.
+  IndexEntry(&dynamic_entries_.front(),
+             &dynamic_name_index_,
+             &dynamic_name_value_index_);
 
   size_ += entry_size;
   ++total_insertions_;
@@ -194,15 +258,9 @@ void HpackHeaderTable::DebugLogTableState() const {
     DVLOG(2) << "  " << it->GetDebugString();
   }
   DVLOG(2) << "Full Static Index:";
-  for (OrderedEntrySet::const_iterator it = static_index_.begin();
-      it != static_index_.end(); ++it) {
-    DVLOG(2) << "  " << (*it)->GetDebugString();
-  }
+  DebugLogIndex(static_name_value_index_);
   DVLOG(2) << "Full Dynamic Index:";
-  for (OrderedEntrySet::const_iterator it = dynamic_index_.begin();
-      it != dynamic_index_.end(); ++it) {
-    DVLOG(2) << "  " << (*it)->GetDebugString();
-  }
+  DebugLogIndex(dynamic_name_value_index_);
 }
 
 }  // namespace net
@@ -7,9 +7,9 @@
 
 #include <cstddef>
 #include <deque>
-#include <set>
 
 #include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
 #include "base/macros.h"
 #include "net/base/net_export.h"
 #include "net/spdy/hpack_entry.h"
@@ -32,20 +32,26 @@ class NET_EXPORT_PRIVATE HpackHeaderTable {
 
   // HpackHeaderTable takes advantage of the deque property that references
   // remain valid, so long as insertions & deletions are at the head & tail.
+  // The deque allocates entries in fixed-size blocks, so the table is never
+  // reallocated nor copied as it grows and shrinks, and no entry is renumbered
+  // on eviction (see HpackEntry::InsertionIndex()).
   // If this changes (eg we start to drop entries from the middle of the table),
   // this needs to be a std::list, in which case |*_index_| can be trivially
   // extended to map to list iterators.
   typedef std::deque<HpackEntry> EntryTable;
 
-  // Implements a total ordering of HpackEntry on name(), value(), then index
-  // ascending. Note that index may change over the lifetime of an HpackEntry,
-  // but the relative index order of two entries will not. This comparator is
-  // composed with the 'lookup' HpackEntry constructor to allow for efficient
-  // lower-bounding of matching entries.
-  struct NET_EXPORT_PRIVATE EntryComparator {
-    bool operator() (const HpackEntry* lhs, const HpackEntry* rhs) const;
-  };
-  typedef std::set<HpackEntry*, EntryComparator> OrderedEntrySet;
+  // Maps a hash of an entry's name, or of its name and value, to the
+  // lowest-index entry having that name, or that name and value. Distinct keys
+  // which hash alike share a bucket, and are told apart by comparing the
+  // entries themselves.
+  typedef base::hash_multimap<size_t, const HpackEntry*> EntryIndex;
+
+  // Makes |entry| the one found by lookups of its name in |name_index|, and of
+  // its name and value in |name_value_index|, in place of any entry found
+  // previously.
+  static void IndexEntry(const HpackEntry* entry,
+                         EntryIndex* name_index,
+                         EntryIndex* name_value_index);
 
   HpackHeaderTable();
 
@@ -62,7 +68,7 @@ class NET_EXPORT_PRIVATE HpackHeaderTable {
   // Returns the entry matching the index, or NULL.
   const HpackEntry* GetByIndex(size_t index);
 
-  // Returns the lowest-value entry having |name|, or NULL.
+  // Returns the lowest-index entry having |name|, or NULL.
   const HpackEntry* GetByName(StringPiece name);
 
   // Returns the lowest-index matching entry, or NULL.
@@ -105,13 +111,15 @@ class NET_EXPORT_PRIVATE HpackHeaderTable {
   // Evicts |count| oldest entries from the table.
   void Evict(size_t count);
 
-  // |static_entries_| and |static_index_| are owned by HpackStaticTable
-  // singleton.
+  // |static_entries_|, |static_name_index_| and |static_name_value_index_| are
+  // owned by HpackStaticTable singleton.
   const EntryTable& static_entries_;
   EntryTable dynamic_entries_;
 
-  const OrderedEntrySet& static_index_;
-  OrderedEntrySet dynamic_index_;
+  const EntryIndex& static_name_index_;
+  const EntryIndex& static_name_value_index_;
+  EntryIndex dynamic_name_index_;
+  EntryIndex dynamic_name_value_index_;
 
   // Last acknowledged value for SETTINGS_HEADER_TABLE_SIZE.
   size_t settings_size_bound_;
@@ -35,7 +35,8 @@ class HpackHeaderTablePeer {
     return table_->static_entries_;
   }
   size_t index_size() {
-    return table_->static_index_.size() + table_->dynamic_index_.size();
+    return table_->static_name_value_index_.size() +
+        table_->dynamic_name_value_index_.size();
   }
   std::vector<HpackEntry*> EvictionSet(StringPiece name, StringPiece value) {
     HpackHeaderTable::EntryTable::iterator begin, end;
@@ -62,11 +63,6 @@ class HpackHeaderTablePeer {
     return table_->Evict(count);
   }
 
-  void AddDynamicEntry(StringPiece name, StringPiece value) {
-    table_->dynamic_entries_.push_back(
-        HpackEntry(name, value, false, table_->total_insertions_++));
-  }
-
  private:
   HpackHeaderTable* table_;
 };
@@ -131,11 +127,6 @@ class HpackHeaderTableTest : public ::testing::Test {
     }
   }
 
-  HpackEntry DynamicEntry(string name, string value) {
-    peer_.AddDynamicEntry(name, value);
-    return peer_.dynamic_entries().back();
-  }
-
   HpackHeaderTable table_;
   test::HpackHeaderTablePeer peer_;
 };
@@ -228,18 +219,18 @@ TEST_F(HpackHeaderTableTest, EntryIndexing) {
   EXPECT_EQ(entry1, table_.GetByIndex(68));
   EXPECT_EQ(first_static_entry, table_.GetByIndex(1));
 
-  // Querying by name returns the lowest-value matching entry.
-  EXPECT_EQ(entry3, table_.GetByName("key-1"));
+  // Querying by name returns the lowest-index matching entry, looking at
+  // static entries first.
+  EXPECT_EQ(entry5, table_.GetByName("key-1"));
   EXPECT_EQ(entry7, table_.GetByName("key-2"));
-  EXPECT_EQ(entry2->name(),
-            table_.GetByName(first_static_entry->name())->name());
+  EXPECT_EQ(first_static_entry, table_.GetByName(first_static_entry->name()));
   EXPECT_EQ(NULL, table_.GetByName("not-present"));
 
-  // Querying by name & value returns the lowest-index matching entry among
-  // static entries, and the highest-index one among dynamic entries.
+  // Querying by name & value returns the lowest-index matching entry, looking
+  // at static entries first.
   EXPECT_EQ(entry3, table_.GetByNameAndValue("key-1", "Value One"));
   EXPECT_EQ(entry5, table_.GetByNameAndValue("key-1", "Value Two"));
-  EXPECT_EQ(entry4, table_.GetByNameAndValue("key-2", "Value Three"));
+  EXPECT_EQ(entry6, table_.GetByNameAndValue("key-2", "Value Three"));
   EXPECT_EQ(entry7, table_.GetByNameAndValue("key-2", "Value Four"));
   EXPECT_EQ(first_static_entry,
             table_.GetByNameAndValue(first_static_entry->name(),
@@ -262,6 +253,20 @@ TEST_F(HpackHeaderTableTest, EntryIndexing) {
   peer_.Evict(1);
   EXPECT_EQ(NULL, table_.GetByNameAndValue(first_static_entry->name(),
                                            "Value Four"));
+
+  // Evict |entry3| and |entry4|. Newer entries sharing their name, or their
+  // name and value, remain queryable.
+  peer_.Evict(2);
+  EXPECT_EQ(NULL, table_.GetByNameAndValue("key-1", "Value One"));
+  EXPECT_EQ(entry5, table_.GetByName("key-1"));
+  EXPECT_EQ(entry6, table_.GetByNameAndValue("key-2", "Value Three"));
+  EXPECT_EQ(entry7, table_.GetByName("key-2"));
+
+  // Evict the remaining entries. The dynamic indices are left empty.
+  peer_.Evict(3);
+  EXPECT_EQ(NULL, table_.GetByName("key-1"));
+  EXPECT_EQ(NULL, table_.GetByName("key-2"));
+  EXPECT_EQ(peer_.static_entries().size(), peer_.index_size());
 }
 
 TEST_F(HpackHeaderTableTest, SetSizes) {
@@ -408,43 +413,6 @@ TEST_F(HpackHeaderTableTest, TryAddTooLargeEntry) {
   EXPECT_EQ(0u, peer_.dynamic_entries().size());
 }
 
-TEST_F(HpackHeaderTableTest, ComparatorNameOrdering) {
-  HpackEntry entry1("header", "value");
-  HpackEntry entry2("HEADER", "value");
-
-  HpackHeaderTable::EntryComparator comparator;
-  EXPECT_FALSE(comparator(&entry1, &entry2));
-  EXPECT_TRUE(comparator(&entry2, &entry1));
-}
-
-TEST_F(HpackHeaderTableTest, ComparatorValueOrdering) {
-  HpackEntry entry1("header", "value");
-  HpackEntry entry2("header", "VALUE");
-
-  HpackHeaderTable::EntryComparator comparator;
-  EXPECT_FALSE(comparator(&entry1, &entry2));
-  EXPECT_TRUE(comparator(&entry2, &entry1));
-}
-
-TEST_F(HpackHeaderTableTest, ComparatorIndexOrdering) {
-  HpackHeaderTable::EntryComparator comparator;
-  HpackEntry entry1(DynamicEntry("name", "value"));
-  HpackEntry entry2(DynamicEntry("name", "value"));
-
-  // |entry1| has lower insertion index than |entry2|.
-  EXPECT_TRUE(comparator(&entry1, &entry2));
-  EXPECT_FALSE(comparator(&entry2, &entry1));
-}
-
-TEST_F(HpackHeaderTableTest, ComparatorEqualityOrdering) {
-  HpackEntry entry1("name", "value");
-  HpackEntry entry2(DynamicEntry("name", "value"));
-
-  HpackHeaderTable::EntryComparator comparator;
-  EXPECT_FALSE(comparator(&entry1, &entry1));
-  EXPECT_FALSE(comparator(&entry2, &entry2));
-}
-
 }  // namespace
 
 }  // namespace net
@@ -48,6 +48,13 @@ HpackHuffmanTable::DecodeEntry::DecodeEntry(uint8 next_table_index,
 size_t HpackHuffmanTable::DecodeTable::size() const {
   return size_t(1) << indexed_length;
 }
+HpackHuffmanTable::MultiSymbolEntry::MultiSymbolEntry()
+  : length(0), symbol_count(0) {
+  symbols[0] = symbols[1] = 0;
+}
+
+// static
+const uint8 HpackHuffmanTable::kMultiSymbolBits;
 
 HpackHuffmanTable::HpackHuffmanTable() {}
 
@@ -99,6 +106,7 @@ bool HpackHuffmanTable::Initialize(const HpackHuffmanSymbol* input_symbols,
   // Order on symbol ID ascending.
   std::sort(symbols.begin(), symbols.end(), SymbolIdCompare);
   BuildEncodeTable(symbols);
+  BuildMultiSymbolTable();
   return true;
 }
 
@@ -111,6 +119,50 @@ void HpackHuffmanTable::BuildEncodeTable(const std::vector<Symbol>& symbols) {
   }
 }
 
+void HpackHuffmanTable::BuildMultiSymbolTable() {
+  multi_symbol_entries_.resize(size_t(1) << kMultiSymbolBits);
+  // Symbols >= 256 are not output, and are left to DecodeTables.
+  const size_t symbol_count = std::min<size_t>(code_by_id_.size(), 256);
+  for (size_t first = 0; first != symbol_count; first++) {
+    const uint8 first_length = length_by_id_[first];
+    if (first_length > kMultiSymbolBits)
+      continue;
+
+    MultiSymbolEntry entry;
+    entry.length = first_length;
+    entry.symbol_count = 1;
+    entry.symbols[0] = static_cast<char>(first);
+    FillMultiSymbolEntries(code_by_id_[first] >> (32 - kMultiSymbolBits),
+                           size_t(1) << (kMultiSymbolBits - first_length),
+                           entry);
+
+    // Entries whose remaining bits also start with a code are overwritten
+    // with the pair of symbols.
+    for (size_t second = 0; second != symbol_count; second++) {
+      const uint8 length = first_length + length_by_id_[second];
+      if (length > kMultiSymbolBits)
+        continue;
+      uint32 code = code_by_id_[first] | (code_by_id_[second] >> first_length);
+
+      entry.length = length;
+      entry.symbol_count = 2;
+      entry.symbols[1] = static_cast<char>(second);
+      FillMultiSymbolEntries(code >> (32 - kMultiSymbolBits),
+                             size_t(1) << (kMultiSymbolBits - length),
+                             entry);
+    }
+  }
+}
+
+void HpackHuffmanTable::FillMultiSymbolEntries(uint32 index,
+                                               size_t count,
+                                               const MultiSymbolEntry& entry) {
+  CHECK_LE(index + count, multi_symbol_entries_.size());
+  std::fill(multi_symbol_entries_.begin() + index,
+            multi_symbol_entries_.begin() + index + count,
+            entry);
+}
+
 void HpackHuffmanTable::BuildDecodeTables(const std::vector<Symbol>& symbols) {
   AddDecodeTable(0, kDecodeTableRootBits);
   // We wish to maximize the flatness of the DecodeTable hierarchy (subject to
@@ -217,34 +269,36 @@ bool HpackHuffmanTable::IsInitialized() const {
 
 void HpackHuffmanTable::EncodeString(StringPiece in,
                                      HpackOutputStream* out) const {
-  size_t bit_remnant = 0;
+  // Codes are accumulated in the low |bit_count| bits of |bits|, and written
+  // out a whole byte at a time. Higher bits of |bits| are stale.
+  uint64 bits = 0;
+  size_t bit_count = 0;
   for (size_t i = 0; i != in.size(); i++) {
     uint16 symbol_id = static_cast<uint8>(in[i]);
     CHECK_GT(code_by_id_.size(), symbol_id);
 
     // Load, and shift code to low bits.
     unsigned length = length_by_id_[symbol_id];
-    uint32 code = code_by_id_[symbol_id] >> (32 - length);
-
-    bit_remnant = (bit_remnant + length) % 8;
-
-    if (length > 24) {
-      out->AppendBits(static_cast<uint8>(code >> 24), length - 24);
-      length = 24;
-    }
-    if (length > 16) {
-      out->AppendBits(static_cast<uint8>(code >> 16), length - 16);
-      length = 16;
-    }
-    if (length > 8) {
-      out->AppendBits(static_cast<uint8>(code >> 8), length - 8);
-      length = 8;
+    bits = (bits << length) | (code_by_id_[symbol_id] >> (32 - length));
+    bit_count += length;
+
+    // Codes are at most 32 bits long, so |bits| cannot overflow.
+    if (bit_count >= 32) {
+      while (bit_count >= 8) {
+        bit_count -= 8;
+        out->AppendBits(static_cast<uint8>(bits >> bit_count), 8);
+      }
     }
-    out->AppendBits(static_cast<uint8>(code), length);
   }
-  if (bit_remnant != 0) {
+  while (bit_count >= 8) {
+    bit_count -= 8;
+    out->AppendBits(static_cast<uint8>(bits >> bit_count), 8);
+  }
+  if (bit_count != 0) {
     // Pad current byte as required.
-    out->AppendBits(pad_bits_ >> bit_remnant, 8 - bit_remnant);
+    out->AppendBits(static_cast<uint8>(bits << (8 - bit_count)) |
+                        (pad_bits_ >> bit_count),
+                    8);
   }
 }
 
@@ -274,9 +328,26 @@ bool HpackHuffmanTable::DecodeString(HpackInputStream* in,
   // Current input, stored in the high |bits_available| bits of |bits|.
   uint32 bits = 0;
   size_t bits_available = 0;
-  bool peeked_success = in->PeekBits(&bits_available, &bits);
 
   while (true) {
+    // Top up |bits| with as much input as it holds. Fewer than 32 bits are
+    // available only once the input runs out.
+    while (in->PeekBits(&bits_available, &bits)) {}
+
+    const MultiSymbolEntry& multi_symbol_entry =
+        multi_symbol_entries_[bits >> (32 - kMultiSymbolBits)];
+    if (multi_symbol_entry.length != 0 &&
+        multi_symbol_entry.length <= bits_available &&
+        out->size() + multi_symbol_entry.symbol_count <= out_capacity) {
+      out->append(multi_symbol_entry.symbols, multi_symbol_entry.symbol_count);
+
+      in->ConsumeBits(multi_symbol_entry.length);
+      bits = bits << multi_symbol_entry.length;
+      bits_available -= multi_symbol_entry.length;
+      continue;
+    }
+
+    // Decode a single symbol by walking the DecodeTables.
     const DecodeTable* table = &decode_tables_[0];
     uint32 index = bits >> (32 - kDecodeTableRootBits);
 
@@ -291,12 +362,10 @@ bool HpackHuffmanTable::DecodeString(HpackInputStream* in,
     const DecodeEntry& entry = Entry(*table, index);
 
     if (entry.length > bits_available) {
-      if (!peeked_success) {
-        // Unable to read enough input for a match. If only a portion of
-        // the last byte remains, this is a successful EOF condition.
-        in->ConsumeByteRemainder();
-        return !in->HasMoreData();
-      }
+      // Unable to read enough input for a match. If only a portion of
+      // the last byte remains, this is a successful EOF condition.
+      in->ConsumeByteRemainder();
+      return !in->HasMoreData();
     } else if (entry.length == 0) {
       // The input is an invalid prefix, larger than any prefix in the table.
       return false;
@@ -314,7 +383,6 @@ bool HpackHuffmanTable::DecodeString(HpackInputStream* in,
       bits = bits << entry.length;
       bits_available -= entry.length;
     }
-    peeked_success = in->PeekBits(&bits_available, &bits);
   }
   NOTREACHED();
   return false;
@@ -60,6 +60,20 @@ class NET_EXPORT_PRIVATE HpackHuffmanTable {
     // Returns |1 << indexed_length|.
     size_t size() const;
   };
+  // MultiSymbolEntries index the leading |kMultiSymbolBits| bits of the input,
+  // so that the short codes making up most of the input are decoded one or
+  // two at a time without walking DecodeTables.
+  struct NET_EXPORT_PRIVATE MultiSymbolEntry {
+    MultiSymbolEntry();
+
+    // Total bit-length of the codes of |symbols|, or 0 if the indexed bits do
+    // not start with a code of at most |kMultiSymbolBits| bits.
+    uint8 length;
+    // Number of valid |symbols|, either 1 or 2 unless |length| is 0.
+    uint8 symbol_count;
+    char symbols[2];
+  };
+  static const uint8 kMultiSymbolBits = 12;
 
   HpackHuffmanTable();
   ~HpackHuffmanTable();
@@ -96,6 +110,14 @@ class NET_EXPORT_PRIVATE HpackHuffmanTable {
   // Expects symbols ordered on ID ascending.
   void BuildEncodeTable(const std::vector<Symbol>& symbols);
 
+  // Expects the encode table to be built.
+  void BuildMultiSymbolTable();
+
+  // Sets the |count| entries of |multi_symbol_entries_| starting at |index|.
+  void FillMultiSymbolEntries(uint32 index,
+                              size_t count,
+                              const MultiSymbolEntry& entry);
+
   // Adds a new DecodeTable with the argument prefix & indexed length.
   // Returns the new table index.
   uint8 AddDecodeTable(uint8 prefix, uint8 indexed);
@@ -108,6 +130,9 @@ class NET_EXPORT_PRIVATE HpackHuffmanTable {
   std::vector<DecodeTable> decode_tables_;
   std::vector<DecodeEntry> decode_entries_;
 
+  // Has |1 << kMultiSymbolBits| entries.
+  std::vector<MultiSymbolEntry> multi_symbol_entries_;
+
   // Symbol code and code length, in ascending symbol ID order.
   // Codes are stored in the most-significant bits of the word.
   std::vector<uint32> code_by_id_;
@@ -8,6 +8,7 @@
 #include <string>
 
 #include "base/logging.h"
+#include "base/rand_util.h"
 #include "net/spdy/hpack_constants.h"
 #include "net/spdy/hpack_input_stream.h"
 #include "net/spdy/hpack_output_stream.h"
@@ -55,6 +56,12 @@ class HpackHuffmanTablePeer {
         table_.decode_entries_.begin() + decode_table.entries_offset;
     return std::vector<DecodeEntry>(begin, begin + decode_table.size());
   }
+  // Makes |table| decode one symbol per DecodeTable walk.
+  static void DisableMultiSymbolDecoding(HpackHuffmanTable* table) {
+    std::fill(table->multi_symbol_entries_.begin(),
+              table->multi_symbol_entries_.end(),
+              HpackHuffmanTable::MultiSymbolEntry());
+  }
   void DumpDecodeTable(const DecodeTable& table) {
     std::vector<DecodeEntry> entries = decode_entries(table);
     LOG(INFO) << "Table size " << (1 << table.indexed_length)
@@ -487,6 +494,38 @@ TEST_F(HpackHuffmanTableTest, RoundTripSymbolSequence) {
   EXPECT_EQ(input, buffer_out);
 }
 
+TEST_F(HpackHuffmanTableTest, MultiSymbolDecodingAgreesWithSingleSymbol) {
+  std::vector<HpackHuffmanSymbol> code = HpackHuffmanCode();
+  EXPECT_TRUE(table_.Initialize(&code[0], code.size()));
+  HpackHuffmanTable reference;
+  EXPECT_TRUE(reference.Initialize(&code[0], code.size()));
+  HpackHuffmanTablePeer::DisableMultiSymbolDecoding(&reference);
+
+  for (int i = 0; i != 1000; ++i) {
+    // Random strings round-trip, and random bytes are mostly invalid input.
+    const string input = base::RandBytesAsString(base::RandInt(0, 64));
+    const string encoded = EncodeString(input);
+    const string* inputs[] = {&encoded, &input};
+    for (size_t j = 0; j != arraysize(inputs); ++j) {
+      // Every symbol is at least 5 bits long. Also try a capacity that is
+      // likely to overflow.
+      const size_t capacities[] = {inputs[j]->size() * 8 / 5, input.size() / 2};
+      for (size_t k = 0; k != arraysize(capacities); ++k) {
+        string buffer;
+        string reference_buffer;
+        HpackInputStream input_stream(kuint32max, *inputs[j]);
+        HpackInputStream reference_stream(kuint32max, *inputs[j]);
+        EXPECT_EQ(reference.DecodeString(&reference_stream, capacities[k],
+                                         &reference_buffer),
+                  table_.DecodeString(&input_stream, capacities[k], &buffer));
+        EXPECT_EQ(reference_buffer, buffer);
+        if (j == 0 && k == 0)
+          EXPECT_EQ(input, buffer);
+      }
+    }
+  }
+}
+
 TEST_F(HpackHuffmanTableTest, EncodedSizeAgreesWithEncodeString) {
   std::vector<HpackHuffmanSymbol> code = HpackHuffmanCode();
   EXPECT_TRUE(table_.Initialize(&code[0], code.size()));
@@ -0,0 +1,181 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/spdy/hpack_constants.h"
+#include "net/spdy/hpack_decoder.h"
+#include "net/spdy/hpack_encoder.h"
+#include "net/spdy/hpack_huffman_table.h"
+#include "net/spdy/hpack_input_stream.h"
+#include "net/spdy/hpack_output_stream.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int kIterations = 2000;
+
+// Builds the request headers of a page load: a document, followed by the
+// stylesheets, scripts and images it references, all carrying the same
+// cookies and client headers.
+vector<map<string, string> > MakeRequestCorpus() {
+  const char* const kPaths[] = {
+    "/",
+    "/static/css/main.css",
+    "/static/css/print.css",
+    "/static/js/jquery.min.js",
+    "/static/js/app.js",
+    "/static/js/analytics.js",
+    "/images/logo.png",
+    "/images/sprite.png",
+    "/images/banner_1024x200.jpg",
+    "/favicon.ico",
+  };
+  vector<map<string, string> > corpus;
+  for (int page = 0; page < 10; ++page) {
+    for (size_t i = 0; i < arraysize(kPaths); ++i) {
+      map<string, string> headers;
+      headers[":method"] = "GET";
+      headers[":scheme"] = "https";
+      headers[":authority"] = base::StringPrintf("www%d.example.com", page % 3);
+      headers[":path"] = base::StringPrintf("%s?page=%d", kPaths[i], page);
+      headers["accept"] = i == 0 ?
+          "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8" :
+          "*/*";
+      headers["accept-encoding"] = "gzip,deflate,sdch";
+      headers["accept-language"] = "en-US,en;q=0.8";
+      headers["cookie"] = base::StringPrintf(
+          "SID=DQAAAHkAAAB0bH5v3Ni0XTo; PREF=ID=8a7b3c2d1e0f:U=%d:FF=0; "
+          "NID=67=q1w2e3r4t5y6u7i8o9p0; _ga=GA1.2.123456789.%d",
+          page, 1400000000 + page);
+      headers["referer"] = base::StringPrintf(
+          "https://www%d.example.com/?page=%d", page % 3, page);
+      headers["user-agent"] =
+          "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+          "(KHTML, like Gecko) Chrome/38.0.2125.104 Safari/537.36";
+      corpus.push_back(headers);
+    }
+  }
+  return corpus;
+}
+
+class HpackPerfTest : public ::testing::Test {
+ protected:
+  HpackPerfTest() : corpus_(MakeRequestCorpus()), header_count_(0) {
+    for (size_t i = 0; i < corpus_.size(); ++i)
+      header_count_ += corpus_[i].size();
+  }
+
+  void LogHeadersPerSecond(const char* test_name, base::TimeDelta elapsed) {
+    base::LogPerfResult(
+        test_name,
+        kIterations * header_count_ / elapsed.InSecondsF(),
+        "headers/s");
+  }
+
+  void LogMegabytesPerSecond(const char* test_name,
+                             size_t bytes,
+                             base::TimeDelta elapsed) {
+    base::LogPerfResult(
+        test_name,
+        kIterations * bytes / elapsed.InSecondsF() / (1024 * 1024),
+        "MB/s");
+  }
+
+  // Returns the names and values of |corpus_|, concatenated.
+  string CorpusText() const {
+    string text;
+    for (size_t i = 0; i < corpus_.size(); ++i) {
+      for (map<string, string>::const_iterator it = corpus_[i].begin();
+           it != corpus_[i].end(); ++it) {
+        text += it->first;
+        text += it->second;
+      }
+    }
+    return text;
+  }
+
+  const vector<map<string, string> > corpus_;
+  size_t header_count_;
+};
+
+TEST_F(HpackPerfTest, Encode) {
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    HpackEncoder encoder(ObtainHpackHuffmanTable());
+    string encoded;
+    for (size_t j = 0; j < corpus_.size(); ++j)
+      ASSERT_TRUE(encoder.EncodeHeaderSet(corpus_[j], &encoded));
+  }
+  LogHeadersPerSecond("Hpack_encode", base::TimeTicks::Now() - start);
+}
+
+TEST_F(HpackPerfTest, Decode) {
+  vector<string> encoded(corpus_.size());
+  {
+    HpackEncoder encoder(ObtainHpackHuffmanTable());
+    for (size_t i = 0; i < corpus_.size(); ++i)
+      ASSERT_TRUE(encoder.EncodeHeaderSet(corpus_[i], &encoded[i]));
+  }
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    HpackDecoder decoder(ObtainHpackHuffmanTable());
+    for (size_t j = 0; j < encoded.size(); ++j) {
+      ASSERT_TRUE(decoder.HandleControlFrameHeadersData(
+          1, encoded[j].data(), encoded[j].size()));
+      ASSERT_TRUE(decoder.HandleControlFrameHeadersComplete(1));
+    }
+  }
+  LogHeadersPerSecond("Hpack_decode", base::TimeTicks::Now() - start);
+}
+
+TEST_F(HpackPerfTest, HuffmanEncode) {
+  const HpackHuffmanTable& table = ObtainHpackHuffmanTable();
+  const string text = CorpusText();
+  HpackOutputStream output_stream;
+  string encoded;
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    table.EncodeString(text, &output_stream);
+    output_stream.TakeString(&encoded);
+  }
+  LogMegabytesPerSecond(
+      "Hpack_huffman_encode", text.size(), base::TimeTicks::Now() - start);
+}
+
+TEST_F(HpackPerfTest, HuffmanDecode) {
+  const HpackHuffmanTable& table = ObtainHpackHuffmanTable();
+  const string text = CorpusText();
+  HpackOutputStream output_stream;
+  string encoded;
+  table.EncodeString(text, &output_stream);
+  output_stream.TakeString(&encoded);
+  string decoded;
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    HpackInputStream input_stream(kuint32max, encoded);
+    ASSERT_TRUE(table.DecodeString(&input_stream, text.size(), &decoded));
+  }
+  LogMegabytesPerSecond(
+      "Hpack_huffman_decode", text.size(), base::TimeTicks::Now() - start);
+  EXPECT_EQ(text, decoded);
+}
+
+}  // namespace
+
+}  // namespace net
@@ -25,10 +25,16 @@ void HpackStaticTable::Initialize(const HpackStaticEntry* static_entry_table,
                                          StringPiece(it->value, it->value_len),
                                          true,  // is_static
                                          total_insertions));
-    CHECK(static_index_.insert(&static_entries_.back()).second);
-
     ++total_insertions;
   }
+  // Index the entries last to first, so that lookups find the lowest-index
+  // entry among those sharing a name.
+  for (HpackHeaderTable::EntryTable::const_reverse_iterator it =
+           static_entries_.rbegin();
+       it != static_entries_.rend(); ++it) {
+    HpackHeaderTable::IndexEntry(&*it, &static_name_index_,
+                                 &static_name_value_index_);
+  }
 }
 
 bool HpackStaticTable::IsInitialized() const {
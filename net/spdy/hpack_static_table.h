@@ -11,7 +11,7 @@ namespace net {
 
 struct HpackStaticEntry;
 
-// HpackStaticTable provides |static_entries_| and |static_index_| for HPACK
+// HpackStaticTable provides |static_entries_| and their indices for HPACK
 // encoding and decoding contexts.  Once initialized, an instance is read only
 // and may be accessed only through its const interface.  Such an instance may
 // be shared accross multiple HPACK contexts.
@@ -20,7 +20,7 @@ class NET_EXPORT_PRIVATE HpackStaticTable {
   HpackStaticTable();
   ~HpackStaticTable();
 
-  // Prepares HpackStaticTable by filling up static_entries_ and static_index_
+  // Prepares HpackStaticTable by filling up static_entries_ and their indices
   // from an array of struct HpackStaticEntry.  Must be called exactly once.
   void Initialize(const HpackStaticEntry* static_entry_table,
                   size_t static_entry_count);
@@ -32,13 +32,17 @@ class NET_EXPORT_PRIVATE HpackStaticTable {
   const HpackHeaderTable::EntryTable& GetStaticEntries() const {
     return static_entries_;
   }
-  const HpackHeaderTable::OrderedEntrySet& GetStaticIndex() const {
-    return static_index_;
+  const HpackHeaderTable::EntryIndex& GetStaticNameIndex() const {
+    return static_name_index_;
+  }
+  const HpackHeaderTable::EntryIndex& GetStaticNameValueIndex() const {
+    return static_name_value_index_;
   }
 
  private:
   HpackHeaderTable::EntryTable static_entries_;
-  HpackHeaderTable::OrderedEntrySet static_index_;
+  HpackHeaderTable::EntryIndex static_name_index_;
+  HpackHeaderTable::EntryIndex static_name_value_index_;
 };
 
 }  // namespace net
@@ -33,8 +33,9 @@ TEST_F(HpackStaticTableTest, Initialize) {
   HpackHeaderTable::EntryTable static_entries = table_.GetStaticEntries();
   EXPECT_EQ(static_table.size(), static_entries.size());
 
-  HpackHeaderTable::OrderedEntrySet static_index = table_.GetStaticIndex();
-  EXPECT_EQ(static_table.size(), static_index.size());
+  // Static entries have distinct names & values, but some share a name.
+  EXPECT_EQ(static_table.size(), table_.GetStaticNameValueIndex().size());
+  EXPECT_LT(table_.GetStaticNameIndex().size(), static_table.size());
 }
 
 // Test that ObtainHpackStaticTable returns the same instance every time.
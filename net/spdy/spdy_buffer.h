@@ -53,6 +53,14 @@ class NET_EXPORT_PRIVATE SpdyBuffer {
   // non-NULL and |size| must be non-zero.
   SpdyBuffer(const char* data, size_t size);
 
+  // Construct with the |size| bytes at |data| within |buffer|'s data,
+  // without copying them. |buffer| is kept alive as long as the data
+  // may be used, including through GetIOBufferForRemainingData(), and
+  // must not be written to meanwhile. |size| must be non-zero.
+  SpdyBuffer(const scoped_refptr<IOBuffer>& buffer,
+             const char* data,
+             size_t size);
+
   // If there are bytes remaining in the buffer, triggers a call to
   // any consume callbacks with a DISCARD source.
   ~SpdyBuffer();
@@ -93,6 +101,8 @@ class NET_EXPORT_PRIVATE SpdyBuffer {
   class SharedFrameIOBuffer;
 
   const scoped_refptr<SharedFrame> shared_frame_;
+  // Holds the data of |shared_frame_|, if it does not own its data.
+  const scoped_refptr<IOBuffer> backing_buffer_;
   std::vector<ConsumeCallback> consume_callbacks_;
   size_t offset_;
 
@@ -55,6 +55,31 @@ TEST_F(SpdyBufferTest, DataConstructor) {
   EXPECT_EQ(std::string(kData, kDataSize), BufferToString(buffer));
 }
 
+// Construct a SpdyBuffer from a slice of an IOBuffer and make sure it
+// points to the IOBuffer's data and keeps it alive.
+TEST_F(SpdyBufferTest, IOBufferConstructor) {
+  scoped_refptr<IOBuffer> io_buffer(new IOBuffer(kDataSize + 1));
+  std::memcpy(io_buffer->data() + 1, kData, kDataSize);
+  scoped_ptr<SpdyBuffer> buffer(
+      new SpdyBuffer(io_buffer, io_buffer->data() + 1, kDataSize));
+  EXPECT_FALSE(io_buffer->HasOneRef());
+
+  EXPECT_EQ(io_buffer->data() + 1, buffer->GetRemainingData());
+  EXPECT_EQ(kDataSize, buffer->GetRemainingSize());
+  EXPECT_EQ(std::string(kData, kDataSize), BufferToString(*buffer));
+
+  // The returned IOBuffer keeps |io_buffer| alive past |buffer|.
+  buffer->Consume(1);
+  scoped_refptr<IOBuffer> remaining_buffer =
+      buffer->GetIOBufferForRemainingData();
+  buffer.reset();
+  EXPECT_FALSE(io_buffer->HasOneRef());
+  EXPECT_EQ(io_buffer->data() + 2, remaining_buffer->data());
+
+  remaining_buffer = NULL;
+  EXPECT_TRUE(io_buffer->HasOneRef());
+}
+
 void IncrementBy(size_t* x,
                  SpdyBuffer::ConsumeSource expected_consume_source,
                  size_t delta,
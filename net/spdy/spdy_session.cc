@@ -51,6 +51,10 @@ namespace net {
 namespace {
 
 const int kReadBufferSize = 8 * 1024;
+// DATA payloads of at least this size are handed to their stream as a
+// slice of the read buffer, instead of a copy. Smaller ones are copied
+// so that a retained payload never holds on to more than twice its size.
+const size_t kMinSharedReadBufferPayloadSize = kReadBufferSize / 2;
 const int kDefaultConnectionAtRiskOfLossSeconds = 10;
 const int kHungIntervalSeconds = 10;
 
@@ -1398,6 +1402,11 @@ int SpdySession::DoRead() {
   CHECK(connection_);
   CHECK(connection_->socket());
   read_state_ = READ_STATE_DO_READ_COMPLETE;
+  // DATA payloads of the last read may still be referenced from the read
+  // buffer (see OnStreamFrameData()); read into a new one rather than
+  // overwrite them.
+  if (!read_buffer_->HasOneRef())
+    read_buffer_ = new IOBuffer(kReadBufferSize);
   return connection_->socket()->Read(
       read_buffer_.get(),
       kReadBufferSize,
@@ -2048,7 +2057,14 @@ void SpdySession::OnStreamFrameData(SpdyStreamId stream_id,
   if (data) {
     DCHECK_GT(len, 0u);
     CHECK_LE(len, static_cast<size_t>(kReadBufferSize));
-    buffer.reset(new SpdyBuffer(data, len));
+    // SpdyFramer hands DATA payloads over as they lie in the read buffer.
+    if (len >= kMinSharedReadBufferPayloadSize &&
+        data >= read_buffer_->data() &&
+        data + len <= read_buffer_->data() + kReadBufferSize) {
+      buffer.reset(new SpdyBuffer(read_buffer_, data, len));
+    } else {
+      buffer.reset(new SpdyBuffer(data, len));
+    }
 
     if (flow_control_state_ == FLOW_CONTROL_STREAM_AND_SESSION) {
       DecreaseRecvWindowSize(static_cast<int32>(len));
@@ -0,0 +1,109 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_session.h"
+
+#include <string>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/test/perf_time_logger.h"
+#include "net/base/request_priority.h"
+#include "net/socket/next_proto.h"
+#include "net/socket/socket_test_util.h"
+#include "net/spdy/spdy_buffer.h"
+#include "net/spdy/spdy_session_key.h"
+#include "net/spdy/spdy_stream.h"
+#include "net/spdy/spdy_stream_test_util.h"
+#include "net/spdy/spdy_test_util_common.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "url/gurl.h"
+
+namespace net {
+
+namespace {
+
+const char kTestUrl[] = "http://www.example.org/";
+const int kDataFrameCount = 4096;
+const int kDataFramePayloadSize = 16 * 1024;
+
+// Stream delegate which consumes the response body as soon as it is
+// received, so that flow control never stalls the download.
+class DrainingStreamDelegate : public test::StreamDelegateBase {
+ public:
+  explicit DrainingStreamDelegate(const base::WeakPtr<SpdyStream>& stream)
+      : StreamDelegateBase(stream), bytes_received_(0) {}
+  virtual ~DrainingStreamDelegate() {}
+
+  virtual void OnDataReceived(scoped_ptr<SpdyBuffer> buffer) OVERRIDE {
+    if (buffer)
+      bytes_received_ += buffer->GetRemainingSize();
+  }
+
+  size_t bytes_received() const { return bytes_received_; }
+
+ private:
+  size_t bytes_received_;
+};
+
+// Measures how fast a SpdySession hands a large response body over to
+// its stream, reading DATA frames off a mock socket.
+TEST(SpdySessionPerfTest, LargeDownload) {
+  base::MessageLoopForIO message_loop;
+  SpdyTestUtil spdy_util(kProtoSPDY31);
+  SpdySessionDependencies session_deps(kProtoSPDY31);
+  session_deps.host_resolver->set_synchronous_mode(true);
+
+  const std::string payload(kDataFramePayloadSize, 'x');
+  scoped_ptr<SpdyFrame> reply(spdy_util.ConstructSpdyGetSynReply(NULL, 0, 1));
+  scoped_ptr<SpdyFrame> data_frame(spdy_util.ConstructSpdyBodyFrame(
+      1, payload.data(), payload.size(), false));
+  scoped_ptr<SpdyFrame> last_data_frame(spdy_util.ConstructSpdyBodyFrame(
+      1, payload.data(), payload.size(), true));
+
+  std::vector<MockRead> reads;
+  reads.push_back(MockRead(SYNCHRONOUS, reply->data(), reply->size()));
+  for (int i = 0; i < kDataFrameCount - 1; ++i) {
+    reads.push_back(
+        MockRead(SYNCHRONOUS, data_frame->data(), data_frame->size()));
+  }
+  reads.push_back(
+      MockRead(SYNCHRONOUS, last_data_frame->data(), last_data_frame->size()));
+  reads.push_back(MockRead(SYNCHRONOUS, ERR_IO_PENDING));  // Stall forever.
+
+  // Writes are not checked.
+  StaticSocketDataProvider data(&reads[0], reads.size(), NULL, 0);
+  session_deps.socket_factory->AddSocketDataProvider(&data);
+  scoped_refptr<HttpNetworkSession> http_session(
+      SpdySessionDependencies::SpdyCreateSession(&session_deps));
+
+  SpdySessionKey key(HostPortPair::FromURL(GURL(kTestUrl)),
+                     ProxyServer::Direct(), PRIVACY_MODE_DISABLED);
+  base::WeakPtr<SpdySession> session =
+      CreateInsecureSpdySession(http_session, key, BoundNetLog());
+
+  GURL url(kTestUrl);
+  base::WeakPtr<SpdyStream> stream =
+      CreateStreamSynchronously(SPDY_REQUEST_RESPONSE_STREAM,
+                                session, url, MEDIUM, BoundNetLog());
+  ASSERT_TRUE(stream.get() != NULL);
+  DrainingStreamDelegate delegate(stream);
+  stream->SetDelegate(&delegate);
+
+  base::PerfTimeLogger timer("SpdySession_large_download");
+  stream->SendRequestHeaders(spdy_util.ConstructGetHeaderBlock(url.spec()),
+                             NO_MORE_DATA_TO_SEND);
+  EXPECT_EQ(OK, delegate.WaitForClose());
+  timer.Done();
+
+  EXPECT_EQ(static_cast<size_t>(kDataFrameCount) * kDataFramePayloadSize,
+            delegate.bytes_received());
+}
+
+}  // namespace
+
+}  // namespace net
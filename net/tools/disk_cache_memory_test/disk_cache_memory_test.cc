@@ -12,20 +12,25 @@
 #include "base/bind.h"
 #include "base/callback.h"
 #include "base/command_line.h"
+#include "base/containers/hash_tables.h"
 #include "base/files/file_path.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
 #include "base/message_loop/message_loop.h"
 #include "base/message_loop/message_loop_proxy.h"
+#include "base/rand_util.h"
 #include "base/run_loop.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_piece.h"
 #include "base/strings/string_split.h"
 #include "base/strings/stringprintf.h"
+#include "base/time/time.h"
 #include "net/base/cache_type.h"
+#include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
 #include "net/disk_cache/simple/simple_index.h"
 
@@ -38,6 +43,19 @@ const char kSimpleBackendType[] = "simple";
 const char kDiskCacheType[] = "disk_cache";
 const char kAppCacheType[] = "app_cache";
 
+const char kMemoryCacheSwitch[] = "memory-cache";
+const char kHeapBacking[] = "heap";
+const char kDiscardableBacking[] = "discardable";
+
+const char kSimpleIndexSwitch[] = "simple-index";
+
+// The memory cache test writes kMemoryCacheEntries entries, about 40 MB, to a
+// memory-only cache large enough to keep all of them.
+const int kMemoryCacheSize = 50 * 1024 * 1024;
+const int kMemoryCacheEntries = 1200;
+const int kMaxHeadersSize = 2 * 1024;
+const int kMaxBodySize = 64 * 1024;
+
 const char kPrivateDirty[] = "Private_Dirty:";
 const char kReadWrite[] = "rw-";
 const char kHeap[] = "[heap]";
@@ -241,16 +259,123 @@ bool CacheMemTest(const ScopedVector<CacheSpec>& specs) {
   return true;
 }
 
+double GetMegabytesPerSecond(int64 bytes, base::TimeDelta elapsed) {
+  return bytes / (1024.0 * 1024.0) / elapsed.InSecondsF();
+}
+
+// Fills a memory-only cache with entries of varied sizes and reads them back,
+// reporting the throughput of both and the memory the cache takes up.
+bool MemoryCacheTest(bool use_discardable_memory) {
+  const uint64 initial_memory_consumption = GetMemoryConsumption();
+  MemBackendImpl backend(NULL);
+  backend.SetMaxSize(kMemoryCacheSize);
+  backend.SetUseDiscardableMemory(use_discardable_memory);
+  if (!backend.Init())
+    return false;
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kMaxBodySize));
+  memset(buffer->data(), 'x', kMaxBodySize);
+
+  // Sizes follow from the entry number so that every run writes the same
+  // entries.
+  int64 bytes_written = 0;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kMemoryCacheEntries; ++i) {
+    Entry* entry = NULL;
+    if (backend.CreateEntry(base::StringPrintf("entry %d", i), &entry,
+                            net::CompletionCallback()) != net::OK) {
+      LOG(ERROR) << "Could not create entry " << i;
+      return false;
+    }
+    const int headers_size = 200 + (i * 7919) % (kMaxHeadersSize - 200);
+    const int body_size = (i * 104729) % kMaxBodySize;
+    entry->WriteData(0, 0, buffer.get(), headers_size,
+                     net::CompletionCallback(), true);
+    entry->WriteData(1, 0, buffer.get(), body_size, net::CompletionCallback(),
+                     true);
+    entry->Close();
+    bytes_written += headers_size + body_size;
+  }
+  const base::TimeDelta write_time = base::TimeTicks::Now() - start;
+
+  int64 bytes_read = 0;
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kMemoryCacheEntries; ++i) {
+    Entry* entry = NULL;
+    if (backend.OpenEntry(base::StringPrintf("entry %d", i), &entry,
+                          net::CompletionCallback()) != net::OK) {
+      continue;
+    }
+    for (int index = 0; index < 2; ++index) {
+      const int result = entry->ReadData(index, 0, buffer.get(), kMaxBodySize,
+                                         net::CompletionCallback());
+      if (result > 0)
+        bytes_read += result;
+    }
+    entry->Close();
+  }
+  const base::TimeDelta read_time = base::TimeTicks::Now() - start;
+
+  std::cout << "Entries in the memory cache: " << backend.GetEntryCount()
+            << " of " << kMemoryCacheEntries << std::endl;
+  std::cout << "Write throughput: "
+            << GetMegabytesPerSecond(bytes_written, write_time) << " MB/s"
+            << std::endl;
+  std::cout << "Read throughput: "
+            << GetMegabytesPerSecond(bytes_read, read_time) << " MB/s"
+            << std::endl;
+  std::cout << "Private dirty memory: "
+            << GetMemoryConsumption() - initial_memory_consumption << " kB"
+            << " for " << bytes_written / 1024 << " kB of entry data"
+            << std::endl;
+  return true;
+}
+
+// Returns the private dirty memory taken by a SimpleIndex entry set of
+// |num_entries| random hashes, in kB.
+template <typename EntrySetType>
+uint64 GetEntrySetMemoryConsumption(int num_entries) {
+  const uint64 initial_memory_consumption = GetMemoryConsumption();
+  EntrySetType entry_set;
+  for (int i = 0; i < num_entries; ++i) {
+    entry_set.insert(std::make_pair(
+        base::RandUint64(), EntryMetadata(base::Time::Now(), i)));
+  }
+  return GetMemoryConsumption() - initial_memory_consumption;
+}
+
+// Compares the memory taken by the simple cache index entries in an
+// EntryMetadataTable and in the base::hash_map it replaced.
+bool SimpleIndexMemoryTest(int num_entries) {
+  // The table is measured first, as the memory of the hash_map nodes is not
+  // necessarily returned to the system once they are freed.
+  const uint64 table_memory =
+      GetEntrySetMemoryConsumption<SimpleIndex::EntrySet>(num_entries);
+  const uint64 hash_map_memory =
+      GetEntrySetMemoryConsumption<base::hash_map<uint64, EntryMetadata> >(
+          num_entries);
+  std::cout << "Private dirty memory for " << num_entries
+            << " index entries: " << table_memory
+            << " kB in an EntryMetadataTable, " << hash_map_memory
+            << " kB in a base::hash_map" << std::endl;
+  return true;
+}
+
 void PrintUsage(std::ostream* stream) {
   *stream << "Usage: disk_cache_mem_test "
           << "--spec-1=<spec> "
           << "[--spec-2=<spec>]"
           << std::endl
+          << "    or disk_cache_mem_test --memory-cache=<backing>"
+          << std::endl
+          << "    or disk_cache_mem_test --simple-index=<entry_count>"
+          << std::endl
           << "  with <cache_spec>=<backend_type>:<cache_type>:<cache_path>"
           << std::endl
           << "       <backend_type>='block_file'|'simple'" << std::endl
           << "       <cache_type>='disk_cache'|'app_cache'" << std::endl
-          << "       <cache_path>=file system path" << std::endl;
+          << "       <cache_path>=file system path" << std::endl
+          << "  with <backing>='heap'|'discardable'" << std::endl;
 }
 
 bool ParseAndStoreSpec(const std::string& spec_str,
@@ -274,6 +399,28 @@ bool Main(int argc, char** argv) {
     PrintUsage(&std::cout);
     return true;
   }
+  if (command_line.HasSwitch(kMemoryCacheSwitch)) {
+    const std::string backing =
+        command_line.GetSwitchValueASCII(kMemoryCacheSwitch);
+    if (command_line.GetSwitches().size() != 1 ||
+        (backing != kHeapBacking && backing != kDiscardableBacking)) {
+      PrintUsage(&std::cerr);
+      return false;
+    }
+    return MemoryCacheTest(backing == kDiscardableBacking);
+  }
+  if (command_line.HasSwitch(kSimpleIndexSwitch)) {
+    int num_entries = 0;
+    if (command_line.GetSwitches().size() != 1 ||
+        !base::StringToInt(
+            command_line.GetSwitchValueASCII(kSimpleIndexSwitch),
+            &num_entries) ||
+        num_entries <= 0) {
+      PrintUsage(&std::cerr);
+      return false;
+    }
+    return SimpleIndexMemoryTest(num_entries);
+  }
   if ((command_line.GetSwitches().size() != 1 &&
        command_line.GetSwitches().size() != 2) ||
       !command_line.HasSwitch("spec-1") ||
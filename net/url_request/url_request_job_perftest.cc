@@ -0,0 +1,163 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/url_request/url_request_job.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/run_loop.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/base/request_priority.h"
+#include "net/base/sdch_manager.h"
+#include "net/http/http_transaction_test_util.h"
+#include "net/url_request/url_request.h"
+#include "net/url_request/url_request_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+#include "url/gurl.h"
+
+namespace net {
+
+namespace {
+
+const int kBodySize = 8 * 1024 * 1024;
+
+const char kSampleDomain[] = "sdchtest.com";
+const char kVcdiffDictionary[] = "DictionaryFor"
+    "SdchCompression1SdchCompression2SdchCompression3SdchCompression\n";
+
+// Text that kVcdiffWindow decodes to with kVcdiffDictionary.
+const char kDecodedText[] = "0000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000TestData "
+    "SdchCompression1SdchCompression2SdchCompression3SdchCompression"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000\n";
+
+// A VCDIFF stream is a header followed by independent windows, so repeating
+// the window repeats the decoded text.
+const char kVcdiffHeader[] = "\326\303\304\0\0";
+const char kVcdiffWindow[] =
+    "\001M\0\201S\202\004\0\201E\006\001"
+    "00000000000000000000000000000000000000000000000000000000000000000000000000"
+    "TestData 00000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000\n\001S\023\077\001r\r";
+
+const int kNumWindows = kBodySize / (sizeof(kDecodedText) - 1);
+
+// The body served by ServeResponseData().
+const std::string* g_response_data = NULL;
+
+void ServeResponseData(const HttpRequestInfo* request,
+                       std::string* response_status,
+                       std::string* response_headers,
+                       std::string* response_data) {
+  *response_data = *g_response_data;
+}
+
+std::string GZipCompress(const std::string& input) {
+  z_stream zlib_stream;
+  memset(&zlib_stream, 0, sizeof(zlib_stream));
+  // Adding 16 to the window bits asks for a gzip header and footer.
+  CHECK_EQ(Z_OK, deflateInit2(&zlib_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                              MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY));
+
+  std::string output(deflateBound(&zlib_stream, input.size()), '\0');
+  zlib_stream.next_in = bit_cast<Bytef*>(input.data());
+  zlib_stream.avail_in = input.size();
+  zlib_stream.next_out = bit_cast<Bytef*>(&output[0]);
+  zlib_stream.avail_out = output.size();
+  CHECK_EQ(Z_STREAM_END, deflate(&zlib_stream, Z_FINISH));
+  output.resize(output.size() - zlib_stream.avail_out);
+  deflateEnd(&zlib_stream);
+  return output;
+}
+
+class URLRequestJobPerfTest : public testing::Test {
+ protected:
+  URLRequestJobPerfTest() {
+    for (int i = 0; i < kNumWindows; ++i)
+      decoded_body_.append(kDecodedText, sizeof(kDecodedText) - 1);
+    context_.set_http_transaction_factory(&network_layer_);
+  }
+
+  // Fetches |transaction| through a URLRequest, and logs the throughput of
+  // the decoded body as |test_name|.
+  void ReadDecodedBody(const char* test_name,
+                       const MockTransaction& transaction,
+                       const std::string& encoded_body) {
+    g_response_data = &encoded_body;
+    ScopedMockTransaction scoped_transaction(transaction);
+
+    TestDelegate delegate;
+    scoped_ptr<URLRequest> request(context_.CreateRequest(
+        GURL(transaction.url), DEFAULT_PRIORITY, &delegate, NULL));
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    request->Start();
+    base::RunLoop().Run();
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    EXPECT_TRUE(request->status().is_success());
+    EXPECT_EQ(decoded_body_, delegate.data_received());
+    base::LogPerfResult(
+        test_name,
+        decoded_body_.size() / (1024.0 * 1024.0) / elapsed.InSecondsF(),
+        "MB/s");
+    g_response_data = NULL;
+  }
+
+  std::string decoded_body_;
+  MockNetworkLayer network_layer_;
+  TestURLRequestContext context_;
+};
+
+TEST_F(URLRequestJobPerfTest, GZip) {
+  MockTransaction transaction(kSimpleGET_Transaction);
+  transaction.url = "http://www.example.com/gzip";
+  transaction.response_headers = "Content-Type: text/html\n"
+                                 "Content-Encoding: gzip\n";
+  transaction.test_mode = TEST_MODE_SYNC_ALL;
+  transaction.handler = &ServeResponseData;
+
+  ReadDecodedBody("URLRequestJob_gzip_decode", transaction,
+                  GZipCompress(decoded_body_));
+}
+
+TEST_F(URLRequestJobPerfTest, SdchAndGZip) {
+  SdchManager sdch_manager;
+  context_.set_sdch_manager(&sdch_manager);
+
+  std::string dictionary = std::string("Domain: ") + kSampleDomain + "\n\n" +
+                           kVcdiffDictionary;
+  const std::string url = std::string("http://") + kSampleDomain + "/sdch";
+  sdch_manager.AddSdchDictionary(dictionary, GURL(url));
+
+  std::string client_hash;
+  std::string server_hash;
+  SdchManager::GenerateHash(dictionary, &client_hash, &server_hash);
+  std::string sdch_body(server_hash);
+  sdch_body.append("\0", 1);
+  sdch_body.append(kVcdiffHeader, sizeof(kVcdiffHeader) - 1);
+  for (int i = 0; i < kNumWindows; ++i)
+    sdch_body.append(kVcdiffWindow, sizeof(kVcdiffWindow) - 1);
+
+  MockTransaction transaction(kSimpleGET_Transaction);
+  transaction.url = url.c_str();
+  transaction.response_headers = "Content-Type: text/html\n"
+                                 "Content-Encoding: sdch,gzip\n";
+  transaction.test_mode = TEST_MODE_SYNC_ALL;
+  transaction.handler = &ServeResponseData;
+
+  ReadDecodedBody("URLRequestJob_sdch_and_gzip_decode", transaction,
+                  GZipCompress(sdch_body));
+  context_.set_sdch_manager(NULL);
+}
+
+}  // namespace
+
+}  // namespace net